@@ -0,0 +1,178 @@
+#include "Arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* every allocation is 16-byte aligned so vertex arrays can be used with SSE loads */
+
+#define ARENA_ALIGNMENT 16
+
+typedef struct ArenaBlock ArenaBlock;
+struct ArenaBlock {
+    ArenaBlock* next;
+
+    unsigned char* data;
+    size_t capacity;
+    size_t used;
+};
+
+struct Arena {
+    ArenaBlock* head;
+
+    size_t blockSize;
+    size_t bytesUsed;
+    size_t bytesReserved;
+
+    unsigned int blockCount;
+};
+
+ArenaBlock* createArenaBlock(Arena* arena, size_t capacity) {
+    ArenaBlock* output;
+    uintptr_t address;
+
+    /* the block header and its data share one allocation, with slack for alignment */
+
+    output = (ArenaBlock*)malloc(sizeof(ArenaBlock) + capacity + ARENA_ALIGNMENT);
+    if (output == NULL) return NULL;
+
+    address = (uintptr_t)(output + 1);
+    address = (address + ARENA_ALIGNMENT - 1) & ~(uintptr_t)(ARENA_ALIGNMENT - 1);
+
+    output->next = NULL;
+    output->data = (unsigned char*)address;
+    output->capacity = capacity;
+    output->used = 0;
+
+    arena->bytesReserved += capacity;
+    arena->blockCount++;
+
+    return output;
+}
+
+Arena* createArena(size_t blockSize) {
+    Arena* output = (Arena*)calloc(1, sizeof(Arena));
+
+    output->blockSize = blockSize;
+
+    return output;
+}
+
+void freeArena(Arena* arena) {
+    while (arena->head != NULL) {
+        ArenaBlock* toFree = arena->head;
+        arena->head = arena->head->next;
+        free(toFree);
+    }
+
+    free(arena);
+}
+
+/* moves every block of other into arena, then frees other */
+
+void absorbArena(Arena* arena, Arena* other) {
+    ArenaBlock* tail = other->head;
+
+    if (tail != NULL) {
+        while (tail->next != NULL) tail = tail->next;
+
+        /* commentary: the absorbed blocks go behind the current head so it stays the block being filled */
+
+        if (arena->head != NULL) {
+            tail->next = arena->head->next;
+            arena->head->next = other->head;
+        }
+        else {
+            arena->head = other->head;
+        }
+    }
+
+    arena->bytesUsed += other->bytesUsed;
+    arena->bytesReserved += other->bytesReserved;
+    arena->blockCount += other->blockCount;
+
+    free(other);
+}
+
+void resetArena(Arena* arena) {
+    ArenaBlock* kept = NULL;
+
+    while (arena->head != NULL) {
+        ArenaBlock* block = arena->head;
+        arena->head = arena->head->next;
+
+        /* commentary: only an ordinary-sized block is kept, so one huge allocation does not stay reserved forever */
+
+        if (kept == NULL && block->capacity == arena->blockSize) kept = block;
+        else free(block);
+    }
+
+    arena->bytesUsed = 0;
+    arena->bytesReserved = 0;
+    arena->blockCount = 0;
+
+    if (kept != NULL) {
+        kept->next = NULL;
+        kept->used = 0;
+
+        arena->head = kept;
+        arena->bytesReserved = kept->capacity;
+        arena->blockCount = 1;
+    }
+}
+
+void* allocateFromArena(Arena* arena, size_t size) {
+    ArenaBlock* block;
+    void* output;
+
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    block = arena->head;
+
+    if (block == NULL || block->capacity - block->used < size) {
+        /* commentary: oversized requests get a block of their own behind the current one,
+           so the space left in the current block is not thrown away */
+
+        if (size > arena->blockSize / 4 && block != NULL) {
+            block = createArenaBlock(arena, size);
+            if (block == NULL) return NULL;
+
+            block->next = arena->head->next;
+            arena->head->next = block;
+        }
+        else {
+            block = createArenaBlock(arena, (size > arena->blockSize) ? size : arena->blockSize);
+            if (block == NULL) return NULL;
+
+            block->next = arena->head;
+            arena->head = block;
+        }
+    }
+
+    output = block->data + block->used;
+    block->used += size;
+
+    arena->bytesUsed += size;
+
+    return output;
+}
+
+void* allocateZeroedFromArena(Arena* arena, size_t size) {
+    void* output = allocateFromArena(arena, size);
+
+    if (output != NULL) memset(output, 0, size);
+
+    return output;
+}
+
+size_t getBytesUsedFromArena(Arena* arena) {
+    return arena->bytesUsed;
+}
+
+size_t getBytesReservedFromArena(Arena* arena) {
+    return arena->bytesReserved;
+}
+
+unsigned int getBlockCountFromArena(Arena* arena) {
+    return arena->blockCount;
+}
@@ -0,0 +1,30 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+/* commentary: an arena hands out memory from large blocks and releases all of it at once */
+
+typedef struct Arena Arena;
+struct Arena;
+
+Arena* createArena(size_t blockSize);
+
+void freeArena(Arena* arena);
+
+void absorbArena(Arena* arena, Arena* other);
+
+/* releases everything allocated so far but keeps one block for reuse */
+void resetArena(Arena* arena);
+
+void* allocateFromArena(Arena* arena, size_t size);
+
+void* allocateZeroedFromArena(Arena* arena, size_t size);
+
+size_t getBytesUsedFromArena(Arena* arena);
+
+size_t getBytesReservedFromArena(Arena* arena);
+
+unsigned int getBlockCountFromArena(Arena* arena);
+
+#endif
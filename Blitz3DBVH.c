@@ -0,0 +1,532 @@
+#include "Blitz3DBVH.h"
+#include "Blitz3DFileInternal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Blitz3D bounding volume hierarchy */
+
+/* a leaf holds at most this many ranges; testing a few boxes beats another level of nodes */
+#define BLITZ3D_BVH_LEAF_SIZE 4
+
+/* one bit per frustum plane */
+#define BLITZ3D_BVH_ALL_PLANES 0x3f
+
+struct Blitz3DBVH {
+    Blitz3DBatchSet* batchSet;
+
+    unsigned int nodeCount;
+    Blitz3DTreeNode* nodeArray;
+
+    /* in node order: each item's range, numbered across the whole set, and its box (6 floats) */
+    unsigned int itemCount;
+    unsigned int* itemRangeArray;
+    float* itemBoxArray;
+
+    /* the set's ranges are numbered batch by batch, the ranges of batch b starting at rangeStartArray[b];
+       the visible ones are a bit each, so clearing and scanning them skips 64 culled ranges at a time */
+    unsigned int batchCount;
+    unsigned int* rangeStartArray;
+    uint64_t* visibleBitArray;
+    unsigned int visibleWordCount;
+
+    /* the draws of batch b are drawStartArray[b] onwards in the two draw arrays, which have room for
+       one draw per range; with indexOffsets set the pointers are offsets into an index buffer */
+    unsigned int* drawStartArray;
+    unsigned int* drawCountArray;
+    int* drawIndexCountArray;
+    const void** drawIndexPointerArray;
+    int indexOffsets;
+
+    /* visibleCount is what is left of frustumVisibleCount once the ranges given to cull within are taken */
+    unsigned int visibleCount, frustumVisibleCount, culledCount, nodesTestedCount;
+};
+
+typedef struct Blitz3DBVHBuilder Blitz3DBVHBuilder;
+struct Blitz3DBVHBuilder {
+    Blitz3DBVH* bvh;
+
+    /* per item, in the order the ranges were found; order is the permutation the splits work on */
+    unsigned int* ranges;
+    float* boxes;
+    float* centers;
+    unsigned int* order;
+};
+
+typedef struct Blitz3DTreeBuilder Blitz3DTreeBuilder;
+struct Blitz3DTreeBuilder {
+    Blitz3DTreeNode* nodes;
+    unsigned int nodeCount;
+
+    const float* boxes;
+    const float* centers;
+    unsigned int* order;
+    unsigned int leafSize;
+};
+
+/* building */
+
+/* commentary: a quickselect, so the items of a node end up on the right side of its median without
+   sorting them */
+
+void selectItemsByCenter(unsigned int* order, const float* centers, unsigned int axis, unsigned int count,
+    unsigned int median) {
+    int low = 0, high = (int)count - 1;
+
+    while (low < high) {
+        float pivot = centers[3 * (size_t)order[(low + high) / 2] + axis];
+        int left = low, right = high;
+
+        while (left <= right) {
+            while (centers[3 * (size_t)order[left] + axis] < pivot) left++;
+            while (centers[3 * (size_t)order[right] + axis] > pivot) right--;
+
+            if (left <= right) {
+                unsigned int swap = order[left];
+
+                order[left] = order[right];
+                order[right] = swap;
+                left++;
+                right--;
+            }
+        }
+
+        if ((int)median <= right) high = right;
+        else if ((int)median >= left) low = left;
+        else break;
+    }
+}
+
+void buildTreeNode(Blitz3DTreeBuilder* builder, unsigned int firstItem, unsigned int itemCount) {
+    Blitz3DTreeNode* node = &(builder->nodes[builder->nodeCount++]);
+    float centerMinimum[3], centerMaximum[3], extent = -1.0f;
+    unsigned int iter, axis, splitAxis = 0, half;
+
+    node->firstItem = firstItem;
+    node->itemCount = itemCount;
+    node->axis = -1;
+
+    for (axis = 0; axis < 3; axis++) {
+        node->minimum[axis] = centerMinimum[axis] = (float)HUGE_VAL;
+        node->maximum[axis] = centerMaximum[axis] = -(float)HUGE_VAL;
+    }
+
+    for (iter = firstItem; iter < firstItem + itemCount; iter++) {
+        const float* box = builder->boxes + 6 * (size_t)builder->order[iter];
+        const float* center = builder->centers + 3 * (size_t)builder->order[iter];
+
+        for (axis = 0; axis < 3; axis++) {
+            if (box[axis] < node->minimum[axis]) node->minimum[axis] = box[axis];
+            if (box[3 + axis] > node->maximum[axis]) node->maximum[axis] = box[3 + axis];
+            if (center[axis] < centerMinimum[axis]) centerMinimum[axis] = center[axis];
+            if (center[axis] > centerMaximum[axis]) centerMaximum[axis] = center[axis];
+        }
+    }
+
+    if (itemCount > builder->leafSize) {
+        for (axis = 0; axis < 3; axis++) {
+            if (centerMaximum[axis] - centerMinimum[axis] > extent) {
+                extent = centerMaximum[axis] - centerMinimum[axis];
+                splitAxis = axis;
+            }
+        }
+
+        node->axis = (int)splitAxis;
+
+        half = itemCount / 2;
+        selectItemsByCenter(builder->order + firstItem, builder->centers, splitAxis, itemCount, half);
+
+        buildTreeNode(builder, firstItem, half);
+        buildTreeNode(builder, firstItem + half, itemCount - half);
+    }
+
+    /* the node array is allocated up front, so the pointer is still good after the recursion */
+    node->end = builder->nodeCount;
+}
+
+unsigned int buildMedianSplitTree(Blitz3DTreeNode* nodes, const float* boxes, const float* centers, unsigned int* order,
+    unsigned int count, unsigned int leafSize) {
+    Blitz3DTreeBuilder builder;
+    unsigned int iter;
+
+    if (count == 0) return 0;
+
+    builder.nodes = nodes;
+    builder.nodeCount = 0;
+    builder.boxes = boxes;
+    builder.centers = centers;
+    builder.order = order;
+    builder.leafSize = leafSize;
+
+    for (iter = 0; iter < count; iter++) order[iter] = iter;
+
+    buildTreeNode(&builder, 0, count);
+
+    return builder.nodeCount;
+}
+
+int collectBVHItems(Blitz3DBVHBuilder* builder) {
+    Blitz3DBVH* bvh = builder->bvh;
+    unsigned int batchIndex, rangeIndex, axis, rangeCount = 0;
+
+    for (batchIndex = 0; batchIndex < bvh->batchCount; batchIndex++) {
+        Blitz3DBatch* batch = getBatchArrayEntryFromBatchSet(bvh->batchSet, batchIndex);
+
+        bvh->rangeStartArray[batchIndex] = rangeCount;
+        rangeCount += getRangeArrayCountFromBatch(batch);
+    }
+
+    bvh->rangeStartArray[bvh->batchCount] = rangeCount;
+
+    builder->ranges = (unsigned int*)malloc((rangeCount + 1) * sizeof(unsigned int));
+    builder->boxes = (float*)malloc((rangeCount + 1) * 6 * sizeof(float));
+    builder->centers = (float*)malloc((rangeCount + 1) * 3 * sizeof(float));
+    builder->order = (unsigned int*)malloc((rangeCount + 1) * sizeof(unsigned int));
+    bvh->visibleWordCount = (rangeCount + 63) / 64;
+    bvh->visibleBitArray = (uint64_t*)calloc(bvh->visibleWordCount + 1, sizeof(uint64_t));
+    bvh->drawIndexCountArray = (int*)malloc((rangeCount + 1) * sizeof(int));
+    bvh->drawIndexPointerArray = (const void**)malloc((rangeCount + 1) * sizeof(void*));
+
+    if (builder->ranges == NULL || builder->boxes == NULL) return -1;
+    if (builder->centers == NULL || builder->order == NULL) return -1;
+    if (bvh->visibleBitArray == NULL || bvh->drawIndexCountArray == NULL || bvh->drawIndexPointerArray == NULL) return -1;
+
+    for (batchIndex = 0; batchIndex < bvh->batchCount; batchIndex++) {
+        Blitz3DBatch* batch = getBatchArrayEntryFromBatchSet(bvh->batchSet, batchIndex);
+
+        for (rangeIndex = 0; rangeIndex < getRangeArrayCountFromBatch(batch); rangeIndex++) {
+            Blitz3DBatchRange* range = getRangeArrayEntryFromBatch(batch, rangeIndex);
+            Blitz3DBounds* bounds = getBoundsFromBatchRange(range);
+            float* box = builder->boxes + 6 * (size_t)bvh->itemCount;
+
+            if (getIndexCountFromBatchRange(range) == 0 || !bounds->present) continue;
+
+            for (axis = 0; axis < 3; axis++) {
+                box[axis] = bounds->minimum[axis];
+                box[3 + axis] = bounds->maximum[axis];
+                builder->centers[3 * (size_t)bvh->itemCount + axis] = 0.5f * (box[axis] + box[3 + axis]);
+            }
+
+            builder->ranges[bvh->itemCount] = bvh->rangeStartArray[batchIndex] + rangeIndex;
+            bvh->itemCount++;
+        }
+    }
+
+    return 0;
+}
+
+Blitz3DBVH* createBVHFromBatchSet(Blitz3DBatchSet* batchSet) {
+    Blitz3DBVHBuilder builder;
+    Blitz3DBVH* output = (Blitz3DBVH*)calloc(1, sizeof(Blitz3DBVH));
+    unsigned int iter;
+    int failed = 0;
+
+    if (output == NULL) return NULL;
+
+    memset(&builder, 0, sizeof(builder));
+    builder.bvh = output;
+
+    output->batchSet = batchSet;
+    output->batchCount = getBatchArrayCountFromBatchSet(batchSet);
+
+    output->rangeStartArray = (unsigned int*)malloc((output->batchCount + 1) * sizeof(unsigned int));
+    output->drawStartArray = (unsigned int*)malloc((output->batchCount + 1) * sizeof(unsigned int));
+    output->drawCountArray = (unsigned int*)calloc(output->batchCount + 1, sizeof(unsigned int));
+
+    if (output->rangeStartArray == NULL || output->drawStartArray == NULL || output->drawCountArray == NULL
+        || collectBVHItems(&builder) != 0) failed = 1;
+
+    if (!failed && output->itemCount > 0) {
+        output->nodeArray = (Blitz3DTreeNode*)malloc((2 * (size_t)output->itemCount - 1) * sizeof(Blitz3DTreeNode));
+        output->itemRangeArray = (unsigned int*)malloc(output->itemCount * sizeof(unsigned int));
+        output->itemBoxArray = (float*)malloc(6 * (size_t)output->itemCount * sizeof(float));
+
+        if (output->nodeArray == NULL || output->itemRangeArray == NULL || output->itemBoxArray == NULL) failed = 1;
+    }
+
+    if (!failed && output->itemCount > 0) {
+        output->nodeCount = buildMedianSplitTree(output->nodeArray, builder.boxes, builder.centers, builder.order,
+            output->itemCount, BLITZ3D_BVH_LEAF_SIZE);
+
+        for (iter = 0; iter < output->itemCount; iter++) {
+            output->itemRangeArray[iter] = builder.ranges[builder.order[iter]];
+            memcpy(output->itemBoxArray + 6 * (size_t)iter, builder.boxes + 6 * (size_t)builder.order[iter],
+                6 * sizeof(float));
+        }
+    }
+
+    free(builder.ranges);
+    free(builder.boxes);
+    free(builder.centers);
+    free(builder.order);
+
+    if (failed) {
+        freeBVH(output);
+        return NULL;
+    }
+
+    return output;
+}
+
+void freeBVH(Blitz3DBVH* bvh) {
+    free(bvh->nodeArray);
+    free(bvh->itemRangeArray);
+    free(bvh->itemBoxArray);
+    free(bvh->rangeStartArray);
+    free(bvh->visibleBitArray);
+    free(bvh->drawStartArray);
+    free(bvh->drawCountArray);
+    free(bvh->drawIndexCountArray);
+    free(bvh->drawIndexPointerArray);
+    free(bvh);
+}
+
+/* culling */
+
+/* commentary: the planes come straight out of the combined matrix (Gribb and Hartmann), as the sums
+   and differences of its last row with the other three; they are not normalized, which the box test
+   does not need */
+
+void getFrustumPlanesFromMatrices(const float* projection, const float* modelview, float* planes) {
+    float clip[16];
+    unsigned int row, column, iter;
+
+    for (column = 0; column < 4; column++) {
+        for (row = 0; row < 4; row++) {
+            clip[4 * column + row] = projection[row] * modelview[4 * column]
+                + projection[4 + row] * modelview[4 * column + 1]
+                + projection[8 + row] * modelview[4 * column + 2]
+                + projection[12 + row] * modelview[4 * column + 3];
+        }
+    }
+
+    /* left, right, bottom, top, near, far */
+
+    for (iter = 0; iter < 6; iter++) {
+        float sign = (iter % 2 == 0) ? 1.0f : -1.0f;
+
+        for (column = 0; column < 4; column++) {
+            planes[4 * iter + column] = clip[4 * column + 3] + sign * clip[4 * column + iter / 2];
+        }
+    }
+}
+
+/* commentary: each node is tested against the planes its parent is not already inside of, given as a
+   bit mask; a box inside a plane takes the plane out of the mask its children get, and a node whose
+   mask runs out is inside the whole frustum */
+
+/* returns -1 when the box is outside a plane, else the planes of the mask that cut it */
+
+int classifyBoxAgainstPlanes(const float* planes, unsigned int mask, const float* minimum, const float* maximum) {
+    unsigned int output = mask;
+    unsigned int iter, axis;
+
+    for (iter = 0; iter < 6; iter++) {
+        const float* plane = planes + 4 * iter;
+        float farthest = plane[3], nearest = plane[3];
+
+        if (!(mask & (1u << iter))) continue;
+
+        for (axis = 0; axis < 3; axis++) {
+            if (plane[axis] >= 0.0f) {
+                farthest += plane[axis] * maximum[axis];
+                nearest += plane[axis] * minimum[axis];
+            } else {
+                farthest += plane[axis] * minimum[axis];
+                nearest += plane[axis] * maximum[axis];
+            }
+        }
+
+        if (farthest < 0.0f) return -1;
+        if (nearest >= 0.0f) output &= ~(1u << iter);
+    }
+
+    return (int)output;
+}
+
+void markBVHItemsVisible(Blitz3DBVH* bvh, unsigned int firstItem, unsigned int itemCount) {
+    unsigned int iter;
+
+    for (iter = firstItem; iter < firstItem + itemCount; iter++) {
+        unsigned int range = bvh->itemRangeArray[iter];
+
+        bvh->visibleBitArray[range / 64] |= (uint64_t)1 << (range % 64);
+    }
+
+    bvh->visibleCount += itemCount;
+}
+
+/* a node's first child comes right after it and its second child where the first one's subtree ends */
+
+void cullBVHNode(Blitz3DBVH* bvh, const float* planes, unsigned int node, unsigned int mask) {
+    Blitz3DTreeNode* current = &(bvh->nodeArray[node]);
+    int classification = classifyBoxAgainstPlanes(planes, mask, current->minimum, current->maximum);
+    unsigned int iter;
+
+    bvh->nodesTestedCount++;
+
+    if (classification < 0) return;
+
+    if (classification == 0) {
+        markBVHItemsVisible(bvh, current->firstItem, current->itemCount);
+    }
+    else if (current->axis < 0) {
+        for (iter = current->firstItem; iter < current->firstItem + current->itemCount; iter++) {
+            const float* box = bvh->itemBoxArray + 6 * (size_t)iter;
+
+            if (classifyBoxAgainstPlanes(planes, (unsigned int)classification, box, box + 3) >= 0) {
+                markBVHItemsVisible(bvh, iter, 1);
+            }
+        }
+    }
+    else {
+        cullBVHNode(bvh, planes, node + 1, (unsigned int)classification);
+        cullBVHNode(bvh, planes, bvh->nodeArray[node + 1].end, (unsigned int)classification);
+    }
+}
+
+/* visible ranges that follow each other in a batch's index array become one draw */
+
+void buildDrawListsInBVH(Blitz3DBVH* bvh) {
+    Blitz3DBatch* batch = NULL;
+    const char* indices = NULL;
+    unsigned int batchIndex = 0, drawIndex = 0, drawEnd = 0, indexSize = 0;
+    unsigned int word, bit;
+
+    for (batchIndex = 0; batchIndex < bvh->batchCount; batchIndex++) {
+        bvh->drawStartArray[batchIndex] = 0;
+        bvh->drawCountArray[batchIndex] = 0;
+    }
+
+    batchIndex = 0;
+
+    for (word = 0; word < bvh->visibleWordCount; word++) {
+        uint64_t bits = bvh->visibleBitArray[word];
+
+        for (bit = 0; bits != 0; bit++, bits >>= 1) {
+            unsigned int range = 64 * word + bit;
+            Blitz3DBatchRange* batchRange;
+            unsigned int firstIndex, indexCount;
+
+            if (!(bits & 1)) continue;
+
+            /* the ranges come in order, so the batch only ever moves forward */
+
+            while (range >= bvh->rangeStartArray[batchIndex + 1]) batchIndex++;
+
+            if (bvh->drawCountArray[batchIndex] == 0) {
+                batch = getBatchArrayEntryFromBatchSet(bvh->batchSet, batchIndex);
+                indexSize = getIndexSizeFromBatch(batch);
+                indices = (indexSize == 2) ? (const char*)getShortIndexArrayFromBatch(batch)
+                    : (const char*)getIndexArrayFromBatch(batch);
+
+                bvh->drawStartArray[batchIndex] = drawIndex;
+            }
+
+            batchRange = getRangeArrayEntryFromBatch(batch, range - bvh->rangeStartArray[batchIndex]);
+            firstIndex = getFirstIndexFromBatchRange(batchRange);
+            indexCount = getIndexCountFromBatchRange(batchRange);
+
+            if (bvh->drawCountArray[batchIndex] > 0 && drawEnd == firstIndex) {
+                bvh->drawIndexCountArray[drawIndex - 1] += (int)indexCount;
+            } else {
+                bvh->drawIndexCountArray[drawIndex] = (int)indexCount;
+                bvh->drawIndexPointerArray[drawIndex] = bvh->indexOffsets
+                    ? (const void*)((size_t)firstIndex * indexSize)
+                    : (const void*)(indices + (size_t)firstIndex * indexSize);
+                bvh->drawCountArray[batchIndex]++;
+                drawIndex++;
+            }
+
+            drawEnd = firstIndex + indexCount;
+        }
+    }
+}
+
+unsigned int countBitsInWord(uint64_t word) {
+    word = word - ((word >> 1) & 0x5555555555555555ULL);
+    word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+
+    return (unsigned int)((word * 0x0101010101010101ULL) >> 56);
+}
+
+void cullBVH(Blitz3DBVH* bvh, const float* planes) {
+    cullBVHWithinRanges(bvh, planes, NULL);
+}
+
+void cullBVHWithinRanges(Blitz3DBVH* bvh, const float* planes, const uint64_t* rangeBits) {
+    unsigned int word;
+
+    memset(bvh->visibleBitArray, 0, bvh->visibleWordCount * sizeof(uint64_t));
+    bvh->visibleCount = 0;
+    bvh->nodesTestedCount = 0;
+
+    if (bvh->nodeCount > 0) cullBVHNode(bvh, planes, 0, BLITZ3D_BVH_ALL_PLANES);
+
+    bvh->frustumVisibleCount = bvh->visibleCount;
+
+    /* the frustum is cheap to test from the top down, so the ranges left out are taken away afterwards */
+
+    if (rangeBits != NULL) {
+        bvh->visibleCount = 0;
+
+        for (word = 0; word < bvh->visibleWordCount; word++) {
+            bvh->visibleBitArray[word] &= rangeBits[word];
+            bvh->visibleCount += countBitsInWord(bvh->visibleBitArray[word]);
+        }
+    }
+
+    bvh->culledCount = bvh->itemCount - bvh->visibleCount;
+
+    buildDrawListsInBVH(bvh);
+}
+
+/* public functions */
+
+unsigned int getNodeCountFromBVH(Blitz3DBVH* bvh) {
+    return bvh->nodeCount;
+}
+
+unsigned int getItemCountFromBVH(Blitz3DBVH* bvh) {
+    return bvh->itemCount;
+}
+
+unsigned int getVisibleCountFromBVH(Blitz3DBVH* bvh) {
+    return bvh->visibleCount;
+}
+
+unsigned int getCulledCountFromBVH(Blitz3DBVH* bvh) {
+    return bvh->culledCount;
+}
+
+unsigned int getFrustumVisibleCountFromBVH(Blitz3DBVH* bvh) {
+    return bvh->frustumVisibleCount;
+}
+
+unsigned int getNodesTestedCountFromBVH(Blitz3DBVH* bvh) {
+    return bvh->nodesTestedCount;
+}
+
+int rangeVisibleInBVH(Blitz3DBVH* bvh, unsigned int batchIndex, unsigned int rangeIndex) {
+    unsigned int range = bvh->rangeStartArray[batchIndex] + rangeIndex;
+
+    return (int)((bvh->visibleBitArray[range / 64] >> (range % 64)) & 1);
+}
+
+void useIndexOffsetsInBVH(Blitz3DBVH* bvh, int offsets) {
+    bvh->indexOffsets = offsets;
+}
+
+unsigned int getDrawCountFromBVH(Blitz3DBVH* bvh, unsigned int batchIndex) {
+    return bvh->drawCountArray[batchIndex];
+}
+
+int* getDrawIndexCountArrayFromBVH(Blitz3DBVH* bvh, unsigned int batchIndex) {
+    return bvh->drawIndexCountArray + bvh->drawStartArray[batchIndex];
+}
+
+const void** getDrawIndexPointerArrayFromBVH(Blitz3DBVH* bvh, unsigned int batchIndex) {
+    return bvh->drawIndexPointerArray + bvh->drawStartArray[batchIndex];
+}
@@ -0,0 +1,67 @@
+#ifndef _BLITZ3DBVH_H_
+#define _BLITZ3DBVH_H_
+
+#include "Blitz3DBatch.h"
+
+/* commentary: a bounding volume hierarchy over the ranges of a batch set, one item per range with
+   triangles in it, for frustum culling. Built once at load by splitting the items at the median of
+   their centers along the longest axis until few enough are left for a leaf.
+
+   The nodes are stored depth first like the scene's, each with the end of its subtree and the run of
+   items under it. A node outside a plane is dropped with its subtree, a node inside every plane takes
+   its items without testing them, and children are only tested against the planes their parent
+   straddles. Leaves test their items one by one.
+
+   After culling, each batch has a list of draws (index counts and pointers into the batch's index
+   array, or offsets into an index buffer) for glMultiDrawElements, with the visible ranges that
+   follow each other in the index array merged into one draw. The BVH refers to the batch set and
+   must be freed before it */
+
+typedef struct Blitz3DBVH Blitz3DBVH;
+struct Blitz3DBVH;
+
+/* returns NULL if out of memory */
+Blitz3DBVH* createBVHFromBatchSet(Blitz3DBatchSet* batchSet);
+
+void freeBVH(Blitz3DBVH* bvh);
+
+/* the six planes (a, b, c, d: inside where ax + by + cz + d >= 0) of the view volume of the column-major
+   projection and modelview matrices, in the space the modelview takes from */
+void getFrustumPlanesFromMatrices(const float* projection, const float* modelview, float* planes);
+
+/* 24 floats as above; fills in the visible ranges and the draw lists */
+void cullBVH(Blitz3DBVH* bvh, const float* planes);
+
+/* as cullBVH, but only ranges with their bit set in rangeBits can be visible: a bit per range, 64 to a
+   word, with the set's ranges numbered batch by batch (see Blitz3DPVS.h). NULL allows every range */
+void cullBVHWithinRanges(Blitz3DBVH* bvh, const float* planes, const uint64_t* rangeBits);
+
+unsigned int getNodeCountFromBVH(Blitz3DBVH* bvh);
+
+/* the ranges with triangles; empty ranges are never drawn and never counted */
+unsigned int getItemCountFromBVH(Blitz3DBVH* bvh);
+
+/* counts from the last cullBVH */
+unsigned int getVisibleCountFromBVH(Blitz3DBVH* bvh);
+
+unsigned int getCulledCountFromBVH(Blitz3DBVH* bvh);
+
+/* the ranges inside the frustum, before rangeBits took any away */
+unsigned int getFrustumVisibleCountFromBVH(Blitz3DBVH* bvh);
+
+unsigned int getNodesTestedCountFromBVH(Blitz3DBVH* bvh);
+
+int rangeVisibleInBVH(Blitz3DBVH* bvh, unsigned int batchIndex, unsigned int rangeIndex);
+
+/* with offsets set, the draw pointers below are byte offsets from the start of the batch's index array
+   (for an index buffer holding it) rather than pointers into it; takes effect from the next cull */
+void useIndexOffsetsInBVH(Blitz3DBVH* bvh, int offsets);
+
+/* the last cull's draws for a batch, for glMultiDrawElements with the batch's index type */
+unsigned int getDrawCountFromBVH(Blitz3DBVH* bvh, unsigned int batchIndex);
+
+int* getDrawIndexCountArrayFromBVH(Blitz3DBVH* bvh, unsigned int batchIndex);
+
+const void** getDrawIndexPointerArrayFromBVH(Blitz3DBVH* bvh, unsigned int batchIndex);
+
+#endif
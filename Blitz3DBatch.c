@@ -0,0 +1,570 @@
+#include "Blitz3DBatch.h"
+#include "Blitz3DFileInternal.h"
+#include "Blitz3DScene.h"
+#include "DynamicArray.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Blitz3D static batches */
+
+#define BLITZ3D_MAX_TEX_COORD_SETS 8
+
+struct Blitz3DBatchRange {
+    Blitz3DNODEChunk* nodeChunk;
+    unsigned int trisChunkIndex;
+
+    unsigned int firstIndex, indexCount;
+    unsigned int firstVertex, vertexCount;
+
+    /* the TRIS chunk's bounds, in the same space as the batch */
+    Blitz3DBounds bounds;
+};
+
+/* commentary: while building, every stream is a DynamicArray of whole vertices and the indices are a
+   DynamicArray of whole triangles; finishBatch trims them and narrows the indices if it can */
+
+struct Blitz3DBatch {
+    int brushId;
+
+    unsigned int vertexCount;
+    DynamicArray vertices;
+    DynamicArray normals;
+    DynamicArray colors;
+    DynamicArray texCoords[BLITZ3D_MAX_TEX_COORD_SETS];
+
+    int hasNormals, hasColors;
+    unsigned int texCoordSets, texCoordSize;
+
+    unsigned int indexCount;
+    DynamicArray indices;
+    uint16_t* shortIndexArray;
+
+    DynamicArray ranges;
+};
+
+struct Blitz3DBatchSet {
+    Blitz3DBatch** batchArray;
+    unsigned int batchCount;
+};
+
+typedef struct Blitz3DBatchBuilder Blitz3DBatchBuilder;
+struct Blitz3DBatchBuilder {
+    /* one slot per brush id, plus one in front for -1 */
+    Blitz3DBatch** batchesByBrush;
+    unsigned int brushCount;
+
+    /* remapStamps[v] == stamp means vertex v of the current mesh is remapIndices[v] in the current batch */
+    unsigned int* remapStamps;
+    unsigned int* remapIndices;
+    unsigned int remapCapacity;
+    unsigned int stamp;
+
+    /* set while copying a mesh of a scene; NULL copies vertices as they are */
+    const float* worldMatrix;
+    float normalMatrix[9];
+
+    int error;
+};
+
+/* building */
+
+Blitz3DBatch* createBatch(int brushId) {
+    Blitz3DBatch* output = (Blitz3DBatch*)calloc(1, sizeof(Blitz3DBatch));
+    unsigned int iter;
+
+    if (output == NULL) return NULL;
+
+    output->brushId = brushId;
+
+    initializeDynamicArray(&(output->vertices), 3 * sizeof(float), NULL);
+    initializeDynamicArray(&(output->normals), 3 * sizeof(float), NULL);
+    initializeDynamicArray(&(output->colors), 4 * sizeof(float), NULL);
+
+    for (iter = 0; iter < BLITZ3D_MAX_TEX_COORD_SETS; iter++) {
+        initializeDynamicArray(&(output->texCoords[iter]), 0, NULL);
+    }
+
+    initializeDynamicArray(&(output->indices), 3 * sizeof(unsigned int), NULL);
+    initializeDynamicArray(&(output->ranges), sizeof(Blitz3DBatchRange), NULL);
+
+    return output;
+}
+
+void freeBatch(Blitz3DBatch* batch) {
+    unsigned int iter;
+
+    freeDynamicArray(&(batch->vertices));
+    freeDynamicArray(&(batch->normals));
+    freeDynamicArray(&(batch->colors));
+
+    for (iter = 0; iter < BLITZ3D_MAX_TEX_COORD_SETS; iter++) freeDynamicArray(&(batch->texCoords[iter]));
+
+    freeDynamicArray(&(batch->indices));
+    free(batch->shortIndexArray);
+    freeDynamicArray(&(batch->ranges));
+
+    free(batch);
+}
+
+Blitz3DBatch* getBatchForBrush(Blitz3DBatchBuilder* builder, int brushId) {
+    Blitz3DBatch** slot;
+
+    if (brushId < 0 || (unsigned int)brushId >= builder->brushCount) brushId = -1;
+
+    slot = &(builder->batchesByBrush[brushId + 1]);
+
+    if (*slot == NULL) {
+        *slot = createBatch(brushId);
+        if (*slot == NULL) builder->error = 1;
+    }
+
+    return *slot;
+}
+
+/* pushes count copies of value (components floats) onto a stream, for attributes a batch gains late */
+
+int fillBatchStream(DynamicArray* stream, const float* value, unsigned int components, unsigned int count) {
+    unsigned int iter;
+
+    for (iter = 0; iter < count; iter++) {
+        float* slot = (float*)pushOntoDynamicArray(stream);
+        if (slot == NULL) return -1;
+
+        memcpy(slot, value, components * sizeof(float));
+    }
+
+    return 0;
+}
+
+int addVertexToBatch(Blitz3DBatchBuilder* builder, Blitz3DBatch* batch, Blitz3DVRTSChunk* vrtsChunk, unsigned int vertex) {
+    const float zeros[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    unsigned int sourceSets, iter;
+    float* slot;
+
+    if (vrtsChunk->normalArray != NULL && !batch->hasNormals) {
+        if (fillBatchStream(&(batch->normals), zeros, 3, batch->vertexCount) != 0) return -1;
+        batch->hasNormals = 1;
+    }
+
+    if (vrtsChunk->colorArray != NULL && !batch->hasColors) {
+        if (fillBatchStream(&(batch->colors), white, 4, batch->vertexCount) != 0) return -1;
+        batch->hasColors = 1;
+    }
+
+    sourceSets = (vrtsChunk->tex_coord_set_size > 0) ? (unsigned int)vrtsChunk->tex_coord_sets : 0;
+    if (sourceSets > BLITZ3D_MAX_TEX_COORD_SETS) sourceSets = BLITZ3D_MAX_TEX_COORD_SETS;
+
+    if (batch->texCoordSize == 0 && sourceSets > 0) {
+        batch->texCoordSize = (unsigned int)vrtsChunk->tex_coord_set_size;
+        if (batch->texCoordSize > 4) batch->texCoordSize = 4;
+    }
+
+    for (; batch->texCoordSets < sourceSets; batch->texCoordSets++) {
+        DynamicArray* stream = &(batch->texCoords[batch->texCoordSets]);
+
+        stream->elementSize = batch->texCoordSize * sizeof(float);
+        if (fillBatchStream(stream, zeros, batch->texCoordSize, batch->vertexCount) != 0) return -1;
+    }
+
+    slot = (float*)pushOntoDynamicArray(&(batch->vertices));
+    if (slot == NULL) return -1;
+
+    if (builder->worldMatrix != NULL) transformPositionByMatrix(builder->worldMatrix, vrtsChunk->vertexArray + 3 * (size_t)vertex, slot);
+    else memcpy(slot, vrtsChunk->vertexArray + 3 * (size_t)vertex, 3 * sizeof(float));
+
+    if (batch->hasNormals) {
+        slot = (float*)pushOntoDynamicArray(&(batch->normals));
+        if (slot == NULL) return -1;
+
+        if (vrtsChunk->normalArray == NULL) memcpy(slot, zeros, 3 * sizeof(float));
+        else if (builder->worldMatrix != NULL) transformNormalByMatrix(builder->normalMatrix, vrtsChunk->normalArray + 3 * (size_t)vertex, slot);
+        else memcpy(slot, vrtsChunk->normalArray + 3 * (size_t)vertex, 3 * sizeof(float));
+    }
+
+    if (batch->hasColors) {
+        slot = (float*)pushOntoDynamicArray(&(batch->colors));
+        if (slot == NULL) return -1;
+
+        if (vrtsChunk->colorArray != NULL) memcpy(slot, vrtsChunk->colorArray + 4 * (size_t)vertex, 4 * sizeof(float));
+        else memcpy(slot, white, 4 * sizeof(float));
+    }
+
+    for (iter = 0; iter < batch->texCoordSets; iter++) {
+        unsigned int copied = 0;
+
+        slot = (float*)pushOntoDynamicArray(&(batch->texCoords[iter]));
+        if (slot == NULL) return -1;
+
+        if (iter < sourceSets) {
+            copied = (unsigned int)vrtsChunk->tex_coord_set_size;
+            if (copied > batch->texCoordSize) copied = batch->texCoordSize;
+
+            memcpy(slot, vrtsChunk->texCoordArrays[iter] + (size_t)vrtsChunk->tex_coord_set_size * vertex,
+                copied * sizeof(float));
+        }
+
+        memcpy(slot + copied, zeros, (batch->texCoordSize - copied) * sizeof(float));
+    }
+
+    batch->vertexCount++;
+
+    return 0;
+}
+
+int addTRISChunkToBatch(Blitz3DBatchBuilder* builder, Blitz3DBatch* batch, Blitz3DNODEChunk* nodeChunk,
+    Blitz3DVRTSChunk* vrtsChunk, Blitz3DTRISChunk* trisChunk, unsigned int trisChunkIndex) {
+
+    Blitz3DBatchRange* range;
+    unsigned int iter, corner;
+
+    range = (Blitz3DBatchRange*)pushOntoDynamicArray(&(batch->ranges));
+    if (range == NULL) return -1;
+
+    range->nodeChunk = nodeChunk;
+    range->trisChunkIndex = trisChunkIndex;
+    range->firstIndex = batch->indexCount;
+
+    if (builder->worldMatrix != NULL) transformBounds(&(trisChunk->bounds), builder->worldMatrix, &(range->bounds));
+    else memcpy(&(range->bounds), &(trisChunk->bounds), sizeof(Blitz3DBounds));
+
+    for (iter = 0; iter < trisChunk->triangleCount; iter++) {
+        unsigned int triangle[3];
+        unsigned int* slot;
+
+        for (corner = 0; corner < 3; corner++) {
+            triangle[corner] = getIndexFromTRISChunk(trisChunk, 3 * iter + corner);
+            if (triangle[corner] >= vrtsChunk->vertexCount) break;
+        }
+
+        if (corner < 3) continue;
+
+        for (corner = 0; corner < 3; corner++) {
+            unsigned int vertex = triangle[corner];
+
+            if (builder->remapStamps[vertex] != builder->stamp) {
+                builder->remapStamps[vertex] = builder->stamp;
+                builder->remapIndices[vertex] = batch->vertexCount;
+
+                if (addVertexToBatch(builder, batch, vrtsChunk, vertex) != 0) return -1;
+            }
+
+            triangle[corner] = builder->remapIndices[vertex];
+        }
+
+        slot = (unsigned int*)pushOntoDynamicArray(&(batch->indices));
+        if (slot == NULL) return -1;
+
+        memcpy(slot, triangle, sizeof(triangle));
+        batch->indexCount += 3;
+    }
+
+    range->indexCount = batch->indexCount - range->firstIndex;
+
+    return 0;
+}
+
+int resolveBrushIdOfTRISChunk(Blitz3DMESHChunk* meshChunk, unsigned int trisChunkIndex) {
+    int output = meshChunk->trisChunkArray[trisChunkIndex]->brush_id;
+
+    return (output == -1) ? meshChunk->brush_id : output;
+}
+
+/* commentary: a mesh's TRIS chunks are taken one brush at a time, so vertices shared by chunks of the
+   same brush are copied once; vertices shared between brushes are copied into each batch */
+
+void addMESHChunkToBatches(Blitz3DBatchBuilder* builder, Blitz3DNODEChunk* nodeChunk, Blitz3DMESHChunk* meshChunk) {
+    int wasPresent = meshDataPresentInMESHChunk(meshChunk);
+    Blitz3DVRTSChunk* vrtsChunk;
+    unsigned char* done;
+    unsigned int first, iter;
+
+    vrtsChunk = getVRTSChunkFromMESHChunk(meshChunk);
+    if (vrtsChunk == NULL || meshChunk->trisChunkCount == 0) return;
+
+    if (vrtsChunk->vertexCount > builder->remapCapacity) {
+        free(builder->remapStamps);
+        free(builder->remapIndices);
+
+        builder->remapCapacity = vrtsChunk->vertexCount;
+        builder->remapStamps = (unsigned int*)calloc(builder->remapCapacity, sizeof(unsigned int));
+        builder->remapIndices = (unsigned int*)malloc(builder->remapCapacity * sizeof(unsigned int));
+
+        if (builder->remapStamps == NULL || builder->remapIndices == NULL) {
+            builder->remapCapacity = 0;
+            builder->error = 1;
+            return;
+        }
+    }
+
+    done = (unsigned char*)calloc(meshChunk->trisChunkCount, 1);
+    if (done == NULL) {
+        builder->error = 1;
+        return;
+    }
+
+    for (first = 0; first < meshChunk->trisChunkCount && !builder->error; first++) {
+        int brushId = resolveBrushIdOfTRISChunk(meshChunk, first);
+        Blitz3DBatch* batch;
+        unsigned int firstVertex, firstRange;
+
+        if (done[first]) continue;
+
+        batch = getBatchForBrush(builder, brushId);
+        if (batch == NULL) break;
+
+        builder->stamp++;
+        firstVertex = batch->vertexCount;
+        firstRange = (unsigned int)getDynamicArrayCount(&(batch->ranges));
+
+        for (iter = first; iter < meshChunk->trisChunkCount; iter++) {
+            if (done[iter] || getBatchForBrush(builder, resolveBrushIdOfTRISChunk(meshChunk, iter)) != batch) continue;
+
+            done[iter] = 1;
+
+            if (addTRISChunkToBatch(builder, batch, nodeChunk, vrtsChunk, meshChunk->trisChunkArray[iter], iter) != 0) {
+                builder->error = 1;
+                break;
+            }
+        }
+
+        for (iter = firstRange; iter < getDynamicArrayCount(&(batch->ranges)); iter++) {
+            Blitz3DBatchRange* range = (Blitz3DBatchRange*)getDataFromDynamicArray(&(batch->ranges)) + iter;
+
+            range->firstVertex = firstVertex;
+            range->vertexCount = batch->vertexCount - firstVertex;
+        }
+    }
+
+    free(done);
+
+    if (!wasPresent) evictMESHChunk(meshChunk);
+}
+
+void addNODEChunkToBatches(Blitz3DBatchBuilder* builder, Blitz3DNODEChunk* nodeChunk) {
+    unsigned int iter;
+
+    if (nodeChunk->meshChunk != NULL) addMESHChunkToBatches(builder, nodeChunk, nodeChunk->meshChunk);
+
+    for (iter = 0; iter < nodeChunk->nodeChunkCount && !builder->error; iter++) {
+        addNODEChunkToBatches(builder, nodeChunk->nodeChunkArray[iter]);
+    }
+}
+
+/* gives back the capacity the geometric growth left over */
+
+void trimBatchStream(DynamicArray* stream) {
+    void* data;
+
+    if (stream->count == 0 || stream->count == stream->capacity) return;
+
+    data = realloc(stream->data, stream->count * stream->elementSize);
+    if (data == NULL) return;
+
+    stream->data = data;
+    stream->capacity = stream->count;
+}
+
+void finishBatch(Blitz3DBatch* batch) {
+    unsigned int iter;
+
+    trimBatchStream(&(batch->vertices));
+    trimBatchStream(&(batch->normals));
+    trimBatchStream(&(batch->colors));
+
+    for (iter = 0; iter < batch->texCoordSets; iter++) trimBatchStream(&(batch->texCoords[iter]));
+
+    trimBatchStream(&(batch->ranges));
+
+    if (batch->vertexCount <= BLITZ3D_MAX_SHORT_INDEX_VERTICES && batch->indexCount > 0) {
+        const unsigned int* indices = (const unsigned int*)getDataFromDynamicArray(&(batch->indices));
+
+        batch->shortIndexArray = (uint16_t*)malloc(batch->indexCount * sizeof(uint16_t));
+
+        if (batch->shortIndexArray != NULL) {
+            for (iter = 0; iter < batch->indexCount; iter++) batch->shortIndexArray[iter] = (uint16_t)indices[iter];
+
+            freeDynamicArray(&(batch->indices));
+            return;
+        }
+    }
+
+    trimBatchStream(&(batch->indices));
+}
+
+/* builds the batches from a whole file, or from the meshes of a scene in world space */
+
+Blitz3DBatchSet* createBatchSet(B3DFile* blitz3dFile, Blitz3DScene* scene) {
+    Blitz3DBatchBuilder builder;
+    Blitz3DBatchSet* output;
+    unsigned int iter;
+
+    memset(&builder, 0, sizeof(builder));
+
+    if (blitz3dFile->bb3dChunk->brusChunk != NULL) builder.brushCount = blitz3dFile->bb3dChunk->brusChunk->brushCount;
+
+    output = (Blitz3DBatchSet*)calloc(1, sizeof(Blitz3DBatchSet));
+    builder.batchesByBrush = (Blitz3DBatch**)calloc(builder.brushCount + 1, sizeof(Blitz3DBatch*));
+
+    if (output == NULL || builder.batchesByBrush == NULL) builder.error = 1;
+
+    if (!builder.error && scene != NULL) {
+        for (iter = 0; iter < getNodeCountFromScene(scene) && !builder.error; iter++) {
+            if (getMESHChunkFromScene(scene, iter) == NULL) continue;
+
+            builder.worldMatrix = getWorldMatrixFromScene(scene, iter);
+            getNormalMatrixFromMatrix(builder.worldMatrix, builder.normalMatrix);
+
+            addMESHChunkToBatches(&builder, getNODEChunkFromScene(scene, iter), getMESHChunkFromScene(scene, iter));
+        }
+    }
+    else if (!builder.error && blitz3dFile->bb3dChunk->nodeChunk != NULL) {
+        addNODEChunkToBatches(&builder, blitz3dFile->bb3dChunk->nodeChunk);
+    }
+
+    free(builder.remapStamps);
+    free(builder.remapIndices);
+
+    if (!builder.error) {
+        output->batchArray = (Blitz3DBatch**)malloc((builder.brushCount + 1) * sizeof(Blitz3DBatch*));
+        if (output->batchArray == NULL) builder.error = 1;
+    }
+
+    for (iter = 0; builder.batchesByBrush != NULL && iter < builder.brushCount + 1; iter++) {
+        Blitz3DBatch* batch = builder.batchesByBrush[iter];
+
+        if (batch == NULL) continue;
+
+        if (builder.error) {
+            freeBatch(batch);
+            continue;
+        }
+
+        finishBatch(batch);
+        output->batchArray[output->batchCount++] = batch;
+    }
+
+    free(builder.batchesByBrush);
+
+    if (builder.error) {
+        if (output != NULL) free(output->batchArray);
+        free(output);
+        return NULL;
+    }
+
+    return output;
+}
+
+/* public functions */
+
+Blitz3DBatchSet* createBatchSetFromB3DFile(B3DFile* blitz3dFile) {
+    return createBatchSet(blitz3dFile, NULL);
+}
+
+Blitz3DBatchSet* createBatchSetFromScene(Blitz3DScene* scene) {
+    return createBatchSet(getFileFromScene(scene), scene);
+}
+
+void freeBatchSet(Blitz3DBatchSet* batchSet) {
+    unsigned int iter;
+
+    for (iter = 0; iter < batchSet->batchCount; iter++) freeBatch(batchSet->batchArray[iter]);
+
+    free(batchSet->batchArray);
+    free(batchSet);
+}
+
+unsigned int getBatchArrayCountFromBatchSet(Blitz3DBatchSet* batchSet) {
+    return batchSet->batchCount;
+}
+
+Blitz3DBatch* getBatchArrayEntryFromBatchSet(Blitz3DBatchSet* batchSet, unsigned int index) {
+    return batchSet->batchArray[index];
+}
+
+int getBrushIdFromBatch(Blitz3DBatch* batch) {
+    return batch->brushId;
+}
+
+unsigned int getVertexCountFromBatch(Blitz3DBatch* batch) {
+    return batch->vertexCount;
+}
+
+float* getVertexArrayFromBatch(Blitz3DBatch* batch) {
+    return (float*)getDataFromDynamicArray(&(batch->vertices));
+}
+
+float* getNormalArrayFromBatch(Blitz3DBatch* batch) {
+    return batch->hasNormals ? (float*)getDataFromDynamicArray(&(batch->normals)) : NULL;
+}
+
+float* getColorArrayFromBatch(Blitz3DBatch* batch) {
+    return batch->hasColors ? (float*)getDataFromDynamicArray(&(batch->colors)) : NULL;
+}
+
+unsigned int getTexCoordArrayCountFromBatch(Blitz3DBatch* batch) {
+    return batch->texCoordSets;
+}
+
+float* getTexCoordArrayEntryFromBatch(Blitz3DBatch* batch, unsigned int index) {
+    if (index >= batch->texCoordSets) return NULL;
+
+    return (float*)getDataFromDynamicArray(&(batch->texCoords[index]));
+}
+
+unsigned int getTexCoordArrayComponentCountFromBatch(Blitz3DBatch* batch) {
+    return batch->texCoordSize;
+}
+
+unsigned int getIndexCountFromBatch(Blitz3DBatch* batch) {
+    return batch->indexCount;
+}
+
+unsigned int getIndexSizeFromBatch(Blitz3DBatch* batch) {
+    return (batch->shortIndexArray != NULL) ? 2 : 4;
+}
+
+unsigned int* getIndexArrayFromBatch(Blitz3DBatch* batch) {
+    return (batch->shortIndexArray != NULL) ? NULL : (unsigned int*)getDataFromDynamicArray(&(batch->indices));
+}
+
+uint16_t* getShortIndexArrayFromBatch(Blitz3DBatch* batch) {
+    return batch->shortIndexArray;
+}
+
+unsigned int getRangeArrayCountFromBatch(Blitz3DBatch* batch) {
+    return (unsigned int)getDynamicArrayCount(&(batch->ranges));
+}
+
+Blitz3DBatchRange* getRangeArrayEntryFromBatch(Blitz3DBatch* batch, unsigned int index) {
+    return (Blitz3DBatchRange*)getDataFromDynamicArray(&(batch->ranges)) + index;
+}
+
+Blitz3DNODEChunk* getNODEChunkFromBatchRange(Blitz3DBatchRange* range) {
+    return range->nodeChunk;
+}
+
+unsigned int getTRISChunkIndexFromBatchRange(Blitz3DBatchRange* range) {
+    return range->trisChunkIndex;
+}
+
+unsigned int getFirstIndexFromBatchRange(Blitz3DBatchRange* range) {
+    return range->firstIndex;
+}
+
+unsigned int getIndexCountFromBatchRange(Blitz3DBatchRange* range) {
+    return range->indexCount;
+}
+
+unsigned int getFirstVertexFromBatchRange(Blitz3DBatchRange* range) {
+    return range->firstVertex;
+}
+
+unsigned int getVertexCountFromBatchRange(Blitz3DBatchRange* range) {
+    return range->vertexCount;
+}
+
+Blitz3DBounds* getBoundsFromBatchRange(Blitz3DBatchRange* range) {
+    return &(range->bounds);
+}
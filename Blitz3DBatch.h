@@ -0,0 +1,92 @@
+#ifndef _BLITZ3DBATCH_H_
+#define _BLITZ3DBATCH_H_
+
+#include "Blitz3DFile.h"
+#include "Blitz3DScene.h"
+
+/* commentary: static batching. Every TRIS chunk of the scene that resolves to the same brush (a TRIS
+   brush id of -1 falls back to the MESH chunk's) is merged into one batch with a vertex and index
+   buffer of its own, so a frame costs one draw per brush rather than one per TRIS chunk.
+   createBatchSetFromB3DFile merges meshes in their own space; createBatchSetFromScene merges them
+   in world space, through each node's world matrix. Brush ids outside the BRUS chunk end up in the
+   batch for -1, which has no brush.
+
+   A batch has every attribute any of its sources has; sources without one get zero normals, white
+   colors or zero tex coords, and tex coords keep the component count of the first source with any.
+   Triangles with an index outside their mesh's vertex array are dropped.
+
+   Each batch also keeps a range per source TRIS chunk: the run of its index buffer that came from
+   that chunk, the run of vertices it can reference and the chunk's bounds in the batch's space (so
+   world space for a scene). Culling can leave ranges out and draw the rest with glMultiDrawElements,
+   see Blitz3DBVH.h. The batches copy everything they need, so they outlive the file; index-only
+   meshes are evicted again as soon as they have been copied */
+
+typedef struct Blitz3DBatchRange Blitz3DBatchRange;
+struct Blitz3DBatchRange;
+
+typedef struct Blitz3DBatch Blitz3DBatch;
+struct Blitz3DBatch;
+
+typedef struct Blitz3DBatchSet Blitz3DBatchSet;
+struct Blitz3DBatchSet;
+
+/* returns NULL if out of memory */
+Blitz3DBatchSet* createBatchSetFromB3DFile(B3DFile* blitz3dFile);
+
+/* returns NULL if out of memory; the batches outlive the scene as well */
+Blitz3DBatchSet* createBatchSetFromScene(Blitz3DScene* scene);
+
+void freeBatchSet(Blitz3DBatchSet* batchSet);
+
+/* batches come in brush id order, the one for -1 (if any) first */
+unsigned int getBatchArrayCountFromBatchSet(Blitz3DBatchSet* batchSet);
+
+Blitz3DBatch* getBatchArrayEntryFromBatchSet(Blitz3DBatchSet* batchSet, unsigned int index);
+
+int getBrushIdFromBatch(Blitz3DBatch* batch);
+
+unsigned int getVertexCountFromBatch(Blitz3DBatch* batch);
+
+float* getVertexArrayFromBatch(Blitz3DBatch* batch);
+
+/* NULL when no source has the attribute */
+float* getNormalArrayFromBatch(Blitz3DBatch* batch);
+
+float* getColorArrayFromBatch(Blitz3DBatch* batch);
+
+unsigned int getTexCoordArrayCountFromBatch(Blitz3DBatch* batch);
+
+float* getTexCoordArrayEntryFromBatch(Blitz3DBatch* batch, unsigned int index);
+
+unsigned int getTexCoordArrayComponentCountFromBatch(Blitz3DBatch* batch);
+
+unsigned int getIndexCountFromBatch(Blitz3DBatch* batch);
+
+/* returns 2 or 4, as for TRIS chunks; 16 bits are used whenever the vertex count allows */
+unsigned int getIndexSizeFromBatch(Blitz3DBatch* batch);
+
+unsigned int* getIndexArrayFromBatch(Blitz3DBatch* batch);
+
+uint16_t* getShortIndexArrayFromBatch(Blitz3DBatch* batch);
+
+unsigned int getRangeArrayCountFromBatch(Blitz3DBatch* batch);
+
+Blitz3DBatchRange* getRangeArrayEntryFromBatch(Blitz3DBatch* batch, unsigned int index);
+
+Blitz3DNODEChunk* getNODEChunkFromBatchRange(Blitz3DBatchRange* range);
+
+/* the TRIS chunk's index within its MESH chunk; the chunk itself may have been evicted */
+unsigned int getTRISChunkIndexFromBatchRange(Blitz3DBatchRange* range);
+
+unsigned int getFirstIndexFromBatchRange(Blitz3DBatchRange* range);
+
+unsigned int getIndexCountFromBatchRange(Blitz3DBatchRange* range);
+
+unsigned int getFirstVertexFromBatchRange(Blitz3DBatchRange* range);
+
+unsigned int getVertexCountFromBatchRange(Blitz3DBatchRange* range);
+
+/* empty when the chunk has no triangles inside its vertex array */
+Blitz3DBounds* getBoundsFromBatchRange(Blitz3DBatchRange* range);
+
+#endif
@@ -0,0 +1,544 @@
+#include "Blitz3DFileInternal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "SIMD.h"
+
+/* Blitz3D bounding volumes */
+
+/* commentary: a TRIS chunk's indices are read once, stamping every vertex they reference and noting
+   the span from the lowest to the highest; the box and then the sphere come from walking that span
+   of the vertex array in order, four vertices at a time, with vertices that do not carry the
+   chunk's stamp masked out. Nothing is gathered and only referenced vertices count. The MESH chunk
+   box is the union of its TRIS chunk boxes and its sphere takes every stamped vertex */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BLITZ3D_BOUNDS_X86
+#include <immintrin.h>
+#endif
+
+/* kernels: a vertex counts when its stamp equals the one given, or for a stamp of 0 when it has any */
+
+int vertexStampMatches(unsigned int vertexStamp, unsigned int stamp) {
+    return (stamp == 0) ? (vertexStamp != 0) : (vertexStamp == stamp);
+}
+
+void accumulateExtentsScalar(const float* positions, const unsigned int* stamps, unsigned int stamp,
+    unsigned int first, unsigned int end, float* minimum, float* maximum) {
+    unsigned int iter, axis;
+
+    for (iter = first; iter < end; iter++) {
+        const float* position = positions + 3 * (size_t)iter;
+
+        if (!vertexStampMatches(stamps[iter], stamp)) continue;
+
+        for (axis = 0; axis < 3; axis++) {
+            if (position[axis] < minimum[axis]) minimum[axis] = position[axis];
+            if (position[axis] > maximum[axis]) maximum[axis] = position[axis];
+        }
+    }
+}
+
+void accumulateRadiusScalar(const float* positions, const unsigned int* stamps, unsigned int stamp,
+    unsigned int first, unsigned int end, const float* center, float* radiusSquared) {
+    unsigned int iter;
+
+    for (iter = first; iter < end; iter++) {
+        const float* position = positions + 3 * (size_t)iter;
+        float x = position[0] - center[0], y = position[1] - center[1], z = position[2] - center[2];
+        float distance = x * x + y * y + z * z;
+
+        if (vertexStampMatches(stamps[iter], stamp) && distance > *radiusSquared) *radiusSquared = distance;
+    }
+}
+
+/* widens lowest and highest by every index of the chunk from first on, in range or not */
+
+void accumulateIndexSpanScalar(const Blitz3DTRISChunk* trisChunk, unsigned int first, long* lowest, long* highest) {
+    unsigned int indexCount = 3 * trisChunk->triangleCount;
+    unsigned int iter;
+    long index;
+
+    for (iter = first; iter < indexCount; iter++) {
+        if (trisChunk->shortIndexArray != NULL) {
+            index = trisChunk->shortIndexArray[iter];
+        } else {
+            index = trisChunk->indexArray[iter];
+        }
+
+        if (index < *lowest) *lowest = index;
+        if (index > *highest) *highest = index;
+    }
+}
+
+#ifdef BLITZ3D_BOUNDS_X86
+
+/* four consecutive x, y, z vertices into one register per axis */
+
+__attribute__((target("sse2")))
+void loadFourPositionsSSE2(const float* positions, __m128* x, __m128* y, __m128* z) {
+    __m128 first = _mm_loadu_ps(positions);         /* x0 y0 z0 x1 */
+    __m128 second = _mm_loadu_ps(positions + 4);    /* y1 z1 x2 y2 */
+    __m128 third = _mm_loadu_ps(positions + 8);     /* z2 x3 y3 z3 */
+    __m128 xy = _mm_shuffle_ps(second, third, _MM_SHUFFLE(2, 1, 3, 2));  /* x2 y2 x3 y3 */
+    __m128 yz = _mm_shuffle_ps(first, second, _MM_SHUFFLE(1, 0, 2, 1));  /* y0 z0 y1 z1 */
+
+    *x = _mm_shuffle_ps(first, xy, _MM_SHUFFLE(2, 0, 3, 0));
+    *y = _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+    *z = _mm_shuffle_ps(yz, third, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+/* all ones in the lanes of the four vertices whose stamps match */
+
+__attribute__((target("sse2")))
+__m128 loadStampMaskSSE2(const unsigned int* stamps, unsigned int stamp) {
+    __m128i vertexStamps = _mm_loadu_si128((const __m128i*)stamps);
+
+    if (stamp == 0) {
+        return _mm_castsi128_ps(_mm_xor_si128(_mm_cmpeq_epi32(vertexStamps, _mm_setzero_si128()), _mm_set1_epi32(-1)));
+    }
+
+    return _mm_castsi128_ps(_mm_cmpeq_epi32(vertexStamps, _mm_set1_epi32((int)stamp)));
+}
+
+__attribute__((target("sse2")))
+__m128 selectSSE2(__m128 mask, __m128 value, __m128 otherwise) {
+    return _mm_or_ps(_mm_and_ps(mask, value), _mm_andnot_ps(mask, otherwise));
+}
+
+__attribute__((target("sse2")))
+void accumulateExtentsSSE2(const float* positions, const unsigned int* stamps, unsigned int stamp,
+    unsigned int first, unsigned int end, float* minimum, float* maximum) {
+    __m128 minimumX = _mm_set1_ps(minimum[0]), minimumY = _mm_set1_ps(minimum[1]), minimumZ = _mm_set1_ps(minimum[2]);
+    __m128 maximumX = _mm_set1_ps(maximum[0]), maximumY = _mm_set1_ps(maximum[1]), maximumZ = _mm_set1_ps(maximum[2]);
+    __m128 huge = _mm_set1_ps((float)HUGE_VAL), negativeHuge = _mm_set1_ps(-(float)HUGE_VAL);
+    float lanes[6][4];
+    unsigned int iter, lane;
+
+    for (iter = first; iter + 4 <= end; iter += 4) {
+        __m128 mask = loadStampMaskSSE2(stamps + iter, stamp);
+        __m128 x, y, z;
+
+        loadFourPositionsSSE2(positions + 3 * (size_t)iter, &x, &y, &z);
+
+        minimumX = _mm_min_ps(minimumX, selectSSE2(mask, x, huge));
+        minimumY = _mm_min_ps(minimumY, selectSSE2(mask, y, huge));
+        minimumZ = _mm_min_ps(minimumZ, selectSSE2(mask, z, huge));
+        maximumX = _mm_max_ps(maximumX, selectSSE2(mask, x, negativeHuge));
+        maximumY = _mm_max_ps(maximumY, selectSSE2(mask, y, negativeHuge));
+        maximumZ = _mm_max_ps(maximumZ, selectSSE2(mask, z, negativeHuge));
+    }
+
+    _mm_storeu_ps(lanes[0], minimumX); _mm_storeu_ps(lanes[1], minimumY); _mm_storeu_ps(lanes[2], minimumZ);
+    _mm_storeu_ps(lanes[3], maximumX); _mm_storeu_ps(lanes[4], maximumY); _mm_storeu_ps(lanes[5], maximumZ);
+
+    for (lane = 0; lane < 4; lane++) {
+        if (lanes[0][lane] < minimum[0]) minimum[0] = lanes[0][lane];
+        if (lanes[1][lane] < minimum[1]) minimum[1] = lanes[1][lane];
+        if (lanes[2][lane] < minimum[2]) minimum[2] = lanes[2][lane];
+        if (lanes[3][lane] > maximum[0]) maximum[0] = lanes[3][lane];
+        if (lanes[4][lane] > maximum[1]) maximum[1] = lanes[4][lane];
+        if (lanes[5][lane] > maximum[2]) maximum[2] = lanes[5][lane];
+    }
+
+    accumulateExtentsScalar(positions, stamps, stamp, iter, end, minimum, maximum);
+}
+
+__attribute__((target("sse2")))
+void accumulateRadiusSSE2(const float* positions, const unsigned int* stamps, unsigned int stamp,
+    unsigned int first, unsigned int end, const float* center, float* radiusSquared) {
+    __m128 centerX = _mm_set1_ps(center[0]), centerY = _mm_set1_ps(center[1]), centerZ = _mm_set1_ps(center[2]);
+    __m128 farthest = _mm_set1_ps(*radiusSquared);
+    float lanes[4];
+    unsigned int iter, lane;
+
+    for (iter = first; iter + 4 <= end; iter += 4) {
+        __m128 mask = loadStampMaskSSE2(stamps + iter, stamp);
+        __m128 x, y, z, distance;
+
+        loadFourPositionsSSE2(positions + 3 * (size_t)iter, &x, &y, &z);
+
+        x = _mm_sub_ps(x, centerX);
+        y = _mm_sub_ps(y, centerY);
+        z = _mm_sub_ps(z, centerZ);
+        distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+
+        farthest = _mm_max_ps(farthest, _mm_and_ps(mask, distance));
+    }
+
+    _mm_storeu_ps(lanes, farthest);
+
+    for (lane = 0; lane < 4; lane++) {
+        if (lanes[lane] > *radiusSquared) *radiusSquared = lanes[lane];
+    }
+
+    accumulateRadiusScalar(positions, stamps, stamp, iter, end, center, radiusSquared);
+}
+
+/* 16-bit indices are biased to signed for the compares; 32-bit ones are signed already, and SSE2 has
+   no 32-bit min/max, so those select through a compare */
+
+__attribute__((target("sse2")))
+void accumulateIndexSpanSSE2(const Blitz3DTRISChunk* trisChunk, unsigned int first, long* lowest, long* highest) {
+    unsigned int indexCount = 3 * trisChunk->triangleCount;
+    unsigned int iter = first, lane;
+
+    if (trisChunk->shortIndexArray != NULL) {
+        __m128i bias = _mm_set1_epi16((short)0x8000);
+        __m128i low = _mm_set1_epi16(0x7fff), high = _mm_set1_epi16((short)0x8000);
+        int16_t lanes[2][8];
+
+        for (; iter + 8 <= indexCount; iter += 8) {
+            __m128i indices = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(trisChunk->shortIndexArray + iter)), bias);
+
+            low = _mm_min_epi16(low, indices);
+            high = _mm_max_epi16(high, indices);
+        }
+
+        _mm_storeu_si128((__m128i*)lanes[0], low);
+        _mm_storeu_si128((__m128i*)lanes[1], high);
+
+        for (lane = 0; lane < 8 && iter > first; lane++) {
+            if (lanes[0][lane] + 0x8000L < *lowest) *lowest = lanes[0][lane] + 0x8000L;
+            if (lanes[1][lane] + 0x8000L > *highest) *highest = lanes[1][lane] + 0x8000L;
+        }
+    } else {
+        __m128i low = _mm_set1_epi32(0x7fffffff), high = _mm_set1_epi32((int)0x80000000);
+        int lanes[2][4];
+
+        for (; iter + 4 <= indexCount; iter += 4) {
+            __m128i indices = _mm_loadu_si128((const __m128i*)(trisChunk->indexArray + iter));
+            __m128i lower = _mm_cmpgt_epi32(low, indices), higher = _mm_cmpgt_epi32(indices, high);
+
+            low = _mm_or_si128(_mm_and_si128(lower, indices), _mm_andnot_si128(lower, low));
+            high = _mm_or_si128(_mm_and_si128(higher, indices), _mm_andnot_si128(higher, high));
+        }
+
+        _mm_storeu_si128((__m128i*)lanes[0], low);
+        _mm_storeu_si128((__m128i*)lanes[1], high);
+
+        for (lane = 0; lane < 4 && iter > first; lane++) {
+            if (lanes[0][lane] < *lowest) *lowest = lanes[0][lane];
+            if (lanes[1][lane] > *highest) *highest = lanes[1][lane];
+        }
+    }
+
+    accumulateIndexSpanScalar(trisChunk, iter, lowest, highest);
+}
+
+#endif
+
+typedef void (*Blitz3DIndexSpanFunction)(const Blitz3DTRISChunk* trisChunk, unsigned int first, long* lowest,
+    long* highest);
+typedef void (*Blitz3DExtentsFunction)(const float* positions, const unsigned int* stamps, unsigned int stamp,
+    unsigned int first, unsigned int end, float* minimum, float* maximum);
+typedef void (*Blitz3DRadiusFunction)(const float* positions, const unsigned int* stamps, unsigned int stamp,
+    unsigned int first, unsigned int end, const float* center, float* radiusSquared);
+
+/* helpers */
+
+void setBoundsCenterFromBox(Blitz3DBounds* bounds) {
+    unsigned int axis;
+
+    for (axis = 0; axis < 3; axis++) bounds->center[axis] = 0.5f * (bounds->minimum[axis] + bounds->maximum[axis]);
+}
+
+float getHalfDiagonalFromBounds(const Blitz3DBounds* bounds) {
+    float x = bounds->maximum[0] - bounds->minimum[0];
+    float y = bounds->maximum[1] - bounds->minimum[1];
+    float z = bounds->maximum[2] - bounds->minimum[2];
+
+    return 0.5f * (float)sqrt(x * x + y * y + z * z);
+}
+
+void addBoxToBounds(Blitz3DBounds* bounds, const Blitz3DBounds* part) {
+    unsigned int axis;
+
+    if (!part->present) return;
+
+    if (!bounds->present) {
+        memcpy(bounds->minimum, part->minimum, sizeof(bounds->minimum));
+        memcpy(bounds->maximum, part->maximum, sizeof(bounds->maximum));
+        bounds->present = 1;
+        return;
+    }
+
+    for (axis = 0; axis < 3; axis++) {
+        if (part->minimum[axis] < bounds->minimum[axis]) bounds->minimum[axis] = part->minimum[axis];
+        if (part->maximum[axis] > bounds->maximum[axis]) bounds->maximum[axis] = part->maximum[axis];
+    }
+}
+
+/* stamps the vertices the chunk references inside the vertex array and returns one past the highest,
+   with the lowest in first; returns 0 when it references none */
+
+/* commentary: the span is found first, with the vectorized kernel; when every index is in range, as
+   in any sound file, the stamping loop is nothing but stores */
+
+unsigned int stampReferencedVertices(Blitz3DTRISChunk* trisChunk, Blitz3DIndexSpanFunction indexSpan,
+    unsigned int vertexCount, unsigned int stamp, unsigned int* stamps, unsigned int* first) {
+
+    unsigned int indexCount = 3 * trisChunk->triangleCount;
+    unsigned int lowest = vertexCount, highest = 0;
+    unsigned int iter, index;
+    long spanLowest = LONG_MAX, spanHighest = LONG_MIN;
+
+    indexSpan(trisChunk, 0, &spanLowest, &spanHighest);
+    if (spanLowest > spanHighest) return 0;
+
+    if (spanLowest >= 0 && spanHighest < (long)vertexCount) {
+        if (trisChunk->shortIndexArray != NULL) {
+            for (iter = 0; iter < indexCount; iter++) stamps[trisChunk->shortIndexArray[iter]] = stamp;
+        } else {
+            for (iter = 0; iter < indexCount; iter++) stamps[trisChunk->indexArray[iter]] = stamp;
+        }
+
+        *first = (unsigned int)spanLowest;
+
+        return (unsigned int)spanHighest + 1;
+    }
+
+    for (iter = 0; iter < indexCount; iter++) {
+        index = getIndexFromTRISChunk(trisChunk, iter);
+        if (index >= vertexCount) continue;
+
+        stamps[index] = stamp;
+        if (index < lowest) lowest = index;
+        if (index + 1 > highest) highest = index + 1;
+    }
+
+    *first = lowest;
+
+    return highest;
+}
+
+/* computation */
+
+void computeBoundsOfMESHChunk(Blitz3DMESHChunk* meshChunk) {
+    Blitz3DIndexSpanFunction indexSpan = accumulateIndexSpanScalar;
+    Blitz3DExtentsFunction extents = accumulateExtentsScalar;
+    Blitz3DRadiusFunction radius = accumulateRadiusScalar;
+    Blitz3DVRTSChunk* vrtsChunk = meshChunk->vrtsChunk;
+    Blitz3DBounds* meshBounds = &(meshChunk->bounds);
+    unsigned int meshFirst = 0, meshEnd = 0;
+    unsigned int* stamps;
+    unsigned int iter, first, end, axis;
+    float radiusSquared;
+
+#ifdef BLITZ3D_BOUNDS_X86
+    if (getSIMDLevel() == SIMD_LEVEL_SSE2) {
+        indexSpan = accumulateIndexSpanSSE2;
+        extents = accumulateExtentsSSE2;
+        radius = accumulateRadiusSSE2;
+    }
+#endif
+
+    memset(meshBounds, 0, sizeof(Blitz3DBounds));
+
+    for (iter = 0; iter < meshChunk->trisChunkCount; iter++) {
+        memset(&(meshChunk->trisChunkArray[iter]->bounds), 0, sizeof(Blitz3DBounds));
+    }
+
+    if (vrtsChunk == NULL || vrtsChunk->vertexCount == 0 || meshChunk->trisChunkCount == 0) return;
+
+    /* commentary: out of memory leaves the bounds empty, which culling treats as nothing to draw; a
+       mesh that big would not have loaded in the first place */
+
+    stamps = (unsigned int*)calloc(vrtsChunk->vertexCount, sizeof(unsigned int));
+    if (stamps == NULL) return;
+
+    for (iter = 0; iter < meshChunk->trisChunkCount; iter++) {
+        Blitz3DBounds* bounds = &(meshChunk->trisChunkArray[iter]->bounds);
+
+        end = stampReferencedVertices(meshChunk->trisChunkArray[iter], indexSpan, vrtsChunk->vertexCount, iter + 1,
+            stamps, &first);
+        if (end == 0) continue;
+
+        for (axis = 0; axis < 3; axis++) {
+            bounds->minimum[axis] = HUGE_VAL;
+            bounds->maximum[axis] = -HUGE_VAL;
+        }
+
+        extents(vrtsChunk->vertexArray, stamps, iter + 1, first, end, bounds->minimum, bounds->maximum);
+        setBoundsCenterFromBox(bounds);
+
+        radiusSquared = 0.0f;
+        radius(vrtsChunk->vertexArray, stamps, iter + 1, first, end, bounds->center, &radiusSquared);
+
+        bounds->radius = (float)sqrt(radiusSquared);
+        bounds->present = 1;
+
+        addBoxToBounds(meshBounds, bounds);
+
+        if (meshEnd == 0 || first < meshFirst) meshFirst = first;
+        if (end > meshEnd) meshEnd = end;
+    }
+
+    if (meshBounds->present) {
+        setBoundsCenterFromBox(meshBounds);
+
+        radiusSquared = 0.0f;
+        radius(vrtsChunk->vertexArray, stamps, 0, meshFirst, meshEnd, meshBounds->center, &radiusSquared);
+
+        meshBounds->radius = (float)sqrt(radiusSquared);
+    }
+
+    free(stamps);
+}
+
+/* commentary: a box goes through a matrix as its center and half extents, the extents through the
+   absolute values of the matrix (Arvo's method); a sphere's radius grows by the largest axis scale */
+
+void transformBounds(const Blitz3DBounds* bounds, const float* matrix, Blitz3DBounds* output) {
+    float center[3], extent[3], scale = 0.0f;
+    unsigned int axis, column;
+
+    for (axis = 0; axis < 3; axis++) {
+        center[axis] = 0.5f * (bounds->minimum[axis] + bounds->maximum[axis]);
+        extent[axis] = 0.5f * (bounds->maximum[axis] - bounds->minimum[axis]);
+    }
+
+    for (axis = 0; axis < 3; axis++) {
+        float transformedCenter = matrix[12 + axis];
+        float transformedExtent = 0.0f;
+
+        for (column = 0; column < 3; column++) {
+            transformedCenter += matrix[4 * column + axis] * center[column];
+            transformedExtent += (float)fabs(matrix[4 * column + axis]) * extent[column];
+        }
+
+        output->minimum[axis] = transformedCenter - transformedExtent;
+        output->maximum[axis] = transformedCenter + transformedExtent;
+
+        output->center[axis] = matrix[12 + axis] + matrix[axis] * bounds->center[0]
+            + matrix[4 + axis] * bounds->center[1] + matrix[8 + axis] * bounds->center[2];
+    }
+
+    for (column = 0; column < 3; column++) {
+        const float* basis = matrix + 4 * column;
+        float length = basis[0] * basis[0] + basis[1] * basis[1] + basis[2] * basis[2];
+
+        if (length > scale) scale = length;
+    }
+
+    output->radius = bounds->radius * (float)sqrt(scale);
+    output->present = bounds->present;
+}
+
+/* grows the radius to reach around a part's sphere, seen from the box center */
+
+void addSphereToBounds(Blitz3DBounds* bounds, const Blitz3DBounds* part) {
+    float x, y, z, reach;
+
+    if (!part->present) return;
+
+    x = part->center[0] - bounds->center[0];
+    y = part->center[1] - bounds->center[1];
+    z = part->center[2] - bounds->center[2];
+
+    reach = (float)sqrt(x * x + y * y + z * z) + part->radius;
+    if (reach > bounds->radius) bounds->radius = reach;
+}
+
+void getChildBoundsInParentSpace(Blitz3DNODEChunk* childChunk, Blitz3DBounds* output) {
+    float matrix[16];
+
+    composeLocalMatrixScalar(childChunk->position, childChunk->scale, childChunk->rotation, matrix);
+    transformBounds(&(childChunk->bounds), matrix, output);
+}
+
+/* commentary: the node sphere is centered on the node box and reaches around every part's sphere,
+   but never grows past the box's own half diagonal, which bounds everything just as well */
+
+void propagateBoundsInNODEChunk(Blitz3DNODEChunk* nodeChunk) {
+    Blitz3DBounds* bounds = &(nodeChunk->bounds);
+    Blitz3DBounds childBounds;
+    float halfDiagonal;
+    unsigned int iter;
+
+    memset(bounds, 0, sizeof(Blitz3DBounds));
+
+    for (iter = 0; iter < nodeChunk->nodeChunkCount; iter++) propagateBoundsInNODEChunk(nodeChunk->nodeChunkArray[iter]);
+
+    if (nodeChunk->meshChunk != NULL) addBoxToBounds(bounds, &(nodeChunk->meshChunk->bounds));
+
+    for (iter = 0; iter < nodeChunk->nodeChunkCount; iter++) {
+        getChildBoundsInParentSpace(nodeChunk->nodeChunkArray[iter], &childBounds);
+        addBoxToBounds(bounds, &childBounds);
+    }
+
+    if (!bounds->present) return;
+
+    setBoundsCenterFromBox(bounds);
+
+    if (nodeChunk->meshChunk != NULL) addSphereToBounds(bounds, &(nodeChunk->meshChunk->bounds));
+
+    for (iter = 0; iter < nodeChunk->nodeChunkCount; iter++) {
+        getChildBoundsInParentSpace(nodeChunk->nodeChunkArray[iter], &childBounds);
+        addSphereToBounds(bounds, &childBounds);
+    }
+
+    halfDiagonal = getHalfDiagonalFromBounds(bounds);
+    if (halfDiagonal < bounds->radius) bounds->radius = halfDiagonal;
+}
+
+/* public functions */
+
+void updateBoundsInNODEChunk(Blitz3DNODEChunk* nodeChunk) {
+    Blitz3DMESHChunk* meshChunk = nodeChunk->meshChunk;
+    unsigned int iter;
+
+    if (meshChunk != NULL) {
+        if (meshDataPresentInMESHChunk(meshChunk)) computeBoundsOfMESHChunk(meshChunk);
+        else getBoundsFromMESHChunk(meshChunk);
+    }
+
+    for (iter = 0; iter < nodeChunk->nodeChunkCount; iter++) updateBoundsInNODEChunk(nodeChunk->nodeChunkArray[iter]);
+}
+
+void updateBoundsInB3DFile(B3DFile* blitz3dFile) {
+    if (blitz3dFile->bb3dChunk->nodeChunk == NULL) return;
+
+    updateBoundsInNODEChunk(blitz3dFile->bb3dChunk->nodeChunk);
+    propagateBoundsInNODEChunk(blitz3dFile->bb3dChunk->nodeChunk);
+}
+
+Blitz3DBounds* getBoundsFromMESHChunk(Blitz3DMESHChunk* meshChunk) {
+    if (meshChunk->lazyMesh != NULL && !meshChunk->lazyMesh->boundsKnown) {
+        getVRTSChunkFromMESHChunk(meshChunk);
+        evictMESHChunk(meshChunk);
+    }
+
+    return &(meshChunk->bounds);
+}
+
+Blitz3DBounds* getBoundsFromTRISChunk(Blitz3DTRISChunk* trisChunk) {
+    return &(trisChunk->bounds);
+}
+
+Blitz3DBounds* getBoundsFromNODEChunk(Blitz3DNODEChunk* nodeChunk) {
+    return &(nodeChunk->bounds);
+}
+
+int boundsEmpty(Blitz3DBounds* bounds) {
+    return !bounds->present;
+}
+
+float* getMinimumFromBounds(Blitz3DBounds* bounds) {
+    return bounds->minimum;
+}
+
+float* getMaximumFromBounds(Blitz3DBounds* bounds) {
+    return bounds->maximum;
+}
+
+float* getCenterFromBounds(Blitz3DBounds* bounds) {
+    return bounds->center;
+}
+
+float getRadiusFromBounds(Blitz3DBounds* bounds) {
+    return bounds->radius;
+}
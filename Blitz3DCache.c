@@ -0,0 +1,953 @@
+#include "Blitz3DFileInternal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* Blitz3D cache files */
+
+/* commentary: a cache file holds an already decoded level in a layout without pointers. Every
+   section and every vertex or index array starts on a 16-byte boundary, so once the cache is
+   mapped the B3DFile structures can point straight into it. Only the small per-chunk structures
+   are built in the arena; none of the vertex or index data is copied.
+
+   layout: header, textures, brushes, brush texture ids, nodes (depth-first), node child indices,
+   meshes, TRIS chunks, strings, then the vertex and index arrays. Meshes and TRIS chunks carry their
+   bounds (version 2), so a cached load skips the pass over the vertices; node bounds are cheap to
+   propagate and are not stored */
+
+#define BLITZ3D_CACHE_MAGIC 0x43443342
+#define BLITZ3D_CACHE_VERSION 2
+#define BLITZ3D_CACHE_ALIGNMENT 16
+
+#define BLITZ3D_CACHE_HAS_TEXS 1
+#define BLITZ3D_CACHE_HAS_BRUS 2
+#define BLITZ3D_CACHE_HAS_NODE 4
+
+#define BLITZ3D_CACHE_WRITE_BUFFER_SIZE (1024 * 1024)
+
+/* cache structures, 64-bit fields first so the layout does not depend on the compiler's packing */
+
+typedef struct Blitz3DCacheHeader Blitz3DCacheHeader;
+struct Blitz3DCacheHeader {
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint64_t totalSize;
+
+    uint64_t texsFileOffset;
+    uint64_t brusFileOffset;
+
+    uint64_t textureOffset;
+    uint64_t brushOffset;
+    uint64_t brushTextureIdOffset;
+    uint64_t nodeOffset;
+    uint64_t childOffset;
+    uint64_t meshOffset;
+    uint64_t trisOffset;
+    uint64_t stringOffset;
+    uint64_t stringSize;
+
+    uint32_t magic;
+    uint32_t version;
+
+    int32_t bb3dVersion;
+    uint32_t chunkFlags;
+
+    uint32_t textureCount;
+    uint32_t brushCount;
+    int32_t brushTextureCount;
+    uint32_t nodeCount;
+    uint32_t childCount;
+    uint32_t meshCount;
+    uint32_t trisCount;
+    uint32_t padding;
+};
+
+typedef struct Blitz3DCacheTexture Blitz3DCacheTexture;
+struct Blitz3DCacheTexture {
+    uint32_t file;
+
+    int32_t flags, blend;
+    float x_pos, y_pos;
+    float x_scale, y_scale;
+    float rotation;
+};
+
+typedef struct Blitz3DCacheBrush Blitz3DCacheBrush;
+struct Blitz3DCacheBrush {
+    uint32_t name;
+
+    float red, green, blue, alpha;
+    float shininess;
+    int32_t blend, fx;
+};
+
+typedef struct Blitz3DCacheNode Blitz3DCacheNode;
+struct Blitz3DCacheNode {
+    uint64_t fileOffset;
+
+    uint32_t name;
+    int32_t meshIndex;
+
+    uint32_t firstChild;
+    uint32_t childCount;
+
+    float position[3];
+    float scale[3];
+    float rotation[4];
+};
+
+typedef struct Blitz3DCacheMesh Blitz3DCacheMesh;
+struct Blitz3DCacheMesh {
+    uint64_t fileOffset;
+
+    uint64_t vertexData;
+    uint64_t normalData;
+    uint64_t colorData;
+    uint64_t texCoordData;
+    uint64_t texCoordStride;
+
+    int32_t brush_id;
+
+    uint32_t firstTris;
+    uint32_t trisCount;
+
+    uint32_t vrtsPresent;
+    uint32_t vertexCount;
+
+    int32_t flags;
+    int32_t tex_coord_sets;
+    int32_t tex_coord_set_size;
+
+    /* box minimum and maximum, sphere center and radius */
+    float bounds[10];
+    uint32_t boundsPresent;
+    uint32_t padding;
+};
+
+typedef struct Blitz3DCacheTris Blitz3DCacheTris;
+struct Blitz3DCacheTris {
+    uint64_t indexData;
+
+    int32_t brush_id;
+    uint32_t triangleCount;
+
+    float bounds[10];
+    uint32_t boundsPresent;
+    uint32_t padding;
+};
+
+/* flattened view of a loaded file, used while writing */
+
+typedef struct Blitz3DCacheLayout Blitz3DCacheLayout;
+struct Blitz3DCacheLayout {
+    Blitz3DNODEChunk** nodes;
+    Blitz3DMESHChunk** meshes;
+    Blitz3DTRISChunk** tris;
+
+    unsigned int nodeCount, meshCount, trisCount, childCount;
+};
+
+/* bounds */
+
+void storeCacheBounds(const Blitz3DBounds* bounds, float* values, uint32_t* present) {
+    memcpy(values, bounds->minimum, 3 * sizeof(float));
+    memcpy(values + 3, bounds->maximum, 3 * sizeof(float));
+    memcpy(values + 6, bounds->center, 3 * sizeof(float));
+    values[9] = bounds->radius;
+
+    *present = (uint32_t)bounds->present;
+}
+
+void loadCacheBounds(Blitz3DBounds* bounds, const float* values, uint32_t present) {
+    memcpy(bounds->minimum, values, 3 * sizeof(float));
+    memcpy(bounds->maximum, values + 3, 3 * sizeof(float));
+    memcpy(bounds->center, values + 6, 3 * sizeof(float));
+    bounds->radius = values[9];
+
+    bounds->present = (present != 0);
+}
+
+/* content hash */
+
+/* commentary: four independent multiply-rotate lanes over 64-bit words, in the spirit of xxHash64;
+   it runs at memory speed, so hashing the source costs little next to decoding it */
+
+#define BLITZ3D_HASH_PRIME_1 0x9E3779B185EBCA87ULL
+#define BLITZ3D_HASH_PRIME_2 0xC2B2AE3D27D4EB4FULL
+#define BLITZ3D_HASH_PRIME_3 0x165667B19E3779F9ULL
+
+uint64_t rotateLeft64(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t mixHashLane(uint64_t lane, uint64_t value) {
+    lane += value * BLITZ3D_HASH_PRIME_2;
+    lane = rotateLeft64(lane, 31);
+
+    return lane * BLITZ3D_HASH_PRIME_1;
+}
+
+uint64_t hashBlitz3DSource(const unsigned char* data, size_t size) {
+    uint64_t lanes[4];
+    uint64_t output, value;
+    size_t position = 0;
+    int iter;
+
+    lanes[0] = BLITZ3D_HASH_PRIME_1 + BLITZ3D_HASH_PRIME_2;
+    lanes[1] = BLITZ3D_HASH_PRIME_2;
+    lanes[2] = 0;
+    lanes[3] = (uint64_t)0 - BLITZ3D_HASH_PRIME_1;
+
+    for (; position + 32 <= size; position += 32) {
+        for (iter = 0; iter < 4; iter++) {
+            memcpy(&value, data + position + 8 * iter, sizeof(uint64_t));
+            lanes[iter] = mixHashLane(lanes[iter], value);
+        }
+    }
+
+    output = rotateLeft64(lanes[0], 1) + rotateLeft64(lanes[1], 7)
+        + rotateLeft64(lanes[2], 12) + rotateLeft64(lanes[3], 18);
+    output += (uint64_t)size;
+
+    for (; position < size; position++) {
+        output ^= data[position] * BLITZ3D_HASH_PRIME_3;
+        output = rotateLeft64(output, 11) * BLITZ3D_HASH_PRIME_1;
+    }
+
+    output ^= output >> 33;
+    output *= BLITZ3D_HASH_PRIME_2;
+    output ^= output >> 29;
+    output *= BLITZ3D_HASH_PRIME_3;
+    output ^= output >> 32;
+
+    return output;
+}
+
+/* cache writing */
+
+uint64_t alignCacheOffset(uint64_t offset) {
+    return (offset + BLITZ3D_CACHE_ALIGNMENT - 1) & ~(uint64_t)(BLITZ3D_CACHE_ALIGNMENT - 1);
+}
+
+void countCacheNodes(Blitz3DCacheLayout* layout, Blitz3DNODEChunk* node) {
+    unsigned int iter;
+
+    layout->nodeCount++;
+    layout->childCount += node->nodeChunkCount;
+
+    if (node->meshChunk != NULL) {
+        layout->meshCount++;
+        layout->trisCount += node->meshChunk->trisChunkCount;
+    }
+
+    for (iter = 0; iter < node->nodeChunkCount; iter++) {
+        countCacheNodes(layout, node->nodeChunkArray[iter]);
+    }
+}
+
+void collectCacheNodes(Blitz3DCacheLayout* layout, Blitz3DNODEChunk* node) {
+    unsigned int iter;
+
+    layout->nodes[layout->nodeCount++] = node;
+
+    if (node->meshChunk != NULL) {
+        layout->meshes[layout->meshCount++] = node->meshChunk;
+
+        for (iter = 0; iter < node->meshChunk->trisChunkCount; iter++) {
+            layout->tris[layout->trisCount++] = node->meshChunk->trisChunkArray[iter];
+        }
+    }
+
+    for (iter = 0; iter < node->nodeChunkCount; iter++) {
+        collectCacheNodes(layout, node->nodeChunkArray[iter]);
+    }
+}
+
+int writeCachePadding(FILE* fp, uint64_t* position) {
+    static const unsigned char zeroes[BLITZ3D_CACHE_ALIGNMENT] = { 0 };
+    uint64_t aligned = alignCacheOffset(*position);
+    size_t count = (size_t)(aligned - *position);
+
+    *position = aligned;
+
+    return (fwrite(zeroes, 1, count, fp) == count) ? 0 : -1;
+}
+
+int writeCacheBytes(FILE* fp, uint64_t* position, const void* data, size_t size) {
+    *position += size;
+
+    return (fwrite(data, 1, size, fp) == size) ? 0 : -1;
+}
+
+uint32_t addCacheString(uint64_t* stringSize, const char* string) {
+    uint32_t output = (uint32_t)*stringSize;
+
+    *stringSize += strlen(string) + 1;
+
+    return output;
+}
+
+/* commentary: the cache is written under a temporary name and renamed into place, so a reader never sees half a cache */
+
+int writeB3DFileCache(B3DFile* b3dFile, const char* cachePath, uint64_t sourceHash, uint64_t sourceSize) {
+    Blitz3DBB3DChunk* bb3dChunk = b3dFile->bb3dChunk;
+    Blitz3DCacheLayout layout;
+    Blitz3DCacheHeader header;
+    Blitz3DMESHChunk** meshIndexLookup;
+    char* temporaryPath;
+    char* writeBuffer;
+    uint64_t position, dataPosition, stringSize;
+    unsigned int iter, meshIter, childIter, trisIter;
+    int result = 0, set;
+    FILE* fp;
+
+    memset(&layout, 0, sizeof(layout));
+    memset(&header, 0, sizeof(header));
+
+    if (bb3dChunk->nodeChunk != NULL) countCacheNodes(&layout, bb3dChunk->nodeChunk);
+
+    layout.nodes = (Blitz3DNODEChunk**)malloc((layout.nodeCount + 1) * sizeof(Blitz3DNODEChunk*));
+    layout.meshes = (Blitz3DMESHChunk**)malloc((layout.meshCount + 1) * sizeof(Blitz3DMESHChunk*));
+    layout.tris = (Blitz3DTRISChunk**)malloc((layout.trisCount + 1) * sizeof(Blitz3DTRISChunk*));
+
+    header.childCount = layout.childCount;
+    layout.nodeCount = layout.meshCount = layout.trisCount = 0;
+
+    if (bb3dChunk->nodeChunk != NULL) collectCacheNodes(&layout, bb3dChunk->nodeChunk);
+
+    meshIndexLookup = layout.meshes;
+
+    /* header fields and section offsets */
+
+    header.magic = BLITZ3D_CACHE_MAGIC;
+    header.version = BLITZ3D_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+    header.bb3dVersion = bb3dChunk->version;
+
+    if (bb3dChunk->texsChunk != NULL) {
+        header.chunkFlags |= BLITZ3D_CACHE_HAS_TEXS;
+        header.textureCount = bb3dChunk->texsChunk->textureCount;
+        header.texsFileOffset = bb3dChunk->texsChunk->fileOffset;
+    }
+
+    if (bb3dChunk->brusChunk != NULL) {
+        header.chunkFlags |= BLITZ3D_CACHE_HAS_BRUS;
+        header.brushCount = bb3dChunk->brusChunk->brushCount;
+        header.brushTextureCount = bb3dChunk->brusChunk->n_texs;
+        header.brusFileOffset = bb3dChunk->brusChunk->fileOffset;
+    }
+
+    if (bb3dChunk->nodeChunk != NULL) header.chunkFlags |= BLITZ3D_CACHE_HAS_NODE;
+
+    header.nodeCount = layout.nodeCount;
+    header.meshCount = layout.meshCount;
+    header.trisCount = layout.trisCount;
+
+    header.textureOffset = alignCacheOffset(sizeof(Blitz3DCacheHeader));
+    header.brushOffset = alignCacheOffset(header.textureOffset + header.textureCount * sizeof(Blitz3DCacheTexture));
+    header.brushTextureIdOffset = alignCacheOffset(header.brushOffset + header.brushCount * sizeof(Blitz3DCacheBrush));
+    header.nodeOffset = alignCacheOffset(header.brushTextureIdOffset
+        + (uint64_t)header.brushCount * header.brushTextureCount * sizeof(int32_t));
+    header.childOffset = alignCacheOffset(header.nodeOffset + header.nodeCount * sizeof(Blitz3DCacheNode));
+    header.meshOffset = alignCacheOffset(header.childOffset + header.childCount * sizeof(uint32_t));
+    header.trisOffset = alignCacheOffset(header.meshOffset + header.meshCount * sizeof(Blitz3DCacheMesh));
+    header.stringOffset = alignCacheOffset(header.trisOffset + header.trisCount * sizeof(Blitz3DCacheTris));
+
+    stringSize = 0;
+    for (iter = 0; iter < header.textureCount; iter++) addCacheString(&stringSize, bb3dChunk->texsChunk->textureArray[iter]->file);
+    for (iter = 0; iter < header.brushCount; iter++) addCacheString(&stringSize, bb3dChunk->brusChunk->brushArray[iter]->name);
+    for (iter = 0; iter < header.nodeCount; iter++) addCacheString(&stringSize, layout.nodes[iter]->name);
+
+    header.stringSize = stringSize;
+
+    /* the arrays follow the strings; their total size decides totalSize */
+
+    dataPosition = alignCacheOffset(header.stringOffset + stringSize);
+
+    for (meshIter = 0; meshIter < layout.meshCount; meshIter++) {
+        Blitz3DVRTSChunk* vrtsChunk = layout.meshes[meshIter]->vrtsChunk;
+
+        if (vrtsChunk != NULL) {
+            dataPosition = alignCacheOffset(dataPosition + vrtsChunk->vertexCount * 3 * sizeof(float));
+            if (vrtsChunk->normalArray != NULL) dataPosition = alignCacheOffset(dataPosition + vrtsChunk->vertexCount * 3 * sizeof(float));
+            if (vrtsChunk->colorArray != NULL) dataPosition = alignCacheOffset(dataPosition + vrtsChunk->vertexCount * 4 * sizeof(float));
+
+            dataPosition += vrtsChunk->tex_coord_sets
+                * alignCacheOffset((uint64_t)vrtsChunk->vertexCount * vrtsChunk->tex_coord_set_size * sizeof(float));
+        }
+    }
+
+    for (trisIter = 0; trisIter < layout.trisCount; trisIter++) {
+        dataPosition = alignCacheOffset(dataPosition + layout.tris[trisIter]->triangleCount * 3 * sizeof(int32_t));
+    }
+
+    header.totalSize = dataPosition;
+
+    /* write everything in order */
+
+    temporaryPath = (char*)malloc(strlen(cachePath) + 5);
+    sprintf(temporaryPath, "%s.tmp", cachePath);
+
+    fp = fopen(temporaryPath, "wb");
+
+    if (fp == NULL) {
+        free(temporaryPath);
+        free(layout.nodes);
+        free(layout.meshes);
+        free(layout.tris);
+        return -1;
+    }
+
+    writeBuffer = (char*)malloc(BLITZ3D_CACHE_WRITE_BUFFER_SIZE);
+    setvbuf(fp, writeBuffer, _IOFBF, BLITZ3D_CACHE_WRITE_BUFFER_SIZE);
+
+    position = 0;
+    result |= writeCacheBytes(fp, &position, &header, sizeof(header));
+
+    stringSize = 0;
+
+    result |= writeCachePadding(fp, &position);
+    for (iter = 0; iter < header.textureCount; iter++) {
+        Blitz3DTexture* texture = bb3dChunk->texsChunk->textureArray[iter];
+        Blitz3DCacheTexture entry;
+
+        entry.file = addCacheString(&stringSize, texture->file);
+        entry.flags = texture->flags;
+        entry.blend = texture->blend;
+        entry.x_pos = texture->x_pos;
+        entry.y_pos = texture->y_pos;
+        entry.x_scale = texture->x_scale;
+        entry.y_scale = texture->y_scale;
+        entry.rotation = texture->rotation;
+
+        result |= writeCacheBytes(fp, &position, &entry, sizeof(entry));
+    }
+
+    result |= writeCachePadding(fp, &position);
+    for (iter = 0; iter < header.brushCount; iter++) {
+        Blitz3DBrush* brush = bb3dChunk->brusChunk->brushArray[iter];
+        Blitz3DCacheBrush entry;
+
+        entry.name = addCacheString(&stringSize, brush->name);
+        entry.red = brush->red;
+        entry.green = brush->green;
+        entry.blue = brush->blue;
+        entry.alpha = brush->alpha;
+        entry.shininess = brush->shininess;
+        entry.blend = brush->blend;
+        entry.fx = brush->fx;
+
+        result |= writeCacheBytes(fp, &position, &entry, sizeof(entry));
+    }
+
+    result |= writeCachePadding(fp, &position);
+    for (iter = 0; iter < header.brushCount; iter++) {
+        result |= writeCacheBytes(fp, &position, bb3dChunk->brusChunk->brushArray[iter]->texture_id,
+            header.brushTextureCount * sizeof(int32_t));
+    }
+
+    /* nodes refer to their children and meshes by index; children are listed in their own section */
+
+    result |= writeCachePadding(fp, &position);
+    childIter = 0;
+    meshIter = 0;
+
+    for (iter = 0; iter < header.nodeCount; iter++) {
+        Blitz3DNODEChunk* node = layout.nodes[iter];
+        Blitz3DCacheNode entry;
+
+        entry.fileOffset = node->fileOffset;
+        entry.name = addCacheString(&stringSize, node->name);
+        entry.firstChild = childIter;
+        entry.childCount = node->nodeChunkCount;
+        entry.meshIndex = -1;
+
+        if (node->meshChunk != NULL) {
+            while (meshIndexLookup[meshIter] != node->meshChunk) meshIter++;
+            entry.meshIndex = (int32_t)meshIter;
+        }
+
+        memcpy(entry.position, node->position, sizeof(entry.position));
+        memcpy(entry.scale, node->scale, sizeof(entry.scale));
+        memcpy(entry.rotation, node->rotation, sizeof(entry.rotation));
+
+        childIter += node->nodeChunkCount;
+
+        result |= writeCacheBytes(fp, &position, &entry, sizeof(entry));
+    }
+
+    /* commentary: depth-first order means each child's index is found by skipping its older siblings' subtrees */
+
+    result |= writeCachePadding(fp, &position);
+    for (iter = 0; iter < header.nodeCount; iter++) {
+        Blitz3DNODEChunk* node = layout.nodes[iter];
+        uint32_t childIndex = iter + 1;
+
+        for (childIter = 0; childIter < node->nodeChunkCount; childIter++) {
+            result |= writeCacheBytes(fp, &position, &childIndex, sizeof(uint32_t));
+
+            /* skip over the whole subtree of this child */
+            {
+                uint32_t remaining = 1;
+
+                while (remaining > 0) {
+                    remaining += layout.nodes[childIndex]->nodeChunkCount;
+                    remaining--;
+                    childIndex++;
+                }
+            }
+        }
+    }
+
+    /* meshes and TRIS chunks, with the array offsets laid out exactly as counted above */
+
+    dataPosition = alignCacheOffset(header.stringOffset + header.stringSize);
+
+    result |= writeCachePadding(fp, &position);
+    trisIter = 0;
+
+    for (meshIter = 0; meshIter < layout.meshCount; meshIter++) {
+        Blitz3DMESHChunk* mesh = layout.meshes[meshIter];
+        Blitz3DVRTSChunk* vrtsChunk = mesh->vrtsChunk;
+        Blitz3DCacheMesh entry;
+
+        memset(&entry, 0, sizeof(entry));
+
+        entry.fileOffset = mesh->fileOffset;
+        entry.brush_id = mesh->brush_id;
+        storeCacheBounds(&(mesh->bounds), entry.bounds, &(entry.boundsPresent));
+        entry.firstTris = trisIter;
+        entry.trisCount = mesh->trisChunkCount;
+
+        trisIter += mesh->trisChunkCount;
+
+        if (vrtsChunk != NULL) {
+            entry.vrtsPresent = 1;
+            entry.vertexCount = vrtsChunk->vertexCount;
+            entry.flags = vrtsChunk->flags;
+            entry.tex_coord_sets = vrtsChunk->tex_coord_sets;
+            entry.tex_coord_set_size = vrtsChunk->tex_coord_set_size;
+
+            entry.vertexData = dataPosition;
+            dataPosition = alignCacheOffset(dataPosition + vrtsChunk->vertexCount * 3 * sizeof(float));
+
+            if (vrtsChunk->normalArray != NULL) {
+                entry.normalData = dataPosition;
+                dataPosition = alignCacheOffset(dataPosition + vrtsChunk->vertexCount * 3 * sizeof(float));
+            }
+
+            if (vrtsChunk->colorArray != NULL) {
+                entry.colorData = dataPosition;
+                dataPosition = alignCacheOffset(dataPosition + vrtsChunk->vertexCount * 4 * sizeof(float));
+            }
+
+            entry.texCoordData = dataPosition;
+            entry.texCoordStride = alignCacheOffset((uint64_t)vrtsChunk->vertexCount * vrtsChunk->tex_coord_set_size * sizeof(float));
+            dataPosition += vrtsChunk->tex_coord_sets * entry.texCoordStride;
+        }
+
+        result |= writeCacheBytes(fp, &position, &entry, sizeof(entry));
+    }
+
+    result |= writeCachePadding(fp, &position);
+    for (trisIter = 0; trisIter < layout.trisCount; trisIter++) {
+        Blitz3DTRISChunk* tris = layout.tris[trisIter];
+        Blitz3DCacheTris entry;
+
+        memset(&entry, 0, sizeof(entry));
+
+        entry.indexData = dataPosition;
+        entry.brush_id = tris->brush_id;
+        entry.triangleCount = tris->triangleCount;
+        storeCacheBounds(&(tris->bounds), entry.bounds, &(entry.boundsPresent));
+
+        dataPosition = alignCacheOffset(dataPosition + tris->triangleCount * 3 * sizeof(int32_t));
+
+        result |= writeCacheBytes(fp, &position, &entry, sizeof(entry));
+    }
+
+    /* strings, in the order their offsets were handed out */
+
+    result |= writeCachePadding(fp, &position);
+    for (iter = 0; iter < header.textureCount; iter++) {
+        char* string = bb3dChunk->texsChunk->textureArray[iter]->file;
+        result |= writeCacheBytes(fp, &position, string, strlen(string) + 1);
+    }
+    for (iter = 0; iter < header.brushCount; iter++) {
+        char* string = bb3dChunk->brusChunk->brushArray[iter]->name;
+        result |= writeCacheBytes(fp, &position, string, strlen(string) + 1);
+    }
+    for (iter = 0; iter < header.nodeCount; iter++) {
+        char* string = layout.nodes[iter]->name;
+        result |= writeCacheBytes(fp, &position, string, strlen(string) + 1);
+    }
+
+    /* vertex and index arrays */
+
+    for (meshIter = 0; meshIter < layout.meshCount; meshIter++) {
+        Blitz3DVRTSChunk* vrtsChunk = layout.meshes[meshIter]->vrtsChunk;
+
+        if (vrtsChunk == NULL) continue;
+
+        result |= writeCachePadding(fp, &position);
+        result |= writeCacheBytes(fp, &position, vrtsChunk->vertexArray, vrtsChunk->vertexCount * 3 * sizeof(float));
+
+        if (vrtsChunk->normalArray != NULL) {
+            result |= writeCachePadding(fp, &position);
+            result |= writeCacheBytes(fp, &position, vrtsChunk->normalArray, vrtsChunk->vertexCount * 3 * sizeof(float));
+        }
+
+        if (vrtsChunk->colorArray != NULL) {
+            result |= writeCachePadding(fp, &position);
+            result |= writeCacheBytes(fp, &position, vrtsChunk->colorArray, vrtsChunk->vertexCount * 4 * sizeof(float));
+        }
+
+        for (set = 0; set < vrtsChunk->tex_coord_sets; set++) {
+            result |= writeCachePadding(fp, &position);
+            result |= writeCacheBytes(fp, &position, vrtsChunk->texCoordArrays[set],
+                vrtsChunk->vertexCount * vrtsChunk->tex_coord_set_size * sizeof(float));
+        }
+    }
+
+    for (trisIter = 0; trisIter < layout.trisCount; trisIter++) {
+        Blitz3DTRISChunk* tris = layout.tris[trisIter];
+
+        result |= writeCachePadding(fp, &position);
+        result |= writeCacheBytes(fp, &position, tris->indexArray, tris->triangleCount * 3 * sizeof(int32_t));
+    }
+
+    result |= writeCachePadding(fp, &position);
+
+    if (position != header.totalSize) result = -1;
+    if (fclose(fp) != 0) result = -1;
+
+    free(writeBuffer);
+
+    if (result == 0) {
+        remove(cachePath);
+        if (rename(temporaryPath, cachePath) != 0) result = -1;
+    }
+
+    if (result != 0) remove(temporaryPath);
+
+    free(temporaryPath);
+    free(layout.nodes);
+    free(layout.meshes);
+    free(layout.tris);
+
+    return result;
+}
+
+/* cache reading */
+
+int cacheRangeValid(Blitz3DCacheHeader* header, uint64_t offset, uint64_t size) {
+    return ( offset <= header->totalSize && size <= header->totalSize - offset && (offset % BLITZ3D_CACHE_ALIGNMENT) == 0 );
+}
+
+int cacheHeaderValid(Blitz3DCacheHeader* header, size_t cacheSize, uint64_t sourceHash, uint64_t sourceSize) {
+    if (cacheSize < sizeof(Blitz3DCacheHeader)) return 0;
+
+    if (header->magic != BLITZ3D_CACHE_MAGIC || header->version != BLITZ3D_CACHE_VERSION) return 0;
+    if (header->sourceHash != sourceHash || header->sourceSize != sourceSize) return 0;
+    if (header->totalSize != cacheSize) return 0;
+
+    if (header->brushTextureCount < 0) return 0;
+
+    return cacheRangeValid(header, header->textureOffset, (uint64_t)header->textureCount * sizeof(Blitz3DCacheTexture))
+        && cacheRangeValid(header, header->brushOffset, (uint64_t)header->brushCount * sizeof(Blitz3DCacheBrush))
+        && cacheRangeValid(header, header->brushTextureIdOffset, (uint64_t)header->brushCount * header->brushTextureCount * sizeof(int32_t))
+        && cacheRangeValid(header, header->nodeOffset, (uint64_t)header->nodeCount * sizeof(Blitz3DCacheNode))
+        && cacheRangeValid(header, header->childOffset, (uint64_t)header->childCount * sizeof(uint32_t))
+        && cacheRangeValid(header, header->meshOffset, (uint64_t)header->meshCount * sizeof(Blitz3DCacheMesh))
+        && cacheRangeValid(header, header->trisOffset, (uint64_t)header->trisCount * sizeof(Blitz3DCacheTris))
+        && cacheRangeValid(header, header->stringOffset, header->stringSize)
+        && (header->stringSize == 0 || ((char*)header)[header->stringOffset + header->stringSize - 1] == '\0');
+}
+
+char* getCacheString(Blitz3DCacheHeader* header, uint32_t offset) {
+    if (offset >= header->stringSize) return (char*)"";
+
+    return (char*)header + header->stringOffset + offset;
+}
+
+/* commentary: returns NULL if any mesh or TRIS entry points outside the cache, in which case the cache is rebuilt */
+
+B3DFile* createB3DFileFromCache(MappedFile* cacheFile, const char* filePath) {
+    Blitz3DCacheHeader* header = (Blitz3DCacheHeader*)getDataFromMappedFile(cacheFile);
+    unsigned char* base = (unsigned char*)header;
+    Blitz3DCacheTexture* textures = (Blitz3DCacheTexture*)(base + header->textureOffset);
+    Blitz3DCacheBrush* brushes = (Blitz3DCacheBrush*)(base + header->brushOffset);
+    int32_t* brushTextureIds = (int32_t*)(base + header->brushTextureIdOffset);
+    Blitz3DCacheNode* nodes = (Blitz3DCacheNode*)(base + header->nodeOffset);
+    uint32_t* children = (uint32_t*)(base + header->childOffset);
+    Blitz3DCacheMesh* meshes = (Blitz3DCacheMesh*)(base + header->meshOffset);
+    Blitz3DCacheTris* tris = (Blitz3DCacheTris*)(base + header->trisOffset);
+    Blitz3DNODEChunk* nodeChunks;
+    Blitz3DMESHChunk* meshChunks;
+    Blitz3DTRISChunk* trisChunks;
+    Blitz3DReader reader;
+    B3DFile* output;
+    unsigned int iter, childIter;
+    int set, valid = 1;
+
+    initializeMemoryReader(&reader, base, getSizeFromMappedFile(cacheFile));
+    reader.arena = createArena(BLITZ3D_ARENA_BLOCK_SIZE);
+
+    output = (B3DFile*)allocateZeroedFromReader(&reader, sizeof(B3DFile), BLITZ3D_CHUNK_BB3D);
+    output->bb3dChunk = (Blitz3DBB3DChunk*)allocateZeroedFromReader(&reader, sizeof(Blitz3DBB3DChunk), BLITZ3D_CHUNK_BB3D);
+    output->bb3dChunk->version = header->bb3dVersion;
+
+    if (header->chunkFlags & BLITZ3D_CACHE_HAS_TEXS) {
+        Blitz3DTEXSChunk* texsChunk = (Blitz3DTEXSChunk*)allocateZeroedFromReader(&reader, sizeof(Blitz3DTEXSChunk), BLITZ3D_CHUNK_TEXS);
+        Blitz3DTexture* textureArray = (Blitz3DTexture*)allocateFromReader(&reader,
+            header->textureCount * sizeof(Blitz3DTexture), BLITZ3D_CHUNK_TEXS);
+
+        texsChunk->fileOffset = header->texsFileOffset;
+        texsChunk->textureCount = header->textureCount;
+        texsChunk->textureArray = (Blitz3DTexture**)allocateFromReader(&reader,
+            header->textureCount * sizeof(Blitz3DTexture*), BLITZ3D_CHUNK_TEXS);
+
+        for (iter = 0; iter < header->textureCount; iter++) {
+            Blitz3DTexture* texture = &(textureArray[iter]);
+
+            texture->file = getCacheString(header, textures[iter].file);
+            texture->flags = textures[iter].flags;
+            texture->blend = textures[iter].blend;
+            texture->x_pos = textures[iter].x_pos;
+            texture->y_pos = textures[iter].y_pos;
+            texture->x_scale = textures[iter].x_scale;
+            texture->y_scale = textures[iter].y_scale;
+            texture->rotation = textures[iter].rotation;
+
+            texsChunk->textureArray[iter] = texture;
+        }
+
+        output->bb3dChunk->texsChunk = texsChunk;
+    }
+
+    if (header->chunkFlags & BLITZ3D_CACHE_HAS_BRUS) {
+        Blitz3DBRUSChunk* brusChunk = (Blitz3DBRUSChunk*)allocateZeroedFromReader(&reader, sizeof(Blitz3DBRUSChunk), BLITZ3D_CHUNK_BRUS);
+        Blitz3DBrush* brushArray = (Blitz3DBrush*)allocateFromReader(&reader,
+            header->brushCount * sizeof(Blitz3DBrush), BLITZ3D_CHUNK_BRUS);
+
+        brusChunk->fileOffset = header->brusFileOffset;
+        brusChunk->n_texs = header->brushTextureCount;
+        brusChunk->brushCount = header->brushCount;
+        brusChunk->brushArray = (Blitz3DBrush**)allocateFromReader(&reader,
+            header->brushCount * sizeof(Blitz3DBrush*), BLITZ3D_CHUNK_BRUS);
+
+        for (iter = 0; iter < header->brushCount; iter++) {
+            Blitz3DBrush* brush = &(brushArray[iter]);
+
+            brush->name = getCacheString(header, brushes[iter].name);
+            brush->texture_id = (int*)brushTextureIds + iter * header->brushTextureCount;
+            brush->red = brushes[iter].red;
+            brush->green = brushes[iter].green;
+            brush->blue = brushes[iter].blue;
+            brush->alpha = brushes[iter].alpha;
+            brush->shininess = brushes[iter].shininess;
+            brush->blend = brushes[iter].blend;
+            brush->fx = brushes[iter].fx;
+
+            brusChunk->brushArray[iter] = brush;
+        }
+
+        output->bb3dChunk->brusChunk = brusChunk;
+    }
+
+    /* TRIS chunks */
+
+    trisChunks = (Blitz3DTRISChunk*)allocateZeroedFromReader(&reader, header->trisCount * sizeof(Blitz3DTRISChunk), BLITZ3D_CHUNK_TRIS);
+
+    for (iter = 0; iter < header->trisCount; iter++) {
+        uint64_t indexBytes = (uint64_t)tris[iter].triangleCount * 3 * sizeof(int32_t);
+
+        if (!cacheRangeValid(header, tris[iter].indexData, indexBytes)) valid = 0;
+        if (!valid) break;
+
+        trisChunks[iter].brush_id = tris[iter].brush_id;
+        trisChunks[iter].triangleCount = tris[iter].triangleCount;
+        trisChunks[iter].indexArray = (int*)(base + tris[iter].indexData);
+        loadCacheBounds(&(trisChunks[iter].bounds), tris[iter].bounds, tris[iter].boundsPresent);
+
+        reader.chunkBytes[BLITZ3D_CHUNK_TRIS] += (size_t)indexBytes;
+    }
+
+    /* meshes and their VRTS chunks */
+
+    meshChunks = (Blitz3DMESHChunk*)allocateZeroedFromReader(&reader, header->meshCount * sizeof(Blitz3DMESHChunk), BLITZ3D_CHUNK_MESH);
+
+    for (iter = 0; iter < header->meshCount && valid; iter++) {
+        Blitz3DCacheMesh* entry = &(meshes[iter]);
+        Blitz3DMESHChunk* mesh = &(meshChunks[iter]);
+
+        mesh->fileOffset = entry->fileOffset;
+        mesh->brush_id = entry->brush_id;
+        loadCacheBounds(&(mesh->bounds), entry->bounds, entry->boundsPresent);
+
+        if ((uint64_t)entry->firstTris + entry->trisCount > header->trisCount) {
+            valid = 0;
+            break;
+        }
+
+        mesh->trisChunkCount = entry->trisCount;
+        mesh->trisChunkArray = (Blitz3DTRISChunk**)allocateFromReader(&reader,
+            entry->trisCount * sizeof(Blitz3DTRISChunk*), BLITZ3D_CHUNK_MESH);
+
+        for (childIter = 0; childIter < entry->trisCount; childIter++) {
+            mesh->trisChunkArray[childIter] = &(trisChunks[entry->firstTris + childIter]);
+        }
+
+        if (entry->vrtsPresent) {
+            Blitz3DVRTSChunk* vrtsChunk = (Blitz3DVRTSChunk*)allocateZeroedFromReader(&reader, sizeof(Blitz3DVRTSChunk), BLITZ3D_CHUNK_VRTS);
+            uint64_t vertexCount = entry->vertexCount;
+
+            if (entry->tex_coord_sets < 0 || entry->tex_coord_sets > 8
+                || entry->tex_coord_set_size < 0 || entry->tex_coord_set_size > 4) {
+                valid = 0;
+                break;
+            }
+
+            vrtsChunk->vertexCount = entry->vertexCount;
+            vrtsChunk->flags = entry->flags;
+            vrtsChunk->tex_coord_sets = entry->tex_coord_sets;
+            vrtsChunk->tex_coord_set_size = entry->tex_coord_set_size;
+
+            if (!cacheRangeValid(header, entry->vertexData, vertexCount * 3 * sizeof(float))) valid = 0;
+            vrtsChunk->vertexArray = (float*)(base + entry->vertexData);
+            reader.chunkBytes[BLITZ3D_CHUNK_VRTS] += (size_t)(vertexCount * 3 * sizeof(float));
+
+            if (entry->flags & BLITZ3D_VERTEX_FLAG_NORMAL) {
+                if (!cacheRangeValid(header, entry->normalData, vertexCount * 3 * sizeof(float))) valid = 0;
+                vrtsChunk->normalArray = (float*)(base + entry->normalData);
+                reader.chunkBytes[BLITZ3D_CHUNK_VRTS] += (size_t)(vertexCount * 3 * sizeof(float));
+            }
+
+            if (entry->flags & BLITZ3D_VERTEX_FLAG_COLOR) {
+                if (!cacheRangeValid(header, entry->colorData, vertexCount * 4 * sizeof(float))) valid = 0;
+                vrtsChunk->colorArray = (float*)(base + entry->colorData);
+                reader.chunkBytes[BLITZ3D_CHUNK_VRTS] += (size_t)(vertexCount * 4 * sizeof(float));
+            }
+
+            vrtsChunk->texCoordArrays = (float**)allocateFromReader(&reader,
+                vrtsChunk->tex_coord_sets * sizeof(float*), BLITZ3D_CHUNK_VRTS);
+
+            for (set = 0; set < vrtsChunk->tex_coord_sets; set++) {
+                uint64_t setOffset = entry->texCoordData + set * entry->texCoordStride;
+                uint64_t setBytes = vertexCount * vrtsChunk->tex_coord_set_size * sizeof(float);
+
+                if (!cacheRangeValid(header, setOffset, setBytes)) valid = 0;
+                vrtsChunk->texCoordArrays[set] = (float*)(base + setOffset);
+                reader.chunkBytes[BLITZ3D_CHUNK_VRTS] += (size_t)setBytes;
+            }
+
+            mesh->vrtsChunk = vrtsChunk;
+        }
+    }
+
+    /* nodes, whose child arrays refer back into the same node array */
+
+    nodeChunks = (Blitz3DNODEChunk*)allocateZeroedFromReader(&reader, header->nodeCount * sizeof(Blitz3DNODEChunk), BLITZ3D_CHUNK_NODE);
+
+    for (iter = 0; iter < header->nodeCount && valid; iter++) {
+        Blitz3DCacheNode* entry = &(nodes[iter]);
+        Blitz3DNODEChunk* node = &(nodeChunks[iter]);
+
+        if ((uint64_t)entry->firstChild + entry->childCount > header->childCount
+            || (entry->meshIndex >= 0 && (uint32_t)entry->meshIndex >= header->meshCount)) {
+            valid = 0;
+            break;
+        }
+
+        node->fileOffset = entry->fileOffset;
+        node->name = getCacheString(header, entry->name);
+
+        memcpy(node->position, entry->position, sizeof(node->position));
+        memcpy(node->scale, entry->scale, sizeof(node->scale));
+        memcpy(node->rotation, entry->rotation, sizeof(node->rotation));
+
+        if (entry->meshIndex >= 0) node->meshChunk = &(meshChunks[entry->meshIndex]);
+
+        node->nodeChunkCount = entry->childCount;
+        node->nodeChunkArray = (Blitz3DNODEChunk**)allocateFromReader(&reader,
+            entry->childCount * sizeof(Blitz3DNODEChunk*), BLITZ3D_CHUNK_NODE);
+
+        for (childIter = 0; childIter < entry->childCount; childIter++) {
+            uint32_t childIndex = children[entry->firstChild + childIter];
+
+            if (childIndex <= iter || childIndex >= header->nodeCount) {
+                valid = 0;
+                break;
+            }
+
+            node->nodeChunkArray[childIter] = &(nodeChunks[childIndex]);
+        }
+    }
+
+    if (!valid) {
+        freeArena(reader.arena);
+        return NULL;
+    }
+
+    if ((header->chunkFlags & BLITZ3D_CACHE_HAS_NODE) && header->nodeCount > 0) {
+        output->bb3dChunk->nodeChunk = &(nodeChunks[0]);
+        propagateBoundsInNODEChunk(output->bb3dChunk->nodeChunk);
+    }
+
+    output->directory = createDirectoryFromFilePath(&reader, filePath);
+    output->mappedFile = cacheFile;
+    output->loadedFromCache = 1;
+
+    output->arena = reader.arena;
+    memcpy(output->chunkBytes, reader.chunkBytes, sizeof(output->chunkBytes));
+
+    return output;
+}
+
+B3DFile* loadB3DFileThroughCache(const char* filePath, int flags) {
+    MappedFile* sourceFile;
+    MappedFile* cacheFile;
+    B3DFile* output = NULL;
+    char* cachePath;
+    uint64_t sourceHash, sourceSize;
+
+    sourceFile = openMappedFile(filePath);
+    if (sourceFile == NULL) return NULL;
+
+    sourceSize = getSizeFromMappedFile(sourceFile);
+    sourceHash = hashBlitz3DSource(getDataFromMappedFile(sourceFile), (size_t)sourceSize);
+
+    cachePath = (char*)malloc(strlen(filePath) + 2);
+    sprintf(cachePath, "%sc", filePath);
+
+    cacheFile = openMappedFile(cachePath);
+
+    if (cacheFile != NULL) {
+        Blitz3DCacheHeader* header = (Blitz3DCacheHeader*)getDataFromMappedFile(cacheFile);
+
+        if (cacheHeaderValid(header, getSizeFromMappedFile(cacheFile), sourceHash, sourceSize)) {
+            output = createB3DFileFromCache(cacheFile, filePath);
+        }
+
+        if (output == NULL) closeMappedFile(cacheFile);
+    }
+
+    if (output != NULL) {
+        closeMappedFile(sourceFile);
+    }
+    else {
+        /* missing or stale: decode the level itself and write a fresh cache for next time */
+
+        output = loadB3DFileFromMapping(sourceFile, filePath, flags & BLITZ3D_LOAD_PARALLEL);
+
+        if (output != NULL && writeB3DFileCache(output, cachePath, sourceHash, sourceSize) != 0) {
+            fprintf(stderr, "could not write cache file %s\n", cachePath);
+        }
+    }
+
+    free(cachePath);
+
+    return output;
+}
@@ -1,149 +1,53 @@
-#include "Blitz3DFile.h"
+/* 64-bit off_t for fseeko/ftello on 32-bit systems; must come before any system header */
+#define _FILE_OFFSET_BITS 64
+
+#include "Blitz3DFileInternal.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 
-#include "Stack.h"
-
-/* Blitz3D defines */
-
-#define BLITZ3D_TAG_BB3D_LITTLE_ENDIAN 0x44334242
-#define BLITZ3D_TAG_TEXS_LITTLE_ENDIAN 0x53584554
-#define BLITZ3D_TAG_BRUS_LITTLE_ENDIAN 0x53555242
-#define BLITZ3D_TAG_NODE_LITTLE_ENDIAN 0x45444F4E
-#define BLITZ3D_TAG_MESH_LITTLE_ENDIAN 0x4853454D
-#define BLITZ3D_TAG_VRTS_LITTLE_ENDIAN 0x53545256
-#define BLITZ3D_TAG_TRIS_LITTLE_ENDIAN 0x53495254
-
-#define BLITZ3D_VERTEX_FLAG_NORMAL 1
-#define BLITZ3D_VERTEX_FLAG_COLOR 2
-
-/* Blitz3D structures */
-
-struct Blitz3DTexture {
-    char* file;
-
-    int flags, blend;
-    float x_pos, y_pos;
-    float x_scale, y_scale;
-    float rotation;
-};
-
-struct Blitz3DTEXSChunk {
-    Blitz3DTexture** textureArray;
-
-    unsigned int textureCount;
-};
-
-struct Blitz3DBrush {
-    char* name;
-    int* texture_id;
-
-    float red, green, blue, alpha;
-    float shininess;
-    int blend, fx;
-};
-
-struct Blitz3DBRUSChunk {
-    Blitz3DBrush** brushArray;
-
-    unsigned int brushCount;
-
-    int n_texs;
-};
-
-struct Blitz3DVertexNormal {
-    float nx, ny, nz;
-};
-
-struct Blitz3DVertexColor {
-    float red, green, blue, alpha;
-};
-
-struct Blitz3DVertex {
-    Blitz3DVertexNormal* vertexNormal;
-    Blitz3DVertexColor* vertexColor;
-    float** tex_coords;
+#include "ThreadPool.h"
+#include "BulkDecode.h"
 
-    float x, y, z;
-};
-
-struct Blitz3DVRTSChunk {
-    float* vertexArray;
-    float* normalArray;
-    float* colorArray;
-    float** texCoordArrays;
-
-    unsigned int vertexCount;
-
-    int flags;
-    int tex_coord_sets;
-    int tex_coord_set_size;
-};
-
-struct Blitz3DTriangle {
-    int vertex_id[3];
-};
-
-struct Blitz3DTRISChunk {
-    int* indexArray;
-
-    unsigned int triangleCount;
-
-    int brush_id;
-};
-
-struct Blitz3DMESHChunk {
-    Blitz3DVRTSChunk* vrtsChunk;
-    Blitz3DTRISChunk** trisChunkArray;
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
 
-    unsigned int trisChunkCount;
+/* meshes are handed to the parallel loader's workers in batches of at least this many bytes */
+#define BLITZ3D_PARALLEL_MIN_BATCH_BYTES (64 * 1024)
+#define BLITZ3D_PARALLEL_BATCHES_PER_THREAD 8
 
-    int brush_id;
-};
-
-struct Blitz3DNODEChunk {
-    Blitz3DMESHChunk* meshChunk;
-    Blitz3DNODEChunk** nodeChunkArray;
-    char* name;
-
-    unsigned int nodeChunkCount;
-
-    float position[3];
-    float scale[3];
-    float rotation[4];
-};
-
-struct Blitz3DBB3DChunk {
-    Blitz3DTEXSChunk* texsChunk;
-    Blitz3DBRUSChunk* brusChunk;
-    Blitz3DNODEChunk* nodeChunk;
-
-    int version;
-};
-
-/* commentary: this name might be changed to Blitz3DFile? */
+/* binary read functions */
 
-struct B3DFile {
-    Blitz3DBB3DChunk* bb3dChunk;
-    char* directory;
-};
+/* commentary: plain fseek/ftell take a long, which is 32 bits on Windows, so files over 2 GB go through these */
 
-/* binary read functions */
+int seekBinaryFile(FILE* fp, int64_t offset, int origin) {
+#ifdef _WIN32
+    return _fseeki64(fp, offset, origin);
+#else
+    return fseeko(fp, (off_t)offset, origin);
+#endif
+}
 
-/* commentary: consider adding a float-reading function */
+int64_t tellBinaryFile(FILE* fp) {
+#ifdef _WIN32
+    return _ftelli64(fp);
+#else
+    return (int64_t)ftello(fp);
+#endif
+}
 
 char* readStringFromBinaryFile(FILE* fp) {
     int position = 0;
     int capacity = 8;
     char* buffer;
     char* output;
-    char temp;
+    int temp;
 
     buffer = (char*)malloc(capacity);
 
-    while ( (temp = fgetc(fp)) != '\0' ) {
+    while ( (temp = fgetc(fp)) != '\0' && temp != EOF ) {
         if (position >= capacity) {
             char* temporaryBuffer = (char*)malloc(2 * capacity);
             memcpy(temporaryBuffer, buffer, capacity);
@@ -153,7 +57,7 @@ char* readStringFromBinaryFile(FILE* fp) {
             capacity *= 2;
         }
 
-        buffer[position] = temp;
+        buffer[position] = (char)temp;
         position++;
     }
 
@@ -195,474 +99,833 @@ int read32BitIntegerFromBinaryFile(FILE* stream, uint32_t* address, int littleEn
     return 0;
 }
 
-/* Blitz3D binary read functions */
 
-void skipBlitz3DChunk(FILE* fp) {
-    int size;
+void initializeFileReader(Blitz3DReader* reader, FILE* fp, uint64_t size) {
+    memset(reader, 0, sizeof(Blitz3DReader));
+
+    reader->fp = fp;
+    reader->size = size;
+}
 
-    read32BitIntegerFromBinaryFile(fp, &size, 1);
+void initializeMemoryReader(Blitz3DReader* reader, const unsigned char* data, size_t size) {
+    memset(reader, 0, sizeof(Blitz3DReader));
 
-    fseek(fp, size, SEEK_CUR);
+    reader->data = data;
+    reader->size = size;
 }
 
-Blitz3DTEXSChunk* readBlitz3DTEXSChunk(FILE* fp) {
-    Blitz3DTEXSChunk* output;
-    Stack* textureStack;
-    int size, startingPoint, iter;
+void* allocateFromReader(Blitz3DReader* reader, size_t size, int chunkType) {
+    reader->chunkBytes[chunkType] += size;
+
+    return allocateFromArena(reader->arena, size);
+}
 
-    output = (Blitz3DTEXSChunk*)malloc(sizeof(Blitz3DTEXSChunk));
-    textureStack = createStack();
+void* allocateZeroedFromReader(Blitz3DReader* reader, size_t size, int chunkType) {
+    reader->chunkBytes[chunkType] += size;
 
-    read32BitIntegerFromBinaryFile(fp, &size, 1);
+    return allocateZeroedFromArena(reader->arena, size);
+}
 
-    /*printf("size = %d\n", size);*/
-    startingPoint = ftell(fp);
+/* child arrays are filled in file order straight into the reader's arena, then kept as they are */
 
-    /* reading stuff here */
+void initializeChildArrayFromReader(Blitz3DReader* reader, DynamicArray* array) {
+    initializeDynamicArray(array, sizeof(void*), reader->arena);
+}
+
+void pushOntoChildArrayFromReader(Blitz3DReader* reader, DynamicArray* array, void* child) {
+    if (pushPointerOntoDynamicArray(array, child) != 0) reader->error = 1;
+}
+
+void* finishChildArrayFromReader(Blitz3DReader* reader, DynamicArray* array, int chunkType) {
+    reader->chunkBytes[chunkType] += array->capacity * array->elementSize;
+
+    return getDataFromDynamicArray(array);
+}
+
+uint64_t getRemainingBytesFromReader(Blitz3DReader* reader) {
+    return reader->size - reader->position;
+}
+
+int checkReaderBounds(Blitz3DReader* reader, uint64_t count) {
+    if (reader->error || count > getRemainingBytesFromReader(reader)) {
+        reader->error = 1;
+        reader->position = reader->size;
+        return -1;
+    }
+
+    return 0;
+}
+
+char* readStringFromReader(Blitz3DReader* reader, int chunkType) {
+    const unsigned char* start;
+    const unsigned char* terminator;
+    char* output;
+    size_t length;
 
-    while (ftell(fp) < startingPoint + size) {
-        Blitz3DTexture* texture = (Blitz3DTexture*)malloc(sizeof(Blitz3DTexture));
+    if (reader->fp != NULL) {
+        char* temporaryString = readStringFromBinaryFile(reader->fp);
+        length = strlen(temporaryString);
 
-        texture->file = readStringFromBinaryFile(fp);
+        output = (char*)allocateFromReader(reader, length + 1, chunkType);
+        memcpy(output, temporaryString, length + 1);
+        free(temporaryString);
 
-        read32BitIntegerFromBinaryFile(fp, &(texture->flags), 1);
-        read32BitIntegerFromBinaryFile(fp, &(texture->blend), 1);
+        reader->position += length + 1;
 
-        read32BitIntegerFromBinaryFile(fp, (int*)&(texture->x_pos), 1);
-        read32BitIntegerFromBinaryFile(fp, (int*)&(texture->y_pos), 1);
-        read32BitIntegerFromBinaryFile(fp, (int*)&(texture->x_scale), 1);
-        read32BitIntegerFromBinaryFile(fp, (int*)&(texture->y_scale), 1);
-        read32BitIntegerFromBinaryFile(fp, (int*)&(texture->rotation), 1);
+        if (reader->position > reader->size) {
+            reader->error = 1;
+            reader->position = reader->size;
+        }
 
-        pushOntoStack(textureStack, (void*)texture);
+        return output;
     }
 
-    output->textureCount = getStackCount(textureStack);
-    output->textureArray = (Blitz3DTexture**)malloc(output->textureCount * sizeof(Blitz3DTexture*));
+    start = reader->data + reader->position;
+    terminator = (const unsigned char*)memchr(start, '\0', (size_t)getRemainingBytesFromReader(reader));
 
-    for (iter = 0; iter < output->textureCount; iter++) {
-        output->textureArray[output->textureCount - iter - 1] = (Blitz3DTexture*)popOffOfStack(textureStack);
+    if (terminator == NULL) {
+        checkReaderBounds(reader, getRemainingBytesFromReader(reader) + 1);
+        return (char*)allocateZeroedFromReader(reader, 1, chunkType);
     }
 
-    /*fseek(fp, size + startingPoint - ftell(fp), SEEK_CUR);*/
+    length = terminator - start;
+
+    output = (char*)allocateFromReader(reader, length + 1, chunkType);
+    memcpy(output, start, length + 1);
 
-    freeStack(textureStack);
+    reader->position += length + 1;
 
     return output;
 }
 
-Blitz3DBRUSChunk* readBlitz3DBRUSChunk(FILE* fp) {
-    Blitz3DBRUSChunk* output;
-    Stack* brushStack;
-    int size, startingPoint, iter;
+int read32BitIntegerFromReader(Blitz3DReader* reader, uint32_t* address) {
+    const unsigned char* bytes;
 
-    output = (Blitz3DBRUSChunk*)malloc(sizeof(Blitz3DBRUSChunk));
-    brushStack = createStack();
+    if (checkReaderBounds(reader, 4) != 0) {
+        *address = 0;
+        return -1;
+    }
 
-    read32BitIntegerFromBinaryFile(fp, &size, 1);
+    if (reader->fp != NULL) {
+        read32BitIntegerFromBinaryFile(reader->fp, address, 1);
+    }
+    else {
+        bytes = reader->data + reader->position;
 
-    /*printf("size = %d\n", size);*/
-    startingPoint = ftell(fp);
+        *address = (uint32_t)bytes[0]
+            | ((uint32_t)bytes[1] << 0x08)
+            | ((uint32_t)bytes[2] << 0x10)
+            | ((uint32_t)bytes[3] << 0x18);
+    }
 
-    /* reading stuff here */
+    reader->position += 4;
 
-    read32BitIntegerFromBinaryFile(fp, &(output->n_texs), 1);
+    return 0;
+}
 
-    /*printf("nTexs = %d\n", output->n_texs);*/
+int readFloatFromReader(Blitz3DReader* reader, float* address) {
+    uint32_t bits;
+    int result;
 
-    while (ftell(fp) < startingPoint + size) {
-        Blitz3DBrush* brush = (Blitz3DBrush*)malloc(sizeof(Blitz3DBrush));
+    result = read32BitIntegerFromReader(reader, &bits);
+    memcpy(address, &bits, sizeof(float));
 
-        brush->name = readStringFromBinaryFile(fp);
+    return result;
+}
 
-        read32BitIntegerFromBinaryFile(fp, (int*)&(brush->red), 1);
-        read32BitIntegerFromBinaryFile(fp, (int*)&(brush->green), 1);
-        read32BitIntegerFromBinaryFile(fp, (int*)&(brush->blue), 1);
-        read32BitIntegerFromBinaryFile(fp, (int*)&(brush->alpha), 1);
+void skipBytesInReader(Blitz3DReader* reader, uint64_t count) {
+    if (checkReaderBounds(reader, count) != 0) return;
 
-        read32BitIntegerFromBinaryFile(fp, (int*)&(brush->shininess), 1);
+    if (reader->fp != NULL) seekBinaryFile(reader->fp, (int64_t)count, SEEK_CUR);
 
-        read32BitIntegerFromBinaryFile(fp, &(brush->blend), 1);
-        read32BitIntegerFromBinaryFile(fp, &(brush->fx), 1);
+    reader->position += count;
+}
 
-        brush->texture_id = (int*)malloc(output->n_texs * sizeof(int));
+/* returns the next count bytes and moves past them; a FILE* reader reads them into its scratch buffer first */
 
-        for (iter = 0; iter < output->n_texs; iter++) {
-            read32BitIntegerFromBinaryFile(fp, &(brush->texture_id[iter]), 1);
+const unsigned char* readBytesFromReader(Blitz3DReader* reader, uint64_t count) {
+    const unsigned char* output;
+
+    if (checkReaderBounds(reader, count) != 0) return NULL;
+
+    if (reader->fp != NULL) {
+        if (count > reader->scratchSize) {
+            unsigned char* scratch = (unsigned char*)realloc(reader->scratch, (size_t)count);
+
+            if (scratch == NULL) {
+                reader->error = 1;
+                return NULL;
+            }
+
+            reader->scratch = scratch;
+            reader->scratchSize = (size_t)count;
         }
 
-        pushOntoStack(brushStack, (void*)brush);
+        if (fread(reader->scratch, 1, (size_t)count, reader->fp) != (size_t)count) {
+            reader->error = 1;
+            return NULL;
+        }
+
+        output = reader->scratch;
+    }
+    else {
+        output = reader->data + reader->position;
     }
 
-    output->brushCount = getStackCount(brushStack);
-    output->brushArray = (Blitz3DBrush**)malloc(output->brushCount * sizeof(Blitz3DBrush*));
+    reader->position += count;
 
-    for (iter = 0; iter < output->brushCount; iter++) {
-        output->brushArray[output->brushCount - iter - 1] = (Blitz3DBrush*)popOffOfStack(brushStack);
-    }
+    return output;
+}
+
+uint64_t readChunkEndFromReader(Blitz3DReader* reader) {
+    uint32_t size;
+
+    read32BitIntegerFromReader(reader, &size);
+
+    if (checkReaderBounds(reader, size) != 0) return reader->size;
+
+    return reader->position + size;
+}
+
+/* Blitz3D binary read functions */
+
+void skipBlitz3DChunk(Blitz3DReader* reader) {
+    uint32_t size;
+
+    read32BitIntegerFromReader(reader, &size);
+
+    skipBytesInReader(reader, size);
+}
+
+Blitz3DTEXSChunk* readBlitz3DTEXSChunk(Blitz3DReader* reader) {
+    Blitz3DTEXSChunk* output;
+    DynamicArray textures;
+    uint64_t end;
+
+    output = (Blitz3DTEXSChunk*)allocateFromReader(reader, sizeof(Blitz3DTEXSChunk), BLITZ3D_CHUNK_TEXS);
+    output->fileOffset = reader->position - 4;
+    initializeChildArrayFromReader(reader, &textures);
+
+    end = readChunkEndFromReader(reader);
+
+    /* reading stuff here */
+
+    while (reader->position < end && !reader->error) {
+        Blitz3DTexture* texture = (Blitz3DTexture*)allocateFromReader(reader, sizeof(Blitz3DTexture), BLITZ3D_CHUNK_TEXS);
+
+        texture->file = readStringFromReader(reader, BLITZ3D_CHUNK_TEXS);
 
-    /*fseek(fp, size + startingPoint - ftell(fp), SEEK_CUR);*/
+        read32BitIntegerFromReader(reader, &(texture->flags));
+        read32BitIntegerFromReader(reader, &(texture->blend));
+
+        readFloatFromReader(reader, &(texture->x_pos));
+        readFloatFromReader(reader, &(texture->y_pos));
+        readFloatFromReader(reader, &(texture->x_scale));
+        readFloatFromReader(reader, &(texture->y_scale));
+        readFloatFromReader(reader, &(texture->rotation));
+
+        pushOntoChildArrayFromReader(reader, &textures, (void*)texture);
+    }
 
-    freeStack(brushStack);
+    output->textureCount = (unsigned int)getDynamicArrayCount(&textures);
+    output->textureArray = (Blitz3DTexture**)finishChildArrayFromReader(reader, &textures, BLITZ3D_CHUNK_TEXS);
 
     return output;
 }
 
-Blitz3DVRTSChunk* readBlitz3DVRTSChunk(FILE* fp) {
-    Blitz3DVRTSChunk* output;
-    Stack* vertexStack;
-    int size, startingPoint, iter, texCoordIter, texComponentIter;
+Blitz3DBRUSChunk* readBlitz3DBRUSChunk(Blitz3DReader* reader) {
+    Blitz3DBRUSChunk* output;
+    DynamicArray brushes;
+    uint64_t end;
+    unsigned int iter;
 
-    output = (Blitz3DVRTSChunk*)calloc(1, sizeof(Blitz3DVRTSChunk));
-    vertexStack = createStack();
+    output = (Blitz3DBRUSChunk*)allocateFromReader(reader, sizeof(Blitz3DBRUSChunk), BLITZ3D_CHUNK_BRUS);
+    output->fileOffset = reader->position - 4;
+    initializeChildArrayFromReader(reader, &brushes);
 
-    read32BitIntegerFromBinaryFile(fp, &size, 1);
+    end = readChunkEndFromReader(reader);
 
-    /*printf("size = %d\n", size);*/
-    startingPoint = ftell(fp);
+    /* reading stuff here */
 
-    read32BitIntegerFromBinaryFile(fp, &(output->flags), 1);
-    read32BitIntegerFromBinaryFile(fp, &(output->tex_coord_sets), 1);
-    read32BitIntegerFromBinaryFile(fp, &(output->tex_coord_set_size), 1);
+    read32BitIntegerFromReader(reader, &(output->n_texs));
 
-    /*printf("flags = %d\n", output->flags);
-    printf("tex_coord_sets = %d\n", output->tex_coord_sets);
-    printf("tex_coord_set_size = %d\n", output->tex_coord_set_size);*/
+    /*printf("nTexs = %d\n", output->n_texs);*/
+
+    /* commentary: n_texs comes straight from the file, so keep it within what the chunk can hold; a chunk
+       too small for n_texs itself leaves the position past its end */
+    if (reader->position > end || output->n_texs < 0 || (uint64_t)output->n_texs > (end - reader->position) / 4) {
+        output->n_texs = 0;
+        reader->error = 1;
+    }
 
-    /* commentary: consider alternative approach of refering to size and doing fixed iteration count */
+    while (reader->position < end && !reader->error) {
+        Blitz3DBrush* brush = (Blitz3DBrush*)allocateFromReader(reader, sizeof(Blitz3DBrush), BLITZ3D_CHUNK_BRUS);
 
-    while (ftell(fp) < startingPoint + size) {
-        Blitz3DVertex* vertex = (Blitz3DVertex*)malloc(sizeof(Blitz3DVertex));
+        brush->name = readStringFromReader(reader, BLITZ3D_CHUNK_BRUS);
 
-        read32BitIntegerFromBinaryFile(fp, (int*)&(vertex->x), 1);
-        read32BitIntegerFromBinaryFile(fp, (int*)&(vertex->y), 1);
-        read32BitIntegerFromBinaryFile(fp, (int*)&(vertex->z), 1);
+        readFloatFromReader(reader, &(brush->red));
+        readFloatFromReader(reader, &(brush->green));
+        readFloatFromReader(reader, &(brush->blue));
+        readFloatFromReader(reader, &(brush->alpha));
 
-        if (output->flags & BLITZ3D_VERTEX_FLAG_NORMAL) {
-            Blitz3DVertexNormal* normal = (Blitz3DVertexNormal*)malloc(sizeof(Blitz3DVertexNormal));
+        readFloatFromReader(reader, &(brush->shininess));
 
-            read32BitIntegerFromBinaryFile(fp, (int*)&(normal->nx), 1);
-            read32BitIntegerFromBinaryFile(fp, (int*)&(normal->ny), 1);
-            read32BitIntegerFromBinaryFile(fp, (int*)&(normal->nz), 1);
+        read32BitIntegerFromReader(reader, &(brush->blend));
+        read32BitIntegerFromReader(reader, &(brush->fx));
 
-            vertex->vertexNormal = normal;
+        brush->texture_id = (int*)allocateFromReader(reader, output->n_texs * sizeof(int), BLITZ3D_CHUNK_BRUS);
+
+        for (iter = 0; iter < output->n_texs; iter++) {
+            read32BitIntegerFromReader(reader, &(brush->texture_id[iter]));
         }
 
-        if (output->flags & BLITZ3D_VERTEX_FLAG_COLOR) {
-            Blitz3DVertexColor* color = (Blitz3DVertexColor*)malloc(sizeof(Blitz3DVertexColor));
+        pushOntoChildArrayFromReader(reader, &brushes, (void*)brush);
+    }
 
-            read32BitIntegerFromBinaryFile(fp, (int*)&(color->red), 1);
-            read32BitIntegerFromBinaryFile(fp, (int*)&(color->green), 1);
-            read32BitIntegerFromBinaryFile(fp, (int*)&(color->blue), 1);
-            read32BitIntegerFromBinaryFile(fp, (int*)&(color->alpha), 1);
+    output->brushCount = (unsigned int)getDynamicArrayCount(&brushes);
+    output->brushArray = (Blitz3DBrush**)finishChildArrayFromReader(reader, &brushes, BLITZ3D_CHUNK_BRUS);
 
-            vertex->vertexColor = color;
-        }
+    return output;
+}
 
-        vertex->tex_coords = (float**)malloc(output->tex_coord_sets * sizeof(float*));
+unsigned int getVertexStrideFromVRTSChunk(Blitz3DVRTSChunk* vrtsChunk) {
+    unsigned int output = 3;
 
-        for (iter = 0; iter < output->tex_coord_sets; iter++) {
-            vertex->tex_coords[iter] = (float*)malloc(output->tex_coord_set_size * sizeof(float));
+    if (vrtsChunk->flags & BLITZ3D_VERTEX_FLAG_NORMAL) output += 3;
+    if (vrtsChunk->flags & BLITZ3D_VERTEX_FLAG_COLOR) output += 4;
 
-            for (texCoordIter = 0; texCoordIter < output->tex_coord_set_size; texCoordIter++) {
-                read32BitIntegerFromBinaryFile(fp, (int*)&(vertex->tex_coords[iter][texCoordIter]), 1);
-            }
-        }
+    output += vrtsChunk->tex_coord_sets * vrtsChunk->tex_coord_set_size;
 
-        pushOntoStack(vertexStack, (void*)vertex);
+    return output * sizeof(float);
+}
+
+Blitz3DVRTSChunk* readBlitz3DVRTSChunk(Blitz3DReader* reader) {
+    Blitz3DVRTSChunk* output;
+    const unsigned char* payload;
+    uint64_t end;
+    unsigned int stride;
+    int texCoordIter;
+
+    output = (Blitz3DVRTSChunk*)allocateZeroedFromReader(reader, sizeof(Blitz3DVRTSChunk), BLITZ3D_CHUNK_VRTS);
+
+    end = readChunkEndFromReader(reader);
+
+    read32BitIntegerFromReader(reader, &(output->flags));
+    read32BitIntegerFromReader(reader, &(output->tex_coord_sets));
+    read32BitIntegerFromReader(reader, &(output->tex_coord_set_size));
+
+    /*printf("flags = %d\n", output->flags);
+    printf("tex_coord_sets = %d\n", output->tex_coord_sets);
+    printf("tex_coord_set_size = %d\n", output->tex_coord_set_size);*/
+
+    /* commentary: both counts come straight from the file, so reject anything that cannot fit the chunk */
+    if (output->tex_coord_sets < 0 || output->tex_coord_sets > 8
+        || output->tex_coord_set_size < 0 || output->tex_coord_set_size > 4) {
+        output->tex_coord_sets = 0;
+        output->tex_coord_set_size = 0;
+        reader->error = 1;
     }
 
-    output->vertexCount = getStackCount(vertexStack);
+    /* the vertex count follows from the chunk size and the per-vertex layout in the header */
+
+    if (reader->error || reader->position > end) output->vertexCount = 0;
+    else output->vertexCount = (end - reader->position) / getVertexStrideFromVRTSChunk(output);
 
-    output->vertexArray = (float*)malloc(output->vertexCount * 3 * sizeof(float));
+    output->vertexArray = (float*)allocateFromReader(reader, output->vertexCount * 3 * sizeof(float), BLITZ3D_CHUNK_VRTS);
     if (output->flags & BLITZ3D_VERTEX_FLAG_NORMAL) {
-        output->normalArray = (float*)malloc(output->vertexCount * 3 * sizeof(float));
+        output->normalArray = (float*)allocateFromReader(reader, output->vertexCount * 3 * sizeof(float), BLITZ3D_CHUNK_VRTS);
     }
     if (output->flags & BLITZ3D_VERTEX_FLAG_COLOR) {
-        output->colorArray = (float*)malloc(output->vertexCount * 4 * sizeof(float));
+        output->colorArray = (float*)allocateFromReader(reader, output->vertexCount * 4 * sizeof(float), BLITZ3D_CHUNK_VRTS);
     }
 
-    output->texCoordArrays = (float**)malloc(output->tex_coord_sets * sizeof(float));
-    for (iter = 0; iter < output->tex_coord_sets; iter++) {
-        output->texCoordArrays[iter] = (float*)malloc(output->vertexCount * output->tex_coord_set_size * sizeof(float));
+    output->texCoordArrays = (float**)allocateFromReader(reader, output->tex_coord_sets * sizeof(float*), BLITZ3D_CHUNK_VRTS);
+    for (texCoordIter = 0; texCoordIter < output->tex_coord_sets; texCoordIter++) {
+        output->texCoordArrays[texCoordIter] = (float*)allocateFromReader(reader,
+            output->vertexCount * output->tex_coord_set_size * sizeof(float), BLITZ3D_CHUNK_VRTS);
     }
 
-    for (iter = 0; iter < output->vertexCount; iter++) {
-        Blitz3DVertex* vertex = (Blitz3DVertex*)popOffOfStack(vertexStack);
+    /* the vertices are one interleaved run, decoded in one go by a decoder picked for this chunk's layout */
 
-        output->vertexArray[3 * (output->vertexCount - iter - 1) + 0] = vertex->x;
-        output->vertexArray[3 * (output->vertexCount - iter - 1) + 1] = vertex->y;
-        output->vertexArray[3 * (output->vertexCount - iter - 1) + 2] = vertex->z;
+    stride = getVertexStrideFromVRTSChunk(output);
+    payload = readBytesFromReader(reader, (uint64_t)output->vertexCount * stride);
 
-        if (output->flags & BLITZ3D_VERTEX_FLAG_NORMAL) {
-            output->normalArray[3 * (output->vertexCount - iter - 1) + 0] = vertex->vertexNormal->nx;
-            output->normalArray[3 * (output->vertexCount - iter - 1) + 1] = vertex->vertexNormal->ny;
-            output->normalArray[3 * (output->vertexCount - iter - 1) + 2] = vertex->vertexNormal->nz;
-        }
-
-        if (output->flags & BLITZ3D_VERTEX_FLAG_COLOR) {
-            output->colorArray[4 * (output->vertexCount - iter - 1) + 0] = vertex->vertexColor->red;
-            output->colorArray[4 * (output->vertexCount - iter - 1) + 1] = vertex->vertexColor->green;
-            output->colorArray[4 * (output->vertexCount - iter - 1) + 2] = vertex->vertexColor->blue;
-            output->colorArray[4 * (output->vertexCount - iter - 1) + 3] = vertex->vertexColor->alpha;
-        }
+    if (payload != NULL) decodeVRTSPayload(output, payload, stride);
 
-        for (texCoordIter = 0; texCoordIter < output->tex_coord_sets; texCoordIter++) {
-            for (texComponentIter = 0; texComponentIter < output->tex_coord_set_size; texComponentIter++) {
-                output->texCoordArrays[texCoordIter][output->tex_coord_set_size * (output->vertexCount - iter - 1) + texComponentIter] =
-                    vertex->tex_coords[texCoordIter][texComponentIter];
-            }
-        }
-
-        free(vertex);
-    }
-
-    /*fseek(fp, size + startingPoint - ftell(fp), SEEK_CUR);*/
-
-    freeStack(vertexStack);
+    /* commentary: a partial trailing vertex is padding as far as we are concerned */
+    if (reader->position < end) skipBytesInReader(reader, end - reader->position);
 
     return output;
 }
 
-Blitz3DTRISChunk* readBlitz3DTRISChunk(FILE* fp) {
+Blitz3DTRISChunk* readBlitz3DTRISChunk(Blitz3DReader* reader) {
     Blitz3DTRISChunk* output;
-    Stack* triangleStack;
-    int size, startingPoint, iter;
+    const unsigned char* payload;
+    uint64_t end;
 
-    output = (Blitz3DTRISChunk*)calloc(1, sizeof(Blitz3DTRISChunk));
-    triangleStack = createStack();
+    output = (Blitz3DTRISChunk*)allocateZeroedFromReader(reader, sizeof(Blitz3DTRISChunk), BLITZ3D_CHUNK_TRIS);
 
-    read32BitIntegerFromBinaryFile(fp, &size, 1);
+    end = readChunkEndFromReader(reader);
 
-    /*printf("size = %d\n", size);*/
-    startingPoint = ftell(fp);
-
-    read32BitIntegerFromBinaryFile(fp, &(output->brush_id), 1);
+    read32BitIntegerFromReader(reader, &(output->brush_id));
     /*printf("brush_id = %d\n", output->brush_id);*/
 
-    while (ftell(fp) < startingPoint + size) {
-        Blitz3DTriangle* triangle = (Blitz3DTriangle*)malloc(sizeof(Blitz3DTriangle));
+    /* each triangle is three 32-bit vertex ids */
 
-        read32BitIntegerFromBinaryFile(fp, &(triangle->vertex_id[0]), 1);
-        read32BitIntegerFromBinaryFile(fp, &(triangle->vertex_id[1]), 1);
-        read32BitIntegerFromBinaryFile(fp, &(triangle->vertex_id[2]), 1);
+    if (reader->error || reader->position > end) output->triangleCount = 0;
+    else output->triangleCount = (end - reader->position) / (3 * 4);
 
-        pushOntoStack(triangleStack, (void*)triangle);
-    }
+    payload = readBytesFromReader(reader, (uint64_t)output->triangleCount * 3 * 4);
 
-    output->triangleCount = getStackCount(triangleStack);
+    /* commentary: a 16-bit array that turns out too narrow stays behind in the arena; that takes
+       indices beyond the vertex array, which a sound file does not have */
 
-    output->indexArray = (int*)malloc(output->triangleCount * 3 * sizeof(int));
+    if (payload != NULL && output->triangleCount > 0 && reader->shortIndices
+        && reader->meshVertexCount <= BLITZ3D_MAX_SHORT_INDEX_VERTICES) {
 
-    for (iter = 0; iter < output->triangleCount; iter++) {
-        Blitz3DTriangle* triangle = (Blitz3DTriangle*)popOffOfStack(triangleStack);
+        output->shortIndexArray = (uint16_t*)allocateFromReader(reader, output->triangleCount * 3 * sizeof(uint16_t), BLITZ3D_CHUNK_TRIS);
 
-        output->indexArray[3 * (output->triangleCount - iter - 1) + 0] = triangle->vertex_id[0];
-        output->indexArray[3 * (output->triangleCount - iter - 1) + 1] = triangle->vertex_id[1];
-        output->indexArray[3 * (output->triangleCount - iter - 1) + 2] = triangle->vertex_id[2];
+        if (narrowLittleEndian32To16(output->shortIndexArray, payload, 3 * output->triangleCount) == 0) {
+            if (reader->position < end) skipBytesInReader(reader, end - reader->position);
 
-        free(triangle);
+            return output;
+        }
+
+        output->shortIndexArray = NULL;
     }
 
-    /*fseek(fp, size + startingPoint - ftell(fp), SEEK_CUR);*/
+    output->indexArray = (int*)allocateFromReader(reader, output->triangleCount * 3 * sizeof(int), BLITZ3D_CHUNK_TRIS);
+
+    if (payload != NULL) decodeLittleEndian32(output->indexArray, payload, 3 * output->triangleCount);
+    else memset(output->indexArray, 0, output->triangleCount * 3 * sizeof(int));
 
-    freeStack(triangleStack);
+    if (reader->position < end) skipBytesInReader(reader, end - reader->position);
 
     return output;
 }
 
-Blitz3DMESHChunk* readBlitz3DMESHChunk(FILE* fp) {
-    Blitz3DMESHChunk* output;
-    Stack* trisStack;
-    int size, startingPoint, iter, id;
+unsigned int getIndexFromTRISChunk(Blitz3DTRISChunk* trisChunk, unsigned int index) {
+    if (trisChunk->shortIndexArray != NULL) return trisChunk->shortIndexArray[index];
+
+    return (unsigned int)trisChunk->indexArray[index];
+}
 
-    output = (Blitz3DMESHChunk*)malloc(sizeof(Blitz3DMESHChunk));
-    trisStack = createStack();
+void readBlitz3DMESHChunkInto(Blitz3DReader* reader, Blitz3DMESHChunk* output) {
+    DynamicArray trisChunks;
+    uint64_t end;
+    uint32_t id;
 
-    read32BitIntegerFromBinaryFile(fp, &size, 1);
+    output->fileOffset = reader->position - 4;
+    initializeChildArrayFromReader(reader, &trisChunks);
 
-    /*printf("size = %d\n", size);*/
-    startingPoint = ftell(fp);
+    end = readChunkEndFromReader(reader);
 
-    read32BitIntegerFromBinaryFile(fp, &(output->brush_id), 1);
+    read32BitIntegerFromReader(reader, &(output->brush_id));
     /*printf("brush_id = %d\n", output->brush_id);*/
 
-    read32BitIntegerFromBinaryFile(fp, &id, 1);
+    read32BitIntegerFromReader(reader, &id);
+
+    reader->meshVertexCount = 0;
 
     if (id == BLITZ3D_TAG_VRTS_LITTLE_ENDIAN) {
         /*printf("VRTS chunk\n");*/
 
-        output->vrtsChunk = readBlitz3DVRTSChunk(fp);
+        output->vrtsChunk = readBlitz3DVRTSChunk(reader);
+        reader->meshVertexCount = output->vrtsChunk->vertexCount;
     }
 
-    while (ftell(fp) < startingPoint + size) {
-        read32BitIntegerFromBinaryFile(fp, &id, 1);
+    while (reader->position < end && !reader->error) {
+        read32BitIntegerFromReader(reader, &id);
 
         if (id == BLITZ3D_TAG_TRIS_LITTLE_ENDIAN) {
             Blitz3DTRISChunk* tris;
 
             /*printf("TRIS chunk\n");*/
 
-            tris = readBlitz3DTRISChunk(fp);
-            pushOntoStack(trisStack, (void*)tris);
+            tris = readBlitz3DTRISChunk(reader);
+            pushOntoChildArrayFromReader(reader, &trisChunks, (void*)tris);
+        }
+        else {
+            skipBlitz3DChunk(reader);
         }
     }
 
-    output->trisChunkCount = getStackCount(trisStack);
-    output->trisChunkArray = (Blitz3DTRISChunk**)malloc(output->trisChunkCount * sizeof(Blitz3DTRISChunk*));
+    output->trisChunkCount = (unsigned int)getDynamicArrayCount(&trisChunks);
+    output->trisChunkArray = (Blitz3DTRISChunk**)finishChildArrayFromReader(reader, &trisChunks, BLITZ3D_CHUNK_MESH);
 
-    for (iter = 0; iter < output->trisChunkCount; iter++) {
-        output->trisChunkArray[output->trisChunkCount - iter - 1] = (Blitz3DTRISChunk*)popOffOfStack(trisStack);
-    }
+    /* the vertices are still in cache from decoding, so this is the cheapest moment for the bounds */
+    if (!reader->error) computeBoundsOfMESHChunk(output);
+}
 
-    /*fseek(fp, size + startingPoint - ftell(fp), SEEK_CUR);*/
+Blitz3DMESHChunk* readBlitz3DMESHChunk(Blitz3DReader* reader) {
+    Blitz3DMESHChunk* output;
 
-    freeStack(trisStack);
+    output = (Blitz3DMESHChunk*)allocateZeroedFromReader(reader, sizeof(Blitz3DMESHChunk), BLITZ3D_CHUNK_MESH);
+    readBlitz3DMESHChunkInto(reader, output);
 
     return output;
 }
 
-Blitz3DNODEChunk* readBlitz3DNODEChunk(FILE* fp) {
-    Blitz3DNODEChunk* output;
-    Stack* nodeStack;
-    int size, startingPoint, iter, id;
+/* parallel loading */
+
+/* commentary: the NODE pass doubles as the pre-scan; it builds the node tree in file order but only
+   records where each MESH chunk is, using the chunk sizes to jump over the vertex and index data.
+   The MESH chunks are then decoded on a thread pool, each straight into its node's meshChunk slot */
+
+typedef struct Blitz3DDeferredMesh Blitz3DDeferredMesh;
+struct Blitz3DDeferredMesh {
+    Blitz3DNODEChunk* node;
 
-    output = (Blitz3DNODEChunk*)calloc(1, sizeof(Blitz3DNODEChunk));
-    nodeStack = createStack();
+    size_t offset;
+    size_t size;
+};
 
-    read32BitIntegerFromBinaryFile(fp, &size, 1);
+typedef struct Blitz3DParallelLoad Blitz3DParallelLoad;
+struct Blitz3DParallelLoad {
+    Blitz3DDeferredMesh* meshes;
+    unsigned int* batchStarts;
 
-    /*printf("size = %d\n", size);*/
-    startingPoint = ftell(fp);
+    Blitz3DReader* workerReaders;
+};
 
-    output->name = readStringFromBinaryFile(fp);
+unsigned int parallelLoadThreadCount = 0;
 
-    read32BitIntegerFromBinaryFile(fp, (int*)&(output->position[0]), 1);
-    read32BitIntegerFromBinaryFile(fp, (int*)&(output->position[1]), 1);
-    read32BitIntegerFromBinaryFile(fp, (int*)&(output->position[2]), 1);
+void deferBlitz3DMESHChunk(Blitz3DReader* reader, Blitz3DNODEChunk* node) {
+    Blitz3DDeferredMesh* mesh = (Blitz3DDeferredMesh*)pushOntoDynamicArray(&(reader->deferredMeshes));
 
-    read32BitIntegerFromBinaryFile(fp, (int*)&(output->scale[0]), 1);
-    read32BitIntegerFromBinaryFile(fp, (int*)&(output->scale[1]), 1);
-    read32BitIntegerFromBinaryFile(fp, (int*)&(output->scale[2]), 1);
+    if (mesh == NULL) {
+        reader->error = 1;
+        return;
+    }
 
-    read32BitIntegerFromBinaryFile(fp, (int*)&(output->rotation[0]), 1);
-    read32BitIntegerFromBinaryFile(fp, (int*)&(output->rotation[1]), 1);
-    read32BitIntegerFromBinaryFile(fp, (int*)&(output->rotation[2]), 1);
-    read32BitIntegerFromBinaryFile(fp, (int*)&(output->rotation[3]), 1);
+    mesh->node = node;
+    mesh->offset = (size_t)reader->position;
 
-    while (ftell(fp) < startingPoint + size) {
-        read32BitIntegerFromBinaryFile(fp, &id, 1);
+    skipBlitz3DChunk(reader);
+
+    mesh->size = (size_t)reader->position - mesh->offset;
+}
+
+void readDeferredMeshBatch(void* context, unsigned int index, unsigned int workerIndex) {
+    Blitz3DParallelLoad* load = (Blitz3DParallelLoad*)context;
+    Blitz3DReader* reader = &(load->workerReaders[workerIndex]);
+    unsigned int iter;
+
+    for (iter = load->batchStarts[index]; iter < load->batchStarts[index + 1]; iter++) {
+        Blitz3DDeferredMesh* mesh = &(load->meshes[iter]);
+
+        reader->position = mesh->offset;
+        mesh->node->meshChunk = readBlitz3DMESHChunk(reader);
+    }
+}
+
+void readDeferredMeshes(Blitz3DReader* reader) {
+    Blitz3DParallelLoad load;
+    ThreadPool* threadPool;
+    unsigned int meshCount, batchCount, threadCount, iter;
+    size_t totalBytes, batchBytes, targetBytes;
+    int chunkType;
+
+    meshCount = (unsigned int)getDynamicArrayCount(&(reader->deferredMeshes));
+    load.meshes = (Blitz3DDeferredMesh*)getDataFromDynamicArray(&(reader->deferredMeshes));
+
+    totalBytes = 0;
+
+    for (iter = 0; iter < meshCount; iter++) totalBytes += load.meshes[iter].size;
+
+    threadPool = createThreadPool(parallelLoadThreadCount);
+    threadCount = getThreadCountFromThreadPool(threadPool);
+
+    /* group neighbouring meshes so tiny brush meshes do not cost one hand-off each */
+
+    targetBytes = totalBytes / (threadCount * BLITZ3D_PARALLEL_BATCHES_PER_THREAD);
+    if (targetBytes < BLITZ3D_PARALLEL_MIN_BATCH_BYTES) targetBytes = BLITZ3D_PARALLEL_MIN_BATCH_BYTES;
+
+    load.batchStarts = (unsigned int*)malloc((meshCount + 1) * sizeof(unsigned int));
+    load.workerReaders = (Blitz3DReader*)malloc(threadCount * sizeof(Blitz3DReader));
+
+    if (load.batchStarts == NULL || load.workerReaders == NULL) {
+        reader->error = 1;
+
+        freeThreadPool(threadPool);
+
+        free(load.workerReaders);
+        free(load.batchStarts);
+        return;
+    }
+
+    batchCount = 0;
+    batchBytes = targetBytes;
+
+    for (iter = 0; iter < meshCount; iter++) {
+        if (batchBytes >= targetBytes) {
+            load.batchStarts[batchCount++] = iter;
+            batchBytes = 0;
+        }
+
+        batchBytes += load.meshes[iter].size;
+    }
+
+    load.batchStarts[batchCount] = meshCount;
+
+    /* each worker decodes into an arena of its own, absorbed into the file's arena afterwards */
+
+    for (iter = 0; iter < threadCount; iter++) {
+        initializeMemoryReader(&(load.workerReaders[iter]), reader->data, reader->size);
+        load.workerReaders[iter].arena = createArena(BLITZ3D_ARENA_BLOCK_SIZE);
+        load.workerReaders[iter].shortIndices = reader->shortIndices;
+    }
+
+    runParallelForOnThreadPool(threadPool, batchCount, readDeferredMeshBatch, &load);
+
+    for (iter = 0; iter < threadCount; iter++) {
+        Blitz3DReader* workerReader = &(load.workerReaders[iter]);
+
+        if (workerReader->error) reader->error = 1;
+
+        for (chunkType = 0; chunkType < BLITZ3D_CHUNK_TYPE_COUNT; chunkType++) {
+            reader->chunkBytes[chunkType] += workerReader->chunkBytes[chunkType];
+        }
+
+        absorbArena(reader->arena, workerReader->arena);
+    }
+
+    freeThreadPool(threadPool);
+
+    free(load.workerReaders);
+    free(load.batchStarts);
+}
+
+/* index-only loading */
+
+void createLazyMeshes(Blitz3DReader* reader, B3DFile* file) {
+    unsigned int meshCount, iter;
+
+    meshCount = (unsigned int)getDynamicArrayCount(&(reader->deferredMeshes));
+
+    file->lazyMeshCount = meshCount;
+    file->lazyMeshArray = (Blitz3DMESHChunk**)allocateFromReader(reader, meshCount * sizeof(Blitz3DMESHChunk*), BLITZ3D_CHUNK_MESH);
+
+    for (iter = 0; iter < meshCount; iter++) {
+        Blitz3DDeferredMesh* deferredMesh = (Blitz3DDeferredMesh*)getDataFromDynamicArray(&(reader->deferredMeshes)) + iter;
+        Blitz3DMESHChunk* mesh;
+
+        mesh = (Blitz3DMESHChunk*)allocateZeroedFromReader(reader, sizeof(Blitz3DMESHChunk), BLITZ3D_CHUNK_MESH);
+        mesh->fileOffset = deferredMesh->offset - 4;
+
+        mesh->lazyMesh = (Blitz3DLazyMesh*)allocateZeroedFromReader(reader, sizeof(Blitz3DLazyMesh), BLITZ3D_CHUNK_MESH);
+        mesh->lazyMesh->file = file;
+
+        /* the brush id is the first field of the chunk, so it is cheap to have up front */
+        reader->position = deferredMesh->offset + 4;
+        read32BitIntegerFromReader(reader, &(mesh->brush_id));
+
+        deferredMesh->node->meshChunk = mesh;
+        file->lazyMeshArray[iter] = mesh;
+    }
+}
+
+void materializeMESHChunk(Blitz3DMESHChunk* meshChunk) {
+    Blitz3DLazyMesh* lazyMesh = meshChunk->lazyMesh;
+    Blitz3DReader reader;
+    int chunkType;
+
+    if (lazyMesh == NULL || lazyMesh->arena != NULL || lazyMesh->failed) return;
+
+    initializeMemoryReader(&reader, getDataFromMappedFile(lazyMesh->file->mappedFile),
+        getSizeFromMappedFile(lazyMesh->file->mappedFile));
+
+    reader.arena = createArena(BLITZ3D_ARENA_BLOCK_SIZE);
+    reader.position = meshChunk->fileOffset + 4;
+    reader.shortIndices = lazyMesh->file->shortIndices;
+
+    readBlitz3DMESHChunkInto(&reader, meshChunk);
+
+    /* commentary: the index pass only stepped over this chunk by its size, so this is the first time its
+       contents are checked; a mesh that fails is left without VRTS and TRIS chunks, which callers see
+       through meshDataPresentInMESHChunk */
+    if (reader.error) {
+        fprintf(stderr, "MESH chunk at offset %lu could not be decoded\n", (unsigned long)meshChunk->fileOffset);
+
+        freeArena(reader.arena);
+
+        meshChunk->vrtsChunk = NULL;
+        meshChunk->trisChunkArray = NULL;
+        meshChunk->trisChunkCount = 0;
+
+        lazyMesh->failed = 1;
+        return;
+    }
+
+    lazyMesh->arena = reader.arena;
+    lazyMesh->boundsKnown = 1;
+
+    for (chunkType = 0; chunkType < BLITZ3D_CHUNK_TYPE_COUNT; chunkType++) {
+        lazyMesh->chunkBytes[chunkType] = reader.chunkBytes[chunkType];
+        lazyMesh->file->chunkBytes[chunkType] += reader.chunkBytes[chunkType];
+    }
+}
+
+Blitz3DNODEChunk* readBlitz3DNODEChunk(Blitz3DReader* reader) {
+    Blitz3DNODEChunk* output;
+    DynamicArray nodeChunks;
+    uint64_t end;
+    uint32_t id;
+
+    output = (Blitz3DNODEChunk*)allocateZeroedFromReader(reader, sizeof(Blitz3DNODEChunk), BLITZ3D_CHUNK_NODE);
+    output->fileOffset = reader->position - 4;
+    initializeChildArrayFromReader(reader, &nodeChunks);
+
+    end = readChunkEndFromReader(reader);
+
+    output->name = readStringFromReader(reader, BLITZ3D_CHUNK_NODE);
+
+    readFloatFromReader(reader, &(output->position[0]));
+    readFloatFromReader(reader, &(output->position[1]));
+    readFloatFromReader(reader, &(output->position[2]));
+
+    readFloatFromReader(reader, &(output->scale[0]));
+    readFloatFromReader(reader, &(output->scale[1]));
+    readFloatFromReader(reader, &(output->scale[2]));
+
+    readFloatFromReader(reader, &(output->rotation[0]));
+    readFloatFromReader(reader, &(output->rotation[1]));
+    readFloatFromReader(reader, &(output->rotation[2]));
+    readFloatFromReader(reader, &(output->rotation[3]));
+
+    while (reader->position < end && !reader->error) {
+        read32BitIntegerFromReader(reader, &id);
 
         if (id == BLITZ3D_TAG_NODE_LITTLE_ENDIAN) {
             Blitz3DNODEChunk* node;
 
             /*printf("NODE chunk (child)\n");*/
 
-            node = readBlitz3DNODEChunk(fp);
-            pushOntoStack(nodeStack, (void*)node);
+            node = readBlitz3DNODEChunk(reader);
+            pushOntoChildArrayFromReader(reader, &nodeChunks, (void*)node);
         }
         else if (id == BLITZ3D_TAG_MESH_LITTLE_ENDIAN) {
             /*printf("MESH chunk\n");*/
 
-            output->meshChunk = readBlitz3DMESHChunk(fp);
+            if (reader->deferMeshes) deferBlitz3DMESHChunk(reader, output);
+            else output->meshChunk = readBlitz3DMESHChunk(reader);
         }
         else {
-            skipBlitz3DChunk(fp);
+            skipBlitz3DChunk(reader);
         }
     }
 
-    output->nodeChunkCount = getStackCount(nodeStack);
-    output->nodeChunkArray = (Blitz3DNODEChunk**)malloc(output->nodeChunkCount * sizeof(Blitz3DNODEChunk*));
-
-    for (iter = 0; iter < output->nodeChunkCount; iter++) {
-        output->nodeChunkArray[output->nodeChunkCount - iter - 1] = (Blitz3DNODEChunk*)popOffOfStack(nodeStack);
-    }
-
-    /*fseek(fp, size + startingPoint - ftell(fp), SEEK_CUR);*/
-
-    freeStack(nodeStack);
+    output->nodeChunkCount = (unsigned int)getDynamicArrayCount(&nodeChunks);
+    output->nodeChunkArray = (Blitz3DNODEChunk**)finishChildArrayFromReader(reader, &nodeChunks, BLITZ3D_CHUNK_NODE);
 
     return output;
 }
 
-Blitz3DBB3DChunk* readBlitz3DBB3DChunk(FILE* fp) {
+Blitz3DBB3DChunk* readBlitz3DBB3DChunk(Blitz3DReader* reader) {
     Blitz3DBB3DChunk* output;
-    int id, size, version;
+    uint32_t id;
+    int version;
 
-    read32BitIntegerFromBinaryFile(fp, &size, 1);
-    read32BitIntegerFromBinaryFile(fp, &version, 1);
+    readChunkEndFromReader(reader);
+    read32BitIntegerFromReader(reader, &version);
 
-    /*printf("size = %d\n", size);
-    printf("version = %d\n", version);*/
+    /*printf("version = %d\n", version);*/
 
-    output = (Blitz3DBB3DChunk*)calloc(1, sizeof(Blitz3DBB3DChunk));
+    output = (Blitz3DBB3DChunk*)allocateZeroedFromReader(reader, sizeof(Blitz3DBB3DChunk), BLITZ3D_CHUNK_BB3D);
     output->version = version;
 
     /* attempt to handle TEXS chunk */
 
-    read32BitIntegerFromBinaryFile(fp, &id, 1);
+    read32BitIntegerFromReader(reader, &id);
 
     if (id == BLITZ3D_TAG_TEXS_LITTLE_ENDIAN) {
         /*printf("TEXS chunk\n");*/
-        output->texsChunk = readBlitz3DTEXSChunk(fp);
+        output->texsChunk = readBlitz3DTEXSChunk(reader);
 
-        read32BitIntegerFromBinaryFile(fp, &id, 1);
+        read32BitIntegerFromReader(reader, &id);
     }
 
     /* attempt to handle BRUS chunk */
 
     if (id == BLITZ3D_TAG_BRUS_LITTLE_ENDIAN) {
         /*printf("BRUS chunk\n");*/
-        output->brusChunk = readBlitz3DBRUSChunk(fp);
+        output->brusChunk = readBlitz3DBRUSChunk(reader);
 
-        read32BitIntegerFromBinaryFile(fp, &id, 1);
+        read32BitIntegerFromReader(reader, &id);
     }
 
     /* attempt to handle NODE chunk */
 
     if (id == BLITZ3D_TAG_NODE_LITTLE_ENDIAN) {
         /*printf("NODE chunk\n");*/
-        output->nodeChunk = readBlitz3DNODEChunk(fp);
+        output->nodeChunk = readBlitz3DNODEChunk(reader);
     }
 
     return output;
 }
 
-/* public functions */
-
-B3DFile* loadB3DFile(const char* filePath) {
-    B3DFile* output;
+char* createDirectoryFromFilePath(Blitz3DReader* reader, const char* filePath) {
+    char* output;
     char* relativePath;
     char* lastSlash;
-    char id[4];
 
-    FILE* fp = fopen(filePath, "rb");
-    if (fp == NULL) return NULL;
+    relativePath = (char*)calloc(strlen(filePath) + 3, sizeof(char));
+    sprintf(relativePath, "./%s", filePath);
 
-    id[0] = fgetc(fp);
-    id[1] = fgetc(fp);
-    id[2] = fgetc(fp);
-    id[3] = fgetc(fp);
+    lastSlash = relativePath + strlen(relativePath) - 1;
+    for (; *lastSlash != '/' && *lastSlash != '\\'; lastSlash--) ;
+    *lastSlash = '\0';
 
-    if (id[0] != 'B' || id[1] != 'B' || id[2] != '3' || id[3] != 'D') {
+    output = (char*)allocateZeroedFromReader(reader, strlen(relativePath) + 2, BLITZ3D_CHUNK_BB3D);
+    sprintf(output, "%s/", relativePath);
+
+    free(relativePath);
+
+    return output;
+}
+
+B3DFile* readB3DFile(Blitz3DReader* reader, const char* filePath) {
+    B3DFile* output;
+    uint32_t id;
+
+    read32BitIntegerFromReader(reader, &id);
+
+    if (id != BLITZ3D_TAG_BB3D_LITTLE_ENDIAN) {
         fprintf(stderr, "provided file, %s, is not Blitz3D format\n", filePath);
         return NULL;
     }
 
-    output = (B3DFile*)malloc(sizeof(B3DFile));
-    output->bb3dChunk = readBlitz3DBB3DChunk(fp);
+    reader->arena = createArena(BLITZ3D_ARENA_BLOCK_SIZE);
+    initializeBulkDecode();
 
-    relativePath = (char*)calloc(strlen(filePath) + 3, sizeof(char));
-    sprintf(relativePath, "./%s", filePath);
+    output = (B3DFile*)allocateZeroedFromReader(reader, sizeof(B3DFile), BLITZ3D_CHUNK_BB3D);
+    output->shortIndices = reader->shortIndices;
+    output->bb3dChunk = readBlitz3DBB3DChunk(reader);
 
-    lastSlash = relativePath + strlen(relativePath) - 1;
-    for (; *lastSlash != '/'; lastSlash--) ;
-    *lastSlash = '\0';
+    if (reader->deferMeshes) {
+        if (!reader->error) {
+            if (reader->indexOnly) createLazyMeshes(reader, output);
+            else readDeferredMeshes(reader);
+        }
 
-    output->directory = (char*)calloc(strlen(relativePath) + 2, sizeof(char));
-    sprintf(output->directory, "%s/", relativePath);
+        freeDynamicArray(&(reader->deferredMeshes));
+    }
 
-    free(relativePath);
+    /* every mesh has its bounds by now, except those of an index-only file, which has not decoded any */
+    if (!reader->error && !reader->indexOnly && output->bb3dChunk->nodeChunk != NULL) {
+        propagateBoundsInNODEChunk(output->bb3dChunk->nodeChunk);
+    }
+
+    if (reader->error) {
+        fprintf(stderr, "provided file, %s, is truncated or corrupt\n", filePath);
+        freeArena(reader->arena);
+        return NULL;
+    }
+
+    output->directory = createDirectoryFromFilePath(reader, filePath);
+
+    output->arena = reader->arena;
+    memcpy(output->chunkBytes, reader->chunkBytes, sizeof(output->chunkBytes));
 /*
     printf("\n---final results---\n");
     printf("file version = %d\n", output->bb3dChunk->version);
@@ -722,11 +985,133 @@ B3DFile* loadB3DFile(const char* filePath) {
 
     printf("directory = %s\n", output->directory);
 */
-    fclose(fp);
+    return output;
+}
+
+/* public functions */
+
+B3DFile* loadB3DFile(const char* filePath) {
+    return loadB3DFileWithFlags(filePath, 0);
+}
+
+/* takes ownership of the mapping, which is either closed or kept by the returned file */
+
+B3DFile* loadB3DFileFromMapping(MappedFile* mappedFile, const char* filePath, int flags) {
+    B3DFile* output;
+    Blitz3DReader reader;
+
+    initializeMemoryReader(&reader, getDataFromMappedFile(mappedFile), getSizeFromMappedFile(mappedFile));
+    if (flags & (BLITZ3D_LOAD_PARALLEL | BLITZ3D_LOAD_INDEX_ONLY)) {
+        initializeDynamicArray(&(reader.deferredMeshes), sizeof(Blitz3DDeferredMesh), NULL);
+        reader.deferMeshes = 1;
+    }
+    if (flags & BLITZ3D_LOAD_INDEX_ONLY) reader.indexOnly = 1;
+    if (flags & BLITZ3D_LOAD_SHORT_INDICES) reader.shortIndices = 1;
+
+    output = readB3DFile(&reader, filePath);
+
+    /* an index-only file decodes its meshes from the mapping later on */
+    if (output != NULL && (flags & BLITZ3D_LOAD_INDEX_ONLY)) output->mappedFile = mappedFile;
+    else closeMappedFile(mappedFile);
 
     return output;
 }
 
+B3DFile* loadB3DFileWithFlags(const char* filePath, int flags) {
+    B3DFile* output;
+    Blitz3DReader reader;
+
+    /* commentary: the parallel and index-only loaders need random access, so they always work from a mapping */
+
+    if (flags & BLITZ3D_LOAD_CACHED) {
+        output = loadB3DFileThroughCache(filePath, flags);
+    }
+    else if (flags & (BLITZ3D_LOAD_MAPPED | BLITZ3D_LOAD_PARALLEL | BLITZ3D_LOAD_INDEX_ONLY)) {
+        MappedFile* mappedFile = openMappedFile(filePath);
+        if (mappedFile == NULL) return NULL;
+
+        output = loadB3DFileFromMapping(mappedFile, filePath, flags);
+    }
+    else {
+        int64_t size;
+
+        FILE* fp = fopen(filePath, "rb");
+        if (fp == NULL) return NULL;
+
+        seekBinaryFile(fp, 0, SEEK_END);
+        size = tellBinaryFile(fp);
+        seekBinaryFile(fp, 0, SEEK_SET);
+
+        initializeFileReader(&reader, fp, (size < 0) ? 0 : (uint64_t)size);
+        if (flags & BLITZ3D_LOAD_SHORT_INDICES) reader.shortIndices = 1;
+
+        output = readB3DFile(&reader, filePath);
+
+        free(reader.scratch);
+        fclose(fp);
+    }
+
+    return output;
+}
+
+void setThreadCountForParallelLoad(unsigned int threadCount) {
+    parallelLoadThreadCount = threadCount;
+}
+
+void freeB3DFile(B3DFile* blitz3dFile) {
+    unsigned int iter;
+
+    for (iter = 0; iter < blitz3dFile->lazyMeshCount; iter++) {
+        evictMESHChunk(blitz3dFile->lazyMeshArray[iter]);
+    }
+
+    if (blitz3dFile->mappedFile != NULL) closeMappedFile(blitz3dFile->mappedFile);
+
+    /* commentary: the B3DFile itself lives in its arena, so this is the last call needed */
+    freeArena(blitz3dFile->arena);
+}
+
+void evictMESHChunk(Blitz3DMESHChunk* meshChunk) {
+    Blitz3DLazyMesh* lazyMesh = meshChunk->lazyMesh;
+    int chunkType;
+
+    if (lazyMesh == NULL || lazyMesh->arena == NULL) return;
+
+    for (chunkType = 0; chunkType < BLITZ3D_CHUNK_TYPE_COUNT; chunkType++) {
+        lazyMesh->file->chunkBytes[chunkType] -= lazyMesh->chunkBytes[chunkType];
+        lazyMesh->chunkBytes[chunkType] = 0;
+    }
+
+    freeArena(lazyMesh->arena);
+    lazyMesh->arena = NULL;
+
+    meshChunk->vrtsChunk = NULL;
+    meshChunk->trisChunkArray = NULL;
+    meshChunk->trisChunkCount = 0;
+}
+
+int meshDataPresentInMESHChunk(Blitz3DMESHChunk* meshChunk) {
+    return ( meshChunk->lazyMesh == NULL || meshChunk->lazyMesh->arena != NULL );
+}
+
+size_t getBytesUsedByChunkTypeFromFile(B3DFile* blitz3dFile, int chunkType) {
+    if (chunkType < 0 || chunkType >= BLITZ3D_CHUNK_TYPE_COUNT) return 0;
+
+    return blitz3dFile->chunkBytes[chunkType];
+}
+
+size_t getBytesReservedFromFile(B3DFile* blitz3dFile) {
+    return getBytesReservedFromArena(blitz3dFile->arena);
+}
+
+unsigned int getBlockCountFromFile(B3DFile* blitz3dFile) {
+    return getBlockCountFromArena(blitz3dFile->arena);
+}
+
+int fileLoadedFromCache(B3DFile* blitz3dFile) {
+    return blitz3dFile->loadedFromCache;
+}
+
 Blitz3DBB3DChunk* getBB3DChunkFromFile(B3DFile* blitz3dFile) {
     return blitz3dFile->bb3dChunk;
 }
@@ -751,6 +1136,10 @@ char* getFileFromTexture(Blitz3DTexture* texture) {
     return texture->file;
 }
 
+uint64_t getFileOffsetFromTEXSChunk(Blitz3DTEXSChunk* texsChunk) {
+    return texsChunk->fileOffset;
+}
+
 Blitz3DBRUSChunk* getBRUSChunkFromBB3DChunk(Blitz3DBB3DChunk* bb3dChunk) {
     return bb3dChunk->brusChunk;
 }
@@ -771,6 +1160,18 @@ int getTextureIdArrayEntryFromBrush(Blitz3DBrush* brush, unsigned int index) {
     return brush->texture_id[index];
 }
 
+unsigned int getTextureLayerFromTexCoordSet(unsigned int set) {
+    return (set < 2) ? 1 - set : set;
+}
+
+int getFxFromBrush(Blitz3DBrush* brush) {
+    return brush->fx;
+}
+
+uint64_t getFileOffsetFromBRUSChunk(Blitz3DBRUSChunk* brusChunk) {
+    return brusChunk->fileOffset;
+}
+
 Blitz3DNODEChunk* getNODEChunkFromBB3DChunk(Blitz3DBB3DChunk* bb3dChunk) {
     return bb3dChunk->nodeChunk;
 }
@@ -787,15 +1188,33 @@ Blitz3DNODEChunk* getNODEChunkArrayEntryFromNODEChunk(Blitz3DNODEChunk* nodeChun
     return nodeChunk->nodeChunkArray[index];
 }
 
+char* getNameFromNODEChunk(Blitz3DNODEChunk* nodeChunk) {
+    return nodeChunk->name;
+}
+
+uint64_t getFileOffsetFromNODEChunk(Blitz3DNODEChunk* nodeChunk) {
+    return nodeChunk->fileOffset;
+}
+
+uint64_t getFileOffsetFromMESHChunk(Blitz3DMESHChunk* meshChunk) {
+    return meshChunk->fileOffset;
+}
+
 Blitz3DVRTSChunk* getVRTSChunkFromMESHChunk(Blitz3DMESHChunk* meshChunk) {
+    if (meshChunk->lazyMesh != NULL) materializeMESHChunk(meshChunk);
+
     return meshChunk->vrtsChunk;
 }
 
 unsigned int getTRISChunkArrayCountFromMESHChunk(Blitz3DMESHChunk* meshChunk) {
+    if (meshChunk->lazyMesh != NULL) materializeMESHChunk(meshChunk);
+
     return meshChunk->trisChunkCount;
 }
 
 Blitz3DTRISChunk* getTRISChunkArrayEntryFromMESHChunk(Blitz3DMESHChunk* meshChunk, unsigned int index) {
+    if (meshChunk->lazyMesh != NULL) materializeMESHChunk(meshChunk);
+
     return meshChunk->trisChunkArray[index];
 }
 
@@ -803,6 +1222,10 @@ int getBrushIdFromMESHChunk(Blitz3DMESHChunk* meshChunk) {
     return meshChunk->brush_id;
 }
 
+unsigned int getVertexCountFromVRTSChunk(Blitz3DVRTSChunk* vrtsChunk) {
+    return vrtsChunk->vertexCount;
+}
+
 float* getVertexArrayFromVRTSChunk(Blitz3DVRTSChunk* vrtsChunk) {
     return vrtsChunk->vertexArray;
 }
@@ -839,10 +1262,18 @@ unsigned getTriangleCountFromTRISChunk(Blitz3DTRISChunk* trisChunk) {
     return trisChunk->triangleCount;
 }
 
+unsigned int getIndexSizeFromTRISChunk(Blitz3DTRISChunk* trisChunk) {
+    return (trisChunk->shortIndexArray != NULL) ? 2 : 4;
+}
+
 int* getTriangleIndexArrayFromTRISChunk(Blitz3DTRISChunk* trisChunk) {
     return trisChunk->indexArray;
 }
 
+uint16_t* getShortTriangleIndexArrayFromTRISChunk(Blitz3DTRISChunk* trisChunk) {
+    return trisChunk->shortIndexArray;
+}
+
 int getBrushIdFromTRISChunk(Blitz3DTRISChunk* trisChunk) {
     return trisChunk->brush_id;
 }
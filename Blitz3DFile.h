@@ -2,6 +2,8 @@
 #define _BLITZ3DFILE_H_
 
 #include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /* Blitz3D structures */
 
@@ -41,16 +43,69 @@ struct Blitz3DMESHChunk;
 typedef struct Blitz3DNODEChunk Blitz3DNODEChunk;
 struct Blitz3DNODEChunk;
 
+typedef struct Blitz3DBounds Blitz3DBounds;
+struct Blitz3DBounds;
+
 typedef struct Blitz3DBB3DChunk Blitz3DBB3DChunk;
 struct Blitz3DBB3DChunk;
 
 typedef struct B3DFile B3DFile;
 struct B3DFile;
 
+/* load flags */
+
+/* commentary: BLITZ3D_LOAD_MAPPED decodes straight from a memory mapping of the file instead of a FILE*,
+   BLITZ3D_LOAD_PARALLEL (which implies a mapping) decodes the MESH chunks on a thread pool, and
+   BLITZ3D_LOAD_INDEX_ONLY (which also implies a mapping) leaves each MESH chunk undecoded until its
+   VRTS or TRIS chunks are first asked for; evictMESHChunk drops them again.
+   BLITZ3D_LOAD_CACHED uses (and if missing or stale, writes) a decoded copy of the level next to it,
+   named after the level with a trailing 'c' (level.b3d -> level.b3dc); it takes precedence over
+   BLITZ3D_LOAD_INDEX_ONLY.
+   BLITZ3D_LOAD_SHORT_INDICES stores the TRIS indices of every mesh with at most 65536 vertices in
+   16 bits, halving their memory; see getIndexSizeFromTRISChunk. A chunk keeps 32-bit indices if any
+   of its indices does not fit. Cached loads ignore it, as their arrays point into the cache file */
+
+#define BLITZ3D_LOAD_MAPPED 1
+#define BLITZ3D_LOAD_PARALLEL 2
+#define BLITZ3D_LOAD_INDEX_ONLY 4
+#define BLITZ3D_LOAD_CACHED 8
+#define BLITZ3D_LOAD_SHORT_INDICES 16
+
+/* chunk types, used when asking how much memory each kind of chunk takes */
+
+#define BLITZ3D_CHUNK_BB3D 0
+#define BLITZ3D_CHUNK_TEXS 1
+#define BLITZ3D_CHUNK_BRUS 2
+#define BLITZ3D_CHUNK_NODE 3
+#define BLITZ3D_CHUNK_MESH 4
+#define BLITZ3D_CHUNK_VRTS 5
+#define BLITZ3D_CHUNK_TRIS 6
+
+#define BLITZ3D_CHUNK_TYPE_COUNT 7
+
 /* public functions */
 
 B3DFile* loadB3DFile(const char* filePath);
 
+B3DFile* loadB3DFileWithFlags(const char* filePath, int flags);
+
+/* 0 (the default) uses one thread per processor */
+void setThreadCountForParallelLoad(unsigned int threadCount);
+
+/* on by default; when off, every VRTS chunk goes through the generic decoder, for comparison */
+void setSpecializedVertexDecodersEnabled(int enabled);
+
+void freeB3DFile(B3DFile* blitz3dFile);
+
+size_t getBytesUsedByChunkTypeFromFile(B3DFile* blitz3dFile, int chunkType);
+
+size_t getBytesReservedFromFile(B3DFile* blitz3dFile);
+
+/* the number of heap blocks the loaded file lives in, not counting meshes decoded later on demand */
+unsigned int getBlockCountFromFile(B3DFile* blitz3dFile);
+
+int fileLoadedFromCache(B3DFile* blitz3dFile);
+
 Blitz3DBB3DChunk* getBB3DChunkFromFile(B3DFile* blitz3dFile);
 
 char* getDirectoryFromFile(B3DFile* blitz3dFile);
@@ -63,6 +118,8 @@ Blitz3DTexture* getTextureArrayEntryFromTEXSChunk(Blitz3DTEXSChunk* texsChunk, u
 
 char* getFileFromTexture(Blitz3DTexture* texture);
 
+uint64_t getFileOffsetFromTEXSChunk(Blitz3DTEXSChunk* texsChunk);
+
 Blitz3DBRUSChunk* getBRUSChunkFromBB3DChunk(Blitz3DBB3DChunk* bb3dChunk);
 
 int getNumberOfTexturesFromBRUSChunk(Blitz3DBRUSChunk* brusChunk);
@@ -73,6 +130,16 @@ Blitz3DBrush* getBrushArrayEntryFromBRUSChunk(Blitz3DBRUSChunk* brusChunk, unsig
 
 int getTextureIdArrayEntryFromBrush(Blitz3DBrush* brush, unsigned int index);
 
+/* the brush texture layer drawn with a tex coord set: the levels this loads are lit by a lightmap in
+   their second texture that uses the first tex coord set, so sets 0 and 1 feed layers 1 and 0, and any
+   later set feeds its own layer. The mapping is its own inverse */
+unsigned int getTextureLayerFromTexCoordSet(unsigned int set);
+
+/* Blitz3D brush effects: 1 full-bright, 2 use vertex colors, 4 flat shaded, 8 no fog, 16 two-sided */
+int getFxFromBrush(Blitz3DBrush* brush);
+
+uint64_t getFileOffsetFromBRUSChunk(Blitz3DBRUSChunk* brusChunk);
+
 Blitz3DNODEChunk* getNODEChunkFromBB3DChunk(Blitz3DBB3DChunk* bb3dChunk);
 
 Blitz3DMESHChunk* getMESHChunkFromNODEChunk(Blitz3DNODEChunk* nodeChunk);
@@ -81,6 +148,19 @@ unsigned int getNODEChunkArrayCountFromNodeChunk(Blitz3DNODEChunk* nodeChunk);
 
 Blitz3DNODEChunk* getNODEChunkArrayEntryFromNODEChunk(Blitz3DNODEChunk* nodeChunk, unsigned int index);
 
+char* getNameFromNODEChunk(Blitz3DNODEChunk* nodeChunk);
+
+uint64_t getFileOffsetFromNODEChunk(Blitz3DNODEChunk* nodeChunk);
+
+uint64_t getFileOffsetFromMESHChunk(Blitz3DMESHChunk* meshChunk);
+
+/* for index-only files, asking for the VRTS or TRIS chunks of a mesh decodes it; this is not thread-safe.
+   A mesh that cannot be decoded has no VRTS or TRIS chunks and its data is never present */
+
+int meshDataPresentInMESHChunk(Blitz3DMESHChunk* meshChunk);
+
+void evictMESHChunk(Blitz3DMESHChunk* meshChunk);
+
 Blitz3DVRTSChunk* getVRTSChunkFromMESHChunk(Blitz3DMESHChunk* meshChunk);
 
 unsigned int getTRISChunkArrayCountFromMESHChunk(Blitz3DMESHChunk* meshChunk);
@@ -89,6 +169,8 @@ Blitz3DTRISChunk* getTRISChunkArrayEntryFromMESHChunk(Blitz3DMESHChunk* meshChun
 
 int getBrushIdFromMESHChunk(Blitz3DMESHChunk* meshChunk);
 
+unsigned int getVertexCountFromVRTSChunk(Blitz3DVRTSChunk* vrtsChunk);
+
 float* getVertexArrayFromVRTSChunk(Blitz3DVRTSChunk* vrtsChunk);
 
 float* getNormalArrayFromVRTSChunk(Blitz3DVRTSChunk* vrtsChunk);
@@ -107,8 +189,47 @@ int colorArrayPresentInVRTSChunk(Blitz3DVRTSChunk* vrtsChunk);
 
 unsigned getTriangleCountFromTRISChunk(Blitz3DTRISChunk* trisChunk);
 
+/* returns 2 or 4; a chunk has exactly one of the two index arrays below, the other returns NULL */
+unsigned int getIndexSizeFromTRISChunk(Blitz3DTRISChunk* trisChunk);
+
 int* getTriangleIndexArrayFromTRISChunk(Blitz3DTRISChunk* trisChunk);
 
+uint16_t* getShortTriangleIndexArrayFromTRISChunk(Blitz3DTRISChunk* trisChunk);
+
 int getBrushIdFromTRISChunk(Blitz3DTRISChunk* trisChunk);
 
+/* commentary: bounds are an axis-aligned box and a sphere, computed over the vertices the triangles
+   actually reference (indices past the vertex array are left out) as each mesh is decoded, so they
+   come with every load; cache files store them. A node's bounds cover its mesh and its whole subtree
+   in the node's own space (children through their local transforms), so the node's world matrix
+   takes them to world space and a subtree can be rejected in one test.
+
+   Index-only files are the exception: a mesh's bounds are known once it has been decoded (they are
+   kept when it is evicted), and node bounds are empty until updateBoundsInB3DFile. The stream reader
+   does not compute bounds */
+
+/* recomputes the bounds of every mesh whose data is present and the bounds of every node; meshes of
+   an index-only file that were never decoded are decoded for this and evicted again. Call it after
+   changing vertex data or node transforms */
+void updateBoundsInB3DFile(B3DFile* blitz3dFile);
+
+/* for a never-decoded index-only mesh this decodes it (and evicts it again) */
+Blitz3DBounds* getBoundsFromMESHChunk(Blitz3DMESHChunk* meshChunk);
+
+Blitz3DBounds* getBoundsFromTRISChunk(Blitz3DTRISChunk* trisChunk);
+
+Blitz3DBounds* getBoundsFromNODEChunk(Blitz3DNODEChunk* nodeChunk);
+
+/* empty bounds, around no vertices at all, have no meaningful box or sphere */
+int boundsEmpty(Blitz3DBounds* bounds);
+
+/* 3 floats each */
+float* getMinimumFromBounds(Blitz3DBounds* bounds);
+
+float* getMaximumFromBounds(Blitz3DBounds* bounds);
+
+float* getCenterFromBounds(Blitz3DBounds* bounds);
+
+float getRadiusFromBounds(Blitz3DBounds* bounds);
+
 #endif
@@ -0,0 +1,330 @@
+#ifndef _BLITZ3DFILEINTERNAL_H_
+#define _BLITZ3DFILEINTERNAL_H_
+
+/* commentary: structure layouts shared by the Blitz3D modules; nothing outside them should include this */
+
+#include "Blitz3DFile.h"
+
+#include <stdint.h>
+
+#include "DynamicArray.h"
+#include "MappedFile.h"
+#include "Arena.h"
+
+/* Blitz3D defines */
+
+#define BLITZ3D_TAG_BB3D_LITTLE_ENDIAN 0x44334242
+#define BLITZ3D_TAG_TEXS_LITTLE_ENDIAN 0x53584554
+#define BLITZ3D_TAG_BRUS_LITTLE_ENDIAN 0x53555242
+#define BLITZ3D_TAG_NODE_LITTLE_ENDIAN 0x45444F4E
+#define BLITZ3D_TAG_MESH_LITTLE_ENDIAN 0x4853454D
+#define BLITZ3D_TAG_VRTS_LITTLE_ENDIAN 0x53545256
+#define BLITZ3D_TAG_TRIS_LITTLE_ENDIAN 0x53495254
+
+#define BLITZ3D_VERTEX_FLAG_NORMAL 1
+#define BLITZ3D_VERTEX_FLAG_COLOR 2
+
+#define BLITZ3D_ARENA_BLOCK_SIZE (256 * 1024)
+
+/* meshes with at most this many vertices may have 16-bit indices */
+#define BLITZ3D_MAX_SHORT_INDEX_VERTICES 65536
+
+/* Blitz3D structures */
+
+struct Blitz3DTexture {
+    char* file;
+
+    int flags, blend;
+    float x_pos, y_pos;
+    float x_scale, y_scale;
+    float rotation;
+};
+
+struct Blitz3DTEXSChunk {
+    Blitz3DTexture** textureArray;
+
+    unsigned int textureCount;
+
+    uint64_t fileOffset;
+};
+
+struct Blitz3DBrush {
+    char* name;
+    int* texture_id;
+
+    float red, green, blue, alpha;
+    float shininess;
+    int blend, fx;
+};
+
+struct Blitz3DBRUSChunk {
+    Blitz3DBrush** brushArray;
+
+    unsigned int brushCount;
+
+    int n_texs;
+
+    uint64_t fileOffset;
+};
+
+struct Blitz3DVertexNormal {
+    float nx, ny, nz;
+};
+
+struct Blitz3DVertexColor {
+    float red, green, blue, alpha;
+};
+
+struct Blitz3DVertex {
+    Blitz3DVertexNormal* vertexNormal;
+    Blitz3DVertexColor* vertexColor;
+    float** tex_coords;
+
+    float x, y, z;
+};
+
+struct Blitz3DVRTSChunk {
+    float* vertexArray;
+    float* normalArray;
+    float* colorArray;
+    float** texCoordArrays;
+
+    unsigned int vertexCount;
+
+    int flags;
+    int tex_coord_sets;
+    int tex_coord_set_size;
+};
+
+/* commentary: an axis-aligned box and a sphere around the same points, the sphere centered on the box;
+   zeroed bounds are empty, so chunks allocated zeroed start out without bounds */
+
+struct Blitz3DBounds {
+    float minimum[3];
+    float maximum[3];
+
+    float center[3];
+    float radius;
+
+    int present;
+};
+
+struct Blitz3DTriangle {
+    int vertex_id[3];
+};
+
+struct Blitz3DTRISChunk {
+    /* exactly one of these is set */
+    int* indexArray;
+    uint16_t* shortIndexArray;
+
+    unsigned int triangleCount;
+
+    int brush_id;
+
+    Blitz3DBounds bounds;
+};
+
+typedef struct Blitz3DLazyMesh Blitz3DLazyMesh;
+
+struct Blitz3DMESHChunk {
+    Blitz3DVRTSChunk* vrtsChunk;
+    Blitz3DTRISChunk** trisChunkArray;
+
+    unsigned int trisChunkCount;
+
+    int brush_id;
+
+    uint64_t fileOffset;
+
+    /* kept when an index-only mesh is evicted */
+    Blitz3DBounds bounds;
+
+    /* only set for meshes of a file loaded with BLITZ3D_LOAD_INDEX_ONLY */
+    Blitz3DLazyMesh* lazyMesh;
+};
+
+struct Blitz3DNODEChunk {
+    Blitz3DMESHChunk* meshChunk;
+    Blitz3DNODEChunk** nodeChunkArray;
+    char* name;
+
+    unsigned int nodeChunkCount;
+
+    uint64_t fileOffset;
+
+    float position[3];
+    float scale[3];
+    float rotation[4];
+
+    /* the mesh and every descendant, in this node's own space */
+    Blitz3DBounds bounds;
+};
+
+struct Blitz3DBB3DChunk {
+    Blitz3DTEXSChunk* texsChunk;
+    Blitz3DBRUSChunk* brusChunk;
+    Blitz3DNODEChunk* nodeChunk;
+
+    int version;
+};
+
+/* commentary: this name might be changed to Blitz3DFile? */
+
+struct B3DFile {
+    Blitz3DBB3DChunk* bb3dChunk;
+    char* directory;
+
+    /* every allocation belonging to this file lives in the arena */
+    Arena* arena;
+    size_t chunkBytes[BLITZ3D_CHUNK_TYPE_COUNT];
+
+    /* index-only files keep their mapping open and decode meshes from it on demand */
+    MappedFile* mappedFile;
+    Blitz3DMESHChunk** lazyMeshArray;
+    unsigned int lazyMeshCount;
+
+    /* set when the arrays point into a mapped cache file rather than the arena */
+    int loadedFromCache;
+
+    /* set for BLITZ3D_LOAD_SHORT_INDICES, so lazy meshes are decoded the same way */
+    int shortIndices;
+};
+
+/* commentary: a lazy mesh's VRTS and TRIS chunks live in an arena of their own, so they can be evicted */
+
+struct Blitz3DLazyMesh {
+    B3DFile* file;
+
+    Arena* arena;
+    size_t chunkBytes[BLITZ3D_CHUNK_TYPE_COUNT];
+
+    /* set once the mesh has been decoded, and with it its bounds computed */
+    int boundsKnown;
+
+    /* set when the chunk could not be decoded, so it is not tried again */
+    int failed;
+};
+
+/* Blitz3D reader */
+
+/* commentary: a reader walks either a FILE* (fgetc for the small fields, one fread into a scratch
+   buffer for each vertex and index payload) or a block of memory such as a mapped file; the position
+   is tracked here so the chunk readers never call ftell, and every read is checked against the size
+   so a truncated file sets error instead of running off the end */
+
+typedef struct Blitz3DReader Blitz3DReader;
+struct Blitz3DReader {
+    FILE* fp;
+    const unsigned char* data;
+
+    uint64_t position;
+    uint64_t size;
+
+    int error;
+
+    Arena* arena;
+    size_t chunkBytes[BLITZ3D_CHUNK_TYPE_COUNT];
+
+    /* when deferMeshes is set, MESH chunks are only recorded in deferredMeshes and decoded later,
+       either by the parallel loader or (with indexOnly) on first use */
+    DynamicArray deferredMeshes;
+    int deferMeshes;
+    int indexOnly;
+
+    /* with shortIndices set, TRIS chunks are narrowed to 16 bits when the vertex count of the
+       MESH chunk being read allows it */
+    int shortIndices;
+    unsigned int meshVertexCount;
+
+    /* a FILE* reader reads bulk payloads in here before decoding them */
+    unsigned char* scratch;
+    size_t scratchSize;
+};
+
+/* shared reader functions */
+
+int seekBinaryFile(FILE* fp, int64_t offset, int origin);
+
+void initializeMemoryReader(Blitz3DReader* reader, const unsigned char* data, size_t size);
+
+void* allocateFromReader(Blitz3DReader* reader, size_t size, int chunkType);
+
+void* allocateZeroedFromReader(Blitz3DReader* reader, size_t size, int chunkType);
+
+Blitz3DTEXSChunk* readBlitz3DTEXSChunk(Blitz3DReader* reader);
+
+Blitz3DBRUSChunk* readBlitz3DBRUSChunk(Blitz3DReader* reader);
+
+unsigned int getVertexStrideFromVRTSChunk(Blitz3DVRTSChunk* vrtsChunk);
+
+Blitz3DVRTSChunk* readBlitz3DVRTSChunk(Blitz3DReader* reader);
+
+Blitz3DTRISChunk* readBlitz3DTRISChunk(Blitz3DReader* reader);
+
+/* one index, whichever width the chunk stores; negative 32-bit indices come back huge */
+unsigned int getIndexFromTRISChunk(Blitz3DTRISChunk* trisChunk, unsigned int index);
+
+char* createDirectoryFromFilePath(Blitz3DReader* reader, const char* filePath);
+
+B3DFile* loadB3DFileFromMapping(MappedFile* mappedFile, const char* filePath, int flags);
+
+/* Blitz3DVertexDecoders.c */
+
+void decodeVRTSPayload(Blitz3DVRTSChunk* vrtsChunk, const unsigned char* payload, unsigned int stride);
+
+/* Blitz3DBounds.c */
+
+/* bounds of the MESH chunk and each of its TRIS chunks, over the vertices the triangles reference */
+void computeBoundsOfMESHChunk(Blitz3DMESHChunk* meshChunk);
+
+/* bounds of the node and its subtree, from the MESH chunk bounds already there */
+void propagateBoundsInNODEChunk(Blitz3DNODEChunk* nodeChunk);
+
+/* the bounds through a column-major matrix: the box by Arvo's method, the sphere by the largest scale */
+void transformBounds(const Blitz3DBounds* bounds, const float* matrix, Blitz3DBounds* output);
+
+/* Blitz3DScene.c */
+
+void composeLocalMatrixScalar(const float* position, const float* scale, const float* rotation, float* matrix);
+
+/* Blitz3DCache.c */
+
+B3DFile* loadB3DFileThroughCache(const char* filePath, int flags);
+
+uint64_t hashBlitz3DSource(const unsigned char* data, size_t size);
+
+/* Blitz3DBVH.c */
+
+/* a node of a tree over boxes, laid out depth first: a node's first child comes right after it and its
+   second child where the first one's subtree ends */
+typedef struct Blitz3DTreeNode Blitz3DTreeNode;
+struct Blitz3DTreeNode {
+    float minimum[3];
+    float maximum[3];
+
+    /* one past the node's last descendant */
+    unsigned int end;
+
+    /* the items under the node, leaf or not, as positions in the order the tree was built into */
+    unsigned int firstItem, itemCount;
+
+    /* the axis the node's children were split along, -1 for leaves */
+    int axis;
+};
+
+/* builds a tree over count items, splitting each node at the median of its items' centers along the
+   axis they spread furthest on, until a node holds at most leafSize items. boxes has 6 floats per item
+   (minimum, then maximum) and centers 3; order gets the items in node order, and nodes needs room for
+   2 * count - 1 nodes. Returns the node count */
+unsigned int buildMedianSplitTree(Blitz3DTreeNode* nodes, const float* boxes, const float* centers, unsigned int* order,
+    unsigned int count, unsigned int leafSize);
+
+/* moves the items of order so the one with the median center along the axis is at median, with the
+   items below it before it and the items above it after it */
+void selectItemsByCenter(unsigned int* order, const float* centers, unsigned int axis, unsigned int count,
+    unsigned int median);
+
+unsigned int countBitsInWord(uint64_t word);
+
+#endif
@@ -0,0 +1,363 @@
+#include "Blitz3DGenerator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "Blitz3DFileInternal.h"
+
+#define BLITZ3D_GENERATOR_TEXTURE_COUNT 2
+#define BLITZ3D_GENERATOR_BRUSH_COUNT 4
+
+/* vertices are laid out in rows of this many, two triangles per grid cell */
+#define BLITZ3D_GENERATOR_GRID_WIDTH 32
+
+typedef struct Blitz3DGenerator Blitz3DGenerator;
+struct Blitz3DGenerator {
+    const Blitz3DGeneratorSettings* settings;
+
+    unsigned char* data;
+    size_t size, capacity;
+
+    /* nodes on each level of the tree, the root being level 0 */
+    unsigned int* levelCounts;
+    unsigned int levelCount;
+
+    uint32_t random;
+    int failed;
+};
+
+/* output buffer */
+
+/* commentary: the file is built in memory so each chunk's size can be patched in once its contents
+   are written; it is written out in one go at the end */
+
+unsigned char* reserveInGenerator(Blitz3DGenerator* generator, size_t size) {
+    unsigned char* output;
+
+    if (generator->failed) return NULL;
+
+    if (generator->size + size > generator->capacity) {
+        size_t capacity = generator->capacity * 2;
+        unsigned char* data;
+
+        while (capacity < generator->size + size) capacity *= 2;
+
+        data = (unsigned char*)realloc(generator->data, capacity);
+        if (data == NULL) {
+            generator->failed = 1;
+            return NULL;
+        }
+
+        generator->data = data;
+        generator->capacity = capacity;
+    }
+
+    output = generator->data + generator->size;
+    generator->size += size;
+
+    return output;
+}
+
+void store32BitInteger(unsigned char* output, uint32_t value) {
+    output[0] = (unsigned char)(value & 0xFF);
+    output[1] = (unsigned char)((value >> 0x08) & 0xFF);
+    output[2] = (unsigned char)((value >> 0x10) & 0xFF);
+    output[3] = (unsigned char)((value >> 0x18) & 0xFF);
+}
+
+void write32BitIntegerToGenerator(Blitz3DGenerator* generator, uint32_t value) {
+    unsigned char* output = reserveInGenerator(generator, 4);
+
+    if (output != NULL) store32BitInteger(output, value);
+}
+
+void writeFloatToGenerator(Blitz3DGenerator* generator, float value) {
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    write32BitIntegerToGenerator(generator, bits);
+}
+
+/* the prefix is cut or padded with letters to the configured length */
+
+void writeStringToGenerator(Blitz3DGenerator* generator, const char* prefix, unsigned int number) {
+    unsigned int length = generator->settings->stringLength, iter;
+    char formatted[32];
+    unsigned char* output;
+    size_t prefixLength;
+
+    sprintf(formatted, "%s%u", prefix, number);
+    prefixLength = strlen(formatted);
+
+    if (length == 0) length = 1;
+
+    output = reserveInGenerator(generator, length + 1);
+    if (output == NULL) return;
+
+    for (iter = 0; iter < length; iter++) {
+        output[iter] = (iter < prefixLength) ? (unsigned char)formatted[iter] : (unsigned char)('a' + iter % 26);
+    }
+
+    output[length] = '\0';
+}
+
+size_t beginChunkInGenerator(Blitz3DGenerator* generator, uint32_t tag) {
+    size_t output = generator->size;
+
+    write32BitIntegerToGenerator(generator, tag);
+    write32BitIntegerToGenerator(generator, 0);
+
+    return output;
+}
+
+void endChunkInGenerator(Blitz3DGenerator* generator, size_t chunkStart) {
+    if (generator->failed) return;
+
+    store32BitInteger(generator->data + chunkStart + 4, (uint32_t)(generator->size - chunkStart - 8));
+}
+
+/* a small xorshift, so the same settings always give the same file */
+
+float getRandomFloatFromGenerator(Blitz3DGenerator* generator) {
+    generator->random ^= generator->random << 13;
+    generator->random ^= generator->random >> 17;
+    generator->random ^= generator->random << 5;
+
+    return (float)(generator->random >> 8) / (float)(1 << 24);
+}
+
+/* chunks */
+
+void writeTEXSChunkToGenerator(Blitz3DGenerator* generator) {
+    size_t chunkStart = beginChunkInGenerator(generator, BLITZ3D_TAG_TEXS_LITTLE_ENDIAN);
+    unsigned int iter;
+
+    for (iter = 0; iter < BLITZ3D_GENERATOR_TEXTURE_COUNT; iter++) {
+        writeStringToGenerator(generator, "texture", iter);
+
+        write32BitIntegerToGenerator(generator, 1);
+        write32BitIntegerToGenerator(generator, 2);
+
+        writeFloatToGenerator(generator, 0.0f);
+        writeFloatToGenerator(generator, 0.0f);
+        writeFloatToGenerator(generator, 1.0f);
+        writeFloatToGenerator(generator, 1.0f);
+        writeFloatToGenerator(generator, 0.0f);
+    }
+
+    endChunkInGenerator(generator, chunkStart);
+}
+
+void writeBRUSChunkToGenerator(Blitz3DGenerator* generator) {
+    size_t chunkStart = beginChunkInGenerator(generator, BLITZ3D_TAG_BRUS_LITTLE_ENDIAN);
+    unsigned int iter, textureIter;
+
+    write32BitIntegerToGenerator(generator, BLITZ3D_GENERATOR_TEXTURE_COUNT);
+
+    for (iter = 0; iter < BLITZ3D_GENERATOR_BRUSH_COUNT; iter++) {
+        writeStringToGenerator(generator, "brush", iter);
+
+        writeFloatToGenerator(generator, 1.0f);
+        writeFloatToGenerator(generator, 1.0f);
+        writeFloatToGenerator(generator, 1.0f);
+        writeFloatToGenerator(generator, 1.0f);
+        writeFloatToGenerator(generator, 0.0f);
+
+        write32BitIntegerToGenerator(generator, 1);
+        write32BitIntegerToGenerator(generator, 0);
+
+        for (textureIter = 0; textureIter < BLITZ3D_GENERATOR_TEXTURE_COUNT; textureIter++) {
+            write32BitIntegerToGenerator(generator, textureIter);
+        }
+    }
+
+    endChunkInGenerator(generator, chunkStart);
+}
+
+void writeVRTSChunkToGenerator(Blitz3DGenerator* generator, unsigned int meshIndex) {
+    const Blitz3DGeneratorSettings* settings = generator->settings;
+    size_t chunkStart = beginChunkInGenerator(generator, BLITZ3D_TAG_VRTS_LITTLE_ENDIAN);
+    unsigned int iter, setIter;
+
+    write32BitIntegerToGenerator(generator, settings->vertexFlags);
+    write32BitIntegerToGenerator(generator, settings->texCoordSets);
+    write32BitIntegerToGenerator(generator, 2);
+
+    for (iter = 0; iter < settings->vertexCount; iter++) {
+        float x = (float)(iter % BLITZ3D_GENERATOR_GRID_WIDTH);
+        float z = (float)(iter / BLITZ3D_GENERATOR_GRID_WIDTH);
+
+        writeFloatToGenerator(generator, x);
+        writeFloatToGenerator(generator, getRandomFloatFromGenerator(generator));
+        writeFloatToGenerator(generator, z + (float)(meshIndex * 64));
+
+        if (settings->vertexFlags & BLITZ3D_VERTEX_FLAG_NORMAL) {
+            writeFloatToGenerator(generator, 0.0f);
+            writeFloatToGenerator(generator, 1.0f);
+            writeFloatToGenerator(generator, 0.0f);
+        }
+
+        if (settings->vertexFlags & BLITZ3D_VERTEX_FLAG_COLOR) {
+            writeFloatToGenerator(generator, 1.0f);
+            writeFloatToGenerator(generator, 1.0f);
+            writeFloatToGenerator(generator, 1.0f);
+            writeFloatToGenerator(generator, 1.0f);
+        }
+
+        for (setIter = 0; setIter < settings->texCoordSets; setIter++) {
+            writeFloatToGenerator(generator, x / BLITZ3D_GENERATOR_GRID_WIDTH);
+            writeFloatToGenerator(generator, getRandomFloatFromGenerator(generator));
+        }
+    }
+
+    endChunkInGenerator(generator, chunkStart);
+}
+
+/* the grid cells are handed out to the TRIS chunks in contiguous runs */
+
+void writeTRISChunksToGenerator(Blitz3DGenerator* generator, unsigned int meshIndex) {
+    const Blitz3DGeneratorSettings* settings = generator->settings;
+    unsigned int columns, rows, cellCount, trisIter, cell;
+
+    columns = (settings->vertexCount < BLITZ3D_GENERATOR_GRID_WIDTH) ? settings->vertexCount : BLITZ3D_GENERATOR_GRID_WIDTH;
+    rows = (columns > 0) ? settings->vertexCount / columns : 0;
+    cellCount = (columns > 1 && rows > 1) ? (columns - 1) * (rows - 1) : 0;
+
+    for (trisIter = 0; trisIter < settings->trisChunkCount; trisIter++) {
+        size_t chunkStart = beginChunkInGenerator(generator, BLITZ3D_TAG_TRIS_LITTLE_ENDIAN);
+        unsigned int first = (unsigned int)((uint64_t)cellCount * trisIter / settings->trisChunkCount);
+        unsigned int last = (unsigned int)((uint64_t)cellCount * (trisIter + 1) / settings->trisChunkCount);
+
+        write32BitIntegerToGenerator(generator, (meshIndex + trisIter) % BLITZ3D_GENERATOR_BRUSH_COUNT);
+
+        for (cell = first; cell < last; cell++) {
+            unsigned int corner = (cell / (columns - 1)) * columns + cell % (columns - 1);
+
+            write32BitIntegerToGenerator(generator, corner);
+            write32BitIntegerToGenerator(generator, corner + columns);
+            write32BitIntegerToGenerator(generator, corner + 1);
+
+            write32BitIntegerToGenerator(generator, corner + 1);
+            write32BitIntegerToGenerator(generator, corner + columns);
+            write32BitIntegerToGenerator(generator, corner + columns + 1);
+        }
+
+        endChunkInGenerator(generator, chunkStart);
+    }
+}
+
+void writeMESHChunkToGenerator(Blitz3DGenerator* generator, unsigned int meshIndex) {
+    size_t chunkStart = beginChunkInGenerator(generator, BLITZ3D_TAG_MESH_LITTLE_ENDIAN);
+
+    write32BitIntegerToGenerator(generator, meshIndex % BLITZ3D_GENERATOR_BRUSH_COUNT);
+
+    writeVRTSChunkToGenerator(generator, meshIndex);
+    writeTRISChunksToGenerator(generator, meshIndex);
+
+    endChunkInGenerator(generator, chunkStart);
+}
+
+/* commentary: node k of a level hangs off node (k mod n) of the level above, n being that level's size,
+   so the children of a node are every n'th node of the next level starting at its own index */
+
+void writeNODEChunkToGenerator(Blitz3DGenerator* generator, unsigned int level, unsigned int index, unsigned int meshIndex) {
+    size_t chunkStart = beginChunkInGenerator(generator, BLITZ3D_TAG_NODE_LITTLE_ENDIAN);
+    unsigned int child;
+
+    writeStringToGenerator(generator, "node", meshIndex);
+
+    writeFloatToGenerator(generator, 0.0f);
+    writeFloatToGenerator(generator, 0.0f);
+    writeFloatToGenerator(generator, 0.0f);
+
+    writeFloatToGenerator(generator, 1.0f);
+    writeFloatToGenerator(generator, 1.0f);
+    writeFloatToGenerator(generator, 1.0f);
+
+    writeFloatToGenerator(generator, 1.0f);
+    writeFloatToGenerator(generator, 0.0f);
+    writeFloatToGenerator(generator, 0.0f);
+    writeFloatToGenerator(generator, 0.0f);
+
+    if (generator->settings->vertexCount > 0) writeMESHChunkToGenerator(generator, meshIndex);
+
+    if (level + 1 < generator->levelCount) {
+        unsigned int levelStart = meshIndex - index + generator->levelCounts[level];
+
+        for (child = index; child < generator->levelCounts[level + 1]; child += generator->levelCounts[level]) {
+            writeNODEChunkToGenerator(generator, level + 1, child, levelStart + child);
+        }
+    }
+
+    endChunkInGenerator(generator, chunkStart);
+}
+
+/* public functions */
+
+void initializeBlitz3DGeneratorSettings(Blitz3DGeneratorSettings* settings) {
+    settings->nodeCount = 256;
+    settings->treeDepth = 4;
+
+    settings->vertexCount = 4096;
+    settings->texCoordSets = 2;
+    settings->trisChunkCount = 2;
+    settings->vertexFlags = 0;
+
+    settings->stringLength = 16;
+
+    settings->seed = 1;
+}
+
+size_t generateB3DFile(const char* filePath, const Blitz3DGeneratorSettings* settings) {
+    Blitz3DGenerator generator;
+    size_t chunkStart, output = 0;
+    unsigned int levelCount, iter;
+    FILE* fp;
+
+    memset(&generator, 0, sizeof(Blitz3DGenerator));
+    generator.settings = settings;
+    generator.random = settings->seed ? settings->seed : 1;
+
+    /* the root is a level of its own; a deeper tree than there are nodes for is cut short */
+
+    levelCount = settings->treeDepth + 1;
+    if (settings->nodeCount < levelCount) levelCount = (settings->nodeCount > 0) ? settings->nodeCount : 1;
+
+    generator.levelCount = levelCount;
+    generator.levelCounts = (unsigned int*)malloc(levelCount * sizeof(unsigned int));
+    generator.levelCounts[0] = 1;
+
+    for (iter = 1; iter < levelCount; iter++) {
+        generator.levelCounts[iter] = (settings->nodeCount - 1) / (levelCount - 1)
+            + ((iter - 1 < (settings->nodeCount - 1) % (levelCount - 1)) ? 1 : 0);
+    }
+
+    generator.capacity = 64 * 1024;
+    generator.data = (unsigned char*)malloc(generator.capacity);
+    if (generator.data == NULL) generator.failed = 1;
+
+    chunkStart = beginChunkInGenerator(&generator, BLITZ3D_TAG_BB3D_LITTLE_ENDIAN);
+    write32BitIntegerToGenerator(&generator, 1);
+
+    writeTEXSChunkToGenerator(&generator);
+    writeBRUSChunkToGenerator(&generator);
+    writeNODEChunkToGenerator(&generator, 0, 0, 0);
+
+    endChunkInGenerator(&generator, chunkStart);
+
+    if (!generator.failed) {
+        fp = fopen(filePath, "wb");
+
+        if (fp != NULL) {
+            if (fwrite(generator.data, 1, generator.size, fp) == generator.size) output = generator.size;
+            if (fclose(fp) != 0) output = 0;
+        }
+    }
+
+    free(generator.data);
+    free(generator.levelCounts);
+
+    return output;
+}
@@ -0,0 +1,36 @@
+#ifndef _BLITZ3DGENERATOR_H_
+#define _BLITZ3DGENERATOR_H_
+
+#include <stddef.h>
+
+/* commentary: writes synthetic but valid BB3D files for benchmarking the loaders. Every node carries a
+   mesh laid out as a grid of vertices, so the index data has the locality of a real level, and the
+   rest (tree shape, UV sets, TRIS chunks per mesh, string lengths) is set by the settings below */
+
+#define BLITZ3D_GENERATOR_NORMALS 1
+#define BLITZ3D_GENERATOR_COLORS 2
+
+typedef struct Blitz3DGeneratorSettings Blitz3DGeneratorSettings;
+struct Blitz3DGeneratorSettings {
+    /* nodes in the whole tree, spread evenly over treeDepth levels below the root */
+    unsigned int nodeCount;
+    unsigned int treeDepth;
+
+    /* per mesh; vertexFlags is any of BLITZ3D_GENERATOR_NORMALS and BLITZ3D_GENERATOR_COLORS */
+    unsigned int vertexCount;
+    unsigned int texCoordSets;
+    unsigned int trisChunkCount;
+    int vertexFlags;
+
+    /* node names, brush names and texture files are padded out to this many characters */
+    unsigned int stringLength;
+
+    unsigned int seed;
+};
+
+void initializeBlitz3DGeneratorSettings(Blitz3DGeneratorSettings* settings);
+
+/* returns the number of bytes written, or 0 if the file could not be written */
+size_t generateB3DFile(const char* filePath, const Blitz3DGeneratorSettings* settings);
+
+#endif
@@ -0,0 +1,719 @@
+#include "Blitz3DInterleave.h"
+#include "SIMD.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BLITZ3D_INTERLEAVE_X86
+#include <immintrin.h>
+#endif
+
+/* Blitz3D interleaved vertices */
+
+#define BLITZ3D_BRUSH_FX_FULL_BRIGHT 1
+#define BLITZ3D_BRUSH_FX_VERTEX_COLORS 2
+
+#define BLITZ3D_EVERY_ATTRIBUTE ((1u << BLITZ3D_ATTRIBUTE_COUNT) - 1)
+
+struct Blitz3DInterleavedVertices {
+    unsigned int vertexCount;
+    unsigned int stride, sourceStride;
+
+    unsigned char* data;
+
+    int states[BLITZ3D_ATTRIBUTE_COUNT];
+    int types[BLITZ3D_ATTRIBUTE_COUNT];
+    unsigned int componentCounts[BLITZ3D_ATTRIBUTE_COUNT];
+    unsigned int offsets[BLITZ3D_ATTRIBUTE_COUNT], sizes[BLITZ3D_ATTRIBUTE_COUNT];
+    float constants[BLITZ3D_ATTRIBUTE_COUNT][4];
+
+    /* for BLITZ3D_COMPONENTS_SHORT_RANGE: value = offset + scale * stored, per component */
+    float decodeOffsets[BLITZ3D_ATTRIBUTE_COUNT][4];
+    float decodeScales[BLITZ3D_ATTRIBUTE_COUNT][4];
+};
+
+/* the separate arrays a mesh or batch keeps its vertices in; NULL where it has no such attribute */
+
+typedef struct Blitz3DVertexSource Blitz3DVertexSource;
+struct Blitz3DVertexSource {
+    unsigned int vertexCount;
+    const float* arrays[BLITZ3D_ATTRIBUTE_COUNT];
+    unsigned int componentCounts[BLITZ3D_ATTRIBUTE_COUNT];
+};
+
+void initializeVertexSource(Blitz3DVertexSource* source, unsigned int vertexCount, const float* vertices,
+    const float* normals, const float* colors, unsigned int texCoordSets, unsigned int texCoordSize) {
+    unsigned int set;
+
+    memset(source, 0, sizeof(Blitz3DVertexSource));
+
+    source->vertexCount = vertexCount;
+
+    source->arrays[BLITZ3D_ATTRIBUTE_POSITION] = vertices;
+    source->arrays[BLITZ3D_ATTRIBUTE_NORMAL] = normals;
+    source->arrays[BLITZ3D_ATTRIBUTE_COLOR] = colors;
+
+    source->componentCounts[BLITZ3D_ATTRIBUTE_POSITION] = 3;
+    source->componentCounts[BLITZ3D_ATTRIBUTE_NORMAL] = 3;
+    source->componentCounts[BLITZ3D_ATTRIBUTE_COLOR] = 4;
+
+    for (set = 0; set < texCoordSets && set < BLITZ3D_ATTRIBUTE_COUNT - BLITZ3D_ATTRIBUTE_TEX_COORDS; set++) {
+        source->componentCounts[BLITZ3D_ATTRIBUTE_TEX_COORDS + set] = texCoordSize;
+    }
+}
+
+/* a bit per attribute (1 << attribute) that drawing with the brush reads */
+
+unsigned int getAttributesReadByBrush(Blitz3DBRUSChunk* brusChunk, int brushId) {
+    Blitz3DBrush* brush;
+    unsigned int output = 1u << BLITZ3D_ATTRIBUTE_POSITION;
+    unsigned int set;
+    int fx;
+
+    if (brusChunk == NULL || brushId < 0 || (unsigned int)brushId >= getBrushArrayCountFromBRUSChunk(brusChunk)) {
+        return BLITZ3D_EVERY_ATTRIBUTE;
+    }
+
+    brush = getBrushArrayEntryFromBRUSChunk(brusChunk, (unsigned int)brushId);
+    fx = getFxFromBrush(brush);
+
+    if ((fx & BLITZ3D_BRUSH_FX_FULL_BRIGHT) == 0) output |= 1u << BLITZ3D_ATTRIBUTE_NORMAL;
+    if ((fx & BLITZ3D_BRUSH_FX_VERTEX_COLORS) != 0) output |= 1u << BLITZ3D_ATTRIBUTE_COLOR;
+
+    for (set = 0; set < BLITZ3D_ATTRIBUTE_COUNT - BLITZ3D_ATTRIBUTE_TEX_COORDS; set++) {
+        unsigned int layer = getTextureLayerFromTexCoordSet(set);
+
+        if ((int)layer < getNumberOfTexturesFromBRUSChunk(brusChunk)
+            && getTextureIdArrayEntryFromBrush(brush, layer) >= 0) {
+            output |= 1u << (BLITZ3D_ATTRIBUTE_TEX_COORDS + set);
+        }
+    }
+
+    return output;
+}
+
+/* compares bit patterns, so -0.0 and 0.0 differ and a NaN matches itself */
+
+int attributeConstant(const float* array, unsigned int componentCount, unsigned int vertexCount) {
+    size_t vertexBytes = componentCount * sizeof(float);
+    unsigned int iter;
+
+    for (iter = 1; iter < vertexCount; iter++) {
+        if (memcmp(array, array + (size_t)iter * componentCount, vertexBytes) != 0) return 0;
+    }
+
+    return 1;
+}
+
+/* quantization kernels */
+
+/* commentary: every kernel reads one contiguous source array and writes one attribute of each vertex,
+   destinationStride bytes apart. The SSE2 kernels compute exactly what the scalar ones do: the same
+   float operations in the same order, clamps that send NaN to the low end, and rounding by adding a
+   half and truncating, so the packed bytes do not depend on the kernel */
+
+/* the smallest and largest value of each component */
+
+void findRangeScalar(const float* source, size_t count, unsigned int components, float* minimum, float* maximum) {
+    size_t iter;
+    unsigned int component;
+
+    for (iter = 0; iter < count; iter++) {
+        for (component = 0; component < components; component++) {
+            float value = source[components * iter + component];
+
+            if (value < minimum[component]) minimum[component] = value;
+            if (value > maximum[component]) maximum[component] = value;
+        }
+    }
+}
+
+/* stores 1 to 4 values with fixed-size copies, which the compiler turns into plain moves */
+
+void storeShorts(unsigned char* destination, const int16_t* values, unsigned int components) {
+    switch (components) {
+        case 1: memcpy(destination, values, 2); break;
+        case 2: memcpy(destination, values, 4); break;
+        case 3: memcpy(destination, values, 6); break;
+        default: memcpy(destination, values, 8); break;
+    }
+}
+
+/* per component, 0 to 65535 across [minimum, minimum + 65535 / scale], stored less 32768 */
+
+void quantizeRangeScalar(unsigned char* destination, size_t destinationStride, const float* source, size_t count,
+    unsigned int components, const float* minimum, const float* scale) {
+    size_t iter;
+    unsigned int component;
+
+    for (iter = 0; iter < count; iter++) {
+        int16_t* output = (int16_t*)(destination + destinationStride * iter);
+
+        for (component = 0; component < components; component++) {
+            float value = (source[components * iter + component] - minimum[component]) * scale[component] + 0.5f;
+
+            value = (value >= 0.0f) ? value : 0.0f;
+            value = (value <= 65535.0f) ? value : 65535.0f;
+
+            output[component] = (int16_t)((int)value - 32768);
+        }
+    }
+}
+
+/* 0 to 1 onto 0 to 255 */
+
+void quantizeColorsScalar(unsigned char* destination, size_t destinationStride, const float* source, size_t count) {
+    size_t iter;
+    unsigned int component;
+
+    for (iter = 0; iter < count; iter++) {
+        for (component = 0; component < 4; component++) {
+            float value = source[4 * iter + component];
+
+            value = (value >= 0.0f) ? value : 0.0f;
+            value = (value <= 1.0f) ? value : 1.0f;
+
+            destination[destinationStride * iter + component] = (unsigned char)(int)(value * 255.0f + 0.5f);
+        }
+    }
+}
+
+/* commentary: octahedral normals. A normal is projected onto the octahedron |x| + |y| + |z| = 1, the
+   lower half is folded over the upper one along the diagonals, and the square that leaves is stored
+   as two signed 16-bit values. A zero normal comes out as (0, 0), which decodes to +z */
+
+float foldOctahedralComponent(float value, float other) {
+    float folded = 1.0f - ((other < 0.0f) ? -other : other);
+
+    return (value < 0.0f) ? -folded : folded;
+}
+
+int16_t quantizeSignedUnit(float value) {
+    return (int16_t)(int)(value * 32767.0f + ((value < 0.0f) ? -0.5f : 0.5f));
+}
+
+void encodeOctahedralScalar(unsigned char* destination, size_t destinationStride, const float* source, size_t count) {
+    size_t iter;
+
+    for (iter = 0; iter < count; iter++) {
+        int16_t* output = (int16_t*)(destination + destinationStride * iter);
+        float x = source[3 * iter], y = source[3 * iter + 1], z = source[3 * iter + 2];
+        float length = ((x < 0.0f) ? -x : x) + ((y < 0.0f) ? -y : y) + ((z < 0.0f) ? -z : z);
+        float inverse = (length > 0.0f) ? 1.0f / length : 0.0f;
+
+        x *= inverse;
+        y *= inverse;
+
+        if (z < 0.0f) {
+            float foldedX = foldOctahedralComponent(x, y);
+
+            y = foldOctahedralComponent(y, x);
+            x = foldedX;
+        }
+
+        output[0] = quantizeSignedUnit(x);
+        output[1] = quantizeSignedUnit(y);
+    }
+}
+
+#ifdef BLITZ3D_INTERLEAVE_X86
+
+/* commentary: twelve values at a time, which is a whole number of vertices for 1 to 4 components, so
+   the minimum and scale patterns line up with the same three registers every time */
+
+__attribute__((target("sse2")))
+void findRangeSSE2(const float* source, size_t count, unsigned int components, float* minimum, float* maximum) {
+    float lanes[2][12];
+    __m128 minimums[3], maximums[3];
+    size_t iter = 0, verticesPerBlock = 12 / components;
+    unsigned int lane;
+
+    for (lane = 0; lane < 12; lane++) {
+        lanes[0][lane] = minimum[lane % components];
+        lanes[1][lane] = maximum[lane % components];
+    }
+
+    for (lane = 0; lane < 3; lane++) {
+        minimums[lane] = _mm_loadu_ps(lanes[0] + 4 * lane);
+        maximums[lane] = _mm_loadu_ps(lanes[1] + 4 * lane);
+    }
+
+    for (; iter + verticesPerBlock <= count; iter += verticesPerBlock) {
+        for (lane = 0; lane < 3; lane++) {
+            __m128 value = _mm_loadu_ps(source + components * iter + 4 * lane);
+
+            /* with a NaN in the first operand these return the second, so NaNs are skipped as above */
+            minimums[lane] = _mm_min_ps(value, minimums[lane]);
+            maximums[lane] = _mm_max_ps(value, maximums[lane]);
+        }
+    }
+
+    for (lane = 0; lane < 3; lane++) {
+        _mm_storeu_ps(lanes[0] + 4 * lane, minimums[lane]);
+        _mm_storeu_ps(lanes[1] + 4 * lane, maximums[lane]);
+    }
+
+    for (lane = 0; lane < 12; lane++) {
+        if (lanes[0][lane] < minimum[lane % components]) minimum[lane % components] = lanes[0][lane];
+        if (lanes[1][lane] > maximum[lane % components]) maximum[lane % components] = lanes[1][lane];
+    }
+
+    findRangeScalar(source + components * iter, count - iter, components, minimum, maximum);
+}
+
+__attribute__((target("sse2")))
+void quantizeRangeSSE2(unsigned char* destination, size_t destinationStride, const float* source, size_t count,
+    unsigned int components, const float* minimum, const float* scale) {
+    float minimumPattern[12], scalePattern[12];
+    __m128 minimums[3], scales[3];
+    __m128 half = _mm_set1_ps(0.5f), zero = _mm_setzero_ps(), top = _mm_set1_ps(65535.0f);
+    __m128i bias = _mm_set1_epi32(32768);
+    int16_t block[16];
+    size_t iter = 0, vertex, verticesPerBlock = 12 / components;
+    unsigned int lane;
+
+    for (lane = 0; lane < 12; lane++) {
+        minimumPattern[lane] = minimum[lane % components];
+        scalePattern[lane] = scale[lane % components];
+    }
+
+    for (lane = 0; lane < 3; lane++) {
+        minimums[lane] = _mm_loadu_ps(minimumPattern + 4 * lane);
+        scales[lane] = _mm_loadu_ps(scalePattern + 4 * lane);
+    }
+
+    for (; iter + verticesPerBlock <= count; iter += verticesPerBlock) {
+        const float* input = source + components * iter;
+        __m128i quantized[3];
+
+        for (lane = 0; lane < 3; lane++) {
+            __m128 value = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(input + 4 * lane), minimums[lane]),
+                scales[lane]), half);
+
+            value = _mm_min_ps(_mm_max_ps(value, zero), top);
+            quantized[lane] = _mm_sub_epi32(_mm_cvttps_epi32(value), bias);
+        }
+
+        _mm_storeu_si128((__m128i*)block, _mm_packs_epi32(quantized[0], quantized[1]));
+        _mm_storel_epi64((__m128i*)(block + 8), _mm_packs_epi32(quantized[2], quantized[2]));
+
+        for (vertex = 0; vertex < verticesPerBlock; vertex++) {
+            storeShorts(destination + destinationStride * (iter + vertex), block + components * vertex, components);
+        }
+    }
+
+    quantizeRangeScalar(destination + destinationStride * iter, destinationStride, source + components * iter,
+        count - iter, components, minimum, scale);
+}
+
+__attribute__((target("sse2")))
+void quantizeColorsSSE2(unsigned char* destination, size_t destinationStride, const float* source, size_t count) {
+    __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    __m128 full = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+    unsigned char block[16];
+    size_t iter = 0;
+    unsigned int lane;
+
+    for (; iter + 4 <= count; iter += 4) {
+        __m128i quantized[4];
+
+        for (lane = 0; lane < 4; lane++) {
+            __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + 4 * (iter + lane)), zero), one);
+
+            quantized[lane] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, full), half));
+        }
+
+        _mm_storeu_si128((__m128i*)block, _mm_packus_epi16(_mm_packs_epi32(quantized[0], quantized[1]),
+            _mm_packs_epi32(quantized[2], quantized[3])));
+
+        for (lane = 0; lane < 4; lane++) memcpy(destination + destinationStride * (iter + lane), block + 4 * lane, 4);
+    }
+
+    quantizeColorsScalar(destination + destinationStride * iter, destinationStride, source + 4 * iter, count - iter);
+}
+
+/* lanes where the mask is set take their sign from the mask */
+
+__attribute__((target("sse2")))
+__m128 negateWhereSSE2(__m128 mask, __m128 value) {
+    return _mm_xor_ps(value, _mm_and_ps(mask, _mm_set1_ps(-0.0f)));
+}
+
+__attribute__((target("sse2")))
+__m128 absoluteSSE2(__m128 value) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), value);
+}
+
+__attribute__((target("sse2")))
+__m128i quantizeSignedUnitSSE2(__m128 value) {
+    __m128 half = negateWhereSSE2(_mm_cmplt_ps(value, _mm_setzero_ps()), _mm_set1_ps(0.5f));
+
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(32767.0f)), half));
+}
+
+__attribute__((target("sse2")))
+void encodeOctahedralSSE2(unsigned char* destination, size_t destinationStride, const float* source, size_t count) {
+    __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    int16_t block[8];
+    size_t iter = 0;
+    unsigned int lane;
+
+    for (; iter + 4 <= count; iter += 4) {
+        const float* input = source + 3 * iter;
+        __m128 x = _mm_setr_ps(input[0], input[3], input[6], input[9]);
+        __m128 y = _mm_setr_ps(input[1], input[4], input[7], input[10]);
+        __m128 z = _mm_setr_ps(input[2], input[5], input[8], input[11]);
+        __m128 length = _mm_add_ps(_mm_add_ps(absoluteSSE2(x), absoluteSSE2(y)), absoluteSSE2(z));
+        __m128 positive = _mm_cmpgt_ps(length, zero);
+        __m128 inverse = _mm_and_ps(positive, _mm_div_ps(one, _mm_or_ps(length, _mm_andnot_ps(positive, one))));
+        __m128 lower = _mm_cmplt_ps(z, zero);
+        __m128 foldedX, foldedY;
+
+        x = _mm_mul_ps(x, inverse);
+        y = _mm_mul_ps(y, inverse);
+
+        foldedX = negateWhereSSE2(_mm_cmplt_ps(x, zero), _mm_sub_ps(one, absoluteSSE2(y)));
+        foldedY = negateWhereSSE2(_mm_cmplt_ps(y, zero), _mm_sub_ps(one, absoluteSSE2(x)));
+
+        x = _mm_or_ps(_mm_and_ps(lower, foldedX), _mm_andnot_ps(lower, x));
+        y = _mm_or_ps(_mm_and_ps(lower, foldedY), _mm_andnot_ps(lower, y));
+
+        _mm_storeu_si128((__m128i*)block, _mm_packs_epi32(_mm_unpacklo_epi32(quantizeSignedUnitSSE2(x),
+            quantizeSignedUnitSSE2(y)), _mm_unpackhi_epi32(quantizeSignedUnitSSE2(x), quantizeSignedUnitSSE2(y))));
+
+        for (lane = 0; lane < 4; lane++) {
+            memcpy(destination + destinationStride * (iter + lane), block + 2 * lane, 2 * sizeof(int16_t));
+        }
+    }
+
+    encodeOctahedralScalar(destination + destinationStride * iter, destinationStride, source + 3 * iter, count - iter);
+}
+
+#endif
+
+/* packing */
+
+/* commentary: compact normals are octahedral, colors are bytes and everything else is 16-bit over its
+   range; each attribute's size is rounded up to 4 bytes so every attribute stays aligned for the driver */
+
+void chooseAttributeType(Blitz3DInterleavedVertices* vertices, unsigned int attribute, int compact) {
+    unsigned int componentCount = vertices->componentCounts[attribute];
+
+    if (!compact) {
+        vertices->types[attribute] = BLITZ3D_COMPONENTS_FLOAT;
+        vertices->sizes[attribute] = componentCount * sizeof(float);
+    } else if (attribute == BLITZ3D_ATTRIBUTE_NORMAL) {
+        vertices->types[attribute] = BLITZ3D_COMPONENTS_OCTAHEDRAL;
+        vertices->sizes[attribute] = 2 * sizeof(int16_t);
+    } else if (attribute == BLITZ3D_ATTRIBUTE_COLOR) {
+        vertices->types[attribute] = BLITZ3D_COMPONENTS_UNSIGNED_BYTE;
+        vertices->sizes[attribute] = 4;
+    } else {
+        vertices->types[attribute] = BLITZ3D_COMPONENTS_SHORT_RANGE;
+        vertices->sizes[attribute] = (componentCount * sizeof(int16_t) + 3) & ~3u;
+    }
+}
+
+void packAttribute(Blitz3DInterleavedVertices* vertices, unsigned int attribute, const float* array) {
+    unsigned char* destination = vertices->data + vertices->offsets[attribute];
+    unsigned int componentCount = vertices->componentCounts[attribute];
+    size_t count = vertices->vertexCount;
+
+    if (vertices->types[attribute] == BLITZ3D_COMPONENTS_FLOAT) {
+        size_t iter;
+
+        for (iter = 0; iter < count; iter++) {
+            memcpy(destination + vertices->stride * iter, array + componentCount * iter,
+                componentCount * sizeof(float));
+        }
+    } else if (vertices->types[attribute] == BLITZ3D_COMPONENTS_SHORT_RANGE) {
+        float minimum[4], maximum[4], scale[4];
+        unsigned int component;
+
+        for (component = 0; component < componentCount; component++) {
+            minimum[component] = maximum[component] = array[component];
+        }
+
+#ifdef BLITZ3D_INTERLEAVE_X86
+        if (getSIMDLevel() == SIMD_LEVEL_SSE2) findRangeSSE2(array, count, componentCount, minimum, maximum);
+        else
+#endif
+        findRangeScalar(array, count, componentCount, minimum, maximum);
+
+        for (component = 0; component < componentCount; component++) {
+            /* a component with no extent stores 0 everywhere and decodes to its minimum */
+            scale[component] = (maximum[component] > minimum[component])
+                ? 65535.0f / (maximum[component] - minimum[component]) : 0.0f;
+
+            vertices->decodeScales[attribute][component] = (maximum[component] - minimum[component]) / 65535.0f;
+            vertices->decodeOffsets[attribute][component] = minimum[component]
+                + 32768.0f * vertices->decodeScales[attribute][component];
+        }
+
+#ifdef BLITZ3D_INTERLEAVE_X86
+        if (getSIMDLevel() == SIMD_LEVEL_SSE2) {
+            quantizeRangeSSE2(destination, vertices->stride, array, count, componentCount, minimum, scale);
+            return;
+        }
+#endif
+        quantizeRangeScalar(destination, vertices->stride, array, count, componentCount, minimum, scale);
+    } else if (vertices->types[attribute] == BLITZ3D_COMPONENTS_UNSIGNED_BYTE) {
+#ifdef BLITZ3D_INTERLEAVE_X86
+        if (getSIMDLevel() == SIMD_LEVEL_SSE2) {
+            quantizeColorsSSE2(destination, vertices->stride, array, count);
+            return;
+        }
+#endif
+        quantizeColorsScalar(destination, vertices->stride, array, count);
+    } else {
+#ifdef BLITZ3D_INTERLEAVE_X86
+        if (getSIMDLevel() == SIMD_LEVEL_SSE2) {
+            encodeOctahedralSSE2(destination, vertices->stride, array, count);
+            return;
+        }
+#endif
+        encodeOctahedralScalar(destination, vertices->stride, array, count);
+    }
+}
+
+Blitz3DInterleavedVertices* interleaveVertexSource(Blitz3DVertexSource* source, unsigned int readAttributes,
+    int compact) {
+    Blitz3DInterleavedVertices* output;
+    unsigned int attribute;
+
+    output = (Blitz3DInterleavedVertices*)calloc(1, sizeof(Blitz3DInterleavedVertices));
+    if (output == NULL) return NULL;
+
+    output->vertexCount = source->vertexCount;
+
+    for (attribute = 0; attribute < BLITZ3D_ATTRIBUTE_COUNT; attribute++) {
+        const float* array = source->arrays[attribute];
+        unsigned int componentCount = source->componentCounts[attribute];
+
+        output->componentCounts[attribute] = componentCount;
+
+        if (array == NULL) {
+            output->states[attribute] = BLITZ3D_ATTRIBUTE_ABSENT;
+            continue;
+        }
+
+        output->sourceStride += componentCount * sizeof(float);
+
+        if (attribute != BLITZ3D_ATTRIBUTE_POSITION && (readAttributes & (1u << attribute)) == 0) {
+            output->states[attribute] = BLITZ3D_ATTRIBUTE_UNUSED;
+        } else if (attribute != BLITZ3D_ATTRIBUTE_POSITION && source->vertexCount > 0
+            && attributeConstant(array, componentCount, source->vertexCount)) {
+            output->states[attribute] = BLITZ3D_ATTRIBUTE_CONSTANT;
+            memcpy(output->constants[attribute], array, componentCount * sizeof(float));
+        } else {
+            output->states[attribute] = BLITZ3D_ATTRIBUTE_PACKED;
+            chooseAttributeType(output, attribute, compact);
+            output->offsets[attribute] = output->stride;
+            output->stride += output->sizes[attribute];
+        }
+    }
+
+    output->data = (unsigned char*)calloc((size_t)source->vertexCount * output->stride + 1, 1);
+    if (output->data == NULL) {
+        free(output);
+        return NULL;
+    }
+
+    /* commentary: one attribute at a time, so each source array is read straight through */
+    for (attribute = 0; attribute < BLITZ3D_ATTRIBUTE_COUNT; attribute++) {
+        if (output->states[attribute] != BLITZ3D_ATTRIBUTE_PACKED) continue;
+
+        packAttribute(output, attribute, source->arrays[attribute]);
+    }
+
+    return output;
+}
+
+/* the brushes are the MESH chunk's and its TRIS chunks'; returns NULL without a VRTS chunk */
+
+Blitz3DInterleavedVertices* interleaveMESHChunk(Blitz3DMESHChunk* meshChunk, Blitz3DBRUSChunk* brusChunk,
+    int compact) {
+    Blitz3DVRTSChunk* vrtsChunk = getVRTSChunkFromMESHChunk(meshChunk);
+    Blitz3DVertexSource source;
+    unsigned int iter, readAttributes = 0;
+    int meshBrushRead = 0;
+
+    if (vrtsChunk == NULL) return NULL;
+
+    initializeVertexSource(&source, getVertexCountFromVRTSChunk(vrtsChunk), getVertexArrayFromVRTSChunk(vrtsChunk),
+        normalArrayPresentInVRTSChunk(vrtsChunk) ? getNormalArrayFromVRTSChunk(vrtsChunk) : NULL,
+        colorArrayPresentInVRTSChunk(vrtsChunk) ? getColorArrayFromVRTSChunk(vrtsChunk) : NULL,
+        getTexCoordArrayCountFromVRTSChunk(vrtsChunk), getTexCoordArrayComponentCountFromVRTSChunk(vrtsChunk));
+
+    for (iter = 0; iter < getTexCoordArrayCountFromVRTSChunk(vrtsChunk)
+        && iter < BLITZ3D_ATTRIBUTE_COUNT - BLITZ3D_ATTRIBUTE_TEX_COORDS; iter++) {
+        source.arrays[BLITZ3D_ATTRIBUTE_TEX_COORDS + iter] = getTexCoordArrayEntryFromVRTSChunk(vrtsChunk, iter);
+    }
+
+    /* a TRIS chunk's brush id of -1 falls back to the MESH chunk's, as when drawing */
+    for (iter = 0; iter < getTRISChunkArrayCountFromMESHChunk(meshChunk); iter++) {
+        int brushId = getBrushIdFromTRISChunk(getTRISChunkArrayEntryFromMESHChunk(meshChunk, iter));
+
+        if (brushId == -1) {
+            meshBrushRead = 1;
+        } else {
+            readAttributes |= getAttributesReadByBrush(brusChunk, brushId);
+        }
+    }
+
+    if (meshBrushRead || getTRISChunkArrayCountFromMESHChunk(meshChunk) == 0) {
+        readAttributes |= getAttributesReadByBrush(brusChunk, getBrushIdFromMESHChunk(meshChunk));
+    }
+
+    return interleaveVertexSource(&source, readAttributes, compact);
+}
+
+Blitz3DInterleavedVertices* interleaveBatch(Blitz3DBatch* batch, Blitz3DBRUSChunk* brusChunk, int compact) {
+    Blitz3DVertexSource source;
+    unsigned int set;
+
+    initializeVertexSource(&source, getVertexCountFromBatch(batch), getVertexArrayFromBatch(batch),
+        getNormalArrayFromBatch(batch), getColorArrayFromBatch(batch), getTexCoordArrayCountFromBatch(batch),
+        getTexCoordArrayComponentCountFromBatch(batch));
+
+    for (set = 0; set < getTexCoordArrayCountFromBatch(batch)
+        && set < BLITZ3D_ATTRIBUTE_COUNT - BLITZ3D_ATTRIBUTE_TEX_COORDS; set++) {
+        source.arrays[BLITZ3D_ATTRIBUTE_TEX_COORDS + set] = getTexCoordArrayEntryFromBatch(batch, set);
+    }
+
+    return interleaveVertexSource(&source, getAttributesReadByBrush(brusChunk, getBrushIdFromBatch(batch)), compact);
+}
+
+Blitz3DInterleavedVertices* createInterleavedVerticesFromMESHChunk(Blitz3DMESHChunk* meshChunk,
+    Blitz3DBRUSChunk* brusChunk) {
+    return interleaveMESHChunk(meshChunk, brusChunk, 0);
+}
+
+Blitz3DInterleavedVertices* createInterleavedVerticesFromBatch(Blitz3DBatch* batch, Blitz3DBRUSChunk* brusChunk) {
+    return interleaveBatch(batch, brusChunk, 0);
+}
+
+Blitz3DInterleavedVertices* createCompactVerticesFromMESHChunk(Blitz3DMESHChunk* meshChunk,
+    Blitz3DBRUSChunk* brusChunk) {
+    return interleaveMESHChunk(meshChunk, brusChunk, 1);
+}
+
+Blitz3DInterleavedVertices* createCompactVerticesFromBatch(Blitz3DBatch* batch, Blitz3DBRUSChunk* brusChunk) {
+    return interleaveBatch(batch, brusChunk, 1);
+}
+
+void freeInterleavedVertices(Blitz3DInterleavedVertices* vertices) {
+    if (vertices == NULL) return;
+
+    free(vertices->data);
+    free(vertices);
+}
+
+void releaseDataFromInterleavedVertices(Blitz3DInterleavedVertices* vertices) {
+    free(vertices->data);
+    vertices->data = NULL;
+}
+
+unsigned int getVertexCountFromInterleavedVertices(Blitz3DInterleavedVertices* vertices) {
+    return vertices->vertexCount;
+}
+
+unsigned int getStrideFromInterleavedVertices(Blitz3DInterleavedVertices* vertices) {
+    return vertices->stride;
+}
+
+unsigned int getSourceStrideFromInterleavedVertices(Blitz3DInterleavedVertices* vertices) {
+    return vertices->sourceStride;
+}
+
+void* getDataFromInterleavedVertices(Blitz3DInterleavedVertices* vertices) {
+    return vertices->data;
+}
+
+int getAttributeStateFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute) {
+    return vertices->states[attribute];
+}
+
+int getAttributeTypeFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute) {
+    return vertices->types[attribute];
+}
+
+unsigned int getAttributeSizeFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute) {
+    return vertices->sizes[attribute];
+}
+
+unsigned int getAttributeComponentCountFromInterleavedVertices(Blitz3DInterleavedVertices* vertices,
+    unsigned int attribute) {
+    return vertices->componentCounts[attribute];
+}
+
+unsigned int getAttributeOffsetFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute) {
+    return vertices->offsets[attribute];
+}
+
+float* getAttributeConstantFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute) {
+    return vertices->constants[attribute];
+}
+
+float* getAttributeDecodeOffsetFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute) {
+    return vertices->decodeOffsets[attribute];
+}
+
+float* getAttributeDecodeScaleFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute) {
+    return vertices->decodeScales[attribute];
+}
+
+void decodeOctahedralNormal(const int16_t* encoded, float* normal) {
+    float x = encoded[0] / 32767.0f, y = encoded[1] / 32767.0f;
+    float z = 1.0f - ((x < 0.0f) ? -x : x) - ((y < 0.0f) ? -y : y);
+    float length;
+
+    if (z < 0.0f) {
+        float foldedX = foldOctahedralComponent(x, y);
+
+        y = foldOctahedralComponent(y, x);
+        x = foldedX;
+    }
+
+    length = (float)sqrt(x * x + y * y + z * z);
+
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+void decodeAttributeFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute,
+    unsigned int vertexIndex, float* output) {
+    const unsigned char* input;
+    unsigned int component, componentCount = vertices->componentCounts[attribute];
+
+    if (vertices->states[attribute] == BLITZ3D_ATTRIBUTE_CONSTANT) {
+        memcpy(output, vertices->constants[attribute], componentCount * sizeof(float));
+        return;
+    }
+
+    input = vertices->data + vertices->stride * (size_t)vertexIndex + vertices->offsets[attribute];
+
+    switch (vertices->types[attribute]) {
+        case BLITZ3D_COMPONENTS_FLOAT:
+            memcpy(output, input, componentCount * sizeof(float));
+            break;
+
+        case BLITZ3D_COMPONENTS_SHORT_RANGE:
+            for (component = 0; component < componentCount; component++) {
+                output[component] = vertices->decodeOffsets[attribute][component]
+                    + vertices->decodeScales[attribute][component] * ((const int16_t*)input)[component];
+            }
+            break;
+
+        case BLITZ3D_COMPONENTS_UNSIGNED_BYTE:
+            for (component = 0; component < 4; component++) output[component] = input[component] / 255.0f;
+            break;
+
+        case BLITZ3D_COMPONENTS_OCTAHEDRAL:
+            decodeOctahedralNormal((const int16_t*)input, output);
+            break;
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef _BLITZ3DINTERLEAVE_H_
+#define _BLITZ3DINTERLEAVE_H_
+
+#include "Blitz3DFile.h"
+#include "Blitz3DBatch.h"
+
+/* commentary: interleaved vertices. A VRTS chunk (and a batch) keeps positions, normals, colors and
+   each tex coord set in arrays of their own, so a vertex is read from up to eleven places. This packs
+   a mesh's or a batch's vertices into one float array, one whole vertex after another, and leaves out
+   every attribute that would only repeat itself or that nothing reads:
+
+   - an attribute with the same value at every vertex (all-white colors, say) is dropped and its value
+     kept, to be set once per draw instead;
+   - an attribute none of the brushes drawing the vertices uses is dropped: normals when every brush
+     is full-bright, colors when no brush has the vertex color effect, and a tex coord set when no brush
+     has a texture in the layer it feeds (see getTextureLayerFromTexCoordSet).
+
+   A brush id of -1, or one outside the BRUS chunk, says nothing about what is read, so vertices drawn
+   with one keep everything that varies. Positions are always kept. The packed vertices copy what they
+   need and outlive the mesh or batch, so an index-only file can evict each mesh once it is packed.
+
+   Packed attributes are floats, or in the compact form quantized, which for a lightmapped level takes
+   a vertex from 28 bytes to 16. Decoding is cheap enough to leave to the renderer (a matrix for
+   positions and tex coords, normalized bytes for colors); the error bounds are:
+
+   - positions and tex coords: 16 bits over the range each component spans in the mesh or batch, off
+     by at most half a step, (maximum - minimum) / 131070, plus float rounding;
+   - colors: RGBA8, off by at most 1 / 510; components outside 0 to 1 are clamped;
+   - normals: octahedral, two 16-bit values; a normal comes back within 0.004 degrees of its
+     direction, and always as unit length
+
+   Quantizing runs four (or twelve) values at a time with SSE2 where the SIMD level allows, and
+   gives the same bytes as the scalar code */
+
+/* attributes, in the order they are packed; tex coord set n is BLITZ3D_ATTRIBUTE_TEX_COORDS + n */
+#define BLITZ3D_ATTRIBUTE_POSITION 0
+#define BLITZ3D_ATTRIBUTE_NORMAL 1
+#define BLITZ3D_ATTRIBUTE_COLOR 2
+#define BLITZ3D_ATTRIBUTE_TEX_COORDS 3
+#define BLITZ3D_ATTRIBUTE_COUNT 11
+
+/* how a packed attribute is stored */
+#define BLITZ3D_COMPONENTS_FLOAT 0
+/* signed 16-bit values; value = decode offset + decode scale * stored, per component */
+#define BLITZ3D_COMPONENTS_SHORT_RANGE 1
+/* 8-bit values; value = stored / 255 */
+#define BLITZ3D_COMPONENTS_UNSIGNED_BYTE 2
+/* two signed 16-bit values onto the octahedron; see decodeOctahedralNormal */
+#define BLITZ3D_COMPONENTS_OCTAHEDRAL 3
+
+/* what became of an attribute */
+#define BLITZ3D_ATTRIBUTE_PACKED 0
+#define BLITZ3D_ATTRIBUTE_ABSENT 1
+#define BLITZ3D_ATTRIBUTE_CONSTANT 2
+#define BLITZ3D_ATTRIBUTE_UNUSED 3
+
+typedef struct Blitz3DInterleavedVertices Blitz3DInterleavedVertices;
+struct Blitz3DInterleavedVertices;
+
+/* the brushes are the MESH chunk's and its TRIS chunks'; brusChunk may be NULL. For index-only files
+   this decodes the mesh. Returns NULL if the mesh has no VRTS chunk or out of memory */
+Blitz3DInterleavedVertices* createInterleavedVerticesFromMESHChunk(Blitz3DMESHChunk* meshChunk,
+    Blitz3DBRUSChunk* brusChunk);
+
+/* the brush is the batch's; returns NULL if out of memory */
+Blitz3DInterleavedVertices* createInterleavedVerticesFromBatch(Blitz3DBatch* batch, Blitz3DBRUSChunk* brusChunk);
+
+/* as above, with every packed attribute quantized */
+Blitz3DInterleavedVertices* createCompactVerticesFromMESHChunk(Blitz3DMESHChunk* meshChunk,
+    Blitz3DBRUSChunk* brusChunk);
+
+Blitz3DInterleavedVertices* createCompactVerticesFromBatch(Blitz3DBatch* batch, Blitz3DBRUSChunk* brusChunk);
+
+void freeInterleavedVertices(Blitz3DInterleavedVertices* vertices);
+
+/* drops the packed array (once it has been uploaded, say); the layout and the constants stay */
+void releaseDataFromInterleavedVertices(Blitz3DInterleavedVertices* vertices);
+
+unsigned int getVertexCountFromInterleavedVertices(Blitz3DInterleavedVertices* vertices);
+
+/* bytes per vertex, packed */
+unsigned int getStrideFromInterleavedVertices(Blitz3DInterleavedVertices* vertices);
+
+/* bytes per vertex across the separate arrays the vertices came from */
+unsigned int getSourceStrideFromInterleavedVertices(Blitz3DInterleavedVertices* vertices);
+
+/* vertex count * stride bytes; NULL once released */
+void* getDataFromInterleavedVertices(Blitz3DInterleavedVertices* vertices);
+
+/* returns one of the BLITZ3D_ATTRIBUTE_ states above */
+int getAttributeStateFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute);
+
+/* one of the BLITZ3D_COMPONENTS_ types above */
+int getAttributeTypeFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute);
+
+/* floats in the attribute: 3 for positions and normals, 4 for colors, 1 to 4 for tex coords */
+unsigned int getAttributeComponentCountFromInterleavedVertices(Blitz3DInterleavedVertices* vertices,
+    unsigned int attribute);
+
+/* byte offset of a packed attribute within a vertex */
+unsigned int getAttributeOffsetFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute);
+
+/* bytes a packed attribute takes in each vertex, padding included */
+unsigned int getAttributeSizeFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute);
+
+/* the value of a constant attribute, component count floats */
+float* getAttributeConstantFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute);
+
+/* for BLITZ3D_COMPONENTS_SHORT_RANGE, component count floats each */
+float* getAttributeDecodeOffsetFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute);
+
+float* getAttributeDecodeScaleFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute);
+
+/* a unit normal (+z for an encoded zero normal) */
+void decodeOctahedralNormal(const int16_t* encoded, float* normal);
+
+/* one vertex's value of a packed or constant attribute as component count floats, whatever its type;
+   packed attributes need the data, so not after releaseDataFromInterleavedVertices */
+void decodeAttributeFromInterleavedVertices(Blitz3DInterleavedVertices* vertices, unsigned int attribute,
+    unsigned int vertexIndex, float* output);
+
+#endif
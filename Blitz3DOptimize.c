@@ -0,0 +1,841 @@
+#include "Blitz3DOptimize.h"
+#include "Blitz3DFileInternal.h"
+#include "DynamicArray.h"
+#include "ThreadPool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+/* Blitz3D mesh passes */
+
+/* one VRTS chunk holds at most a position, a normal, a color and 8 UV sets */
+#define BLITZ3D_MAX_VERTEX_STREAMS 11
+
+#define BLITZ3D_UNUSED_VERTEX 0xFFFFFFFF
+
+float weldEpsilon = 0.0f;
+unsigned int optimizeThreadCount = 0;
+
+/* commentary: the passes see a vertex as a set of streams, one per attribute array, so they do not
+   need to know which attributes a chunk has */
+
+typedef struct Blitz3DVertexStream Blitz3DVertexStream;
+struct Blitz3DVertexStream {
+    float* data;
+    unsigned int components;
+};
+
+unsigned int collectVertexStreams(Blitz3DVRTSChunk* vrtsChunk, Blitz3DVertexStream* streams) {
+    unsigned int output = 0;
+    int iter;
+
+    streams[output].data = vrtsChunk->vertexArray;
+    streams[output++].components = 3;
+
+    if (vrtsChunk->normalArray != NULL) {
+        streams[output].data = vrtsChunk->normalArray;
+        streams[output++].components = 3;
+    }
+
+    if (vrtsChunk->colorArray != NULL) {
+        streams[output].data = vrtsChunk->colorArray;
+        streams[output++].components = 4;
+    }
+
+    for (iter = 0; iter < vrtsChunk->tex_coord_sets; iter++) {
+        if (vrtsChunk->tex_coord_set_size == 0) break;
+
+        streams[output].data = vrtsChunk->texCoordArrays[iter];
+        streams[output++].components = vrtsChunk->tex_coord_set_size;
+    }
+
+    return output;
+}
+
+/* indices outside the vertex array are left alone; the loader does not reject them either */
+
+void remapMESHChunkIndices(Blitz3DMESHChunk* meshChunk, const unsigned int* remap, unsigned int vertexCount) {
+    unsigned int trisIter, iter;
+
+    for (trisIter = 0; trisIter < meshChunk->trisChunkCount; trisIter++) {
+        Blitz3DTRISChunk* trisChunk = meshChunk->trisChunkArray[trisIter];
+
+        for (iter = 0; iter < 3 * trisChunk->triangleCount; iter++) {
+            int index = trisChunk->indexArray[iter];
+
+            if (index >= 0 && (unsigned int)index < vertexCount) trisChunk->indexArray[iter] = (int)remap[index];
+        }
+    }
+}
+
+/* commentary: the passes work on 32-bit indices, so 16-bit chunks are widened into temporary arrays
+   for the length of a run and narrowed back at the end. The passes never raise an index above the
+   vertex count, which is what allowed 16 bits in the first place, so the narrowed indices still fit */
+
+int widenIndicesInMESHChunk(Blitz3DMESHChunk* meshChunk) {
+    unsigned int trisIter, iter;
+
+    for (trisIter = 0; trisIter < meshChunk->trisChunkCount; trisIter++) {
+        Blitz3DTRISChunk* trisChunk = meshChunk->trisChunkArray[trisIter];
+
+        if (trisChunk->shortIndexArray == NULL) continue;
+
+        trisChunk->indexArray = (int*)malloc(3 * (size_t)trisChunk->triangleCount * sizeof(int));
+        if (trisChunk->indexArray == NULL) return -1;
+
+        for (iter = 0; iter < 3 * trisChunk->triangleCount; iter++) {
+            trisChunk->indexArray[iter] = trisChunk->shortIndexArray[iter];
+        }
+    }
+
+    return 0;
+}
+
+void narrowIndicesInMESHChunk(Blitz3DMESHChunk* meshChunk) {
+    unsigned int trisIter, iter;
+
+    for (trisIter = 0; trisIter < meshChunk->trisChunkCount; trisIter++) {
+        Blitz3DTRISChunk* trisChunk = meshChunk->trisChunkArray[trisIter];
+
+        if (trisChunk->shortIndexArray == NULL || trisChunk->indexArray == NULL) continue;
+
+        for (iter = 0; iter < 3 * trisChunk->triangleCount; iter++) {
+            trisChunk->shortIndexArray[iter] = (uint16_t)trisChunk->indexArray[iter];
+        }
+
+        free(trisChunk->indexArray);
+        trisChunk->indexArray = NULL;
+    }
+}
+
+/* stripping */
+
+void stripAttributesFromMESHChunk(Blitz3DMESHChunk* meshChunk, int passes) {
+    Blitz3DVRTSChunk* vrtsChunk = meshChunk->vrtsChunk;
+
+    if (passes & BLITZ3D_PASS_STRIP_NORMALS) {
+        vrtsChunk->normalArray = NULL;
+        vrtsChunk->flags &= ~BLITZ3D_VERTEX_FLAG_NORMAL;
+    }
+
+    if (passes & BLITZ3D_PASS_STRIP_COLORS) {
+        vrtsChunk->colorArray = NULL;
+        vrtsChunk->flags &= ~BLITZ3D_VERTEX_FLAG_COLOR;
+    }
+}
+
+/* welding */
+
+/* commentary: the key of a component is its grid cell when welding with an epsilon, and its bits
+   otherwise. Cells are kept within 2^61 either way, so a value too large (or not finite) to snap
+   falls back to its bits, tagged with bit 62 so it can never equal a cell */
+
+uint64_t getWeldKey(float value, float epsilon) {
+    uint32_t bits;
+
+    if (epsilon > 0.0f) {
+        double cell = floor((double)value / epsilon + 0.5);
+
+        if (cell > -2.3e18 && cell < 2.3e18) return (uint64_t)(int64_t)cell;
+    }
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    return ((uint64_t)1 << 62) | bits;
+}
+
+uint32_t hashVertex(Blitz3DVertexStream* streams, unsigned int streamCount, unsigned int vertex, float epsilon) {
+    uint32_t output = 2166136261u;
+    unsigned int streamIter, component;
+
+    for (streamIter = 0; streamIter < streamCount; streamIter++) {
+        const float* values = streams[streamIter].data + (size_t)streams[streamIter].components * vertex;
+
+        for (component = 0; component < streams[streamIter].components; component++) {
+            uint64_t key = getWeldKey(values[component], epsilon);
+
+            output = (output ^ (uint32_t)key) * 16777619u;
+            output = (output ^ (uint32_t)(key >> 32)) * 16777619u;
+        }
+    }
+
+    return output ^ (output >> 15);
+}
+
+int verticesIdentical(Blitz3DVertexStream* streams, unsigned int streamCount, unsigned int first, unsigned int second,
+    float epsilon) {
+
+    unsigned int iter, component;
+
+    for (iter = 0; iter < streamCount; iter++) {
+        unsigned int components = streams[iter].components;
+        const float* firstValues = streams[iter].data + (size_t)components * first;
+        const float* secondValues = streams[iter].data + (size_t)components * second;
+
+        if (epsilon <= 0.0f) {
+            if (memcmp(firstValues, secondValues, components * sizeof(float)) != 0) return 0;
+            continue;
+        }
+
+        for (component = 0; component < components; component++) {
+            if (getWeldKey(firstValues[component], epsilon) != getWeldKey(secondValues[component], epsilon)) return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* commentary: first occurrences are compacted towards the front as they are found, so the surviving
+   vertices keep their order and the arrays shrink in place. The hash table is open addressing with
+   linear probing, at most half full, and stores the compacted index plus one (0 marks a free slot) */
+
+unsigned int weldVerticesInMESHChunk(Blitz3DMESHChunk* meshChunk, float epsilon) {
+    Blitz3DVRTSChunk* vrtsChunk = meshChunk->vrtsChunk;
+    Blitz3DVertexStream streams[BLITZ3D_MAX_VERTEX_STREAMS];
+    unsigned int streamCount, vertexCount, weldedCount, tableSize, iter, streamIter;
+    unsigned int* table;
+    unsigned int* remap;
+
+    vertexCount = vrtsChunk->vertexCount;
+    if (vertexCount < 2) return 0;
+
+    streamCount = collectVertexStreams(vrtsChunk, streams);
+
+    for (tableSize = 16; tableSize < 2 * vertexCount; tableSize *= 2) ;
+
+    table = (unsigned int*)calloc(tableSize, sizeof(unsigned int));
+    remap = (unsigned int*)malloc(vertexCount * sizeof(unsigned int));
+
+    if (table == NULL || remap == NULL) {
+        free(table);
+        free(remap);
+        return 0;
+    }
+
+    weldedCount = 0;
+
+    for (iter = 0; iter < vertexCount; iter++) {
+        unsigned int slot = hashVertex(streams, streamCount, iter, epsilon) & (tableSize - 1);
+
+        while (table[slot] != 0 && !verticesIdentical(streams, streamCount, table[slot] - 1, iter, epsilon)) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+
+        if (table[slot] != 0) {
+            remap[iter] = table[slot] - 1;
+            continue;
+        }
+
+        if (weldedCount != iter) {
+            for (streamIter = 0; streamIter < streamCount; streamIter++) {
+                unsigned int components = streams[streamIter].components;
+
+                memcpy(streams[streamIter].data + (size_t)components * weldedCount,
+                    streams[streamIter].data + (size_t)components * iter, components * sizeof(float));
+            }
+        }
+
+        table[slot] = weldedCount + 1;
+        remap[iter] = weldedCount++;
+    }
+
+    remapMESHChunkIndices(meshChunk, remap, vertexCount);
+    vrtsChunk->vertexCount = weldedCount;
+
+    free(table);
+    free(remap);
+
+    return vertexCount - weldedCount;
+}
+
+/* triangle cleaning */
+
+int triangleHasArea(Blitz3DVRTSChunk* vrtsChunk, const int* triangle) {
+    const float* a;
+    const float* b;
+    const float* c;
+    float ab[3], ac[3];
+    unsigned int iter;
+
+    if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2]) return 0;
+
+    for (iter = 0; iter < 3; iter++) {
+        if (triangle[iter] < 0 || (unsigned int)triangle[iter] >= vrtsChunk->vertexCount) return 1;
+    }
+
+    a = vrtsChunk->vertexArray + 3 * (size_t)triangle[0];
+    b = vrtsChunk->vertexArray + 3 * (size_t)triangle[1];
+    c = vrtsChunk->vertexArray + 3 * (size_t)triangle[2];
+
+    for (iter = 0; iter < 3; iter++) {
+        ab[iter] = b[iter] - a[iter];
+        ac[iter] = c[iter] - a[iter];
+    }
+
+    return ab[1] * ac[2] - ab[2] * ac[1] != 0.0f
+        || ab[2] * ac[0] - ab[0] * ac[2] != 0.0f
+        || ab[0] * ac[1] - ab[1] * ac[0] != 0.0f;
+}
+
+/* commentary: a triangle is a duplicate if it has the same corners in the same winding as an earlier
+   one, whichever corner it starts at; the same corners wound the other way face the other way and are
+   kept. Triangles are rotated to start at their smallest index so that duplicates hash alike, and the
+   survivors are compacted towards the front through the same kind of table the weld uses */
+
+unsigned int cleanTrianglesInTRISChunk(Blitz3DVRTSChunk* vrtsChunk, Blitz3DTRISChunk* trisChunk, unsigned int* table,
+    unsigned int tableSize) {
+
+    unsigned int keptCount, droppedCount, iter;
+    int* indices = trisChunk->indexArray;
+
+    memset(table, 0, tableSize * sizeof(unsigned int));
+    keptCount = 0;
+
+    for (iter = 0; iter < trisChunk->triangleCount; iter++) {
+        int triangle[3];
+        unsigned int first, slot;
+        uint32_t hash;
+
+        if (!triangleHasArea(vrtsChunk, indices + 3 * iter)) continue;
+
+        first = 0;
+        if (indices[3 * iter + 1] < indices[3 * iter + first]) first = 1;
+        if (indices[3 * iter + 2] < indices[3 * iter + first]) first = 2;
+
+        triangle[0] = indices[3 * iter + first];
+        triangle[1] = indices[3 * iter + (first + 1) % 3];
+        triangle[2] = indices[3 * iter + (first + 2) % 3];
+
+        hash = (((uint32_t)triangle[0] * 73856093u) ^ ((uint32_t)triangle[1] * 19349663u) ^ ((uint32_t)triangle[2] * 83492791u));
+        slot = (hash ^ (hash >> 15)) & (tableSize - 1);
+
+        while (table[slot] != 0 && memcmp(indices + 3 * (table[slot] - 1), triangle, sizeof(triangle)) != 0) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+
+        if (table[slot] != 0) continue;
+
+        memcpy(indices + 3 * keptCount, triangle, sizeof(triangle));
+        table[slot] = ++keptCount;
+    }
+
+    droppedCount = trisChunk->triangleCount - keptCount;
+    trisChunk->triangleCount = keptCount;
+
+    return droppedCount;
+}
+
+unsigned int cleanTrianglesInMESHChunk(Blitz3DMESHChunk* meshChunk) {
+    unsigned int maxTriangles, tableSize, trisIter, output;
+    unsigned int* table;
+
+    maxTriangles = 0;
+
+    for (trisIter = 0; trisIter < meshChunk->trisChunkCount; trisIter++) {
+        if (meshChunk->trisChunkArray[trisIter]->triangleCount > maxTriangles) {
+            maxTriangles = meshChunk->trisChunkArray[trisIter]->triangleCount;
+        }
+    }
+
+    if (maxTriangles == 0) return 0;
+
+    for (tableSize = 16; tableSize < 2 * maxTriangles; tableSize *= 2) ;
+
+    table = (unsigned int*)malloc(tableSize * sizeof(unsigned int));
+    if (table == NULL) return 0;
+
+    output = 0;
+
+    /* each chunk only clears as much of the table as it needs */
+    for (trisIter = 0; trisIter < meshChunk->trisChunkCount; trisIter++) {
+        Blitz3DTRISChunk* trisChunk = meshChunk->trisChunkArray[trisIter];
+        unsigned int chunkTableSize;
+
+        for (chunkTableSize = 16; chunkTableSize < 2 * trisChunk->triangleCount; chunkTableSize *= 2) ;
+
+        output += cleanTrianglesInTRISChunk(meshChunk->vrtsChunk, trisChunk, table, chunkTableSize);
+    }
+
+    free(table);
+
+    return output;
+}
+
+/* reordering */
+
+/* commentary: after this pass, walking the index arrays touches the vertex arrays front to back, which
+   is what the vertex fetch wants; the permutation goes through one scratch array, a stream at a time */
+
+void reorderVerticesInMESHChunk(Blitz3DMESHChunk* meshChunk) {
+    Blitz3DVRTSChunk* vrtsChunk = meshChunk->vrtsChunk;
+    Blitz3DVertexStream streams[BLITZ3D_MAX_VERTEX_STREAMS];
+    unsigned int streamCount, vertexCount, usedCount, trisIter, iter, streamIter;
+    unsigned int* remap;
+    float* scratch;
+
+    vertexCount = vrtsChunk->vertexCount;
+    if (vertexCount == 0) return;
+
+    streamCount = collectVertexStreams(vrtsChunk, streams);
+
+    remap = (unsigned int*)malloc(vertexCount * sizeof(unsigned int));
+    scratch = (float*)malloc((size_t)vertexCount * 4 * sizeof(float));
+
+    if (remap == NULL || scratch == NULL) {
+        free(remap);
+        free(scratch);
+        return;
+    }
+
+    for (iter = 0; iter < vertexCount; iter++) remap[iter] = BLITZ3D_UNUSED_VERTEX;
+
+    usedCount = 0;
+
+    for (trisIter = 0; trisIter < meshChunk->trisChunkCount; trisIter++) {
+        Blitz3DTRISChunk* trisChunk = meshChunk->trisChunkArray[trisIter];
+
+        for (iter = 0; iter < 3 * trisChunk->triangleCount; iter++) {
+            int index = trisChunk->indexArray[iter];
+
+            if (index >= 0 && (unsigned int)index < vertexCount && remap[index] == BLITZ3D_UNUSED_VERTEX) {
+                remap[index] = usedCount++;
+            }
+        }
+    }
+
+    for (streamIter = 0; streamIter < streamCount; streamIter++) {
+        unsigned int components = streams[streamIter].components;
+
+        for (iter = 0; iter < vertexCount; iter++) {
+            if (remap[iter] == BLITZ3D_UNUSED_VERTEX) continue;
+
+            memcpy(scratch + (size_t)components * remap[iter],
+                streams[streamIter].data + (size_t)components * iter, components * sizeof(float));
+        }
+
+        memcpy(streams[streamIter].data, scratch, (size_t)components * usedCount * sizeof(float));
+    }
+
+    remapMESHChunkIndices(meshChunk, remap, vertexCount);
+    vrtsChunk->vertexCount = usedCount;
+
+    free(remap);
+    free(scratch);
+}
+
+/* vertex cache ordering */
+
+#define BLITZ3D_FORSYTH_CACHE_SIZE 32
+#define BLITZ3D_FORSYTH_MAX_VALENCE 32
+
+#define BLITZ3D_NO_TRIANGLE 0xFFFFFFFF
+
+/* commentary: Forsyth's greedy ordering. A vertex scores for being recently used (the three of the
+   last triangle score a flat 0.75 so the next one does not have to share an edge) and for having few
+   triangles left, so lone triangles get finished instead of stranded. Each step emits the best
+   triangle touching the simulated LRU cache, and only the scores of the cached vertices change, so a
+   chunk is ordered in time linear in its triangle count. The chunk's vertices are renumbered densely
+   first, so the working arrays are sized by the chunk rather than the whole mesh */
+
+typedef struct Blitz3DForsythState Blitz3DForsythState;
+struct Blitz3DForsythState {
+    float cacheScore[BLITZ3D_FORSYTH_CACHE_SIZE];
+    float valenceScore[BLITZ3D_FORSYTH_MAX_VALENCE + 1];
+
+    unsigned int* localIndices;     /* 3 per triangle, into the chunk's own vertex numbering */
+    unsigned int* liveCounts;       /* triangles not yet emitted, per vertex */
+    unsigned int* adjacencyOffsets;
+    unsigned int* adjacency;        /* the first liveCounts[v] entries after the offset are live */
+    int* cachePositions;
+    float* vertexScores;
+    float* triangleScores;
+    unsigned char* emitted;
+};
+
+float getForsythVertexScore(Blitz3DForsythState* state, unsigned int vertex) {
+    unsigned int liveCount = state->liveCounts[vertex];
+    float output;
+
+    if (liveCount == 0) return -1.0f;
+
+    output = 0.0f;
+    if (state->cachePositions[vertex] >= 0) output = state->cacheScore[state->cachePositions[vertex]];
+
+    if (liveCount > BLITZ3D_FORSYTH_MAX_VALENCE) liveCount = BLITZ3D_FORSYTH_MAX_VALENCE;
+
+    return output + state->valenceScore[liveCount];
+}
+
+void initializeForsythScores(Blitz3DForsythState* state) {
+    unsigned int iter;
+
+    for (iter = 0; iter < BLITZ3D_FORSYTH_CACHE_SIZE; iter++) {
+        if (iter < 3) state->cacheScore[iter] = 0.75f;
+        else state->cacheScore[iter] = (float)pow(1.0 - (double)(iter - 3) / (BLITZ3D_FORSYTH_CACHE_SIZE - 3), 1.5);
+    }
+
+    state->valenceScore[0] = 0.0f;
+
+    for (iter = 1; iter <= BLITZ3D_FORSYTH_MAX_VALENCE; iter++) {
+        state->valenceScore[iter] = (float)(2.0 / sqrt((double)iter));
+    }
+}
+
+/* orders localIndices in place, writing the new triangle order into order */
+
+void orderTrianglesForVertexCache(Blitz3DForsythState* state, unsigned int triangleCount, unsigned int vertexCount,
+    unsigned int* order) {
+
+    unsigned int cache[BLITZ3D_FORSYTH_CACHE_SIZE + 3];
+    unsigned int newCache[BLITZ3D_FORSYTH_CACHE_SIZE + 3];
+    unsigned int cacheCount, newCacheCount, bestTriangle, cursor, emittedCount, iter, corner, slot;
+    float bestScore;
+
+    memset(state->liveCounts, 0, vertexCount * sizeof(unsigned int));
+    for (iter = 0; iter < 3 * triangleCount; iter++) state->liveCounts[state->localIndices[iter]]++;
+
+    state->adjacencyOffsets[0] = 0;
+    for (iter = 0; iter < vertexCount; iter++) {
+        state->adjacencyOffsets[iter + 1] = state->adjacencyOffsets[iter] + state->liveCounts[iter];
+        state->liveCounts[iter] = 0;
+        state->cachePositions[iter] = -1;
+    }
+
+    for (iter = 0; iter < 3 * triangleCount; iter++) {
+        unsigned int vertex = state->localIndices[iter];
+
+        state->adjacency[state->adjacencyOffsets[vertex] + state->liveCounts[vertex]++] = iter / 3;
+    }
+
+    for (iter = 0; iter < vertexCount; iter++) state->vertexScores[iter] = getForsythVertexScore(state, iter);
+
+    bestTriangle = 0;
+    bestScore = -1.0f;
+
+    for (iter = 0; iter < triangleCount; iter++) {
+        const unsigned int* triangle = state->localIndices + 3 * iter;
+
+        state->triangleScores[iter] = state->vertexScores[triangle[0]] + state->vertexScores[triangle[1]]
+            + state->vertexScores[triangle[2]];
+        state->emitted[iter] = 0;
+
+        if (state->triangleScores[iter] > bestScore) {
+            bestScore = state->triangleScores[iter];
+            bestTriangle = iter;
+        }
+    }
+
+    cacheCount = 0;
+    cursor = 0;
+
+    for (emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        const unsigned int* triangle;
+
+        /* nothing in the cache has triangles left, so start over at the first triangle not yet emitted */
+        if (bestTriangle == BLITZ3D_NO_TRIANGLE) {
+            while (state->emitted[cursor]) cursor++;
+            bestTriangle = cursor;
+        }
+
+        triangle = state->localIndices + 3 * bestTriangle;
+        order[emittedCount] = bestTriangle;
+        state->emitted[bestTriangle] = 1;
+
+        newCacheCount = 0;
+
+        for (corner = 0; corner < 3; corner++) {
+            unsigned int vertex = triangle[corner];
+            unsigned int* live = state->adjacency + state->adjacencyOffsets[vertex];
+
+            for (slot = 0; live[slot] != bestTriangle; slot++) ;
+            live[slot] = live[--state->liveCounts[vertex]];
+            live[state->liveCounts[vertex]] = bestTriangle;
+
+            /* a degenerate triangle names a vertex more than once */
+            if (state->cachePositions[vertex] != -2) {
+                state->cachePositions[vertex] = -2;
+                newCache[newCacheCount++] = vertex;
+            }
+        }
+
+        for (iter = 0; iter < cacheCount; iter++) {
+            if (state->cachePositions[cache[iter]] != -2) newCache[newCacheCount++] = cache[iter];
+        }
+
+        for (iter = 0; iter < newCacheCount; iter++) {
+            unsigned int vertex = newCache[iter];
+
+            state->cachePositions[vertex] = iter < BLITZ3D_FORSYTH_CACHE_SIZE ? (int)iter : -1;
+            state->vertexScores[vertex] = getForsythVertexScore(state, vertex);
+        }
+
+        bestTriangle = BLITZ3D_NO_TRIANGLE;
+        bestScore = -1.0f;
+
+        for (iter = 0; iter < newCacheCount; iter++) {
+            unsigned int vertex = newCache[iter];
+            const unsigned int* live = state->adjacency + state->adjacencyOffsets[vertex];
+
+            for (slot = 0; slot < state->liveCounts[vertex]; slot++) {
+                const unsigned int* other = state->localIndices + 3 * live[slot];
+                float score = state->vertexScores[other[0]] + state->vertexScores[other[1]] + state->vertexScores[other[2]];
+
+                state->triangleScores[live[slot]] = score;
+
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = live[slot];
+                }
+            }
+        }
+
+        cacheCount = newCacheCount < BLITZ3D_FORSYTH_CACHE_SIZE ? newCacheCount : BLITZ3D_FORSYTH_CACHE_SIZE;
+        memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+    }
+}
+
+/* commentary: triangles stay in their own TRIS chunk, as each chunk is a separate draw with its own
+   brush; chunks with indices outside the vertex array are left as they are */
+
+void orderTRISChunksForVertexCache(Blitz3DMESHChunk* meshChunk) {
+    Blitz3DForsythState state;
+    unsigned int vertexCount, maxTriangles, trisIter, iter;
+    unsigned int* localVertices;
+    unsigned int* globalVertices;
+    unsigned int* order;
+    int* reordered;
+
+    vertexCount = meshChunk->vrtsChunk->vertexCount;
+    maxTriangles = 0;
+
+    for (trisIter = 0; trisIter < meshChunk->trisChunkCount; trisIter++) {
+        if (meshChunk->trisChunkArray[trisIter]->triangleCount > maxTriangles) {
+            maxTriangles = meshChunk->trisChunkArray[trisIter]->triangleCount;
+        }
+    }
+
+    if (maxTriangles < 2) return;
+
+    initializeForsythScores(&state);
+
+    localVertices = (unsigned int*)malloc(vertexCount * sizeof(unsigned int));
+    globalVertices = (unsigned int*)malloc(3 * (size_t)maxTriangles * sizeof(unsigned int));
+    order = (unsigned int*)malloc(maxTriangles * sizeof(unsigned int));
+    reordered = (int*)malloc(3 * (size_t)maxTriangles * sizeof(int));
+    state.localIndices = (unsigned int*)malloc(3 * (size_t)maxTriangles * sizeof(unsigned int));
+    state.liveCounts = (unsigned int*)malloc(3 * (size_t)maxTriangles * sizeof(unsigned int));
+    state.adjacencyOffsets = (unsigned int*)malloc((3 * (size_t)maxTriangles + 1) * sizeof(unsigned int));
+    state.adjacency = (unsigned int*)malloc(3 * (size_t)maxTriangles * sizeof(unsigned int));
+    state.cachePositions = (int*)malloc(3 * (size_t)maxTriangles * sizeof(int));
+    state.vertexScores = (float*)malloc(3 * (size_t)maxTriangles * sizeof(float));
+    state.triangleScores = (float*)malloc(maxTriangles * sizeof(float));
+    state.emitted = (unsigned char*)malloc(maxTriangles);
+
+    if (localVertices != NULL && globalVertices != NULL && order != NULL && reordered != NULL
+        && state.localIndices != NULL && state.liveCounts != NULL && state.adjacencyOffsets != NULL
+        && state.adjacency != NULL && state.cachePositions != NULL && state.vertexScores != NULL
+        && state.triangleScores != NULL && state.emitted != NULL) {
+
+        for (iter = 0; iter < vertexCount; iter++) localVertices[iter] = BLITZ3D_UNUSED_VERTEX;
+
+        for (trisIter = 0; trisIter < meshChunk->trisChunkCount; trisIter++) {
+            Blitz3DTRISChunk* trisChunk = meshChunk->trisChunkArray[trisIter];
+            unsigned int indexCount = 3 * trisChunk->triangleCount;
+            unsigned int usedCount = 0;
+
+            for (iter = 0; iter < indexCount; iter++) {
+                int index = trisChunk->indexArray[iter];
+
+                if (index < 0 || (unsigned int)index >= vertexCount) break;
+
+                if (localVertices[index] == BLITZ3D_UNUSED_VERTEX) {
+                    localVertices[index] = usedCount;
+                    globalVertices[usedCount++] = (unsigned int)index;
+                }
+
+                state.localIndices[iter] = localVertices[index];
+            }
+
+            if (iter == indexCount && trisChunk->triangleCount > 1) {
+                orderTrianglesForVertexCache(&state, trisChunk->triangleCount, usedCount, order);
+
+                for (iter = 0; iter < trisChunk->triangleCount; iter++) {
+                    memcpy(reordered + 3 * iter, trisChunk->indexArray + 3 * order[iter], 3 * sizeof(int));
+                }
+
+                memcpy(trisChunk->indexArray, reordered, indexCount * sizeof(int));
+            }
+
+            for (iter = 0; iter < usedCount; iter++) localVertices[globalVertices[iter]] = BLITZ3D_UNUSED_VERTEX;
+        }
+    }
+
+    free(localVertices);
+    free(globalVertices);
+    free(order);
+    free(reordered);
+    free(state.localIndices);
+    free(state.liveCounts);
+    free(state.adjacencyOffsets);
+    free(state.adjacency);
+    free(state.cachePositions);
+    free(state.vertexScores);
+    free(state.triangleScores);
+    free(state.emitted);
+}
+
+/* public functions */
+
+size_t optimizeMESHChunk(Blitz3DMESHChunk* meshChunk, int passes) {
+    Blitz3DVRTSChunk* vrtsChunk = getVRTSChunkFromMESHChunk(meshChunk);
+    size_t bytesBefore;
+
+    if (vrtsChunk == NULL) return 0;
+
+    bytesBefore = (size_t)vrtsChunk->vertexCount * getVertexStrideFromVRTSChunk(vrtsChunk);
+
+    if (widenIndicesInMESHChunk(meshChunk) != 0) {
+        narrowIndicesInMESHChunk(meshChunk);
+        return 0;
+    }
+
+    if (passes & (BLITZ3D_PASS_STRIP_NORMALS | BLITZ3D_PASS_STRIP_COLORS)) stripAttributesFromMESHChunk(meshChunk, passes);
+    if (passes & BLITZ3D_PASS_WELD) weldVerticesInMESHChunk(meshChunk, weldEpsilon);
+    if (passes & BLITZ3D_PASS_CLEAN_TRIANGLES) cleanTrianglesInMESHChunk(meshChunk);
+    if (passes & BLITZ3D_PASS_VERTEX_CACHE) orderTRISChunksForVertexCache(meshChunk);
+    if (passes & BLITZ3D_PASS_REORDER) reorderVerticesInMESHChunk(meshChunk);
+
+    narrowIndicesInMESHChunk(meshChunk);
+
+    /* welding and cleaning can change which vertices are referenced */
+    computeBoundsOfMESHChunk(meshChunk);
+
+    return bytesBefore - (size_t)vrtsChunk->vertexCount * getVertexStrideFromVRTSChunk(vrtsChunk);
+}
+
+typedef struct Blitz3DParallelOptimize Blitz3DParallelOptimize;
+struct Blitz3DParallelOptimize {
+    Blitz3DMESHChunk** meshes;
+    size_t* savedBytes;
+    int passes;
+};
+
+void optimizeMeshTask(void* context, unsigned int index, unsigned int workerIndex) {
+    Blitz3DParallelOptimize* optimize = (Blitz3DParallelOptimize*)context;
+
+    (void)workerIndex;
+
+    optimize->savedBytes[index] = optimizeMESHChunk(optimize->meshes[index], optimize->passes);
+}
+
+void collectMESHChunks(Blitz3DNODEChunk* nodeChunk, DynamicArray* meshes) {
+    unsigned int iter;
+
+    /* decoding here keeps the workers away from the index-only reader */
+    if (nodeChunk->meshChunk != NULL && getVRTSChunkFromMESHChunk(nodeChunk->meshChunk) != NULL) {
+        pushPointerOntoDynamicArray(meshes, nodeChunk->meshChunk);
+    }
+
+    for (iter = 0; iter < nodeChunk->nodeChunkCount; iter++) {
+        collectMESHChunks(nodeChunk->nodeChunkArray[iter], meshes);
+    }
+}
+
+size_t optimizeB3DFile(B3DFile* blitz3dFile, int passes) {
+    Blitz3DParallelOptimize optimize;
+    DynamicArray meshes;
+    ThreadPool* threadPool;
+    unsigned int meshCount, iter;
+    size_t output = 0;
+
+    if (blitz3dFile->bb3dChunk->nodeChunk == NULL) return 0;
+
+    initializeDynamicArray(&meshes, sizeof(Blitz3DMESHChunk*), NULL);
+    collectMESHChunks(blitz3dFile->bb3dChunk->nodeChunk, &meshes);
+
+    meshCount = (unsigned int)getDynamicArrayCount(&meshes);
+
+    optimize.meshes = (Blitz3DMESHChunk**)getDataFromDynamicArray(&meshes);
+    optimize.savedBytes = (size_t*)calloc(meshCount + 1, sizeof(size_t));
+    optimize.passes = passes;
+
+    if (optimize.savedBytes != NULL) {
+        if (meshCount > 1 && optimizeThreadCount != 1) {
+            threadPool = createThreadPool(optimizeThreadCount);
+            runParallelForOnThreadPool(threadPool, meshCount, optimizeMeshTask, &optimize);
+            freeThreadPool(threadPool);
+        }
+        else {
+            for (iter = 0; iter < meshCount; iter++) optimizeMeshTask(&optimize, iter, 0);
+        }
+
+        for (iter = 0; iter < meshCount; iter++) output += optimize.savedBytes[iter];
+    }
+
+    free(optimize.savedBytes);
+    freeDynamicArray(&meshes);
+
+    /* every mesh was decoded above, so the node bounds can all be brought up to date */
+    propagateBoundsInNODEChunk(blitz3dFile->bb3dChunk->nodeChunk);
+
+    return output;
+}
+
+void setThreadCountForOptimize(unsigned int threadCount) {
+    optimizeThreadCount = threadCount;
+}
+
+void setWeldEpsilon(float epsilon) {
+    weldEpsilon = epsilon;
+}
+
+/* commentary: a vertex is in the FIFO if it went in fewer than cacheSize misses ago, so the cache is
+   just one stamp per vertex; stamps from before the current TRIS chunk count as empty */
+
+void getVertexCacheStatisticsFromMESHChunk(Blitz3DMESHChunk* meshChunk, unsigned int cacheSize, double* acmr, double* atvr) {
+    Blitz3DVRTSChunk* vrtsChunk = getVRTSChunkFromMESHChunk(meshChunk);
+    unsigned int vertexCount, trisIter, iter;
+    size_t misses, triangles, usedVertices, clock, chunkStart;
+    size_t* stamps;
+
+    *acmr = 0.0;
+    *atvr = 0.0;
+
+    if (vrtsChunk == NULL || vrtsChunk->vertexCount == 0 || cacheSize == 0) return;
+
+    vertexCount = vrtsChunk->vertexCount;
+    stamps = (size_t*)calloc(vertexCount, sizeof(size_t));
+    if (stamps == NULL) return;
+
+    misses = 0;
+    triangles = 0;
+    usedVertices = 0;
+    clock = 0;
+
+    for (trisIter = 0; trisIter < meshChunk->trisChunkCount; trisIter++) {
+        Blitz3DTRISChunk* trisChunk = meshChunk->trisChunkArray[trisIter];
+
+        chunkStart = clock;
+
+        for (iter = 0; iter < 3 * trisChunk->triangleCount; iter++) {
+            unsigned int index = getIndexFromTRISChunk(trisChunk, iter);
+
+            if (index >= vertexCount) continue;
+            if (stamps[index] > chunkStart && clock - stamps[index] < cacheSize) continue;
+
+            if (stamps[index] == 0) usedVertices++;
+
+            stamps[index] = ++clock;
+            misses++;
+        }
+
+        triangles += trisChunk->triangleCount;
+    }
+
+    free(stamps);
+
+    if (triangles > 0) *acmr = (double)misses / (double)triangles;
+    if (usedVertices > 0) *atvr = (double)misses / (double)usedVertices;
+}
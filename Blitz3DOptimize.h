@@ -0,0 +1,56 @@
+#ifndef _BLITZ3DOPTIMIZE_H_
+#define _BLITZ3DOPTIMIZE_H_
+
+#include "Blitz3DFile.h"
+
+/* commentary: optimization passes over loaded meshes, run in place. They are meant for levels that
+   are about to be saved again (see saveB3DFile) but work on any loaded file. For index-only files a
+   pass decodes the mesh first, and the result is lost if the mesh is evicted afterwards */
+
+/* merge vertices that are bit-identical in every attribute, or within the weld epsilon if one is set */
+#define BLITZ3D_PASS_WELD 1
+
+/* renumber vertices in the order the triangles first use them, dropping unused ones */
+#define BLITZ3D_PASS_REORDER 2
+
+/* drop the normal or color attribute, which the lightmap viewer does not use */
+#define BLITZ3D_PASS_STRIP_NORMALS 4
+#define BLITZ3D_PASS_STRIP_COLORS 8
+
+/* reorder the triangles of each TRIS chunk for the post-transform vertex cache (Forsyth's method);
+   best combined with BLITZ3D_PASS_REORDER, which then lays the vertices out in the new order */
+#define BLITZ3D_PASS_VERTEX_CACHE 16
+
+/* drop triangles with zero area or that repeat an earlier triangle of the same TRIS chunk */
+#define BLITZ3D_PASS_CLEAN_TRIANGLES 32
+
+#define BLITZ3D_PASS_ALL (BLITZ3D_PASS_WELD | BLITZ3D_PASS_REORDER | BLITZ3D_PASS_STRIP_NORMALS \
+    | BLITZ3D_PASS_STRIP_COLORS | BLITZ3D_PASS_VERTEX_CACHE | BLITZ3D_PASS_CLEAN_TRIANGLES)
+
+/* the passes run in this order: stripping, welding, triangle cleaning, vertex cache ordering, reordering.
+   The mesh's bounds are recomputed, but not its node's (see updateBoundsInB3DFile).
+   returns the bytes of vertex data they freed up */
+size_t optimizeMESHChunk(Blitz3DMESHChunk* meshChunk, int passes);
+
+/* commentary: meshes are optimized in parallel, one per task; index-only meshes are decoded up front on
+   the calling thread, since decoding is not thread-safe */
+
+size_t optimizeB3DFile(B3DFile* blitz3dFile, int passes);
+
+/* 0 (the default) uses one thread per processor, 1 optimizes on the calling thread alone */
+void setThreadCountForOptimize(unsigned int threadCount);
+
+/* commentary: with an epsilon above 0, welding snaps every attribute component to a grid of that
+   spacing and merges vertices that land in the same cell, keeping the first one's values. Two
+   values closer than epsilon can still straddle a cell boundary and stay apart; that is the price
+   of staying linear. The default of 0 welds bit-identical vertices only */
+
+void setWeldEpsilon(float epsilon);
+
+/* commentary: simulates a FIFO post-transform cache of cacheSize entries, emptied before each TRIS chunk
+   as it is a draw call of its own. ACMR is cache misses per triangle (0.5 at best for a large grid,
+   3 at worst) and ATVR is cache misses per distinct vertex used (1 at best) */
+
+void getVertexCacheStatisticsFromMESHChunk(Blitz3DMESHChunk* meshChunk, unsigned int cacheSize, double* acmr, double* atvr);
+
+#endif
@@ -0,0 +1,952 @@
+#include "Blitz3DPVS.h"
+#include "Blitz3DFileInternal.h"
+#include "ThreadPool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Blitz3D potentially visible sets */
+
+#define BLITZ3D_PVS_MAGIC 0x53565042
+#define BLITZ3D_PVS_VERSION 1
+
+#define BLITZ3D_PVS_DEFAULT_CELLS 32
+#define BLITZ3D_PVS_DEFAULT_SAMPLES 8
+#define BLITZ3D_PVS_DEFAULT_RAYS 256
+
+/* a leaf of the triangle tree holds at most this many triangles */
+#define BLITZ3D_PVS_LEAF_SIZE 4
+
+/* a tree split at the median is never deeper than this for anything that fits in memory */
+#define BLITZ3D_PVS_STACK_SIZE 64
+
+/* the angle between neighbouring points of a Fibonacci spiral, pi * (3 - sqrt(5)) */
+#define BLITZ3D_PVS_GOLDEN_ANGLE 2.39996322972865332f
+
+#define BLITZ3D_PVS_CHECK_SEED 12345u
+
+/* file layout: the header, a set index per cell (x fastest), then the distinct sets; 64-bit fields
+   first so the layout does not depend on the compiler's packing */
+
+typedef struct Blitz3DPVSHeader Blitz3DPVSHeader;
+struct Blitz3DPVSHeader {
+    uint64_t fingerprint;
+    uint64_t totalSize;
+
+    uint32_t magic;
+    uint32_t version;
+
+    uint32_t rangeCount;
+    uint32_t wordCount;
+    uint32_t cellCounts[3];
+    uint32_t setCount;
+
+    float origin[3];
+    float cellSize;
+};
+
+struct Blitz3DPVS {
+    float origin[3];
+    float cellSize;
+    unsigned int cellCounts[3];
+    unsigned int cellCount;
+
+    unsigned int rangeCount, wordCount;
+    uint64_t fingerprint;
+
+    /* cell c sees the ranges of set cellSetArray[c]; set s is the wordCount words from setArray + s * wordCount */
+    unsigned int setCount;
+    uint32_t* cellSetArray;
+    uint64_t* setArray;
+    unsigned int* setVisibleCountArray;
+
+    /* set when loaded, in which case the two arrays above point into it */
+    MappedFile* mappedFile;
+};
+
+/* commentary: the rays need a triangle of their own per hit, so they get a tree over the triangles,
+   built the way the BVH's is */
+
+typedef struct Blitz3DPVSTree Blitz3DPVSTree;
+struct Blitz3DPVSTree {
+    /* in node order: three corners (9 floats) and the range, numbered across the set, per triangle */
+    unsigned int triangleCount;
+    float* cornerArray;
+    unsigned int* rangeArray;
+
+    unsigned int nodeCount;
+    Blitz3DTreeNode* nodeArray;
+
+    unsigned int rangeCount;
+};
+
+typedef struct Blitz3DPVSBuild Blitz3DPVSBuild;
+struct Blitz3DPVSBuild {
+    Blitz3DPVS* pvs;
+    Blitz3DPVSTree* tree;
+    unsigned int samplesPerCell, raysPerSample;
+
+    /* samplesPerCell * raysPerSample directions spread evenly over the sphere; sample k casts every
+       samplesPerCell-th one from k on, so each sample covers the whole sphere and the cell's samples
+       between them cover it densely */
+    float* directionArray;
+
+    /* a set per cell: what its own rays hit and the ranges that touch it, then with its neighbours' added */
+    uint64_t* sampledSetArray;
+    uint64_t* setArray;
+};
+
+void initializeBlitz3DPVSSettings(Blitz3DPVSSettings* settings) {
+    settings->cellsOnLongestAxis = BLITZ3D_PVS_DEFAULT_CELLS;
+    settings->samplesPerCell = BLITZ3D_PVS_DEFAULT_SAMPLES;
+    settings->raysPerSample = BLITZ3D_PVS_DEFAULT_RAYS;
+    settings->threadCount = 0;
+}
+
+/* the triangle tree */
+
+/* returns the number of triangles found; with corners set, also copies them out with their boxes,
+   centers and ranges */
+
+unsigned int collectPVSTriangles(Blitz3DBatchSet* batchSet, float* corners, float* boxes, float* centers,
+    unsigned int* ranges) {
+    unsigned int batchIndex, rangeIndex, iter, corner, axis, rangeNumber = 0, output = 0;
+
+    for (batchIndex = 0; batchIndex < getBatchArrayCountFromBatchSet(batchSet); batchIndex++) {
+        Blitz3DBatch* batch = getBatchArrayEntryFromBatchSet(batchSet, batchIndex);
+        const float* vertices = getVertexArrayFromBatch(batch);
+        const unsigned int* indices = getIndexArrayFromBatch(batch);
+        const uint16_t* shortIndices = getShortIndexArrayFromBatch(batch);
+        int shortIndexed = (getIndexSizeFromBatch(batch) == 2);
+
+        for (rangeIndex = 0; rangeIndex < getRangeArrayCountFromBatch(batch); rangeIndex++, rangeNumber++) {
+            Blitz3DBatchRange* range = getRangeArrayEntryFromBatch(batch, rangeIndex);
+            unsigned int firstIndex = getFirstIndexFromBatchRange(range);
+            unsigned int triangleCount = getIndexCountFromBatchRange(range) / 3;
+
+            if (corners == NULL) {
+                output += triangleCount;
+                continue;
+            }
+
+            for (iter = 0; iter < triangleCount; iter++, output++) {
+                float* triangle = corners + 9 * (size_t)output;
+
+                for (corner = 0; corner < 3; corner++) {
+                    size_t index = firstIndex + 3 * (size_t)iter + corner;
+                    size_t vertex = shortIndexed ? shortIndices[index] : indices[index];
+
+                    memcpy(triangle + 3 * corner, vertices + 3 * vertex, 3 * sizeof(float));
+                }
+
+                for (axis = 0; axis < 3; axis++) {
+                    float* box = boxes + 6 * (size_t)output;
+
+                    box[axis] = box[3 + axis] = triangle[axis];
+
+                    for (corner = 1; corner < 3; corner++) {
+                        if (triangle[3 * corner + axis] < box[axis]) box[axis] = triangle[3 * corner + axis];
+                        if (triangle[3 * corner + axis] > box[3 + axis]) box[3 + axis] = triangle[3 * corner + axis];
+                    }
+
+                    centers[3 * (size_t)output + axis] = (triangle[axis] + triangle[3 + axis] + triangle[6 + axis]) / 3.0f;
+                }
+
+                ranges[output] = rangeNumber;
+            }
+        }
+    }
+
+    return output;
+}
+
+void freePVSTree(Blitz3DPVSTree* tree) {
+    free(tree->cornerArray);
+    free(tree->rangeArray);
+    free(tree->nodeArray);
+    free(tree);
+}
+
+/* returns NULL if the batch set has no triangles or out of memory */
+
+Blitz3DPVSTree* createPVSTreeFromBatchSet(Blitz3DBatchSet* batchSet) {
+    Blitz3DPVSTree* output;
+    float *corners, *boxes, *centers;
+    unsigned int *ranges, *order;
+    unsigned int batchIndex, iter;
+    int failed = 0;
+
+    output = (Blitz3DPVSTree*)calloc(1, sizeof(Blitz3DPVSTree));
+    if (output == NULL) return NULL;
+
+    for (batchIndex = 0; batchIndex < getBatchArrayCountFromBatchSet(batchSet); batchIndex++) {
+        output->rangeCount += getRangeArrayCountFromBatch(getBatchArrayEntryFromBatchSet(batchSet, batchIndex));
+    }
+
+    output->triangleCount = collectPVSTriangles(batchSet, NULL, NULL, NULL, NULL);
+
+    if (output->triangleCount == 0) {
+        freePVSTree(output);
+        return NULL;
+    }
+
+    corners = (float*)malloc(9 * (size_t)output->triangleCount * sizeof(float));
+    boxes = (float*)malloc(6 * (size_t)output->triangleCount * sizeof(float));
+    centers = (float*)malloc(3 * (size_t)output->triangleCount * sizeof(float));
+    ranges = (unsigned int*)malloc(output->triangleCount * sizeof(unsigned int));
+    order = (unsigned int*)malloc(output->triangleCount * sizeof(unsigned int));
+
+    output->nodeArray = (Blitz3DTreeNode*)malloc((2 * (size_t)output->triangleCount - 1) * sizeof(Blitz3DTreeNode));
+    output->cornerArray = (float*)malloc(9 * (size_t)output->triangleCount * sizeof(float));
+    output->rangeArray = (unsigned int*)malloc(output->triangleCount * sizeof(unsigned int));
+
+    if (corners == NULL || boxes == NULL || centers == NULL || ranges == NULL || order == NULL) failed = 1;
+    if (output->nodeArray == NULL || output->cornerArray == NULL || output->rangeArray == NULL) failed = 1;
+
+    if (!failed) {
+        collectPVSTriangles(batchSet, corners, boxes, centers, ranges);
+
+        output->nodeCount = buildMedianSplitTree(output->nodeArray, boxes, centers, order, output->triangleCount,
+            BLITZ3D_PVS_LEAF_SIZE);
+
+        for (iter = 0; iter < output->triangleCount; iter++) {
+            memcpy(output->cornerArray + 9 * (size_t)iter, corners + 9 * (size_t)order[iter], 9 * sizeof(float));
+            output->rangeArray[iter] = ranges[order[iter]];
+        }
+    }
+
+    free(corners);
+    free(boxes);
+    free(centers);
+    free(ranges);
+    free(order);
+
+    if (failed) {
+        freePVSTree(output);
+        return NULL;
+    }
+
+    return output;
+}
+
+/* ray casting */
+
+/* returns the distance along the ray (Moller and Trumbore), or a negative value for a miss; both
+   sides of a triangle count, as a wall seen from behind still hides what is beyond it */
+
+float intersectRayWithTriangle(const float* origin, const float* direction, const float* corners) {
+    float firstEdge[3], secondEdge[3], offset[3], normal[3], cross[3];
+    float determinant, inverse, u, v;
+    unsigned int axis;
+
+    for (axis = 0; axis < 3; axis++) {
+        firstEdge[axis] = corners[3 + axis] - corners[axis];
+        secondEdge[axis] = corners[6 + axis] - corners[axis];
+        offset[axis] = origin[axis] - corners[axis];
+    }
+
+    normal[0] = direction[1] * secondEdge[2] - direction[2] * secondEdge[1];
+    normal[1] = direction[2] * secondEdge[0] - direction[0] * secondEdge[2];
+    normal[2] = direction[0] * secondEdge[1] - direction[1] * secondEdge[0];
+
+    determinant = firstEdge[0] * normal[0] + firstEdge[1] * normal[1] + firstEdge[2] * normal[2];
+    if (determinant == 0.0f) return -1.0f;
+
+    inverse = 1.0f / determinant;
+
+    u = (offset[0] * normal[0] + offset[1] * normal[1] + offset[2] * normal[2]) * inverse;
+    if (u < 0.0f || u > 1.0f) return -1.0f;
+
+    cross[0] = offset[1] * firstEdge[2] - offset[2] * firstEdge[1];
+    cross[1] = offset[2] * firstEdge[0] - offset[0] * firstEdge[2];
+    cross[2] = offset[0] * firstEdge[1] - offset[1] * firstEdge[0];
+
+    v = (direction[0] * cross[0] + direction[1] * cross[1] + direction[2] * cross[2]) * inverse;
+    if (v < 0.0f || u + v > 1.0f) return -1.0f;
+
+    return (secondEdge[0] * cross[0] + secondEdge[1] * cross[1] + secondEdge[2] * cross[2]) * inverse;
+}
+
+/* the slab test, for a ray that has not hit anything nearer than limit yet */
+
+int rayHitsBox(const float* origin, const float* inverseDirection, const float* minimum, const float* maximum,
+    float limit) {
+    float entry = 0.0f, exit = limit;
+    unsigned int axis;
+
+    for (axis = 0; axis < 3; axis++) {
+        float nearDistance = (minimum[axis] - origin[axis]) * inverseDirection[axis];
+        float farDistance = (maximum[axis] - origin[axis]) * inverseDirection[axis];
+
+        if (nearDistance > farDistance) {
+            float swap = nearDistance;
+
+            nearDistance = farDistance;
+            farDistance = swap;
+        }
+
+        if (nearDistance > entry) entry = nearDistance;
+        if (farDistance < exit) exit = farDistance;
+    }
+
+    return entry <= exit;
+}
+
+/* returns the range of the first triangle the ray hits, or -1 if it hits none. Children are visited
+   nearest first along their split axis, so the first hit found tends to be the final one and prunes
+   the rest of the tree */
+
+int castRayInPVSTree(const Blitz3DPVSTree* tree, const float* origin, const float* direction) {
+    unsigned int stack[BLITZ3D_PVS_STACK_SIZE];
+    unsigned int stackSize = 0, iter, axis;
+    float inverseDirection[3], nearest = (float)HUGE_VAL;
+    int output = -1;
+
+    /* a huge finite value stands in for 1 / 0, so the slab test never multiplies 0 by infinity */
+
+    for (axis = 0; axis < 3; axis++) {
+        if (fabs(direction[axis]) > 1e-30) inverseDirection[axis] = 1.0f / direction[axis];
+        else inverseDirection[axis] = (direction[axis] < 0.0f) ? -1e30f : 1e30f;
+    }
+
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        unsigned int node = stack[--stackSize];
+        const Blitz3DTreeNode* current = &(tree->nodeArray[node]);
+
+        if (!rayHitsBox(origin, inverseDirection, current->minimum, current->maximum, nearest)) continue;
+
+        if (current->axis < 0) {
+            for (iter = current->firstItem; iter < current->firstItem + current->itemCount; iter++) {
+                float distance = intersectRayWithTriangle(origin, direction, tree->cornerArray + 9 * (size_t)iter);
+
+                if (distance > 0.0f && distance < nearest) {
+                    nearest = distance;
+                    output = (int)tree->rangeArray[iter];
+                }
+            }
+        }
+        else {
+            unsigned int first = node + 1, second = tree->nodeArray[node + 1].end;
+
+            if (direction[current->axis] < 0.0f) {
+                stack[stackSize++] = first;
+                stack[stackSize++] = second;
+            } else {
+                stack[stackSize++] = second;
+                stack[stackSize++] = first;
+            }
+        }
+    }
+
+    return output;
+}
+
+/* building */
+
+/* the Halton sequence in the given base: points that fill the cell evenly however many are taken */
+
+float getRadicalInverse(unsigned int index, unsigned int base) {
+    float output = 0.0f, fraction = 1.0f / base;
+
+    while (index > 0) {
+        output += fraction * (index % base);
+        index /= base;
+        fraction /= base;
+    }
+
+    return output;
+}
+
+void getSphereDirections(float* directions, unsigned int count) {
+    unsigned int iter;
+
+    for (iter = 0; iter < count; iter++) {
+        float z = 1.0f - (2.0f * iter + 1.0f) / count;
+        float radius = (float)sqrt(1.0f - z * z);
+        float angle = BLITZ3D_PVS_GOLDEN_ANGLE * iter;
+
+        directions[3 * (size_t)iter] = radius * (float)cos(angle);
+        directions[3 * (size_t)iter + 1] = radius * (float)sin(angle);
+        directions[3 * (size_t)iter + 2] = z;
+    }
+}
+
+void getCellCoordinatesFromPVS(Blitz3DPVS* pvs, unsigned int cellIndex, unsigned int* cell) {
+    cell[0] = cellIndex % pvs->cellCounts[0];
+    cell[1] = (cellIndex / pvs->cellCounts[0]) % pvs->cellCounts[1];
+    cell[2] = cellIndex / (pvs->cellCounts[0] * pvs->cellCounts[1]);
+}
+
+void samplePVSCellTask(void* context, unsigned int index, unsigned int workerIndex) {
+    static const unsigned int bases[3] = { 2, 3, 5 };
+    Blitz3DPVSBuild* build = (Blitz3DPVSBuild*)context;
+    Blitz3DPVS* pvs = build->pvs;
+    uint64_t* set = build->sampledSetArray + (size_t)index * pvs->wordCount;
+    unsigned int cell[3], sample, ray, axis;
+    float origin[3];
+
+    (void)workerIndex;
+
+    getCellCoordinatesFromPVS(pvs, index, cell);
+
+    for (sample = 0; sample < build->samplesPerCell; sample++) {
+        for (axis = 0; axis < 3; axis++) {
+            origin[axis] = pvs->origin[axis] + (cell[axis] + getRadicalInverse(sample + 1, bases[axis])) * pvs->cellSize;
+        }
+
+        for (ray = 0; ray < build->raysPerSample; ray++) {
+            const float* direction = build->directionArray + 3 * ((size_t)ray * build->samplesPerCell + sample);
+            int range = castRayInPVSTree(build->tree, origin, direction);
+
+            if (range >= 0) set[range / 64] |= (uint64_t)1 << (range % 64);
+        }
+    }
+}
+
+/* the cells the box touches, clamped to the grid */
+
+void getCellSpanFromPVS(Blitz3DPVS* pvs, const float* minimum, const float* maximum, unsigned int* first,
+    unsigned int* last) {
+    unsigned int axis;
+
+    for (axis = 0; axis < 3; axis++) {
+        double low = floor((minimum[axis] - pvs->origin[axis]) / pvs->cellSize);
+        double high = floor((maximum[axis] - pvs->origin[axis]) / pvs->cellSize);
+        double top = pvs->cellCounts[axis] - 1.0;
+
+        first[axis] = (unsigned int)((low < 0.0) ? 0.0 : (low > top) ? top : low);
+        last[axis] = (unsigned int)((high < 0.0) ? 0.0 : (high > top) ? top : high);
+    }
+}
+
+/* commentary: a range right next to the camera can slip between the rays, so every range is in the
+   sets of the cells its box touches whatever the rays found */
+
+void addTouchingRangesToPVS(Blitz3DPVSBuild* build, Blitz3DBatchSet* batchSet) {
+    Blitz3DPVS* pvs = build->pvs;
+    unsigned int batchIndex, rangeIndex, rangeNumber = 0;
+    unsigned int first[3], last[3], x, y, z;
+
+    for (batchIndex = 0; batchIndex < getBatchArrayCountFromBatchSet(batchSet); batchIndex++) {
+        Blitz3DBatch* batch = getBatchArrayEntryFromBatchSet(batchSet, batchIndex);
+
+        for (rangeIndex = 0; rangeIndex < getRangeArrayCountFromBatch(batch); rangeIndex++, rangeNumber++) {
+            Blitz3DBatchRange* range = getRangeArrayEntryFromBatch(batch, rangeIndex);
+            Blitz3DBounds* bounds = getBoundsFromBatchRange(range);
+            uint64_t bit = (uint64_t)1 << (rangeNumber % 64);
+
+            if (getIndexCountFromBatchRange(range) == 0 || !bounds->present) continue;
+
+            getCellSpanFromPVS(pvs, bounds->minimum, bounds->maximum, first, last);
+
+            for (z = first[2]; z <= last[2]; z++) {
+                for (y = first[1]; y <= last[1]; y++) {
+                    for (x = first[0]; x <= last[0]; x++) {
+                        size_t cellIndex = ((size_t)z * pvs->cellCounts[1] + y) * pvs->cellCounts[0] + x;
+
+                        build->sampledSetArray[cellIndex * pvs->wordCount + rangeNumber / 64] |= bit;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* commentary: the camera can stand anywhere in a cell, including right at its edge where the next
+   cell's view begins, and a cell's samples can all miss a gap its neighbour's catch, so each cell
+   takes its six neighbours' sets as well */
+
+void gatherPVSNeighboursTask(void* context, unsigned int index, unsigned int workerIndex) {
+    Blitz3DPVSBuild* build = (Blitz3DPVSBuild*)context;
+    Blitz3DPVS* pvs = build->pvs;
+    uint64_t* set = build->setArray + (size_t)index * pvs->wordCount;
+    unsigned int cell[3], axis, side, word;
+    size_t stride = 1;
+
+    (void)workerIndex;
+
+    getCellCoordinatesFromPVS(pvs, index, cell);
+
+    memcpy(set, build->sampledSetArray + (size_t)index * pvs->wordCount, pvs->wordCount * sizeof(uint64_t));
+
+    for (axis = 0; axis < 3; axis++) {
+        for (side = 0; side < 2; side++) {
+            const uint64_t* neighbour;
+
+            if (side == 0 && cell[axis] == 0) continue;
+            if (side == 1 && cell[axis] + 1 == pvs->cellCounts[axis]) continue;
+
+            neighbour = build->sampledSetArray + (side == 0 ? index - stride : index + stride) * pvs->wordCount;
+
+            for (word = 0; word < pvs->wordCount; word++) set[word] |= neighbour[word];
+        }
+
+        stride *= pvs->cellCounts[axis];
+    }
+}
+
+/* commentary: neighbouring cells in the same room tend to end up with the same set, so the sets are
+   hashed and each distinct one is kept once. The sets are moved down over the array in place, since a
+   set never moves to a slot after its own */
+
+int shareIdenticalSetsInPVS(Blitz3DPVS* pvs, uint64_t* sets) {
+    unsigned int* table;
+    unsigned int tableSize = 1, cellIndex;
+    size_t setBytes = pvs->wordCount * sizeof(uint64_t);
+
+    while (tableSize < 2 * pvs->cellCount) tableSize *= 2;
+
+    /* slots hold a set index plus one, 0 for empty */
+    table = (unsigned int*)calloc(tableSize, sizeof(unsigned int));
+    pvs->cellSetArray = (uint32_t*)malloc(pvs->cellCount * sizeof(uint32_t));
+
+    if (table == NULL || pvs->cellSetArray == NULL) {
+        free(table);
+        return -1;
+    }
+
+    pvs->setCount = 0;
+
+    for (cellIndex = 0; cellIndex < pvs->cellCount; cellIndex++) {
+        const uint64_t* set = sets + (size_t)cellIndex * pvs->wordCount;
+        unsigned int slot = (unsigned int)hashBlitz3DSource((const unsigned char*)set, setBytes) & (tableSize - 1);
+
+        while (table[slot] != 0 && memcmp(sets + (size_t)(table[slot] - 1) * pvs->wordCount, set, setBytes) != 0) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+
+        if (table[slot] == 0) {
+            if (pvs->setCount != cellIndex) memcpy(sets + (size_t)pvs->setCount * pvs->wordCount, set, setBytes);
+
+            table[slot] = ++pvs->setCount;
+        }
+
+        pvs->cellSetArray[cellIndex] = table[slot] - 1;
+    }
+
+    free(table);
+
+    return 0;
+}
+
+int countVisibleRangesInPVS(Blitz3DPVS* pvs) {
+    unsigned int setIndex, word;
+
+    pvs->setVisibleCountArray = (unsigned int*)calloc(pvs->setCount + 1, sizeof(unsigned int));
+    if (pvs->setVisibleCountArray == NULL) return -1;
+
+    for (setIndex = 0; setIndex < pvs->setCount; setIndex++) {
+        const uint64_t* set = pvs->setArray + (size_t)setIndex * pvs->wordCount;
+
+        for (word = 0; word < pvs->wordCount; word++) pvs->setVisibleCountArray[setIndex] += countBitsInWord(set[word]);
+    }
+
+    return 0;
+}
+
+/* commentary: the fingerprint covers what the sets are numbered by and worked out from: every range's
+   place in its batch's index array and its bounds. A level edited since its PVS was built moves at
+   least one of them */
+
+int getFingerprintFromBatchSet(Blitz3DBatchSet* batchSet, uint64_t* fingerprint, unsigned int* rangeCount) {
+    uint32_t* values;
+    unsigned int batchIndex, rangeIndex, count = 0;
+    size_t valueCount = 0;
+
+    for (batchIndex = 0; batchIndex < getBatchArrayCountFromBatchSet(batchSet); batchIndex++) {
+        count += getRangeArrayCountFromBatch(getBatchArrayEntryFromBatchSet(batchSet, batchIndex));
+    }
+
+    values = (uint32_t*)malloc((2 * (size_t)getBatchArrayCountFromBatchSet(batchSet) + 9 * (size_t)count + 1)
+        * sizeof(uint32_t));
+    if (values == NULL) return -1;
+
+    for (batchIndex = 0; batchIndex < getBatchArrayCountFromBatchSet(batchSet); batchIndex++) {
+        Blitz3DBatch* batch = getBatchArrayEntryFromBatchSet(batchSet, batchIndex);
+
+        values[valueCount++] = (uint32_t)getBrushIdFromBatch(batch);
+        values[valueCount++] = getRangeArrayCountFromBatch(batch);
+
+        for (rangeIndex = 0; rangeIndex < getRangeArrayCountFromBatch(batch); rangeIndex++) {
+            Blitz3DBatchRange* range = getRangeArrayEntryFromBatch(batch, rangeIndex);
+            Blitz3DBounds* bounds = getBoundsFromBatchRange(range);
+
+            values[valueCount++] = getFirstIndexFromBatchRange(range);
+            values[valueCount++] = getIndexCountFromBatchRange(range);
+            values[valueCount++] = (uint32_t)bounds->present;
+            memcpy(values + valueCount, bounds->minimum, 3 * sizeof(float));
+            memcpy(values + valueCount + 3, bounds->maximum, 3 * sizeof(float));
+            valueCount += 6;
+        }
+    }
+
+    *fingerprint = hashBlitz3DSource((const unsigned char*)values, valueCount * sizeof(uint32_t));
+    *rangeCount = count;
+
+    free(values);
+
+    return 0;
+}
+
+/* the grid covers the box around every triangle, in cubes cut to fit the longest side */
+
+void setGridOfPVS(Blitz3DPVS* pvs, const Blitz3DTreeNode* root, unsigned int cellsOnLongestAxis) {
+    float longest = 0.0f;
+    unsigned int axis;
+
+    if (cellsOnLongestAxis == 0) cellsOnLongestAxis = 1;
+
+    for (axis = 0; axis < 3; axis++) {
+        if (root->maximum[axis] - root->minimum[axis] > longest) longest = root->maximum[axis] - root->minimum[axis];
+    }
+
+    pvs->cellSize = (longest > 0.0f) ? longest / cellsOnLongestAxis : 1.0f;
+    pvs->cellCount = 1;
+
+    for (axis = 0; axis < 3; axis++) {
+        double cells = ceil((root->maximum[axis] - root->minimum[axis]) / pvs->cellSize);
+
+        pvs->origin[axis] = root->minimum[axis];
+        pvs->cellCounts[axis] = (cells < 1.0) ? 1 : (cells > cellsOnLongestAxis) ? cellsOnLongestAxis : (unsigned int)cells;
+        pvs->cellCount *= pvs->cellCounts[axis];
+    }
+}
+
+Blitz3DPVS* buildPVSFromBatchSet(Blitz3DBatchSet* batchSet, const Blitz3DPVSSettings* settings) {
+    Blitz3DPVSBuild build;
+    Blitz3DPVS* output;
+    ThreadPool* threadPool;
+    unsigned int iter;
+    size_t setWords;
+    int failed = 0;
+
+    output = (Blitz3DPVS*)calloc(1, sizeof(Blitz3DPVS));
+    if (output == NULL) return NULL;
+
+    memset(&build, 0, sizeof(build));
+    build.pvs = output;
+    build.samplesPerCell = (settings->samplesPerCell > 0) ? settings->samplesPerCell : 1;
+    build.raysPerSample = (settings->raysPerSample > 0) ? settings->raysPerSample : 1;
+    build.tree = createPVSTreeFromBatchSet(batchSet);
+
+    if (build.tree == NULL || getFingerprintFromBatchSet(batchSet, &output->fingerprint, &output->rangeCount) != 0) {
+        if (build.tree != NULL) freePVSTree(build.tree);
+        free(output);
+        return NULL;
+    }
+
+    output->wordCount = (output->rangeCount + 63) / 64;
+    setGridOfPVS(output, &(build.tree->nodeArray[0]), settings->cellsOnLongestAxis);
+
+    setWords = (size_t)output->cellCount * output->wordCount;
+
+    build.directionArray = (float*)malloc(3 * (size_t)build.samplesPerCell * build.raysPerSample * sizeof(float));
+    build.sampledSetArray = (uint64_t*)calloc(setWords + 1, sizeof(uint64_t));
+    build.setArray = (uint64_t*)malloc((setWords + 1) * sizeof(uint64_t));
+
+    if (build.directionArray == NULL || build.sampledSetArray == NULL || build.setArray == NULL) failed = 1;
+
+    if (!failed) {
+        getSphereDirections(build.directionArray, build.samplesPerCell * build.raysPerSample);
+
+        if (output->cellCount > 1 && settings->threadCount != 1) {
+            threadPool = createThreadPool(settings->threadCount);
+            runParallelForOnThreadPool(threadPool, output->cellCount, samplePVSCellTask, &build);
+            addTouchingRangesToPVS(&build, batchSet);
+            runParallelForOnThreadPool(threadPool, output->cellCount, gatherPVSNeighboursTask, &build);
+            freeThreadPool(threadPool);
+        }
+        else {
+            for (iter = 0; iter < output->cellCount; iter++) samplePVSCellTask(&build, iter, 0);
+            addTouchingRangesToPVS(&build, batchSet);
+            for (iter = 0; iter < output->cellCount; iter++) gatherPVSNeighboursTask(&build, iter, 0);
+        }
+
+        failed = (shareIdenticalSetsInPVS(output, build.setArray) != 0);
+    }
+
+    if (!failed) {
+        /* only the distinct sets are kept; a failed shrink leaves the array as it was */
+        output->setArray = (uint64_t*)realloc(build.setArray,
+            ((size_t)output->setCount * output->wordCount + 1) * sizeof(uint64_t));
+        if (output->setArray == NULL) output->setArray = build.setArray;
+
+        build.setArray = NULL;
+        failed = (countVisibleRangesInPVS(output) != 0);
+    }
+
+    free(build.directionArray);
+    free(build.sampledSetArray);
+    free(build.setArray);
+    freePVSTree(build.tree);
+
+    if (failed) {
+        freePVS(output);
+        return NULL;
+    }
+
+    return output;
+}
+
+void freePVS(Blitz3DPVS* pvs) {
+    if (pvs->mappedFile != NULL) {
+        closeMappedFile(pvs->mappedFile);
+    }
+    else {
+        free(pvs->cellSetArray);
+        free(pvs->setArray);
+    }
+
+    free(pvs->setVisibleCountArray);
+    free(pvs);
+}
+
+/* files */
+
+size_t getSetOffsetInPVSFile(unsigned int cellCount) {
+    size_t offset = sizeof(Blitz3DPVSHeader) + (size_t)cellCount * sizeof(uint32_t);
+
+    return (offset + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
+
+/* commentary: written under a temporary name and renamed into place, as the cache is */
+
+int savePVS(Blitz3DPVS* pvs, const char* filePath) {
+    Blitz3DPVSHeader header;
+    FILE* fp;
+    char* temporaryPath;
+    static const char padding[sizeof(uint64_t)] = { 0 };
+    size_t setOffset = getSetOffsetInPVSFile(pvs->cellCount);
+    size_t setBytes = (size_t)pvs->setCount * pvs->wordCount * sizeof(uint64_t);
+    size_t paddingBytes = setOffset - sizeof(header) - (size_t)pvs->cellCount * sizeof(uint32_t);
+    int result = 0;
+
+    memset(&header, 0, sizeof(header));
+    header.fingerprint = pvs->fingerprint;
+    header.totalSize = setOffset + setBytes;
+    header.magic = BLITZ3D_PVS_MAGIC;
+    header.version = BLITZ3D_PVS_VERSION;
+    header.rangeCount = pvs->rangeCount;
+    header.wordCount = pvs->wordCount;
+    memcpy(header.cellCounts, pvs->cellCounts, sizeof(header.cellCounts));
+    header.setCount = pvs->setCount;
+    memcpy(header.origin, pvs->origin, sizeof(header.origin));
+    header.cellSize = pvs->cellSize;
+
+    temporaryPath = (char*)malloc(strlen(filePath) + 5);
+    if (temporaryPath == NULL) return -1;
+
+    sprintf(temporaryPath, "%s.tmp", filePath);
+
+    fp = fopen(temporaryPath, "wb");
+
+    if (fp == NULL) {
+        free(temporaryPath);
+        return -1;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, fp) != 1) result = -1;
+    if (fwrite(pvs->cellSetArray, sizeof(uint32_t), pvs->cellCount, fp) != pvs->cellCount) result = -1;
+    if (paddingBytes > 0 && fwrite(padding, 1, paddingBytes, fp) != paddingBytes) result = -1;
+    if (setBytes > 0 && fwrite(pvs->setArray, 1, setBytes, fp) != setBytes) result = -1;
+    if (fclose(fp) != 0) result = -1;
+
+    if (result == 0) {
+        remove(filePath);
+        if (rename(temporaryPath, filePath) != 0) result = -1;
+    }
+
+    if (result != 0) remove(temporaryPath);
+
+    free(temporaryPath);
+
+    return result;
+}
+
+int pvsHeaderValid(const Blitz3DPVSHeader* header, size_t fileSize, uint64_t fingerprint, unsigned int rangeCount) {
+    uint64_t cellCount;
+    unsigned int axis;
+
+    if (fileSize < sizeof(Blitz3DPVSHeader)) return 0;
+
+    if (header->magic != BLITZ3D_PVS_MAGIC || header->version != BLITZ3D_PVS_VERSION) return 0;
+    if (header->fingerprint != fingerprint || header->rangeCount != rangeCount) return 0;
+    if (header->totalSize != fileSize || header->wordCount != (rangeCount + 63) / 64) return 0;
+    if (!(header->cellSize > 0.0f) || header->cellSize != header->cellSize) return 0;
+
+    cellCount = 1;
+
+    for (axis = 0; axis < 3; axis++) {
+        if (header->cellCounts[axis] == 0 || header->cellCounts[axis] > 65536) return 0;
+        cellCount *= header->cellCounts[axis];
+    }
+
+    if (cellCount > 0xffffffffu / sizeof(uint32_t)) return 0;
+    if (header->setCount == 0 || header->setCount > cellCount) return 0;
+
+    return header->totalSize == getSetOffsetInPVSFile((unsigned int)cellCount)
+        + (uint64_t)header->setCount * header->wordCount * sizeof(uint64_t);
+}
+
+Blitz3DPVS* loadPVSForBatchSet(const char* filePath, Blitz3DBatchSet* batchSet) {
+    MappedFile* mappedFile;
+    Blitz3DPVSHeader* header;
+    Blitz3DPVS* output;
+    uint64_t fingerprint;
+    unsigned int rangeCount, iter;
+
+    mappedFile = openMappedFile(filePath);
+    if (mappedFile == NULL) return NULL;
+
+    header = (Blitz3DPVSHeader*)getDataFromMappedFile(mappedFile);
+    output = (Blitz3DPVS*)calloc(1, sizeof(Blitz3DPVS));
+
+    if (output == NULL || getFingerprintFromBatchSet(batchSet, &fingerprint, &rangeCount) != 0
+        || !pvsHeaderValid(header, getSizeFromMappedFile(mappedFile), fingerprint, rangeCount)) {
+        free(output);
+        closeMappedFile(mappedFile);
+        return NULL;
+    }
+
+    output->fingerprint = fingerprint;
+    output->rangeCount = rangeCount;
+    output->wordCount = header->wordCount;
+    memcpy(output->cellCounts, header->cellCounts, sizeof(output->cellCounts));
+    output->cellCount = header->cellCounts[0] * header->cellCounts[1] * header->cellCounts[2];
+    memcpy(output->origin, header->origin, sizeof(output->origin));
+    output->cellSize = header->cellSize;
+    output->setCount = header->setCount;
+
+    output->mappedFile = mappedFile;
+    output->cellSetArray = (uint32_t*)((unsigned char*)header + sizeof(Blitz3DPVSHeader));
+    output->setArray = (uint64_t*)((unsigned char*)header + getSetOffsetInPVSFile(output->cellCount));
+
+    for (iter = 0; iter < output->cellCount; iter++) {
+        if (output->cellSetArray[iter] >= output->setCount) break;
+    }
+
+    if (iter < output->cellCount || countVisibleRangesInPVS(output) != 0) {
+        freePVS(output);
+        return NULL;
+    }
+
+    return output;
+}
+
+char* getPVSPathFromLevelPath(const char* levelPath) {
+    char* output = (char*)malloc(strlen(levelPath) + 5);
+
+    if (output != NULL) sprintf(output, "%s.pvs", levelPath);
+
+    return output;
+}
+
+/* checking */
+
+float getNextCheckRandom(unsigned int* state) {
+    *state = *state * 1664525u + 1013904223u;
+
+    return (*state >> 8) * (1.0f / 16777216.0f);
+}
+
+unsigned int checkPVSAgainstBatchSet(Blitz3DPVS* pvs, Blitz3DBatchSet* batchSet, unsigned int rayCount,
+    unsigned int* missCount) {
+    Blitz3DPVSTree* tree;
+    unsigned int state = BLITZ3D_PVS_CHECK_SEED, ray, axis, output = 0;
+    float origin[3], direction[3];
+
+    *missCount = 0;
+
+    tree = createPVSTreeFromBatchSet(batchSet);
+    if (tree == NULL) return 0;
+
+    if (tree->rangeCount != pvs->rangeCount) {
+        freePVSTree(tree);
+        return 0;
+    }
+
+    for (ray = 0; ray < rayCount; ray++) {
+        float z = 2.0f * getNextCheckRandom(&state) - 1.0f;
+        float angle = 6.28318530718f * getNextCheckRandom(&state);
+        float radius = (float)sqrt(1.0f - z * z);
+        int cellIndex, range;
+
+        for (axis = 0; axis < 3; axis++) {
+            origin[axis] = pvs->origin[axis] + getNextCheckRandom(&state) * pvs->cellCounts[axis] * pvs->cellSize;
+        }
+
+        direction[0] = radius * (float)cos(angle);
+        direction[1] = radius * (float)sin(angle);
+        direction[2] = z;
+
+        cellIndex = getCellIndexFromPVS(pvs, origin);
+        if (cellIndex < 0) continue;
+
+        output++;
+        range = castRayInPVSTree(tree, origin, direction);
+
+        if (range >= 0) {
+            const uint64_t* set = getVisibleRangesFromPVS(pvs, (unsigned int)cellIndex);
+
+            if (!((set[range / 64] >> (range % 64)) & 1)) (*missCount)++;
+        }
+    }
+
+    freePVSTree(tree);
+
+    return output;
+}
+
+/* public functions */
+
+unsigned int* getCellCountsFromPVS(Blitz3DPVS* pvs) {
+    return pvs->cellCounts;
+}
+
+unsigned int getCellCountFromPVS(Blitz3DPVS* pvs) {
+    return pvs->cellCount;
+}
+
+unsigned int getSetCountFromPVS(Blitz3DPVS* pvs) {
+    return pvs->setCount;
+}
+
+unsigned int getRangeCountFromPVS(Blitz3DPVS* pvs) {
+    return pvs->rangeCount;
+}
+
+int getCellIndexFromPVS(Blitz3DPVS* pvs, const float* position) {
+    unsigned int axis, cell[3];
+
+    for (axis = 0; axis < 3; axis++) {
+        double offset = (position[axis] - pvs->origin[axis]) / pvs->cellSize;
+
+        /* the far faces of the grid belong to its last cells */
+        if (!(offset >= 0.0 && offset <= pvs->cellCounts[axis])) return -1;
+
+        cell[axis] = (unsigned int)offset;
+        if (cell[axis] == pvs->cellCounts[axis]) cell[axis]--;
+    }
+
+    return (int)((cell[2] * pvs->cellCounts[1] + cell[1]) * pvs->cellCounts[0] + cell[0]);
+}
+
+void getCellCenterFromPVS(Blitz3DPVS* pvs, unsigned int cellIndex, float* center) {
+    unsigned int cell[3], axis;
+
+    getCellCoordinatesFromPVS(pvs, cellIndex, cell);
+
+    for (axis = 0; axis < 3; axis++) center[axis] = pvs->origin[axis] + (cell[axis] + 0.5f) * pvs->cellSize;
+}
+
+const uint64_t* getVisibleRangesFromPVS(Blitz3DPVS* pvs, unsigned int cellIndex) {
+    return pvs->setArray + (size_t)pvs->cellSetArray[cellIndex] * pvs->wordCount;
+}
+
+unsigned int getVisibleCountFromPVS(Blitz3DPVS* pvs, unsigned int cellIndex) {
+    return pvs->setVisibleCountArray[pvs->cellSetArray[cellIndex]];
+}
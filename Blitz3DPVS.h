@@ -0,0 +1,85 @@
+#ifndef _BLITZ3DPVS_H_
+#define _BLITZ3DPVS_H_
+
+#include "Blitz3DBatch.h"
+
+/* commentary: potentially visible sets for closed levels. The box around a batch set's ranges is cut
+   into a grid of cubic cells, and each cell gets the set of ranges that can be seen from somewhere in
+   it, so a camera in a room behind walls draws that room and what its doorways let through rather
+   than everything in front of it.
+
+   The sets are worked out offline by casting rays from points spread over each cell against the
+   level's triangles, one cell per task on a thread pool; every range a ray hits first is visible.
+   The sets are approximate, not conservative: sampling can miss a range seen only through a small
+   gap, and a camera culling with them then loses that range from view, so the viewer only culls with
+   them when asked to (--pvs). To make a miss rarer a cell also takes the sets of its six neighbours
+   and every range whose box touches it, and checkPVSAgainstBatchSet measures how often it still
+   happens. Cells with the same set share one copy.
+
+   A set is a bit per range, 64 to a word, with the set's ranges numbered batch by batch as the BVH
+   numbers them, so it can go straight to cullBVHWithinRanges. A PVS is saved next to its level and
+   remembers a fingerprint of the ranges' layout and bounds; a PVS that no longer matches its batch
+   set is not loaded. The PVS copies what it needs, so it does not refer to the batch set */
+
+typedef struct Blitz3DPVS Blitz3DPVS;
+struct Blitz3DPVS;
+
+typedef struct Blitz3DPVSSettings Blitz3DPVSSettings;
+struct Blitz3DPVSSettings {
+    /* the longest side of the grid is cut into this many cells; the other sides get as many cells of
+       the same size as they need */
+    unsigned int cellsOnLongestAxis;
+
+    /* per cell: the points rays start from, and the rays cast from each point */
+    unsigned int samplesPerCell;
+    unsigned int raysPerSample;
+
+    /* 0 uses one thread per processor, 1 builds on the calling thread alone */
+    unsigned int threadCount;
+};
+
+void initializeBlitz3DPVSSettings(Blitz3DPVSSettings* settings);
+
+/* returns NULL if the batch set has no triangles or out of memory */
+Blitz3DPVS* buildPVSFromBatchSet(Blitz3DBatchSet* batchSet, const Blitz3DPVSSettings* settings);
+
+/* returns 0 on success, -1 if the file could not be written */
+int savePVS(Blitz3DPVS* pvs, const char* filePath);
+
+/* returns NULL if the file is missing, damaged or was built for other geometry */
+Blitz3DPVS* loadPVSForBatchSet(const char* filePath, Blitz3DBatchSet* batchSet);
+
+void freePVS(Blitz3DPVS* pvs);
+
+/* the file a level's PVS is kept in: the level's path with ".pvs" added; free it with free() */
+char* getPVSPathFromLevelPath(const char* levelPath);
+
+/* x, y and z */
+unsigned int* getCellCountsFromPVS(Blitz3DPVS* pvs);
+
+unsigned int getCellCountFromPVS(Blitz3DPVS* pvs);
+
+/* distinct sets, as stored */
+unsigned int getSetCountFromPVS(Blitz3DPVS* pvs);
+
+unsigned int getRangeCountFromPVS(Blitz3DPVS* pvs);
+
+/* returns -1 when the position (in the batch set's space) is outside the grid */
+int getCellIndexFromPVS(Blitz3DPVS* pvs, const float* position);
+
+/* 3 floats */
+void getCellCenterFromPVS(Blitz3DPVS* pvs, unsigned int cellIndex, float* center);
+
+/* the cell's set, (range count + 63) / 64 words */
+const uint64_t* getVisibleRangesFromPVS(Blitz3DPVS* pvs, unsigned int cellIndex);
+
+unsigned int getVisibleCountFromPVS(Blitz3DPVS* pvs, unsigned int cellIndex);
+
+/* commentary: casts the same kind of rays the builder does, from points and in directions it did not
+   use, and counts the first hits that land on a range missing from their cell's set. A few misses are
+   expected of sampled sets; many mean the sampling is too sparse for the level. Returns the rays cast */
+
+unsigned int checkPVSAgainstBatchSet(Blitz3DPVS* pvs, Blitz3DBatchSet* batchSet, unsigned int rayCount,
+    unsigned int* missCount);
+
+#endif
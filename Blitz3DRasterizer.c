@@ -0,0 +1,1182 @@
+#include "Blitz3DRasterizer.h"
+#include "SIMD.h"
+#include "ThreadPool.h"
+#include "DynamicArray.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BLITZ3D_RASTERIZER_X86
+#include <immintrin.h>
+#endif
+
+/* Blitz3D rasterizer */
+
+#define BLITZ3D_RASTER_TILE_SIZE 64
+
+/* a tile is drawn 8 by 8 pixel block by block; a block a triangle covers skips the edge tests, and one
+   the triangle is behind everywhere is skipped */
+#define BLITZ3D_RASTER_BLOCK_SIZE 8
+#define BLITZ3D_RASTER_TILE_BLOCKS (BLITZ3D_RASTER_TILE_SIZE / BLITZ3D_RASTER_BLOCK_SIZE)
+
+/* the vertices and triangles of a batch are handed to the threads in runs of at most this many; the
+   runs do not depend on the thread count, so neither does the order triangles reach a tile in */
+#define BLITZ3D_RASTER_VERTEX_RUN 16384
+#define BLITZ3D_RASTER_TRIANGLE_RUN 4096
+
+/* interpolated across a triangle: depth, 1/w, then u and v over w of each tex coord set */
+#define BLITZ3D_RASTER_PLANE_DEPTH 0
+#define BLITZ3D_RASTER_PLANE_INVERSE_W 1
+#define BLITZ3D_RASTER_PLANE_TEX_COORDS 2
+#define BLITZ3D_RASTER_PLANE_COUNT 6
+
+/* a vertex being clipped: its clip space position, then u and v of each tex coord set */
+#define BLITZ3D_RASTER_VERTEX_FLOATS 8
+
+/* clip space outcodes; the near plane is the only one triangles are cut against */
+#define BLITZ3D_RASTER_OUTSIDE_NEAR 16
+#define BLITZ3D_RASTER_OUTSIDE_FAR 32
+
+typedef struct Blitz3DRasterTexture Blitz3DRasterTexture;
+struct Blitz3DRasterTexture {
+    unsigned int width, height;
+    unsigned char* pixels;
+};
+
+typedef struct Blitz3DRasterTriangle Blitz3DRasterTriangle;
+struct Blitz3DRasterTriangle {
+    /* a, b and c of each edge, with the triangle inside where a * x + (b * y + c) is positive at a pixel
+       center, or zero on a top-left edge */
+    float edges[3][3];
+    int topLeft[3];
+
+    /* a, b and c of each interpolated value, which is a * x + (b * y + c) at a pixel center */
+    float planes[BLITZ3D_RASTER_PLANE_COUNT][3];
+
+    /* the pixels whose centers are in the triangle's box, maximum excluded */
+    int minimumX, minimumY, maximumX, maximumY;
+
+    /* per tex coord set, the texture it samples or -1 */
+    int textures[2];
+};
+
+/* a run of one batch's vertices or triangles, and the triangles set up from it */
+
+typedef struct Blitz3DRasterRun Blitz3DRasterRun;
+struct Blitz3DRasterRun {
+    unsigned int batchIndex;
+    unsigned int first, count;
+
+    DynamicArray triangles;
+    int failed;
+};
+
+struct Blitz3DRasterizer {
+    unsigned int width, height;
+
+    /* rows are padded to a multiple of four pixels, so four pixels loaded at once never cross into
+       another tile's */
+    unsigned int rowPixels;
+    unsigned char* colorBuffer;
+    float* depthBuffer;
+
+    /* per tile and block (row by row within the tile), the greatest depth in the block */
+    float* blockDepthArray;
+
+    unsigned int tileColumns, tileRows, tileCount;
+
+    ThreadPool* threadPool;
+
+    unsigned int textureCount;
+    Blitz3DRasterTexture* textureArray;
+
+    /* the draw under way */
+    Blitz3DBatchSet* batchSet;
+    Blitz3DBRUSChunk* brusChunk;
+    float matrix[16];
+
+    /* the SIMD level is read once a draw, not by every worker */
+    int useSSE2;
+
+    /* four clip space floats per vertex, each batch's vertices from clipOffsetArray[batch] on */
+    float* clipArray;
+    size_t clipCapacity;
+    size_t* clipOffsetArray;
+    size_t clipOffsetCapacity;
+
+    Blitz3DRasterRun* vertexRunArray;
+    unsigned int vertexRunCount;
+    size_t vertexRunCapacity;
+
+    Blitz3DRasterRun* triangleRunArray;
+    unsigned int triangleRunCount;
+    size_t triangleRunCapacity;
+
+    /* per run and tile (tile fastest) its triangles' count, then where they go in tileTriangleArray */
+    unsigned int* binArray;
+    size_t binCapacity;
+
+    /* tile t draws tileTriangleArray[tileStartArray[t]] up to tileTriangleArray[tileStartArray[t + 1]] */
+    unsigned int* tileStartArray;
+    Blitz3DRasterTriangle** tileTriangleArray;
+    size_t tileTriangleCapacity;
+
+    unsigned int submittedCount, setupCount, binnedCount;
+};
+
+/* runs a step over the pool, or on the calling thread alone without one */
+
+void runRasterizerStep(Blitz3DRasterizer* rasterizer, unsigned int count, ThreadPoolFunction function) {
+    unsigned int iter;
+
+    if (rasterizer->threadPool != NULL) {
+        runParallelForOnThreadPool(rasterizer->threadPool, count, function, rasterizer);
+        return;
+    }
+
+    for (iter = 0; iter < count; iter++) function(rasterizer, iter, 0);
+}
+
+/* vertices */
+
+void transformVerticesScalar(const float* matrix, const float* source, float* destination, unsigned int count) {
+    unsigned int iter, row;
+
+    for (iter = 0; iter < count; iter++) {
+        const float* vertex = source + 3 * iter;
+
+        for (row = 0; row < 4; row++) {
+            destination[4 * iter + row] = matrix[row] * vertex[0] + matrix[4 + row] * vertex[1]
+                + matrix[8 + row] * vertex[2] + matrix[12 + row];
+        }
+    }
+}
+
+#ifdef BLITZ3D_RASTERIZER_X86
+
+/* a column of the matrix per lane group, added in the same order as above */
+
+__attribute__((target("sse2")))
+void transformVerticesSSE2(const float* matrix, const float* source, float* destination, unsigned int count) {
+    __m128 columns[4];
+    unsigned int iter;
+
+    for (iter = 0; iter < 4; iter++) columns[iter] = _mm_loadu_ps(matrix + 4 * iter);
+
+    for (iter = 0; iter < count; iter++) {
+        const float* vertex = source + 3 * iter;
+        __m128 output = _mm_add_ps(_mm_mul_ps(columns[0], _mm_set1_ps(vertex[0])),
+            _mm_mul_ps(columns[1], _mm_set1_ps(vertex[1])));
+
+        output = _mm_add_ps(output, _mm_mul_ps(columns[2], _mm_set1_ps(vertex[2])));
+        _mm_storeu_ps(destination + 4 * iter, _mm_add_ps(output, columns[3]));
+    }
+}
+
+#endif
+
+void transformVertexRunTask(void* context, unsigned int index, unsigned int workerIndex) {
+    Blitz3DRasterizer* rasterizer = (Blitz3DRasterizer*)context;
+    Blitz3DRasterRun* run = &(rasterizer->vertexRunArray[index]);
+    Blitz3DBatch* batch = getBatchArrayEntryFromBatchSet(rasterizer->batchSet, run->batchIndex);
+    const float* source = getVertexArrayFromBatch(batch) + 3 * (size_t)run->first;
+    float* destination = rasterizer->clipArray + 4 * (rasterizer->clipOffsetArray[run->batchIndex] + run->first);
+
+    (void)workerIndex;
+
+#ifdef BLITZ3D_RASTERIZER_X86
+    if (rasterizer->useSSE2) transformVerticesSSE2(rasterizer->matrix, source, destination, run->count);
+    else
+#endif
+    transformVerticesScalar(rasterizer->matrix, source, destination, run->count);
+}
+
+/* triangle setup */
+
+unsigned int getOutcodeFromClipVertex(const float* vertex) {
+    unsigned int output = 0;
+
+    if (vertex[0] < -vertex[3]) output |= 1;
+    if (vertex[0] > vertex[3]) output |= 2;
+    if (vertex[1] < -vertex[3]) output |= 4;
+    if (vertex[1] > vertex[3]) output |= 8;
+    if (vertex[2] < -vertex[3]) output |= BLITZ3D_RASTER_OUTSIDE_NEAR;
+    if (vertex[2] > vertex[3]) output |= BLITZ3D_RASTER_OUTSIDE_FAR;
+
+    return output;
+}
+
+/* a plane through the three screen points with the values at them; the points are in triangle order */
+
+void setRasterPlane(float* plane, const float* x, const float* y, const float* values, float inverseArea) {
+    float dx1 = x[1] - x[0], dy1 = y[1] - y[0], dx2 = x[2] - x[0], dy2 = y[2] - y[0];
+    float df1 = values[1] - values[0], df2 = values[2] - values[0];
+
+    plane[0] = (df1 * dy2 - df2 * dy1) * inverseArea;
+    plane[1] = (df2 * dx1 - df1 * dx2) * inverseArea;
+    plane[2] = values[0] - plane[0] * x[0] - plane[1] * y[0];
+}
+
+/* takes three clipped vertices to the screen and adds the triangle if its box holds a pixel center */
+
+void setupRasterTriangle(Blitz3DRasterizer* rasterizer, const float* const* vertices, const int* textures,
+    Blitz3DRasterRun* run) {
+    Blitz3DRasterTriangle* triangle;
+    float x[3], y[3], values[BLITZ3D_RASTER_PLANE_COUNT][3];
+    float minimumX, minimumY, maximumX, maximumY, area, swap;
+    unsigned int iter, plane, edge;
+
+    for (iter = 0; iter < 3; iter++) {
+        const float* vertex = vertices[iter];
+        float inverseW;
+
+        if (!(vertex[3] > 0.0f)) return;
+        inverseW = 1.0f / vertex[3];
+
+        x[iter] = (vertex[0] * inverseW * 0.5f + 0.5f) * rasterizer->width;
+        y[iter] = (0.5f - vertex[1] * inverseW * 0.5f) * rasterizer->height;
+
+        values[BLITZ3D_RASTER_PLANE_DEPTH][iter] = vertex[2] * inverseW * 0.5f + 0.5f;
+        values[BLITZ3D_RASTER_PLANE_INVERSE_W][iter] = inverseW;
+
+        for (plane = 0; plane < 4; plane++) {
+            values[BLITZ3D_RASTER_PLANE_TEX_COORDS + plane][iter] = vertex[4 + plane] * inverseW;
+        }
+    }
+
+    /* both windings are drawn; the edge functions want the counterclockwise one (on screen, y down) */
+
+    area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(area != 0.0f)) return;
+
+    if (area < 0.0f) {
+        area = -area;
+
+        swap = x[1]; x[1] = x[2]; x[2] = swap;
+        swap = y[1]; y[1] = y[2]; y[2] = swap;
+
+        for (plane = 0; plane < BLITZ3D_RASTER_PLANE_COUNT; plane++) {
+            swap = values[plane][1]; values[plane][1] = values[plane][2]; values[plane][2] = swap;
+        }
+    }
+
+    minimumX = maximumX = x[0];
+    minimumY = maximumY = y[0];
+
+    for (iter = 1; iter < 3; iter++) {
+        if (x[iter] < minimumX) minimumX = x[iter];
+        if (x[iter] > maximumX) maximumX = x[iter];
+        if (y[iter] < minimumY) minimumY = y[iter];
+        if (y[iter] > maximumY) maximumY = y[iter];
+    }
+
+    /* pixel n has its center at n + 0.5; boxes far off screen are cut down before becoming integers */
+
+    minimumX = (minimumX < 0.0f) ? 0.0f : (float)ceil(minimumX - 0.5f);
+    minimumY = (minimumY < 0.0f) ? 0.0f : (float)ceil(minimumY - 0.5f);
+    maximumX = (maximumX > rasterizer->width) ? rasterizer->width : (float)floor(maximumX - 0.5f) + 1.0f;
+    maximumY = (maximumY > rasterizer->height) ? rasterizer->height : (float)floor(maximumY - 0.5f) + 1.0f;
+
+    if (!(minimumX < maximumX && minimumY < maximumY)) return;
+
+    triangle = (Blitz3DRasterTriangle*)pushOntoDynamicArray(&run->triangles);
+
+    if (triangle == NULL) {
+        run->failed = 1;
+        return;
+    }
+
+    triangle->minimumX = (int)minimumX;
+    triangle->minimumY = (int)minimumY;
+    triangle->maximumX = (int)maximumX;
+    triangle->maximumY = (int)maximumY;
+
+    /* edge n runs between the two vertices other than n; swapping its ends negates all three terms
+       exactly, so a neighbour sharing the edge sees the opposite of what this triangle sees */
+
+    for (edge = 0; edge < 3; edge++) {
+        unsigned int from = (edge + 1) % 3, to = (edge + 2) % 3;
+        float* terms = triangle->edges[edge];
+
+        terms[0] = y[from] - y[to];
+        terms[1] = x[to] - x[from];
+        terms[2] = x[from] * y[to] - x[to] * y[from];
+
+        triangle->topLeft[edge] = (terms[0] > 0.0f || (terms[0] == 0.0f && terms[1] > 0.0f));
+    }
+
+    for (plane = 0; plane < BLITZ3D_RASTER_PLANE_COUNT; plane++) {
+        setRasterPlane(triangle->planes[plane], x, y, values[plane], 1.0f / area);
+    }
+
+    triangle->textures[0] = textures[0];
+    triangle->textures[1] = textures[1];
+}
+
+/* the point where the edge from inside to outside crosses the near plane */
+
+void intersectNearPlane(float* output, const float* inside, const float* outside) {
+    float insideDistance = inside[2] + inside[3], outsideDistance = outside[2] + outside[3];
+    float t = insideDistance / (insideDistance - outsideDistance);
+    unsigned int iter;
+
+    for (iter = 0; iter < BLITZ3D_RASTER_VERTEX_FLOATS; iter++) {
+        output[iter] = inside[iter] + t * (outside[iter] - inside[iter]);
+    }
+}
+
+/* cuts away what is in front of the near plane, leaving up to four vertices, and sets up the fan */
+
+void clipRasterTriangle(Blitz3DRasterizer* rasterizer, const float* const* vertices, const int* textures,
+    Blitz3DRasterRun* run) {
+    float clipped[4][BLITZ3D_RASTER_VERTEX_FLOATS];
+    const float* fan[3];
+    unsigned int iter, count = 0;
+
+    for (iter = 0; iter < 3; iter++) {
+        const float* current = vertices[iter];
+        const float* next = vertices[(iter + 1) % 3];
+        int currentInside = (current[2] + current[3] >= 0.0f), nextInside = (next[2] + next[3] >= 0.0f);
+
+        if (currentInside) memcpy(clipped[count++], current, sizeof(clipped[0]));
+        if (currentInside != nextInside) {
+            if (currentInside) intersectNearPlane(clipped[count++], current, next);
+            else intersectNearPlane(clipped[count++], next, current);
+        }
+    }
+
+    for (iter = 2; iter < count; iter++) {
+        fan[0] = clipped[0];
+        fan[1] = clipped[iter - 1];
+        fan[2] = clipped[iter];
+        setupRasterTriangle(rasterizer, fan, textures, run);
+    }
+}
+
+/* per tex coord set, the texture of the layer it feeds or -1 */
+
+void getRasterTexturesFromBrush(Blitz3DRasterizer* rasterizer, int brushId, int* textures) {
+    Blitz3DBRUSChunk* brusChunk = rasterizer->brusChunk;
+    Blitz3DBrush* brush;
+    unsigned int set;
+
+    textures[0] = textures[1] = -1;
+
+    if (brusChunk == NULL || brushId < 0 || (unsigned int)brushId >= getBrushArrayCountFromBRUSChunk(brusChunk)) {
+        return;
+    }
+
+    brush = getBrushArrayEntryFromBRUSChunk(brusChunk, (unsigned int)brushId);
+
+    for (set = 0; set < 2; set++) {
+        unsigned int layer = getTextureLayerFromTexCoordSet(set);
+        int textureId;
+
+        if ((int)layer >= getNumberOfTexturesFromBRUSChunk(brusChunk)) continue;
+
+        textureId = getTextureIdArrayEntryFromBrush(brush, layer);
+
+        if (textureId >= 0 && (unsigned int)textureId < rasterizer->textureCount
+            && rasterizer->textureArray[textureId].pixels != NULL) {
+            textures[set] = textureId;
+        }
+    }
+}
+
+void setupTriangleRunTask(void* context, unsigned int index, unsigned int workerIndex) {
+    Blitz3DRasterizer* rasterizer = (Blitz3DRasterizer*)context;
+    Blitz3DRasterRun* run = &(rasterizer->triangleRunArray[index]);
+    Blitz3DBatch* batch = getBatchArrayEntryFromBatchSet(rasterizer->batchSet, run->batchIndex);
+    const float* clip = rasterizer->clipArray + 4 * rasterizer->clipOffsetArray[run->batchIndex];
+    const float* texCoordArrays[2] = { NULL, NULL };
+    unsigned int texCoordComponents = getTexCoordArrayComponentCountFromBatch(batch);
+    unsigned int iter, corner, set;
+    float vertexArray[3][BLITZ3D_RASTER_VERTEX_FLOATS];
+    const float* vertices[3];
+    int textures[2];
+
+    (void)workerIndex;
+
+    getRasterTexturesFromBrush(rasterizer, getBrushIdFromBatch(batch), textures);
+
+    /* a missing set reads as 0, 0, the current tex coord OpenGL starts with */
+    for (set = 0; set < 2 && set < getTexCoordArrayCountFromBatch(batch); set++) {
+        texCoordArrays[set] = getTexCoordArrayEntryFromBatch(batch, set);
+    }
+
+    for (corner = 0; corner < 3; corner++) vertices[corner] = vertexArray[corner];
+
+    for (iter = run->first; iter < run->first + run->count; iter++) {
+        unsigned int outcodes[3];
+
+        for (corner = 0; corner < 3; corner++) {
+            size_t position = 3 * (size_t)iter + corner;
+            unsigned int vertex = (getIndexSizeFromBatch(batch) == 2) ? getShortIndexArrayFromBatch(batch)[position]
+                : getIndexArrayFromBatch(batch)[position];
+            float* output = vertexArray[corner];
+
+            memcpy(output, clip + 4 * (size_t)vertex, 4 * sizeof(float));
+
+            for (set = 0; set < 2; set++) {
+                const float* texCoord = (texCoordArrays[set] != NULL)
+                    ? texCoordArrays[set] + texCoordComponents * (size_t)vertex : NULL;
+
+                output[4 + 2 * set] = (texCoord != NULL) ? texCoord[0] : 0.0f;
+                output[5 + 2 * set] = (texCoord != NULL && texCoordComponents > 1) ? texCoord[1] : 0.0f;
+            }
+
+            outcodes[corner] = getOutcodeFromClipVertex(output);
+        }
+
+        /* all three outside one plane: nothing to draw */
+        if ((outcodes[0] & outcodes[1] & outcodes[2]) != 0) continue;
+
+        if ((outcodes[0] | outcodes[1] | outcodes[2]) & BLITZ3D_RASTER_OUTSIDE_NEAR) {
+            clipRasterTriangle(rasterizer, vertices, textures, run);
+        }
+        else {
+            setupRasterTriangle(rasterizer, vertices, textures, run);
+        }
+    }
+}
+
+/* binning */
+
+/* the largest (or smallest) value of an edge function or plane at the pixel centers from x0, y0 up to
+   x1, y1: it is reached at one corner, and evaluated there as the kernels would, every rounding step
+   keeps the order, so no pixel's value in floats is beyond it either */
+
+float getRasterCornerValue(const float* terms, int x0, int y0, int x1, int y1, int largest) {
+    float x = (float)(((terms[0] > 0.0f) == (largest != 0)) ? x1 - 1 : x0) + 0.5f;
+    float y = (float)(((terms[1] > 0.0f) == (largest != 0)) ? y1 - 1 : y0) + 0.5f;
+
+    return terms[0] * x + (terms[1] * y + terms[2]);
+}
+
+/* whether any pixel center of the tile can be inside every edge */
+
+int rasterTriangleTouchesTile(const Blitz3DRasterTriangle* triangle, int tileX0, int tileY0, int tileX1, int tileY1) {
+    unsigned int edge;
+
+    for (edge = 0; edge < 3; edge++) {
+        if (getRasterCornerValue(triangle->edges[edge], tileX0, tileY0, tileX1, tileY1, 1) < 0.0f) return 0;
+    }
+
+    return 1;
+}
+
+/* counts the run's triangles per tile, or with output, places them at the run's cursor for each tile;
+   a triangle whose box is within one tile is taken to touch it */
+
+void countTriangleRunTiles(Blitz3DRasterizer* rasterizer, Blitz3DRasterRun* run, unsigned int* counts,
+    Blitz3DRasterTriangle** output) {
+    Blitz3DRasterTriangle* triangles = (Blitz3DRasterTriangle*)getDataFromDynamicArray(&run->triangles);
+    unsigned int iter;
+    int tileX, tileY;
+
+    for (iter = 0; iter < getDynamicArrayCount(&run->triangles); iter++) {
+        Blitz3DRasterTriangle* triangle = &(triangles[iter]);
+        int firstX = triangle->minimumX / BLITZ3D_RASTER_TILE_SIZE;
+        int firstY = triangle->minimumY / BLITZ3D_RASTER_TILE_SIZE;
+        int lastX = (triangle->maximumX - 1) / BLITZ3D_RASTER_TILE_SIZE;
+        int lastY = (triangle->maximumY - 1) / BLITZ3D_RASTER_TILE_SIZE;
+        int single = (firstX == lastX && firstY == lastY);
+
+        for (tileY = firstY; tileY <= lastY; tileY++) {
+            for (tileX = firstX; tileX <= lastX; tileX++) {
+                unsigned int tile = (unsigned int)tileY * rasterizer->tileColumns + (unsigned int)tileX;
+
+                if (!single && !rasterTriangleTouchesTile(triangle, tileX * BLITZ3D_RASTER_TILE_SIZE,
+                    tileY * BLITZ3D_RASTER_TILE_SIZE, (tileX + 1) * BLITZ3D_RASTER_TILE_SIZE,
+                    (tileY + 1) * BLITZ3D_RASTER_TILE_SIZE)) continue;
+
+                if (output == NULL) counts[tile]++;
+                else output[counts[tile]++] = triangle;
+            }
+        }
+    }
+}
+
+void countTriangleRunTask(void* context, unsigned int index, unsigned int workerIndex) {
+    Blitz3DRasterizer* rasterizer = (Blitz3DRasterizer*)context;
+
+    (void)workerIndex;
+
+    countTriangleRunTiles(rasterizer, &(rasterizer->triangleRunArray[index]),
+        rasterizer->binArray + (size_t)index * rasterizer->tileCount, NULL);
+}
+
+void placeTriangleRunTask(void* context, unsigned int index, unsigned int workerIndex) {
+    Blitz3DRasterizer* rasterizer = (Blitz3DRasterizer*)context;
+
+    (void)workerIndex;
+
+    countTriangleRunTiles(rasterizer, &(rasterizer->triangleRunArray[index]),
+        rasterizer->binArray + (size_t)index * rasterizer->tileCount, rasterizer->tileTriangleArray);
+}
+
+/* rasterization */
+
+/* multiplies two 0 to 255 values as 0 to 1 values */
+#define BLITZ3D_RASTER_MODULATE(first, second) (((first) * (second) + 127) / 255)
+
+/* what is left of a tex coord once the texture has repeated, 0 to 1; a float beyond 2^23 has no
+   fraction, and NaN (from a degenerate triangle) gives 0 */
+
+float getRasterFraction(float value) {
+    float whole;
+
+    if (!(value > -8388608.0f && value < 8388608.0f)) return 0.0f;
+
+    whole = (float)(int)value;
+    if (whole > value) whole -= 1.0f;
+
+    return value - whole;
+}
+
+void sampleRasterTexture(const Blitz3DRasterTexture* texture, float u, float v, unsigned int* color) {
+    const unsigned char* texel;
+    unsigned int x, y, component;
+
+    x = (unsigned int)(getRasterFraction(u) * texture->width);
+    y = (unsigned int)(getRasterFraction(v) * texture->height);
+    if (x >= texture->width) x = texture->width - 1;
+    if (y >= texture->height) y = texture->height - 1;
+
+    texel = texture->pixels + 4 * ((size_t)y * texture->width + x);
+
+    for (component = 0; component < 4; component++) {
+        color[component] = BLITZ3D_RASTER_MODULATE(color[component], texel[component]);
+    }
+}
+
+/* texCoords are u and v of each set */
+
+void shadeRasterPixel(Blitz3DRasterizer* rasterizer, const Blitz3DRasterTriangle* triangle, const float* texCoords,
+    unsigned char* output) {
+    unsigned int color[4] = { 255, 255, 255, 255 };
+    unsigned int set;
+
+    for (set = 0; set < 2; set++) {
+        if (triangle->textures[set] < 0) continue;
+
+        sampleRasterTexture(&(rasterizer->textureArray[triangle->textures[set]]), texCoords[2 * set],
+            texCoords[2 * set + 1], color);
+    }
+
+    output[0] = (unsigned char)color[0];
+    output[1] = (unsigned char)color[1];
+    output[2] = (unsigned char)color[2];
+    output[3] = (unsigned char)color[3];
+}
+
+/* the triangle over the pixels from x0, y0 up to x1, y1, within one block; covered skips the edge tests.
+   Returns whether any pixel was drawn */
+
+int rasterizeTriangleScalar(Blitz3DRasterizer* rasterizer, const Blitz3DRasterTriangle* triangle,
+    int x0, int y0, int x1, int y1, int covered) {
+    float rows[3], planeRows[BLITZ3D_RASTER_PLANE_COUNT], texCoords[4];
+    unsigned int edge, plane;
+    int x, y, drawn = 0;
+
+    for (y = y0; y < y1; y++) {
+        float centerY = (float)y + 0.5f;
+        float* depthRow = rasterizer->depthBuffer + (size_t)y * rasterizer->rowPixels;
+        unsigned char* colorRow = rasterizer->colorBuffer + 4 * (size_t)y * rasterizer->rowPixels;
+
+        for (edge = 0; edge < 3; edge++) rows[edge] = triangle->edges[edge][1] * centerY + triangle->edges[edge][2];
+
+        for (plane = 0; plane < BLITZ3D_RASTER_PLANE_COUNT; plane++) {
+            planeRows[plane] = triangle->planes[plane][1] * centerY + triangle->planes[plane][2];
+        }
+
+        for (x = x0; x < x1; x++) {
+            float centerX = (float)x + 0.5f, depth, w;
+            int inside = 1;
+
+            for (edge = 0; edge < 3 && inside && !covered; edge++) {
+                float value = triangle->edges[edge][0] * centerX + rows[edge];
+
+                inside = (value > 0.0f || (value == 0.0f && triangle->topLeft[edge]));
+            }
+
+            if (!inside) continue;
+
+            depth = triangle->planes[BLITZ3D_RASTER_PLANE_DEPTH][0] * centerX + planeRows[BLITZ3D_RASTER_PLANE_DEPTH];
+            if (!(depth < depthRow[x])) continue;
+
+            depthRow[x] = depth;
+            drawn = 1;
+
+            w = 1.0f / (triangle->planes[BLITZ3D_RASTER_PLANE_INVERSE_W][0] * centerX
+                + planeRows[BLITZ3D_RASTER_PLANE_INVERSE_W]);
+
+            for (plane = 0; plane < 4; plane++) {
+                texCoords[plane] = (triangle->planes[BLITZ3D_RASTER_PLANE_TEX_COORDS + plane][0] * centerX
+                    + planeRows[BLITZ3D_RASTER_PLANE_TEX_COORDS + plane]) * w;
+            }
+
+            shadeRasterPixel(rasterizer, triangle, texCoords, colorRow + 4 * x);
+        }
+    }
+
+    return drawn;
+}
+
+#ifdef BLITZ3D_RASTERIZER_X86
+
+/* four pixels at a time from a multiple of four (so within the tile), with the same arithmetic as
+   above; the depth test and the edge tests go together, and only the pixels passing both are shaded */
+
+__attribute__((target("sse2")))
+int rasterizeTriangleSSE2(Blitz3DRasterizer* rasterizer, const Blitz3DRasterTriangle* triangle,
+    int x0, int y0, int x1, int y1, int covered) {
+    __m128 centerOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f), zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+    __m128 edgeSteps[3], topLeft[3], planeSteps[BLITZ3D_RASTER_PLANE_COUNT];
+    __m128 rows[3], planeRows[BLITZ3D_RASTER_PLANE_COUNT];
+    __m128i first = _mm_set1_epi32(x0 - 1), last = _mm_set1_epi32(x1);
+    float texCoords[4][4], lanes[4];
+    unsigned int edge, plane, lane;
+    int x, y, bits, drawn = 0;
+
+    for (edge = 0; edge < 3; edge++) {
+        edgeSteps[edge] = _mm_set1_ps(triangle->edges[edge][0]);
+        topLeft[edge] = _mm_castsi128_ps(_mm_set1_epi32(triangle->topLeft[edge] ? -1 : 0));
+    }
+
+    for (plane = 0; plane < BLITZ3D_RASTER_PLANE_COUNT; plane++) {
+        planeSteps[plane] = _mm_set1_ps(triangle->planes[plane][0]);
+    }
+
+    for (y = y0; y < y1; y++) {
+        float centerY = (float)y + 0.5f;
+        float* depthRow = rasterizer->depthBuffer + (size_t)y * rasterizer->rowPixels;
+        unsigned char* colorRow = rasterizer->colorBuffer + 4 * (size_t)y * rasterizer->rowPixels;
+
+        for (edge = 0; edge < 3; edge++) {
+            rows[edge] = _mm_set1_ps(triangle->edges[edge][1] * centerY + triangle->edges[edge][2]);
+        }
+
+        for (plane = 0; plane < BLITZ3D_RASTER_PLANE_COUNT; plane++) {
+            planeRows[plane] = _mm_set1_ps(triangle->planes[plane][1] * centerY + triangle->planes[plane][2]);
+        }
+
+        for (x = x0 & ~3; x < x1; x += 4) {
+            __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), centerOffsets);
+            __m128i pixels = _mm_add_epi32(_mm_set1_epi32(x), laneOffsets);
+            __m128 mask = _mm_castsi128_ps(_mm_and_si128(_mm_cmpgt_epi32(pixels, first),
+                _mm_cmplt_epi32(pixels, last)));
+            __m128 depth, stored, w;
+
+            for (edge = 0; edge < 3 && !covered; edge++) {
+                __m128 value = _mm_add_ps(_mm_mul_ps(edgeSteps[edge], centerX), rows[edge]);
+
+                mask = _mm_and_ps(mask, _mm_or_ps(_mm_cmpgt_ps(value, zero),
+                    _mm_and_ps(_mm_cmpeq_ps(value, zero), topLeft[edge])));
+            }
+
+            if (_mm_movemask_ps(mask) == 0) continue;
+
+            depth = _mm_add_ps(_mm_mul_ps(planeSteps[BLITZ3D_RASTER_PLANE_DEPTH], centerX),
+                planeRows[BLITZ3D_RASTER_PLANE_DEPTH]);
+            stored = _mm_loadu_ps(depthRow + x);
+            mask = _mm_and_ps(mask, _mm_cmplt_ps(depth, stored));
+
+            bits = _mm_movemask_ps(mask);
+            if (bits == 0) continue;
+
+            _mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(mask, depth), _mm_andnot_ps(mask, stored)));
+            drawn = 1;
+
+            w = _mm_div_ps(one, _mm_add_ps(_mm_mul_ps(planeSteps[BLITZ3D_RASTER_PLANE_INVERSE_W], centerX),
+                planeRows[BLITZ3D_RASTER_PLANE_INVERSE_W]));
+
+            for (plane = 0; plane < 4; plane++) {
+                __m128 value = _mm_add_ps(_mm_mul_ps(planeSteps[BLITZ3D_RASTER_PLANE_TEX_COORDS + plane], centerX),
+                    planeRows[BLITZ3D_RASTER_PLANE_TEX_COORDS + plane]);
+
+                _mm_storeu_ps(lanes, _mm_mul_ps(value, w));
+                for (lane = 0; lane < 4; lane++) texCoords[lane][plane] = lanes[lane];
+            }
+
+            for (lane = 0; lane < 4; lane++) {
+                if (bits & (1 << lane)) {
+                    shadeRasterPixel(rasterizer, triangle, texCoords[lane], colorRow + 4 * (x + lane));
+                }
+            }
+        }
+    }
+
+    return drawn;
+}
+
+#endif
+
+/* the greatest depth of the pixels from x0, y0 up to x1, y1 */
+
+float getRasterBlockDepth(Blitz3DRasterizer* rasterizer, int x0, int y0, int x1, int y1) {
+    float output = 0.0f;
+    int x, y;
+
+    for (y = y0; y < y1; y++) {
+        const float* depthRow = rasterizer->depthBuffer + (size_t)y * rasterizer->rowPixels;
+
+        for (x = x0; x < x1; x++) {
+            if (depthRow[x] > output) output = depthRow[x];
+        }
+    }
+
+    return output;
+}
+
+/* the triangle over the pixels from x0, y0 up to x1, y1 of the tile, block by block. Whether a block is
+   outside an edge, inside all three or behind what is drawn is decided from its corners, which bound
+   every pixel's value exactly, so the blocks skipped or not edge tested are drawn as they would be.
+   Returns whether any pixel was drawn */
+
+int rasterizeTriangleInTile(Blitz3DRasterizer* rasterizer, const Blitz3DRasterTriangle* triangle, float* blockDepths,
+    int tileX0, int tileY0, int x0, int y0, int x1, int y1) {
+    int blockX0, blockY0, blockX1, blockY1, blockX, blockY, tileDrawn = 0;
+    unsigned int edge;
+
+    for (blockY = (y0 - tileY0) / BLITZ3D_RASTER_BLOCK_SIZE; blockY * BLITZ3D_RASTER_BLOCK_SIZE < y1 - tileY0;
+        blockY++) {
+        blockY0 = tileY0 + blockY * BLITZ3D_RASTER_BLOCK_SIZE;
+        blockY1 = blockY0 + BLITZ3D_RASTER_BLOCK_SIZE;
+        if (blockY0 < y0) blockY0 = y0;
+        if (blockY1 > y1) blockY1 = y1;
+
+        for (blockX = (x0 - tileX0) / BLITZ3D_RASTER_BLOCK_SIZE; blockX * BLITZ3D_RASTER_BLOCK_SIZE < x1 - tileX0;
+            blockX++) {
+            float* blockDepth = &(blockDepths[blockY * BLITZ3D_RASTER_TILE_BLOCKS + blockX]);
+            int covered = 1, outside = 0, drawn;
+
+            blockX0 = tileX0 + blockX * BLITZ3D_RASTER_BLOCK_SIZE;
+            blockX1 = blockX0 + BLITZ3D_RASTER_BLOCK_SIZE;
+            if (blockX0 < x0) blockX0 = x0;
+            if (blockX1 > x1) blockX1 = x1;
+
+            for (edge = 0; edge < 3 && !outside; edge++) {
+                const float* terms = triangle->edges[edge];
+
+                outside = (getRasterCornerValue(terms, blockX0, blockY0, blockX1, blockY1, 1) < 0.0f);
+                if (!(getRasterCornerValue(terms, blockX0, blockY0, blockX1, blockY1, 0) > 0.0f)) covered = 0;
+            }
+
+            if (outside) continue;
+
+            if (getRasterCornerValue(triangle->planes[BLITZ3D_RASTER_PLANE_DEPTH], blockX0, blockY0, blockX1, blockY1,
+                0) >= *blockDepth) continue;
+
+#ifdef BLITZ3D_RASTERIZER_X86
+            if (rasterizer->useSSE2) {
+                drawn = rasterizeTriangleSSE2(rasterizer, triangle, blockX0, blockY0, blockX1, blockY1, covered);
+            }
+            else
+#endif
+            drawn = rasterizeTriangleScalar(rasterizer, triangle, blockX0, blockY0, blockX1, blockY1, covered);
+
+            /* the whole block's, not just the part drawn */
+            if (drawn) {
+                int wholeX0 = tileX0 + blockX * BLITZ3D_RASTER_BLOCK_SIZE;
+                int wholeY0 = tileY0 + blockY * BLITZ3D_RASTER_BLOCK_SIZE;
+                int wholeX1 = wholeX0 + BLITZ3D_RASTER_BLOCK_SIZE, wholeY1 = wholeY0 + BLITZ3D_RASTER_BLOCK_SIZE;
+
+                if (wholeX1 > (int)rasterizer->width) wholeX1 = (int)rasterizer->width;
+                if (wholeY1 > (int)rasterizer->height) wholeY1 = (int)rasterizer->height;
+
+                *blockDepth = getRasterBlockDepth(rasterizer, wholeX0, wholeY0, wholeX1, wholeY1);
+                tileDrawn = 1;
+            }
+        }
+    }
+
+    return tileDrawn;
+}
+
+/* the greatest of the tile's block depths */
+
+float getRasterTileDepth(const float* blockDepths) {
+    float output = 0.0f;
+    unsigned int iter;
+
+    for (iter = 0; iter < BLITZ3D_RASTER_TILE_BLOCKS * BLITZ3D_RASTER_TILE_BLOCKS; iter++) {
+        if (blockDepths[iter] > output) output = blockDepths[iter];
+    }
+
+    return output;
+}
+
+void rasterizeTileTask(void* context, unsigned int index, unsigned int workerIndex) {
+    Blitz3DRasterizer* rasterizer = (Blitz3DRasterizer*)context;
+    float* blockDepths = rasterizer->blockDepthArray
+        + (size_t)index * BLITZ3D_RASTER_TILE_BLOCKS * BLITZ3D_RASTER_TILE_BLOCKS;
+    int tileX0 = (int)(index % rasterizer->tileColumns) * BLITZ3D_RASTER_TILE_SIZE;
+    int tileY0 = (int)(index / rasterizer->tileColumns) * BLITZ3D_RASTER_TILE_SIZE;
+    int tileX1 = tileX0 + BLITZ3D_RASTER_TILE_SIZE, tileY1 = tileY0 + BLITZ3D_RASTER_TILE_SIZE;
+    float tileDepth = getRasterTileDepth(blockDepths);
+    unsigned int iter;
+
+    (void)workerIndex;
+
+    if (tileX1 > (int)rasterizer->width) tileX1 = (int)rasterizer->width;
+    if (tileY1 > (int)rasterizer->height) tileY1 = (int)rasterizer->height;
+
+    for (iter = rasterizer->tileStartArray[index]; iter < rasterizer->tileStartArray[index + 1]; iter++) {
+        const Blitz3DRasterTriangle* triangle = rasterizer->tileTriangleArray[iter];
+        int x0 = (triangle->minimumX > tileX0) ? triangle->minimumX : tileX0;
+        int y0 = (triangle->minimumY > tileY0) ? triangle->minimumY : tileY0;
+        int x1 = (triangle->maximumX < tileX1) ? triangle->maximumX : tileX1;
+        int y1 = (triangle->maximumY < tileY1) ? triangle->maximumY : tileY1;
+
+        /* behind everything in the tile, as a block would be */
+        if (getRasterCornerValue(triangle->planes[BLITZ3D_RASTER_PLANE_DEPTH], x0, y0, x1, y1, 0) >= tileDepth) {
+            continue;
+        }
+
+        if (rasterizeTriangleInTile(rasterizer, triangle, blockDepths, tileX0, tileY0, x0, y0, x1, y1)) {
+            tileDepth = getRasterTileDepth(blockDepths);
+        }
+    }
+}
+
+/* the rasterizer */
+
+Blitz3DRasterizer* createRasterizer(unsigned int width, unsigned int height, unsigned int threadCount) {
+    Blitz3DRasterizer* output;
+    size_t pixelCount;
+
+    if (width == 0 || height == 0) return NULL;
+
+    output = (Blitz3DRasterizer*)calloc(1, sizeof(Blitz3DRasterizer));
+    if (output == NULL) return NULL;
+
+    output->width = width;
+    output->height = height;
+    output->rowPixels = (width + 3) & ~3u;
+
+    output->tileColumns = (width + BLITZ3D_RASTER_TILE_SIZE - 1) / BLITZ3D_RASTER_TILE_SIZE;
+    output->tileRows = (height + BLITZ3D_RASTER_TILE_SIZE - 1) / BLITZ3D_RASTER_TILE_SIZE;
+    output->tileCount = output->tileColumns * output->tileRows;
+
+    pixelCount = (size_t)output->rowPixels * height;
+
+    output->colorBuffer = (unsigned char*)malloc(4 * pixelCount);
+    output->depthBuffer = (float*)malloc(pixelCount * sizeof(float));
+    output->blockDepthArray = (float*)malloc((size_t)output->tileCount * BLITZ3D_RASTER_TILE_BLOCKS
+        * BLITZ3D_RASTER_TILE_BLOCKS * sizeof(float));
+    output->tileStartArray = (unsigned int*)malloc((output->tileCount + 1) * sizeof(unsigned int));
+
+    if (output->colorBuffer == NULL || output->depthBuffer == NULL || output->blockDepthArray == NULL
+        || output->tileStartArray == NULL) {
+        freeRasterizer(output);
+        return NULL;
+    }
+
+    if (threadCount != 1) output->threadPool = createThreadPool(threadCount);
+
+    clearRasterizer(output, 0.0f, 0.0f, 0.0f, 1.0f);
+
+    return output;
+}
+
+void freeRasterizer(Blitz3DRasterizer* rasterizer) {
+    unsigned int iter;
+    size_t runIter;
+
+    for (iter = 0; iter < rasterizer->textureCount; iter++) free(rasterizer->textureArray[iter].pixels);
+    for (runIter = 0; runIter < rasterizer->triangleRunCapacity; runIter++) {
+        freeDynamicArray(&(rasterizer->triangleRunArray[runIter].triangles));
+    }
+
+    if (rasterizer->threadPool != NULL) freeThreadPool(rasterizer->threadPool);
+
+    free(rasterizer->textureArray);
+    free(rasterizer->colorBuffer);
+    free(rasterizer->depthBuffer);
+    free(rasterizer->blockDepthArray);
+    free(rasterizer->clipArray);
+    free(rasterizer->clipOffsetArray);
+    free(rasterizer->vertexRunArray);
+    free(rasterizer->triangleRunArray);
+    free(rasterizer->binArray);
+    free(rasterizer->tileStartArray);
+    free(rasterizer->tileTriangleArray);
+    free(rasterizer);
+}
+
+unsigned int getWidthFromRasterizer(Blitz3DRasterizer* rasterizer) {
+    return rasterizer->width;
+}
+
+unsigned int getHeightFromRasterizer(Blitz3DRasterizer* rasterizer) {
+    return rasterizer->height;
+}
+
+int setTextureInRasterizer(Blitz3DRasterizer* rasterizer, unsigned int textureIndex, unsigned int width,
+    unsigned int height, const unsigned char* pixels) {
+    Blitz3DRasterTexture* texture;
+    unsigned char* copy;
+
+    if (width == 0 || height == 0) return -1;
+
+    if (textureIndex >= rasterizer->textureCount) {
+        Blitz3DRasterTexture* grown = (Blitz3DRasterTexture*)realloc(rasterizer->textureArray,
+            (textureIndex + 1) * sizeof(Blitz3DRasterTexture));
+
+        if (grown == NULL) return -1;
+
+        memset(grown + rasterizer->textureCount, 0,
+            (textureIndex + 1 - rasterizer->textureCount) * sizeof(Blitz3DRasterTexture));
+        rasterizer->textureArray = grown;
+        rasterizer->textureCount = textureIndex + 1;
+    }
+
+    copy = (unsigned char*)malloc(4 * (size_t)width * height);
+    if (copy == NULL) return -1;
+
+    memcpy(copy, pixels, 4 * (size_t)width * height);
+
+    texture = &(rasterizer->textureArray[textureIndex]);
+    free(texture->pixels);
+
+    texture->width = width;
+    texture->height = height;
+    texture->pixels = copy;
+
+    return 0;
+}
+
+void clearRasterizer(Blitz3DRasterizer* rasterizer, float red, float green, float blue, float alpha) {
+    float components[4];
+    unsigned char color[4];
+    size_t iter, pixelCount = (size_t)rasterizer->rowPixels * rasterizer->height;
+    size_t blockCount = (size_t)rasterizer->tileCount * BLITZ3D_RASTER_TILE_BLOCKS * BLITZ3D_RASTER_TILE_BLOCKS;
+    unsigned int component;
+
+    components[0] = red;
+    components[1] = green;
+    components[2] = blue;
+    components[3] = alpha;
+
+    for (component = 0; component < 4; component++) {
+        float value = components[component];
+
+        color[component] = (unsigned char)((value > 1.0f) ? 255.0f : (value > 0.0f) ? value * 255.0f + 0.5f : 0.0f);
+    }
+
+    for (iter = 0; iter < pixelCount; iter++) {
+        memcpy(rasterizer->colorBuffer + 4 * iter, color, 4);
+        rasterizer->depthBuffer[iter] = 1.0f;
+    }
+
+    for (iter = 0; iter < blockCount; iter++) rasterizer->blockDepthArray[iter] = 1.0f;
+}
+
+/* returns the array with room for count elements, moved if it had to grow, or NULL if out of memory
+   (leaving the array as it was) */
+
+void* reserveRasterArray(void* array, size_t* capacity, size_t count, size_t elementSize) {
+    void* grown;
+    size_t newCapacity;
+
+    if (array != NULL && count <= *capacity) return array;
+
+    newCapacity = (*capacity > 0) ? *capacity : 64;
+    while (newCapacity < count) newCapacity *= 2;
+
+    grown = realloc(array, newCapacity * elementSize);
+    if (grown != NULL) *capacity = newCapacity;
+
+    return grown;
+}
+
+/* splits every batch into runs of its vertices and its triangles, and makes room for their clip space
+   vertices; returns 0, or -1 if out of memory */
+
+int prepareRasterRuns(Blitz3DRasterizer* rasterizer) {
+    Blitz3DBatchSet* batchSet = rasterizer->batchSet;
+    unsigned int batchCount = getBatchArrayCountFromBatchSet(batchSet);
+    unsigned int batchIter, first, pass;
+    size_t vertexTotal = 0, runCapacity;
+    void* grown;
+
+    grown = reserveRasterArray(rasterizer->clipOffsetArray, &rasterizer->clipOffsetCapacity, batchCount + 1,
+        sizeof(size_t));
+    if (grown == NULL) return -1;
+    rasterizer->clipOffsetArray = (size_t*)grown;
+
+    rasterizer->submittedCount = 0;
+
+    /* counted first, then filled in */
+
+    for (pass = 0; pass < 2; pass++) {
+        unsigned int vertexRuns = 0, triangleRuns = 0;
+
+        for (batchIter = 0; batchIter < batchCount; batchIter++) {
+            Blitz3DBatch* batch = getBatchArrayEntryFromBatchSet(batchSet, batchIter);
+            unsigned int vertexCount = getVertexCountFromBatch(batch);
+            unsigned int triangleCount = getIndexCountFromBatch(batch) / 3;
+
+            if (pass == 0) {
+                rasterizer->clipOffsetArray[batchIter] = vertexTotal;
+                vertexTotal += vertexCount;
+                rasterizer->submittedCount += triangleCount;
+            }
+
+            for (first = 0; first < vertexCount; first += BLITZ3D_RASTER_VERTEX_RUN, vertexRuns++) {
+                if (pass == 0) continue;
+
+                rasterizer->vertexRunArray[vertexRuns].batchIndex = batchIter;
+                rasterizer->vertexRunArray[vertexRuns].first = first;
+                rasterizer->vertexRunArray[vertexRuns].count = (vertexCount - first < BLITZ3D_RASTER_VERTEX_RUN)
+                    ? vertexCount - first : BLITZ3D_RASTER_VERTEX_RUN;
+            }
+
+            for (first = 0; first < triangleCount; first += BLITZ3D_RASTER_TRIANGLE_RUN, triangleRuns++) {
+                Blitz3DRasterRun* run;
+
+                if (pass == 0) continue;
+
+                run = &(rasterizer->triangleRunArray[triangleRuns]);
+                run->batchIndex = batchIter;
+                run->first = first;
+                run->count = (triangleCount - first < BLITZ3D_RASTER_TRIANGLE_RUN)
+                    ? triangleCount - first : BLITZ3D_RASTER_TRIANGLE_RUN;
+                run->triangles.count = 0;
+                run->failed = 0;
+            }
+        }
+
+        if (pass == 1) break;
+
+        rasterizer->vertexRunCount = vertexRuns;
+        rasterizer->triangleRunCount = triangleRuns;
+
+        grown = reserveRasterArray(rasterizer->vertexRunArray, &rasterizer->vertexRunCapacity, vertexRuns,
+            sizeof(Blitz3DRasterRun));
+        if (grown == NULL) return -1;
+        rasterizer->vertexRunArray = (Blitz3DRasterRun*)grown;
+
+        /* triangle runs keep their arrays from draw to draw, so new ones are set up as they appear */
+        runCapacity = rasterizer->triangleRunCapacity;
+        grown = reserveRasterArray(rasterizer->triangleRunArray, &runCapacity, triangleRuns, sizeof(Blitz3DRasterRun));
+        if (grown == NULL) return -1;
+        rasterizer->triangleRunArray = (Blitz3DRasterRun*)grown;
+
+        for (; rasterizer->triangleRunCapacity < runCapacity; rasterizer->triangleRunCapacity++) {
+            initializeDynamicArray(&(rasterizer->triangleRunArray[rasterizer->triangleRunCapacity].triangles),
+                sizeof(Blitz3DRasterTriangle), NULL);
+        }
+
+        grown = reserveRasterArray(rasterizer->clipArray, &rasterizer->clipCapacity, 4 * vertexTotal, sizeof(float));
+        if (grown == NULL) return -1;
+        rasterizer->clipArray = (float*)grown;
+
+        grown = reserveRasterArray(rasterizer->binArray, &rasterizer->binCapacity,
+            (size_t)triangleRuns * rasterizer->tileCount, sizeof(unsigned int));
+        if (grown == NULL) return -1;
+        rasterizer->binArray = (unsigned int*)grown;
+    }
+
+    return 0;
+}
+
+/* hands each run its place in every tile's list, runs in order within a tile; returns 0, or -1 if out
+   of memory */
+
+int placeRasterBins(Blitz3DRasterizer* rasterizer) {
+    unsigned int tile, runIter;
+    size_t total = 0;
+    void* grown;
+
+    rasterizer->setupCount = 0;
+
+    for (runIter = 0; runIter < rasterizer->triangleRunCount; runIter++) {
+        rasterizer->setupCount +=
+            (unsigned int)getDynamicArrayCount(&(rasterizer->triangleRunArray[runIter].triangles));
+    }
+
+    for (tile = 0; tile < rasterizer->tileCount; tile++) {
+        rasterizer->tileStartArray[tile] = (unsigned int)total;
+
+        for (runIter = 0; runIter < rasterizer->triangleRunCount; runIter++) {
+            unsigned int* bin = &(rasterizer->binArray[(size_t)runIter * rasterizer->tileCount + tile]);
+            unsigned int count = *bin;
+
+            *bin = (unsigned int)total;
+            total += count;
+        }
+    }
+
+    rasterizer->tileStartArray[rasterizer->tileCount] = (unsigned int)total;
+    rasterizer->binnedCount = (unsigned int)total;
+
+    grown = reserveRasterArray(rasterizer->tileTriangleArray, &rasterizer->tileTriangleCapacity, total,
+        sizeof(Blitz3DRasterTriangle*));
+    if (grown == NULL) return -1;
+    rasterizer->tileTriangleArray = (Blitz3DRasterTriangle**)grown;
+
+    return 0;
+}
+
+int drawBatchSetWithRasterizer(Blitz3DRasterizer* rasterizer, Blitz3DBatchSet* batchSet, Blitz3DBRUSChunk* brusChunk,
+    const float* projection, const float* modelview) {
+    unsigned int row, column, iter;
+
+    rasterizer->batchSet = batchSet;
+    rasterizer->brusChunk = brusChunk;
+    rasterizer->useSSE2 = (getSIMDLevel() == SIMD_LEVEL_SSE2);
+    rasterizer->setupCount = rasterizer->binnedCount = 0;
+
+    for (column = 0; column < 4; column++) {
+        for (row = 0; row < 4; row++) {
+            rasterizer->matrix[4 * column + row] = projection[row] * modelview[4 * column]
+                + projection[4 + row] * modelview[4 * column + 1] + projection[8 + row] * modelview[4 * column + 2]
+                + projection[12 + row] * modelview[4 * column + 3];
+        }
+    }
+
+    if (prepareRasterRuns(rasterizer) != 0) return -1;
+
+    runRasterizerStep(rasterizer, rasterizer->vertexRunCount, transformVertexRunTask);
+    runRasterizerStep(rasterizer, rasterizer->triangleRunCount, setupTriangleRunTask);
+
+    for (iter = 0; iter < rasterizer->triangleRunCount; iter++) {
+        if (rasterizer->triangleRunArray[iter].failed) return -1;
+    }
+
+    memset(rasterizer->binArray, 0,
+        (size_t)rasterizer->triangleRunCount * rasterizer->tileCount * sizeof(unsigned int));
+    runRasterizerStep(rasterizer, rasterizer->triangleRunCount, countTriangleRunTask);
+
+    if (placeRasterBins(rasterizer) != 0) return -1;
+
+    runRasterizerStep(rasterizer, rasterizer->triangleRunCount, placeTriangleRunTask);
+    runRasterizerStep(rasterizer, rasterizer->tileCount, rasterizeTileTask);
+
+    return 0;
+}
+
+unsigned char* getColorBufferFromRasterizer(Blitz3DRasterizer* rasterizer) {
+    return rasterizer->colorBuffer;
+}
+
+unsigned int getPitchFromRasterizer(Blitz3DRasterizer* rasterizer) {
+    return 4 * rasterizer->rowPixels;
+}
+
+unsigned int getSubmittedCountFromRasterizer(Blitz3DRasterizer* rasterizer) {
+    return rasterizer->submittedCount;
+}
+
+unsigned int getSetupCountFromRasterizer(Blitz3DRasterizer* rasterizer) {
+    return rasterizer->setupCount;
+}
+
+unsigned int getBinnedCountFromRasterizer(Blitz3DRasterizer* rasterizer) {
+    return rasterizer->binnedCount;
+}
@@ -0,0 +1,73 @@
+#ifndef _BLITZ3DRASTERIZER_H_
+#define _BLITZ3DRASTERIZER_H_
+
+#include "Blitz3DFile.h"
+#include "Blitz3DBatch.h"
+
+/* commentary: a software renderer for the batch set the viewer draws, for images (thumbnails,
+   comparisons) on machines with no GPU. It draws what the viewer's fixed-function setup draws: the
+   brush's texture 1 on the first tex coord set modulated by its texture 0 on the second, as bindBrush
+   binds them, depth tested with GL_LESS and nothing else. Vertex colors, normals and brush effects are
+   ignored (the viewer lights nothing, and a lightmapped level's colors are white); textures repeat
+   and are sampled nearest.
+
+   A draw runs in three steps, the first two spread over the thread pool:
+
+   - the vertices are taken to clip space;
+   - the triangles, in runs of a few thousand, are clipped against the near plane, set up (edge
+     functions, and planes for depth, 1/w and the tex coords over w) and kept if their box on screen
+     holds a pixel center;
+   - each triangle is binned into the 64 by 64 pixel tiles its box touches, in draw order, and the
+     tiles are rasterized in parallel, so no two threads ever write the same pixel. Within a tile a
+     triangle goes 8 by 8 pixel block by block: blocks it covers skip the edge tests, and blocks (or
+     the whole tile) where it is behind every pixel drawn so far are skipped, which keeps scenes with
+     a lot of overdraw from costing their full area.
+
+   The edge functions are evaluated at every pixel from the same products, so the two triangles on
+   either side of an edge get exactly opposite values there and no pixel is drawn twice or left out
+   (a pixel center on the edge goes to one of them by a top-left rule). With SSE2, where the SIMD
+   level allows, four pixels are tested and interpolated at a time; the results are the same as the
+   scalar code's, and the image does not depend on the number of threads */
+
+typedef struct Blitz3DRasterizer Blitz3DRasterizer;
+struct Blitz3DRasterizer;
+
+/* threadCount 0 uses one thread per processor, 1 draws on the calling thread alone; returns NULL if out
+   of memory */
+Blitz3DRasterizer* createRasterizer(unsigned int width, unsigned int height, unsigned int threadCount);
+
+void freeRasterizer(Blitz3DRasterizer* rasterizer);
+
+unsigned int getWidthFromRasterizer(Blitz3DRasterizer* rasterizer);
+
+unsigned int getHeightFromRasterizer(Blitz3DRasterizer* rasterizer);
+
+/* the texture for index textureIndex of the TEXS chunk: width * height RGBA pixels, the top row first
+   as glTexImage2D takes them, which are copied. Returns 0, or -1 if out of memory; brushes using a
+   texture that was never set draw that layer white */
+int setTextureInRasterizer(Blitz3DRasterizer* rasterizer, unsigned int textureIndex, unsigned int width,
+    unsigned int height, const unsigned char* pixels);
+
+/* fills the image with the color (components 0 to 1) and the depth buffer with 1 */
+void clearRasterizer(Blitz3DRasterizer* rasterizer, float red, float green, float blue, float alpha);
+
+/* draws every batch with the column-major projection and modelview matrices, as OpenGL would; the
+   brushes and their texture ids come from brusChunk, which may be NULL. Returns 0, or -1 if out of
+   memory, in which case nothing is drawn */
+int drawBatchSetWithRasterizer(Blitz3DRasterizer* rasterizer, Blitz3DBatchSet* batchSet, Blitz3DBRUSChunk* brusChunk,
+    const float* projection, const float* modelview);
+
+/* RGBA pixels, the top row first and pitch bytes from one row to the next */
+unsigned char* getColorBufferFromRasterizer(Blitz3DRasterizer* rasterizer);
+
+unsigned int getPitchFromRasterizer(Blitz3DRasterizer* rasterizer);
+
+/* counts from the last draw: triangles in the batches, triangles that reached a pixel center (each
+   piece of a clipped one counted), and triangles binned into tiles, once per tile */
+unsigned int getSubmittedCountFromRasterizer(Blitz3DRasterizer* rasterizer);
+
+unsigned int getSetupCountFromRasterizer(Blitz3DRasterizer* rasterizer);
+
+unsigned int getBinnedCountFromRasterizer(Blitz3DRasterizer* rasterizer);
+
+#endif
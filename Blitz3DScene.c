@@ -0,0 +1,423 @@
+#include "Blitz3DScene.h"
+#include "Blitz3DFileInternal.h"
+#include "SIMD.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BLITZ3D_SCENE_X86
+#include <immintrin.h>
+#endif
+
+/* Blitz3D flattened scene */
+
+struct Blitz3DScene {
+    B3DFile* file;
+
+    unsigned int nodeCount;
+
+    Blitz3DNODEChunk** nodeChunkArray;
+    Blitz3DMESHChunk** meshChunkArray;
+    int* parentArray;
+    unsigned int* subtreeEndArray;
+
+    /* 3, 3 and 4 floats per node */
+    float* positionArray;
+    float* scaleArray;
+    float* rotationArray;
+
+    /* 16 floats per node */
+    float* worldMatrixArray;
+};
+
+/* flattening */
+
+unsigned int countNODEChunks(Blitz3DNODEChunk* nodeChunk) {
+    unsigned int output = 1;
+    unsigned int iter;
+
+    for (iter = 0; iter < nodeChunk->nodeChunkCount; iter++) output += countNODEChunks(nodeChunk->nodeChunkArray[iter]);
+
+    return output;
+}
+
+void addNODEChunkToScene(Blitz3DScene* scene, Blitz3DNODEChunk* nodeChunk, int parent, unsigned int* index) {
+    unsigned int self = (*index)++;
+    unsigned int iter;
+
+    scene->nodeChunkArray[self] = nodeChunk;
+    scene->meshChunkArray[self] = nodeChunk->meshChunk;
+    scene->parentArray[self] = parent;
+
+    memcpy(scene->positionArray + 3 * (size_t)self, nodeChunk->position, 3 * sizeof(float));
+    memcpy(scene->scaleArray + 3 * (size_t)self, nodeChunk->scale, 3 * sizeof(float));
+    memcpy(scene->rotationArray + 4 * (size_t)self, nodeChunk->rotation, 4 * sizeof(float));
+
+    for (iter = 0; iter < nodeChunk->nodeChunkCount; iter++) {
+        addNODEChunkToScene(scene, nodeChunk->nodeChunkArray[iter], (int)self, index);
+    }
+
+    scene->subtreeEndArray[self] = *index;
+}
+
+/* local matrices */
+
+/* commentary: the rotation is turned into a matrix the way Blitz3D itself does it (Matrix(Quat) in
+   its geom.h), with the columns scaled by the node's scale and the position as the last column */
+
+void composeLocalMatrixScalar(const float* position, const float* scale, const float* rotation, float* matrix) {
+    float w = rotation[0], x = rotation[1], y = rotation[2], z = rotation[3];
+    float xx = x * x, yy = y * y, zz = z * z;
+    float xy = x * y, xz = x * z, yz = y * z;
+    float wx = w * x, wy = w * y, wz = w * z;
+
+    matrix[0] = (1.0f - 2.0f * (yy + zz)) * scale[0];
+    matrix[1] = 2.0f * (xy - wz) * scale[0];
+    matrix[2] = 2.0f * (xz + wy) * scale[0];
+    matrix[3] = 0.0f;
+
+    matrix[4] = 2.0f * (xy + wz) * scale[1];
+    matrix[5] = (1.0f - 2.0f * (xx + zz)) * scale[1];
+    matrix[6] = 2.0f * (yz - wx) * scale[1];
+    matrix[7] = 0.0f;
+
+    matrix[8] = 2.0f * (xz - wy) * scale[2];
+    matrix[9] = 2.0f * (yz + wx) * scale[2];
+    matrix[10] = (1.0f - 2.0f * (xx + yy)) * scale[2];
+    matrix[11] = 0.0f;
+
+    matrix[12] = position[0];
+    matrix[13] = position[1];
+    matrix[14] = position[2];
+    matrix[15] = 1.0f;
+}
+
+/* column-major: output = left * right; output may be right but not left */
+
+void multiplyMatricesScalar(const float* left, const float* right, float* output) {
+    unsigned int column, row;
+
+    for (column = 0; column < 4; column++) {
+        float value[4];
+
+        for (row = 0; row < 4; row++) {
+            value[row] = left[row] * right[4 * column] + left[4 + row] * right[4 * column + 1]
+                + left[8 + row] * right[4 * column + 2] + left[12 + row] * right[4 * column + 3];
+        }
+
+        memcpy(output + 4 * column, value, sizeof(value));
+    }
+}
+
+#ifdef BLITZ3D_SCENE_X86
+
+/* commentary: four nodes at a time. The quaternions are transposed so each register holds one
+   component of all four, the matrix entries are worked out the same way, and transposing back
+   turns each group of four entries into one column per node */
+
+__attribute__((target("sse2")))
+void composeLocalMatricesSSE2(const float* position, const float* scale, const float* rotation, float* matrix) {
+    __m128 w = _mm_loadu_ps(rotation);
+    __m128 x = _mm_loadu_ps(rotation + 4);
+    __m128 y = _mm_loadu_ps(rotation + 8);
+    __m128 z = _mm_loadu_ps(rotation + 12);
+    __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+    __m128 xx, yy, zz, xy, xz, yz, wx, wy, wz;
+    __m128 sx, sy, sz, px, py, pz;
+    __m128 c0x, c0y, c0z, c1x, c1y, c1z, c2x, c2y, c2z, c3w;
+
+    _MM_TRANSPOSE4_PS(w, x, y, z);
+
+    xx = _mm_mul_ps(x, x); yy = _mm_mul_ps(y, y); zz = _mm_mul_ps(z, z);
+    xy = _mm_mul_ps(x, y); xz = _mm_mul_ps(x, z); yz = _mm_mul_ps(y, z);
+    wx = _mm_mul_ps(w, x); wy = _mm_mul_ps(w, y); wz = _mm_mul_ps(w, z);
+
+    sx = _mm_set_ps(scale[9], scale[6], scale[3], scale[0]);
+    sy = _mm_set_ps(scale[10], scale[7], scale[4], scale[1]);
+    sz = _mm_set_ps(scale[11], scale[8], scale[5], scale[2]);
+
+    px = _mm_set_ps(position[9], position[6], position[3], position[0]);
+    py = _mm_set_ps(position[10], position[7], position[4], position[1]);
+    pz = _mm_set_ps(position[11], position[8], position[5], position[2]);
+
+    c0x = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+    c0y = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sx);
+    c0z = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sx);
+
+    c1x = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sy);
+    c1y = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+    c1z = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sy);
+
+    c2x = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sz);
+    c2y = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sz);
+    c2z = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+
+    w = zero;
+    _MM_TRANSPOSE4_PS(c0x, c0y, c0z, w);
+    _mm_storeu_ps(matrix, c0x); _mm_storeu_ps(matrix + 16, c0y); _mm_storeu_ps(matrix + 32, c0z); _mm_storeu_ps(matrix + 48, w);
+
+    w = zero;
+    _MM_TRANSPOSE4_PS(c1x, c1y, c1z, w);
+    _mm_storeu_ps(matrix + 4, c1x); _mm_storeu_ps(matrix + 20, c1y); _mm_storeu_ps(matrix + 36, c1z); _mm_storeu_ps(matrix + 52, w);
+
+    w = zero;
+    _MM_TRANSPOSE4_PS(c2x, c2y, c2z, w);
+    _mm_storeu_ps(matrix + 8, c2x); _mm_storeu_ps(matrix + 24, c2y); _mm_storeu_ps(matrix + 40, c2z); _mm_storeu_ps(matrix + 56, w);
+
+    c3w = one;
+    _MM_TRANSPOSE4_PS(px, py, pz, c3w);
+    _mm_storeu_ps(matrix + 12, px); _mm_storeu_ps(matrix + 28, py); _mm_storeu_ps(matrix + 44, pz); _mm_storeu_ps(matrix + 60, c3w);
+}
+
+__attribute__((target("sse2")))
+void multiplyMatricesSSE2(const float* left, const float* right, float* output) {
+    __m128 l0 = _mm_loadu_ps(left), l1 = _mm_loadu_ps(left + 4);
+    __m128 l2 = _mm_loadu_ps(left + 8), l3 = _mm_loadu_ps(left + 12);
+    unsigned int column;
+
+    for (column = 0; column < 4; column++) {
+        const float* r = right + 4 * column;
+        __m128 value = _mm_mul_ps(l0, _mm_set1_ps(r[0]));
+
+        value = _mm_add_ps(value, _mm_mul_ps(l1, _mm_set1_ps(r[1])));
+        value = _mm_add_ps(value, _mm_mul_ps(l2, _mm_set1_ps(r[2])));
+        value = _mm_add_ps(value, _mm_mul_ps(l3, _mm_set1_ps(r[3])));
+
+        _mm_storeu_ps(output + 4 * column, value);
+    }
+}
+
+#endif
+
+/* public functions */
+
+Blitz3DScene* createSceneFromB3DFile(B3DFile* blitz3dFile) {
+    Blitz3DScene* output;
+    unsigned int index = 0;
+    size_t count;
+
+    if (blitz3dFile->bb3dChunk->nodeChunk == NULL) return NULL;
+
+    output = (Blitz3DScene*)calloc(1, sizeof(Blitz3DScene));
+    if (output == NULL) return NULL;
+
+    output->file = blitz3dFile;
+    output->nodeCount = countNODEChunks(blitz3dFile->bb3dChunk->nodeChunk);
+    count = output->nodeCount;
+
+    output->nodeChunkArray = (Blitz3DNODEChunk**)malloc(count * sizeof(Blitz3DNODEChunk*));
+    output->meshChunkArray = (Blitz3DMESHChunk**)malloc(count * sizeof(Blitz3DMESHChunk*));
+    output->parentArray = (int*)malloc(count * sizeof(int));
+    output->subtreeEndArray = (unsigned int*)malloc(count * sizeof(unsigned int));
+    output->positionArray = (float*)malloc(3 * count * sizeof(float));
+    output->scaleArray = (float*)malloc(3 * count * sizeof(float));
+    output->rotationArray = (float*)malloc(4 * count * sizeof(float));
+    output->worldMatrixArray = (float*)malloc(16 * count * sizeof(float));
+
+    if (output->nodeChunkArray == NULL || output->meshChunkArray == NULL || output->parentArray == NULL
+        || output->subtreeEndArray == NULL || output->positionArray == NULL || output->scaleArray == NULL
+        || output->rotationArray == NULL || output->worldMatrixArray == NULL) {
+
+        freeScene(output);
+        return NULL;
+    }
+
+    addNODEChunkToScene(output, blitz3dFile->bb3dChunk->nodeChunk, -1, &index);
+    updateWorldMatricesInScene(output);
+
+    return output;
+}
+
+void freeScene(Blitz3DScene* scene) {
+    free(scene->nodeChunkArray);
+    free(scene->meshChunkArray);
+    free(scene->parentArray);
+    free(scene->subtreeEndArray);
+    free(scene->positionArray);
+    free(scene->scaleArray);
+    free(scene->rotationArray);
+    free(scene->worldMatrixArray);
+
+    free(scene);
+}
+
+B3DFile* getFileFromScene(Blitz3DScene* scene) {
+    return scene->file;
+}
+
+/* commentary: the local matrices are written into the world matrix array first; a parent always comes
+   before its children, so one pass front to back turns each into parent world times local */
+
+void updateWorldMatricesInScene(Blitz3DScene* scene) {
+    int useSSE2 = (getSIMDLevel() == SIMD_LEVEL_SSE2);
+    unsigned int iter = 0;
+
+#ifdef BLITZ3D_SCENE_X86
+    if (useSSE2) {
+        for (; iter + 4 <= scene->nodeCount; iter += 4) {
+            composeLocalMatricesSSE2(scene->positionArray + 3 * (size_t)iter, scene->scaleArray + 3 * (size_t)iter,
+                scene->rotationArray + 4 * (size_t)iter, scene->worldMatrixArray + 16 * (size_t)iter);
+        }
+    }
+#endif
+
+    for (; iter < scene->nodeCount; iter++) {
+        composeLocalMatrixScalar(scene->positionArray + 3 * (size_t)iter, scene->scaleArray + 3 * (size_t)iter,
+            scene->rotationArray + 4 * (size_t)iter, scene->worldMatrixArray + 16 * (size_t)iter);
+    }
+
+    for (iter = 0; iter < scene->nodeCount; iter++) {
+        float* matrix = scene->worldMatrixArray + 16 * (size_t)iter;
+        const float* parentMatrix;
+
+        if (scene->parentArray[iter] < 0) continue;
+
+        parentMatrix = scene->worldMatrixArray + 16 * (size_t)scene->parentArray[iter];
+
+#ifdef BLITZ3D_SCENE_X86
+        if (useSSE2) {
+            multiplyMatricesSSE2(parentMatrix, matrix, matrix);
+            continue;
+        }
+#endif
+
+        multiplyMatricesScalar(parentMatrix, matrix, matrix);
+    }
+}
+
+void bakeTransformsIntoScene(Blitz3DScene* scene) {
+    const float identityRotation[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+    const float ones[3] = { 1.0f, 1.0f, 1.0f };
+    unsigned int iter, vertex;
+
+    for (iter = 0; iter < scene->nodeCount; iter++) {
+        const float* matrix = scene->worldMatrixArray + 16 * (size_t)iter;
+        Blitz3DVRTSChunk* vrtsChunk;
+        float normalMatrix[9];
+
+        if (scene->meshChunkArray[iter] == NULL) continue;
+
+        vrtsChunk = getVRTSChunkFromMESHChunk(scene->meshChunkArray[iter]);
+        if (vrtsChunk == NULL) continue;
+
+        getNormalMatrixFromMatrix(matrix, normalMatrix);
+
+        for (vertex = 0; vertex < vrtsChunk->vertexCount; vertex++) {
+            float* position = vrtsChunk->vertexArray + 3 * (size_t)vertex;
+            float value[3];
+
+            transformPositionByMatrix(matrix, position, value);
+            memcpy(position, value, sizeof(value));
+
+            if (vrtsChunk->normalArray != NULL) {
+                float* normal = vrtsChunk->normalArray + 3 * (size_t)vertex;
+
+                transformNormalByMatrix(normalMatrix, normal, value);
+                memcpy(normal, value, sizeof(value));
+            }
+        }
+    }
+
+    for (iter = 0; iter < scene->nodeCount; iter++) {
+        Blitz3DNODEChunk* nodeChunk = scene->nodeChunkArray[iter];
+
+        memset(scene->positionArray + 3 * (size_t)iter, 0, 3 * sizeof(float));
+        memcpy(scene->scaleArray + 3 * (size_t)iter, ones, sizeof(ones));
+        memcpy(scene->rotationArray + 4 * (size_t)iter, identityRotation, sizeof(identityRotation));
+
+        memset(nodeChunk->position, 0, sizeof(nodeChunk->position));
+        memcpy(nodeChunk->scale, ones, sizeof(ones));
+        memcpy(nodeChunk->rotation, identityRotation, sizeof(identityRotation));
+    }
+
+    updateWorldMatricesInScene(scene);
+    updateBoundsInB3DFile(scene->file);
+}
+
+unsigned int getNodeCountFromScene(Blitz3DScene* scene) {
+    return scene->nodeCount;
+}
+
+Blitz3DNODEChunk* getNODEChunkFromScene(Blitz3DScene* scene, unsigned int index) {
+    return scene->nodeChunkArray[index];
+}
+
+Blitz3DMESHChunk* getMESHChunkFromScene(Blitz3DScene* scene, unsigned int index) {
+    return scene->meshChunkArray[index];
+}
+
+int getParentIndexFromScene(Blitz3DScene* scene, unsigned int index) {
+    return scene->parentArray[index];
+}
+
+unsigned int getSubtreeEndFromScene(Blitz3DScene* scene, unsigned int index) {
+    return scene->subtreeEndArray[index];
+}
+
+float* getPositionFromScene(Blitz3DScene* scene, unsigned int index) {
+    return scene->positionArray + 3 * (size_t)index;
+}
+
+float* getScaleFromScene(Blitz3DScene* scene, unsigned int index) {
+    return scene->scaleArray + 3 * (size_t)index;
+}
+
+float* getRotationFromScene(Blitz3DScene* scene, unsigned int index) {
+    return scene->rotationArray + 4 * (size_t)index;
+}
+
+float* getWorldMatrixFromScene(Blitz3DScene* scene, unsigned int index) {
+    return scene->worldMatrixArray + 16 * (size_t)index;
+}
+
+/* commentary: with the upper 3x3 as columns a, b and c, the inverse transpose has the columns b x c,
+   c x a and a x b over the determinant. A singular matrix keeps the cofactors, which still point
+   the right way for whatever normals survive */
+
+void getNormalMatrixFromMatrix(const float* matrix, float* normalMatrix) {
+    const float* a = matrix;
+    const float* b = matrix + 4;
+    const float* c = matrix + 8;
+    float determinant;
+    unsigned int iter;
+
+    normalMatrix[0] = b[1] * c[2] - b[2] * c[1];
+    normalMatrix[1] = b[2] * c[0] - b[0] * c[2];
+    normalMatrix[2] = b[0] * c[1] - b[1] * c[0];
+
+    normalMatrix[3] = c[1] * a[2] - c[2] * a[1];
+    normalMatrix[4] = c[2] * a[0] - c[0] * a[2];
+    normalMatrix[5] = c[0] * a[1] - c[1] * a[0];
+
+    normalMatrix[6] = a[1] * b[2] - a[2] * b[1];
+    normalMatrix[7] = a[2] * b[0] - a[0] * b[2];
+    normalMatrix[8] = a[0] * b[1] - a[1] * b[0];
+
+    determinant = a[0] * normalMatrix[0] + a[1] * normalMatrix[1] + a[2] * normalMatrix[2];
+    if (determinant == 0.0f) return;
+
+    for (iter = 0; iter < 9; iter++) normalMatrix[iter] /= determinant;
+}
+
+void transformPositionByMatrix(const float* matrix, const float* position, float* output) {
+    output[0] = matrix[0] * position[0] + matrix[4] * position[1] + matrix[8] * position[2] + matrix[12];
+    output[1] = matrix[1] * position[0] + matrix[5] * position[1] + matrix[9] * position[2] + matrix[13];
+    output[2] = matrix[2] * position[0] + matrix[6] * position[1] + matrix[10] * position[2] + matrix[14];
+}
+
+void transformNormalByMatrix(const float* normalMatrix, const float* normal, float* output) {
+    float length;
+
+    output[0] = normalMatrix[0] * normal[0] + normalMatrix[3] * normal[1] + normalMatrix[6] * normal[2];
+    output[1] = normalMatrix[1] * normal[0] + normalMatrix[4] * normal[1] + normalMatrix[7] * normal[2];
+    output[2] = normalMatrix[2] * normal[0] + normalMatrix[5] * normal[1] + normalMatrix[8] * normal[2];
+
+    length = (float)sqrt(output[0] * output[0] + output[1] * output[1] + output[2] * output[2]);
+    if (length == 0.0f) return;
+
+    output[0] /= length;
+    output[1] /= length;
+    output[2] /= length;
+}
@@ -0,0 +1,70 @@
+#ifndef _BLITZ3DSCENE_H_
+#define _BLITZ3DSCENE_H_
+
+#include "Blitz3DFile.h"
+
+/* commentary: a flattened copy of the NODE tree. Nodes are numbered depth first, so a node's parent
+   always comes before it and its descendants are the nodes from index + 1 up to its subtree end;
+   walking the arrays front to back visits the tree in the same order the recursive walk did.
+
+   Each node has its local transform as read from the file (position, scale and a w, x, y, z
+   rotation quaternion) and a world matrix, column-major as OpenGL takes it, so a node is drawn
+   with glMultMatrixf(getWorldMatrixFromScene(scene, index)). The scene refers to the file's NODE
+   and MESH chunks and must be freed before the file */
+
+typedef struct Blitz3DScene Blitz3DScene;
+struct Blitz3DScene;
+
+/* returns NULL if the file has no nodes or out of memory */
+Blitz3DScene* createSceneFromB3DFile(B3DFile* blitz3dFile);
+
+void freeScene(Blitz3DScene* scene);
+
+B3DFile* getFileFromScene(Blitz3DScene* scene);
+
+/* recomputes every world matrix, after local transforms were changed through the pointers below */
+void updateWorldMatricesInScene(Blitz3DScene* scene);
+
+/* commentary: moves every world transform into the vertex data: positions go through the node's world
+   matrix and normals through its inverse transpose (renormalized), and every local transform becomes
+   the identity, in the scene and in the NODE chunks, so a file saved afterwards draws the same. The
+   file's bounds are brought up to date as well. Meshes
+   of index-only files are decoded for this and must not be evicted afterwards, or the bake is lost */
+
+void bakeTransformsIntoScene(Blitz3DScene* scene);
+
+unsigned int getNodeCountFromScene(Blitz3DScene* scene);
+
+Blitz3DNODEChunk* getNODEChunkFromScene(Blitz3DScene* scene, unsigned int index);
+
+/* NULL for nodes without a mesh */
+Blitz3DMESHChunk* getMESHChunkFromScene(Blitz3DScene* scene, unsigned int index);
+
+/* -1 for the root */
+int getParentIndexFromScene(Blitz3DScene* scene, unsigned int index);
+
+/* one past the node's last descendant */
+unsigned int getSubtreeEndFromScene(Blitz3DScene* scene, unsigned int index);
+
+/* 3 floats */
+float* getPositionFromScene(Blitz3DScene* scene, unsigned int index);
+
+/* 3 floats */
+float* getScaleFromScene(Blitz3DScene* scene, unsigned int index);
+
+/* 4 floats, w first */
+float* getRotationFromScene(Blitz3DScene* scene, unsigned int index);
+
+/* 16 floats, column-major */
+float* getWorldMatrixFromScene(Blitz3DScene* scene, unsigned int index);
+
+/* the 3x3 column-major matrix normals go through: the inverse transpose of the matrix's upper 3x3 */
+void getNormalMatrixFromMatrix(const float* matrix, float* normalMatrix);
+
+/* output may not alias the input */
+void transformPositionByMatrix(const float* matrix, const float* position, float* output);
+
+/* renormalizes the result; zero normals stay zero */
+void transformNormalByMatrix(const float* normalMatrix, const float* normal, float* output);
+
+#endif
@@ -0,0 +1,511 @@
+#include "Blitz3DStream.h"
+#include "Blitz3DFileInternal.h"
+#include "BulkDecode.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* Blitz3D stream states */
+
+#define BLITZ3D_STREAM_STATE_HEADER 0
+#define BLITZ3D_STREAM_STATE_PAYLOAD 1
+#define BLITZ3D_STREAM_STATE_NAME 2
+#define BLITZ3D_STREAM_STATE_SKIP 3
+#define BLITZ3D_STREAM_STATE_DONE 4
+#define BLITZ3D_STREAM_STATE_ERROR 5
+
+/* every chunk starts with a 4-byte tag and a 4-byte size */
+#define BLITZ3D_STREAM_HEADER_SIZE 8
+
+/* a NODE chunk's fixed fields after its name: position, scale and rotation */
+#define BLITZ3D_STREAM_NODE_FIELD_SIZE 40
+
+#define BLITZ3D_STREAM_ARENA_BLOCK_SIZE (64 * 1024)
+
+/* an open container chunk (BB3D, NODE or MESH), kept until the stream reaches its end */
+
+typedef struct Blitz3DStreamFrame Blitz3DStreamFrame;
+struct Blitz3DStreamFrame {
+    uint32_t tag;
+    uint64_t end;
+
+    Blitz3DNODEChunk node;
+    Blitz3DMESHChunk mesh;
+
+    char* name;
+    size_t nameCapacity;
+};
+
+struct Blitz3DStream {
+    Blitz3DStreamCallbacks callbacks;
+    void* context;
+
+    int state;
+    int version;
+
+    /* bytes consumed so far, and where the chunk being read starts */
+    uint64_t position;
+    uint64_t chunkOffset;
+    uint64_t skipRemaining;
+
+    uint32_t chunkTag;
+    uint32_t chunkSize;
+
+    /* holds the current chunk's header followed by as much of its payload as has to be buffered */
+    unsigned char* buffer;
+    size_t bufferUsed;
+    size_t bufferTarget;
+    size_t bufferCapacity;
+
+    Blitz3DStreamFrame** frames;
+    unsigned int frameCount;
+    unsigned int frameCapacity;
+
+    /* decoded chunks live here until their callback returns */
+    Arena* arena;
+    size_t peakArenaBytes;
+};
+
+/* Blitz3D stream helpers */
+
+uint32_t read32BitIntegerFromStreamBytes(const unsigned char* bytes) {
+    return (uint32_t)bytes[0]
+        | ((uint32_t)bytes[1] << 0x08)
+        | ((uint32_t)bytes[2] << 0x10)
+        | ((uint32_t)bytes[3] << 0x18);
+}
+
+float readFloatFromStreamBytes(const unsigned char* bytes) {
+    uint32_t bits = read32BitIntegerFromStreamBytes(bytes);
+    float output;
+
+    memcpy(&output, &bits, sizeof(float));
+
+    return output;
+}
+
+void failBlitz3DStream(Blitz3DStream* stream, const char* message) {
+    fprintf(stderr, "B3D stream: %s at offset %lu\n", message, (unsigned long)stream->chunkOffset);
+
+    stream->state = BLITZ3D_STREAM_STATE_ERROR;
+}
+
+int reserveStreamBuffer(Blitz3DStream* stream, size_t size) {
+    unsigned char* buffer;
+    size_t capacity;
+
+    if (size <= stream->bufferCapacity) return 0;
+
+    capacity = (stream->bufferCapacity > 0) ? stream->bufferCapacity : 256;
+    while (capacity < size) capacity = (capacity * 2 > capacity) ? capacity * 2 : size;
+
+    buffer = (unsigned char*)realloc(stream->buffer, capacity);
+    if (buffer == NULL) return -1;
+
+    stream->buffer = buffer;
+    stream->bufferCapacity = capacity;
+
+    return 0;
+}
+
+void appendToStreamBuffer(Blitz3DStream* stream, const unsigned char* bytes, size_t count) {
+    memcpy(stream->buffer + stream->bufferUsed, bytes, count);
+    stream->bufferUsed += count;
+}
+
+Blitz3DStreamFrame* getTopFrameFromStream(Blitz3DStream* stream) {
+    return (stream->frameCount > 0) ? stream->frames[stream->frameCount - 1] : NULL;
+}
+
+Blitz3DStreamFrame* pushStreamFrame(Blitz3DStream* stream, uint32_t tag, uint64_t end) {
+    Blitz3DStreamFrame* output;
+
+    if (stream->frameCount == stream->frameCapacity) {
+        unsigned int capacity = (stream->frameCapacity > 0) ? stream->frameCapacity * 2 : 16;
+
+        stream->frames = (Blitz3DStreamFrame**)realloc(stream->frames, capacity * sizeof(Blitz3DStreamFrame*));
+        memset(stream->frames + stream->frameCapacity, 0, (capacity - stream->frameCapacity) * sizeof(Blitz3DStreamFrame*));
+        stream->frameCapacity = capacity;
+    }
+
+    /* commentary: frames are allocated once and reused, so a parent's chunk never moves while its children are read */
+
+    if (stream->frames[stream->frameCount] == NULL) {
+        stream->frames[stream->frameCount] = (Blitz3DStreamFrame*)calloc(1, sizeof(Blitz3DStreamFrame));
+    }
+
+    output = stream->frames[stream->frameCount++];
+
+    output->tag = tag;
+    output->end = end;
+
+    memset(&(output->node), 0, sizeof(Blitz3DNODEChunk));
+    memset(&(output->mesh), 0, sizeof(Blitz3DMESHChunk));
+
+    return output;
+}
+
+/* called whenever a chunk has been fully consumed; closes every container that ends here */
+
+void finishStreamChunk(Blitz3DStream* stream) {
+    Blitz3DStreamFrame* frame;
+
+    stream->state = BLITZ3D_STREAM_STATE_HEADER;
+    stream->bufferUsed = 0;
+    stream->bufferTarget = BLITZ3D_STREAM_HEADER_SIZE;
+
+    while ((frame = getTopFrameFromStream(stream)) != NULL && frame->end == stream->position) {
+        stream->frameCount--;
+
+        if (frame->tag == BLITZ3D_TAG_NODE_LITTLE_ENDIAN) {
+            if (stream->callbacks.nodeEnd != NULL) stream->callbacks.nodeEnd(stream->context, &(frame->node));
+        }
+        else if (frame->tag == BLITZ3D_TAG_MESH_LITTLE_ENDIAN) {
+            Blitz3DStreamFrame* parent = getTopFrameFromStream(stream);
+
+            if (stream->callbacks.meshEnd != NULL) stream->callbacks.meshEnd(stream->context, &(frame->mesh));
+
+            if (parent != NULL) parent->node.meshChunk = NULL;
+        }
+        else if (frame->tag == BLITZ3D_TAG_BB3D_LITTLE_ENDIAN) {
+            stream->state = BLITZ3D_STREAM_STATE_DONE;
+        }
+    }
+}
+
+/* decoding completed chunks */
+
+/* commentary: the buffered bytes are exactly what the loader's chunk readers expect after a tag, so
+   TEXS, BRUS, VRTS and TRIS chunks are decoded by the same code as a mapped file */
+
+void decodeStreamLeafChunk(Blitz3DStream* stream, const unsigned char* chunk) {
+    Blitz3DStreamFrame* frame = getTopFrameFromStream(stream);
+    Blitz3DReader reader;
+    unsigned int iter;
+
+    initializeMemoryReader(&reader, chunk, BLITZ3D_STREAM_HEADER_SIZE + (size_t)stream->chunkSize);
+    reader.position = 4;
+    reader.arena = stream->arena;
+
+    if (stream->chunkTag == BLITZ3D_TAG_TEXS_LITTLE_ENDIAN) {
+        Blitz3DTEXSChunk* texsChunk = readBlitz3DTEXSChunk(&reader);
+
+        if (!reader.error && stream->callbacks.texture != NULL) {
+            for (iter = 0; iter < texsChunk->textureCount; iter++) {
+                stream->callbacks.texture(stream->context, texsChunk->textureArray[iter], iter);
+            }
+        }
+    }
+    else if (stream->chunkTag == BLITZ3D_TAG_BRUS_LITTLE_ENDIAN) {
+        Blitz3DBRUSChunk* brusChunk = readBlitz3DBRUSChunk(&reader);
+
+        if (!reader.error && stream->callbacks.brush != NULL) {
+            for (iter = 0; iter < brusChunk->brushCount; iter++) {
+                stream->callbacks.brush(stream->context, brusChunk->brushArray[iter], iter, brusChunk->n_texs);
+            }
+        }
+    }
+    else if (stream->chunkTag == BLITZ3D_TAG_VRTS_LITTLE_ENDIAN) {
+        Blitz3DVRTSChunk* vrtsChunk = readBlitz3DVRTSChunk(&reader);
+
+        if (!reader.error && stream->callbacks.meshVertices != NULL) {
+            stream->callbacks.meshVertices(stream->context, &(frame->mesh), vrtsChunk);
+        }
+    }
+    else if (stream->chunkTag == BLITZ3D_TAG_TRIS_LITTLE_ENDIAN) {
+        Blitz3DTRISChunk* trisChunk = readBlitz3DTRISChunk(&reader);
+
+        if (!reader.error && stream->callbacks.triangleBatch != NULL) {
+            stream->callbacks.triangleBatch(stream->context, &(frame->mesh), trisChunk);
+        }
+    }
+
+    if (getBytesReservedFromArena(stream->arena) > stream->peakArenaBytes) {
+        stream->peakArenaBytes = getBytesReservedFromArena(stream->arena);
+    }
+
+    resetArena(stream->arena);
+
+    if (reader.error) failBlitz3DStream(stream, "malformed chunk");
+}
+
+void openStreamContainer(Blitz3DStream* stream, const unsigned char* chunk) {
+    Blitz3DStreamFrame* parent = getTopFrameFromStream(stream);
+    Blitz3DStreamFrame* frame;
+    uint64_t end = stream->chunkOffset + BLITZ3D_STREAM_HEADER_SIZE + stream->chunkSize;
+    const unsigned char* fields;
+    size_t nameLength;
+    int iter;
+
+    if (stream->chunkTag == BLITZ3D_TAG_BB3D_LITTLE_ENDIAN) {
+        stream->version = (int)read32BitIntegerFromStreamBytes(chunk + BLITZ3D_STREAM_HEADER_SIZE);
+
+        pushStreamFrame(stream, stream->chunkTag, end);
+    }
+    else if (stream->chunkTag == BLITZ3D_TAG_MESH_LITTLE_ENDIAN) {
+        frame = pushStreamFrame(stream, stream->chunkTag, end);
+
+        frame->mesh.fileOffset = stream->chunkOffset;
+        frame->mesh.brush_id = (int)read32BitIntegerFromStreamBytes(chunk + BLITZ3D_STREAM_HEADER_SIZE);
+
+        parent->node.meshChunk = &(frame->mesh);
+
+        if (stream->callbacks.meshBegin != NULL) stream->callbacks.meshBegin(stream->context, &(frame->mesh));
+    }
+    else {
+        frame = pushStreamFrame(stream, stream->chunkTag, end);
+
+        /* the name runs up to the terminator found while buffering; the fixed fields follow it */
+
+        nameLength = strlen((const char*)chunk + BLITZ3D_STREAM_HEADER_SIZE);
+
+        if (nameLength + 1 > frame->nameCapacity) {
+            frame->nameCapacity = nameLength + 1;
+            frame->name = (char*)realloc(frame->name, frame->nameCapacity);
+        }
+
+        memcpy(frame->name, chunk + BLITZ3D_STREAM_HEADER_SIZE, nameLength + 1);
+
+        fields = chunk + BLITZ3D_STREAM_HEADER_SIZE + nameLength + 1;
+
+        for (iter = 0; iter < 3; iter++) frame->node.position[iter] = readFloatFromStreamBytes(fields + 4 * iter);
+        for (iter = 0; iter < 3; iter++) frame->node.scale[iter] = readFloatFromStreamBytes(fields + 12 + 4 * iter);
+        for (iter = 0; iter < 4; iter++) frame->node.rotation[iter] = readFloatFromStreamBytes(fields + 24 + 4 * iter);
+
+        frame->node.name = frame->name;
+        frame->node.fileOffset = stream->chunkOffset;
+
+        if (stream->callbacks.nodeBegin != NULL) stream->callbacks.nodeBegin(stream->context, &(frame->node));
+    }
+}
+
+void completeStreamPayload(Blitz3DStream* stream, const unsigned char* chunk) {
+    if (stream->chunkTag == BLITZ3D_TAG_BB3D_LITTLE_ENDIAN
+        || stream->chunkTag == BLITZ3D_TAG_NODE_LITTLE_ENDIAN
+        || stream->chunkTag == BLITZ3D_TAG_MESH_LITTLE_ENDIAN) {
+        openStreamContainer(stream, chunk);
+    }
+    else {
+        decodeStreamLeafChunk(stream, chunk);
+    }
+
+    if (stream->state != BLITZ3D_STREAM_STATE_ERROR) finishStreamChunk(stream);
+}
+
+/* picks what to do with a chunk from its tag and the container it is in, mirroring the loader:
+   TEXS, BRUS and NODE inside BB3D, NODE and MESH inside NODE, VRTS and TRIS inside MESH */
+
+void beginStreamChunk(Blitz3DStream* stream, const unsigned char* header) {
+    Blitz3DStreamFrame* parent = getTopFrameFromStream(stream);
+    uint32_t parentTag = (parent != NULL) ? parent->tag : 0;
+    uint64_t end;
+
+    stream->chunkTag = read32BitIntegerFromStreamBytes(header);
+    stream->chunkSize = read32BitIntegerFromStreamBytes(header + 4);
+
+    end = stream->chunkOffset + BLITZ3D_STREAM_HEADER_SIZE + stream->chunkSize;
+
+    if (parent == NULL && stream->chunkTag != BLITZ3D_TAG_BB3D_LITTLE_ENDIAN) {
+        failBlitz3DStream(stream, "not a BB3D file");
+        return;
+    }
+
+    if (parent != NULL && end > parent->end) {
+        failBlitz3DStream(stream, "chunk runs past its parent");
+        return;
+    }
+
+    stream->state = BLITZ3D_STREAM_STATE_PAYLOAD;
+
+    if (parent == NULL
+        || (parentTag == BLITZ3D_TAG_NODE_LITTLE_ENDIAN && stream->chunkTag == BLITZ3D_TAG_MESH_LITTLE_ENDIAN)) {
+        /* BB3D starts with its version and MESH with its brush id */
+
+        if (stream->chunkSize < 4) failBlitz3DStream(stream, "container chunk too small");
+
+        stream->bufferTarget = BLITZ3D_STREAM_HEADER_SIZE + 4;
+    }
+    else if ((parentTag == BLITZ3D_TAG_BB3D_LITTLE_ENDIAN || parentTag == BLITZ3D_TAG_NODE_LITTLE_ENDIAN)
+        && stream->chunkTag == BLITZ3D_TAG_NODE_LITTLE_ENDIAN) {
+        stream->state = BLITZ3D_STREAM_STATE_NAME;
+    }
+    else if ((parentTag == BLITZ3D_TAG_BB3D_LITTLE_ENDIAN
+            && (stream->chunkTag == BLITZ3D_TAG_TEXS_LITTLE_ENDIAN || stream->chunkTag == BLITZ3D_TAG_BRUS_LITTLE_ENDIAN))
+        || (parentTag == BLITZ3D_TAG_MESH_LITTLE_ENDIAN
+            && (stream->chunkTag == BLITZ3D_TAG_VRTS_LITTLE_ENDIAN || stream->chunkTag == BLITZ3D_TAG_TRIS_LITTLE_ENDIAN))) {
+        stream->bufferTarget = BLITZ3D_STREAM_HEADER_SIZE + (size_t)stream->chunkSize;
+    }
+    else {
+        stream->state = BLITZ3D_STREAM_STATE_SKIP;
+        stream->skipRemaining = stream->chunkSize;
+    }
+}
+
+/* public functions */
+
+Blitz3DStream* createBlitz3DStream(const Blitz3DStreamCallbacks* callbacks, void* context) {
+    Blitz3DStream* output = (Blitz3DStream*)calloc(1, sizeof(Blitz3DStream));
+
+    if (callbacks != NULL) output->callbacks = *callbacks;
+    output->context = context;
+
+    output->state = BLITZ3D_STREAM_STATE_HEADER;
+    output->bufferTarget = BLITZ3D_STREAM_HEADER_SIZE;
+
+    output->arena = createArena(BLITZ3D_STREAM_ARENA_BLOCK_SIZE);
+
+    initializeBulkDecode();
+
+    return output;
+}
+
+void freeBlitz3DStream(Blitz3DStream* stream) {
+    unsigned int iter;
+
+    for (iter = 0; iter < stream->frameCapacity; iter++) {
+        if (stream->frames[iter] != NULL) {
+            free(stream->frames[iter]->name);
+            free(stream->frames[iter]);
+        }
+    }
+
+    free(stream->frames);
+    free(stream->buffer);
+    freeArena(stream->arena);
+    free(stream);
+}
+
+int feedBlitz3DStream(Blitz3DStream* stream, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    size_t count;
+
+    while (stream->state != BLITZ3D_STREAM_STATE_ERROR && stream->state != BLITZ3D_STREAM_STATE_DONE) {
+        if (stream->state == BLITZ3D_STREAM_STATE_HEADER) {
+            if (size == 0) break;
+
+            if (stream->bufferUsed == 0) stream->chunkOffset = stream->position;
+
+            /* commentary: when a whole chunk (or a container's fixed fields) is already in the caller's span it
+               is decoded in place, so feeding large spans costs no copy; only chunks split across calls are buffered */
+
+            if (stream->bufferUsed == 0 && size >= BLITZ3D_STREAM_HEADER_SIZE) {
+                beginStreamChunk(stream, bytes);
+
+                if (stream->state == BLITZ3D_STREAM_STATE_PAYLOAD && stream->bufferTarget <= size) {
+                    count = stream->bufferTarget;
+
+                    stream->position += count;
+                    completeStreamPayload(stream, bytes);
+
+                    bytes += count;
+                    size -= count;
+                    continue;
+                }
+
+                if (stream->state == BLITZ3D_STREAM_STATE_ERROR) break;
+
+                count = BLITZ3D_STREAM_HEADER_SIZE;
+            }
+            else {
+                count = BLITZ3D_STREAM_HEADER_SIZE - stream->bufferUsed;
+                if (count > size) count = size;
+            }
+
+            if (reserveStreamBuffer(stream, BLITZ3D_STREAM_HEADER_SIZE) != 0) {
+                failBlitz3DStream(stream, "out of memory");
+                break;
+            }
+
+            appendToStreamBuffer(stream, bytes, count);
+            stream->position += count;
+            bytes += count;
+            size -= count;
+
+            if (stream->bufferUsed == BLITZ3D_STREAM_HEADER_SIZE && stream->state == BLITZ3D_STREAM_STATE_HEADER) {
+                beginStreamChunk(stream, stream->buffer);
+            }
+        }
+        else if (stream->state == BLITZ3D_STREAM_STATE_PAYLOAD) {
+            if (reserveStreamBuffer(stream, stream->bufferTarget) != 0) {
+                failBlitz3DStream(stream, "out of memory");
+                break;
+            }
+
+            count = stream->bufferTarget - stream->bufferUsed;
+            if (count > size) count = size;
+
+            appendToStreamBuffer(stream, bytes, count);
+            stream->position += count;
+            bytes += count;
+            size -= count;
+
+            if (stream->bufferUsed < stream->bufferTarget) break;
+
+            completeStreamPayload(stream, stream->buffer);
+        }
+        else if (stream->state == BLITZ3D_STREAM_STATE_NAME) {
+            /* the name may run no further than leaves room for the fixed fields */
+            size_t limit = BLITZ3D_STREAM_HEADER_SIZE + (size_t)stream->chunkSize;
+            const unsigned char* terminator;
+
+            if (stream->bufferUsed + BLITZ3D_STREAM_NODE_FIELD_SIZE >= limit) {
+                failBlitz3DStream(stream, "NODE chunk too small");
+                break;
+            }
+
+            limit -= stream->bufferUsed + BLITZ3D_STREAM_NODE_FIELD_SIZE;
+            if (limit > size) limit = size;
+
+            if (size == 0) break;
+
+            terminator = (const unsigned char*)memchr(bytes, '\0', limit);
+            count = (terminator != NULL) ? (size_t)(terminator - bytes) + 1 : limit;
+
+            if (reserveStreamBuffer(stream, stream->bufferUsed + count + BLITZ3D_STREAM_NODE_FIELD_SIZE) != 0) {
+                failBlitz3DStream(stream, "out of memory");
+                break;
+            }
+
+            appendToStreamBuffer(stream, bytes, count);
+            stream->position += count;
+            bytes += count;
+            size -= count;
+
+            if (terminator != NULL) {
+                stream->state = BLITZ3D_STREAM_STATE_PAYLOAD;
+                stream->bufferTarget = stream->bufferUsed + BLITZ3D_STREAM_NODE_FIELD_SIZE;
+            }
+        }
+        else {
+            count = (stream->skipRemaining < size) ? (size_t)stream->skipRemaining : size;
+
+            stream->position += count;
+            stream->skipRemaining -= count;
+            bytes += count;
+            size -= count;
+
+            if (stream->skipRemaining > 0) break;
+
+            finishStreamChunk(stream);
+        }
+    }
+
+    return (stream->state == BLITZ3D_STREAM_STATE_ERROR) ? -1 : 0;
+}
+
+int finishBlitz3DStream(Blitz3DStream* stream) {
+    return (stream->state == BLITZ3D_STREAM_STATE_DONE) ? 0 : -1;
+}
+
+int getVersionFromBlitz3DStream(Blitz3DStream* stream) {
+    return stream->version;
+}
+
+uint64_t getPositionFromBlitz3DStream(Blitz3DStream* stream) {
+    return stream->position;
+}
+
+size_t getPeakMemoryFromBlitz3DStream(Blitz3DStream* stream) {
+    return stream->bufferCapacity + stream->peakArenaBytes;
+}
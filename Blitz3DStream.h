@@ -0,0 +1,50 @@
+#ifndef _BLITZ3DSTREAM_H_
+#define _BLITZ3DSTREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Blitz3DFile.h"
+
+/* commentary: a stream parser is fed a B3D file in pieces of any size, e.g. as they come out of a pipe
+   or a decompressor, and calls back as each chunk is completed. Nothing is kept once a chunk's callback
+   returns, so memory stays bounded by the largest single chunk instead of the whole file.
+
+   the chunks handed to the callbacks can be read with the usual accessors. Textures, brushes, VRTS and
+   TRIS chunks are only valid during their callback; NODE and MESH chunks stay valid until their end
+   callback, and have no children or VRTS/TRIS chunks attached. Any callback may be NULL. */
+
+typedef struct Blitz3DStream Blitz3DStream;
+struct Blitz3DStream;
+
+typedef struct Blitz3DStreamCallbacks Blitz3DStreamCallbacks;
+struct Blitz3DStreamCallbacks {
+    void (*texture)(void* context, Blitz3DTexture* texture, unsigned int index);
+    void (*brush)(void* context, Blitz3DBrush* brush, unsigned int index, int textureCount);
+
+    void (*nodeBegin)(void* context, Blitz3DNODEChunk* nodeChunk);
+    void (*nodeEnd)(void* context, Blitz3DNODEChunk* nodeChunk);
+
+    void (*meshBegin)(void* context, Blitz3DMESHChunk* meshChunk);
+    void (*meshVertices)(void* context, Blitz3DMESHChunk* meshChunk, Blitz3DVRTSChunk* vrtsChunk);
+    void (*triangleBatch)(void* context, Blitz3DMESHChunk* meshChunk, Blitz3DTRISChunk* trisChunk);
+    void (*meshEnd)(void* context, Blitz3DMESHChunk* meshChunk);
+};
+
+Blitz3DStream* createBlitz3DStream(const Blitz3DStreamCallbacks* callbacks, void* context);
+
+void freeBlitz3DStream(Blitz3DStream* stream);
+
+/* returns 0, or -1 once the data is found to be malformed; later calls then keep returning -1 */
+int feedBlitz3DStream(Blitz3DStream* stream, const void* data, size_t size);
+
+/* returns 0 if the whole BB3D chunk has been seen, -1 if the data ended early or was malformed */
+int finishBlitz3DStream(Blitz3DStream* stream);
+
+int getVersionFromBlitz3DStream(Blitz3DStream* stream);
+
+uint64_t getPositionFromBlitz3DStream(Blitz3DStream* stream);
+
+size_t getPeakMemoryFromBlitz3DStream(Blitz3DStream* stream);
+
+#endif
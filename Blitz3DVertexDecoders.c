@@ -0,0 +1,167 @@
+#include "Blitz3DFileInternal.h"
+
+#include <string.h>
+#include <stdint.h>
+
+#include "BulkDecode.h"
+
+/* Blitz3D VRTS decoders */
+
+/* commentary: lightmapped levels use a handful of vertex layouts over and over (positions and two UV
+   sets of two, sometimes with normals or colors). Each of those layouts gets a decoder with the layout
+   fixed at compile time, so the per-vertex work is a few straight-line copies out of a single pass over
+   the payload. Anything else goes through the generic path, one strided bulk decode per attribute */
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define BLITZ3D_BIG_ENDIAN_HOST
+#endif
+
+typedef void (*Blitz3DVRTSDecoder)(Blitz3DVRTSChunk* output, const unsigned char* payload, unsigned int stride);
+
+typedef struct Blitz3DVRTSDecoderEntry Blitz3DVRTSDecoderEntry;
+struct Blitz3DVRTSDecoderEntry {
+    int flags;
+    int tex_coord_sets;
+    int tex_coord_set_size;
+
+    Blitz3DVRTSDecoder decoder;
+};
+
+int specializedVertexDecodersEnabled = 1;
+
+/* count must be a constant at each call site, so the copy compiles down to a couple of moves */
+
+void copyLittleEndianFloats(float* destination, const unsigned char* source, unsigned int count) {
+#ifdef BLITZ3D_BIG_ENDIAN_HOST
+    unsigned int iter;
+
+    for (iter = 0; iter < count; iter++) {
+        uint32_t bits = (uint32_t)source[4 * iter]
+            | ((uint32_t)source[4 * iter + 1] << 0x08)
+            | ((uint32_t)source[4 * iter + 2] << 0x10)
+            | ((uint32_t)source[4 * iter + 3] << 0x18);
+
+        memcpy(destination + iter, &bits, sizeof(float));
+    }
+#else
+    memcpy(destination, source, count * sizeof(float));
+#endif
+}
+
+/* commentary: one macro body stamped out per layout; normals and colors are 0 or 1 and uvSets is the
+   number of 2-component UV sets, all constants, so every test below folds away */
+
+#define BLITZ3D_DEFINE_VRTS_DECODER(name, normals, colors, uvSets) \
+void name(Blitz3DVRTSChunk* output, const unsigned char* payload, unsigned int stride) { \
+    float* positions = output->vertexArray; \
+    float* normalArray = output->normalArray; \
+    float* colorArray = output->colorArray; \
+    float* texCoords0 = (uvSets > 0) ? output->texCoordArrays[0] : NULL; \
+    float* texCoords1 = (uvSets > 1) ? output->texCoordArrays[1] : NULL; \
+    unsigned int iter; \
+    \
+    for (iter = 0; iter < output->vertexCount; iter++) { \
+        const unsigned char* field = payload + (size_t)stride * iter; \
+        \
+        copyLittleEndianFloats(positions + 3 * iter, field, 3); \
+        field += 12; \
+        \
+        if (normals) { \
+            copyLittleEndianFloats(normalArray + 3 * iter, field, 3); \
+            field += 12; \
+        } \
+        \
+        if (colors) { \
+            copyLittleEndianFloats(colorArray + 4 * iter, field, 4); \
+            field += 16; \
+        } \
+        \
+        if (uvSets > 0) copyLittleEndianFloats(texCoords0 + 2 * iter, field, 2); \
+        if (uvSets > 1) copyLittleEndianFloats(texCoords1 + 2 * iter, field + 8, 2); \
+    } \
+}
+
+BLITZ3D_DEFINE_VRTS_DECODER(decodeVRTSPosition, 0, 0, 0)
+BLITZ3D_DEFINE_VRTS_DECODER(decodeVRTSPositionUV, 0, 0, 1)
+BLITZ3D_DEFINE_VRTS_DECODER(decodeVRTSPositionUV2, 0, 0, 2)
+BLITZ3D_DEFINE_VRTS_DECODER(decodeVRTSPositionNormal, 1, 0, 0)
+BLITZ3D_DEFINE_VRTS_DECODER(decodeVRTSPositionNormalUV, 1, 0, 1)
+BLITZ3D_DEFINE_VRTS_DECODER(decodeVRTSPositionNormalUV2, 1, 0, 2)
+BLITZ3D_DEFINE_VRTS_DECODER(decodeVRTSPositionColorUV, 0, 1, 1)
+BLITZ3D_DEFINE_VRTS_DECODER(decodeVRTSPositionColorUV2, 0, 1, 2)
+BLITZ3D_DEFINE_VRTS_DECODER(decodeVRTSPositionNormalColorUV, 1, 1, 1)
+BLITZ3D_DEFINE_VRTS_DECODER(decodeVRTSPositionNormalColorUV2, 1, 1, 2)
+
+#define BLITZ3D_VERTEX_FLAG_NORMAL_COLOR (BLITZ3D_VERTEX_FLAG_NORMAL | BLITZ3D_VERTEX_FLAG_COLOR)
+
+Blitz3DVRTSDecoderEntry vrtsDecoderTable[] = {
+    { 0, 0, 0, decodeVRTSPosition },
+    { 0, 1, 2, decodeVRTSPositionUV },
+    { 0, 2, 2, decodeVRTSPositionUV2 },
+    { BLITZ3D_VERTEX_FLAG_NORMAL, 0, 0, decodeVRTSPositionNormal },
+    { BLITZ3D_VERTEX_FLAG_NORMAL, 1, 2, decodeVRTSPositionNormalUV },
+    { BLITZ3D_VERTEX_FLAG_NORMAL, 2, 2, decodeVRTSPositionNormalUV2 },
+    { BLITZ3D_VERTEX_FLAG_COLOR, 1, 2, decodeVRTSPositionColorUV },
+    { BLITZ3D_VERTEX_FLAG_COLOR, 2, 2, decodeVRTSPositionColorUV2 },
+    { BLITZ3D_VERTEX_FLAG_NORMAL_COLOR, 1, 2, decodeVRTSPositionNormalColorUV },
+    { BLITZ3D_VERTEX_FLAG_NORMAL_COLOR, 2, 2, decodeVRTSPositionNormalColorUV2 }
+};
+
+#define BLITZ3D_VRTS_DECODER_COUNT (sizeof(vrtsDecoderTable) / sizeof(vrtsDecoderTable[0]))
+
+/* generic path */
+
+void decodeVRTSGeneric(Blitz3DVRTSChunk* output, const unsigned char* payload, unsigned int stride) {
+    int texCoordIter;
+
+    decodeStridedLittleEndian32(output->vertexArray, payload, output->vertexCount, 3, stride);
+    payload += 3 * sizeof(float);
+
+    if (output->flags & BLITZ3D_VERTEX_FLAG_NORMAL) {
+        decodeStridedLittleEndian32(output->normalArray, payload, output->vertexCount, 3, stride);
+        payload += 3 * sizeof(float);
+    }
+
+    if (output->flags & BLITZ3D_VERTEX_FLAG_COLOR) {
+        decodeStridedLittleEndian32(output->colorArray, payload, output->vertexCount, 4, stride);
+        payload += 4 * sizeof(float);
+    }
+
+    for (texCoordIter = 0; texCoordIter < output->tex_coord_sets; texCoordIter++) {
+        decodeStridedLittleEndian32(output->texCoordArrays[texCoordIter], payload,
+            output->vertexCount, output->tex_coord_set_size, stride);
+        payload += output->tex_coord_set_size * sizeof(float);
+    }
+}
+
+/* selection, once per chunk */
+
+Blitz3DVRTSDecoder findVRTSDecoder(Blitz3DVRTSChunk* vrtsChunk) {
+    int flags = vrtsChunk->flags & BLITZ3D_VERTEX_FLAG_NORMAL_COLOR;
+    unsigned int iter;
+
+    if (!specializedVertexDecodersEnabled) return decodeVRTSGeneric;
+
+    /* commentary: a chunk without UV sets has no meaningful set size, so only the count is compared then */
+
+    for (iter = 0; iter < BLITZ3D_VRTS_DECODER_COUNT; iter++) {
+        Blitz3DVRTSDecoderEntry* entry = &(vrtsDecoderTable[iter]);
+
+        if (entry->flags == flags && entry->tex_coord_sets == vrtsChunk->tex_coord_sets
+            && (entry->tex_coord_sets == 0 || entry->tex_coord_set_size == vrtsChunk->tex_coord_set_size)) {
+            return entry->decoder;
+        }
+    }
+
+    return decodeVRTSGeneric;
+}
+
+void decodeVRTSPayload(Blitz3DVRTSChunk* vrtsChunk, const unsigned char* payload, unsigned int stride) {
+    findVRTSDecoder(vrtsChunk)(vrtsChunk, payload, stride);
+}
+
+/* public functions */
+
+void setSpecializedVertexDecodersEnabled(int enabled) {
+    specializedVertexDecodersEnabled = enabled;
+}
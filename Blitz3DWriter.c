@@ -0,0 +1,374 @@
+#include "Blitz3DWriter.h"
+#include "Blitz3DFileInternal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "BulkDecode.h"
+
+/* Blitz3D writer */
+
+#define BLITZ3D_WRITE_BUFFER_SIZE (1024 * 1024)
+
+/* commentary: output goes through a buffer of our own rather than stdio's, because every chunk starts
+   with its size, which is only known once the chunk is written. The size is patched in the buffer
+   when the chunk started recently enough to still be there; only chunks bigger than the buffer
+   (a large mesh, or a node holding one) need a seek back to patch the file */
+
+typedef struct Blitz3DWriter Blitz3DWriter;
+struct Blitz3DWriter {
+    FILE* fp;
+
+    unsigned char* buffer;
+    size_t used;
+
+    /* file offset of buffer[0] */
+    uint64_t bufferStart;
+
+    int error;
+};
+
+void flushWriter(Blitz3DWriter* writer) {
+    if (writer->used > 0 && !writer->error) {
+        if (fwrite(writer->buffer, 1, writer->used, writer->fp) != writer->used) writer->error = 1;
+    }
+
+    writer->bufferStart += writer->used;
+    writer->used = 0;
+}
+
+/* size must be at most BLITZ3D_WRITE_BUFFER_SIZE */
+
+unsigned char* reserveInWriter(Blitz3DWriter* writer, size_t size) {
+    unsigned char* output;
+
+    if (writer->used + size > BLITZ3D_WRITE_BUFFER_SIZE) flushWriter(writer);
+
+    output = writer->buffer + writer->used;
+    writer->used += size;
+
+    return output;
+}
+
+uint64_t getPositionFromWriter(Blitz3DWriter* writer) {
+    return writer->bufferStart + writer->used;
+}
+
+void store32BitIntegerInWriter(unsigned char* output, uint32_t value) {
+    output[0] = (unsigned char)(value & 0xFF);
+    output[1] = (unsigned char)((value >> 0x08) & 0xFF);
+    output[2] = (unsigned char)((value >> 0x10) & 0xFF);
+    output[3] = (unsigned char)((value >> 0x18) & 0xFF);
+}
+
+void write32BitIntegerToWriter(Blitz3DWriter* writer, uint32_t value) {
+    store32BitIntegerInWriter(reserveInWriter(writer, 4), value);
+}
+
+void writeFloatToWriter(Blitz3DWriter* writer, float value) {
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    write32BitIntegerToWriter(writer, bits);
+}
+
+void writeStringToWriter(Blitz3DWriter* writer, const char* string) {
+    size_t size;
+
+    if (string == NULL) string = "";
+    size = strlen(string) + 1;
+
+    while (size > 0) {
+        size_t piece = (size < BLITZ3D_WRITE_BUFFER_SIZE) ? size : BLITZ3D_WRITE_BUFFER_SIZE;
+
+        memcpy(reserveInWriter(writer, piece), string, piece);
+
+        string += piece;
+        size -= piece;
+    }
+}
+
+/* commentary: encoding to little-endian is the same byte shuffle as decoding from it, so the bulk
+   decode kernels serve for writing too */
+
+void write32BitArrayToWriter(Blitz3DWriter* writer, const void* values, size_t count) {
+    const unsigned char* input = (const unsigned char*)values;
+
+    while (count > 0) {
+        size_t piece = (count < BLITZ3D_WRITE_BUFFER_SIZE / 4) ? count : BLITZ3D_WRITE_BUFFER_SIZE / 4;
+
+        decodeLittleEndian32(reserveInWriter(writer, 4 * piece), input, piece);
+
+        input += 4 * piece;
+        count -= piece;
+    }
+}
+
+/* 16-bit indices are widened back to the 32 bits the format stores */
+
+void writeShortIndexArrayToWriter(Blitz3DWriter* writer, const uint16_t* values, size_t count) {
+    size_t iter;
+
+    while (count > 0) {
+        size_t piece = (count < BLITZ3D_WRITE_BUFFER_SIZE / 4) ? count : BLITZ3D_WRITE_BUFFER_SIZE / 4;
+        unsigned char* output = reserveInWriter(writer, 4 * piece);
+
+        for (iter = 0; iter < piece; iter++) {
+            output[4 * iter] = (unsigned char)(values[iter] & 0xFF);
+            output[4 * iter + 1] = (unsigned char)(values[iter] >> 8);
+            output[4 * iter + 2] = 0;
+            output[4 * iter + 3] = 0;
+        }
+
+        values += piece;
+        count -= piece;
+    }
+}
+
+uint64_t beginChunkInWriter(Blitz3DWriter* writer, uint32_t tag) {
+    uint64_t output = getPositionFromWriter(writer);
+
+    write32BitIntegerToWriter(writer, tag);
+    write32BitIntegerToWriter(writer, 0);
+
+    return output;
+}
+
+void endChunkInWriter(Blitz3DWriter* writer, uint64_t chunkStart) {
+    uint64_t size = getPositionFromWriter(writer) - chunkStart - 8;
+    unsigned char bytes[4];
+
+    /* commentary: chunk sizes are 32 bits, so no single chunk may reach 4 GB */
+    if (size > 0xFFFFFFFF) {
+        writer->error = 1;
+        return;
+    }
+
+    if (chunkStart + 4 >= writer->bufferStart) {
+        store32BitIntegerInWriter(writer->buffer + (size_t)(chunkStart + 4 - writer->bufferStart), (uint32_t)size);
+        return;
+    }
+
+    flushWriter(writer);
+    store32BitIntegerInWriter(bytes, (uint32_t)size);
+
+    if (seekBinaryFile(writer->fp, (int64_t)(chunkStart + 4), SEEK_SET) != 0
+        || fwrite(bytes, 1, 4, writer->fp) != 4
+        || seekBinaryFile(writer->fp, 0, SEEK_END) != 0) {
+        writer->error = 1;
+    }
+}
+
+/* chunks */
+
+void writeTEXSChunk(Blitz3DWriter* writer, Blitz3DTEXSChunk* texsChunk) {
+    uint64_t chunkStart = beginChunkInWriter(writer, BLITZ3D_TAG_TEXS_LITTLE_ENDIAN);
+    unsigned int iter;
+
+    for (iter = 0; iter < texsChunk->textureCount; iter++) {
+        Blitz3DTexture* texture = texsChunk->textureArray[iter];
+
+        writeStringToWriter(writer, texture->file);
+
+        write32BitIntegerToWriter(writer, (uint32_t)texture->flags);
+        write32BitIntegerToWriter(writer, (uint32_t)texture->blend);
+
+        writeFloatToWriter(writer, texture->x_pos);
+        writeFloatToWriter(writer, texture->y_pos);
+        writeFloatToWriter(writer, texture->x_scale);
+        writeFloatToWriter(writer, texture->y_scale);
+        writeFloatToWriter(writer, texture->rotation);
+    }
+
+    endChunkInWriter(writer, chunkStart);
+}
+
+void writeBRUSChunk(Blitz3DWriter* writer, Blitz3DBRUSChunk* brusChunk) {
+    uint64_t chunkStart = beginChunkInWriter(writer, BLITZ3D_TAG_BRUS_LITTLE_ENDIAN);
+    unsigned int iter;
+    int textureIter;
+
+    write32BitIntegerToWriter(writer, (uint32_t)brusChunk->n_texs);
+
+    for (iter = 0; iter < brusChunk->brushCount; iter++) {
+        Blitz3DBrush* brush = brusChunk->brushArray[iter];
+
+        writeStringToWriter(writer, brush->name);
+
+        writeFloatToWriter(writer, brush->red);
+        writeFloatToWriter(writer, brush->green);
+        writeFloatToWriter(writer, brush->blue);
+        writeFloatToWriter(writer, brush->alpha);
+        writeFloatToWriter(writer, brush->shininess);
+
+        write32BitIntegerToWriter(writer, (uint32_t)brush->blend);
+        write32BitIntegerToWriter(writer, (uint32_t)brush->fx);
+
+        for (textureIter = 0; textureIter < brusChunk->n_texs; textureIter++) {
+            write32BitIntegerToWriter(writer, (uint32_t)brush->texture_id[textureIter]);
+        }
+    }
+
+    endChunkInWriter(writer, chunkStart);
+}
+
+/* commentary: vertices are interleaved straight into the write buffer, as many per flush as fit */
+
+void writeVRTSChunk(Blitz3DWriter* writer, Blitz3DVRTSChunk* vrtsChunk) {
+    uint64_t chunkStart = beginChunkInWriter(writer, BLITZ3D_TAG_VRTS_LITTLE_ENDIAN);
+    unsigned int stride, batchSize, first, iter;
+    int texCoordIter;
+
+    write32BitIntegerToWriter(writer, (uint32_t)vrtsChunk->flags);
+    write32BitIntegerToWriter(writer, (uint32_t)vrtsChunk->tex_coord_sets);
+    write32BitIntegerToWriter(writer, (uint32_t)vrtsChunk->tex_coord_set_size);
+
+    stride = getVertexStrideFromVRTSChunk(vrtsChunk);
+    batchSize = BLITZ3D_WRITE_BUFFER_SIZE / stride;
+
+    for (first = 0; first < vrtsChunk->vertexCount; first += batchSize) {
+        unsigned int count = vrtsChunk->vertexCount - first;
+        unsigned char* output;
+
+        if (count > batchSize) count = batchSize;
+        output = reserveInWriter(writer, (size_t)count * stride);
+
+        for (iter = first; iter < first + count; iter++) {
+            decodeLittleEndian32(output, vrtsChunk->vertexArray + 3 * (size_t)iter, 3);
+            output += 12;
+
+            if (vrtsChunk->flags & BLITZ3D_VERTEX_FLAG_NORMAL) {
+                decodeLittleEndian32(output, vrtsChunk->normalArray + 3 * (size_t)iter, 3);
+                output += 12;
+            }
+
+            if (vrtsChunk->flags & BLITZ3D_VERTEX_FLAG_COLOR) {
+                decodeLittleEndian32(output, vrtsChunk->colorArray + 4 * (size_t)iter, 4);
+                output += 16;
+            }
+
+            for (texCoordIter = 0; texCoordIter < vrtsChunk->tex_coord_sets; texCoordIter++) {
+                decodeLittleEndian32(output, vrtsChunk->texCoordArrays[texCoordIter]
+                    + (size_t)vrtsChunk->tex_coord_set_size * iter, vrtsChunk->tex_coord_set_size);
+                output += 4 * vrtsChunk->tex_coord_set_size;
+            }
+        }
+    }
+
+    endChunkInWriter(writer, chunkStart);
+}
+
+void writeTRISChunk(Blitz3DWriter* writer, Blitz3DTRISChunk* trisChunk) {
+    uint64_t chunkStart = beginChunkInWriter(writer, BLITZ3D_TAG_TRIS_LITTLE_ENDIAN);
+
+    write32BitIntegerToWriter(writer, (uint32_t)trisChunk->brush_id);
+    if (trisChunk->shortIndexArray != NULL) {
+        writeShortIndexArrayToWriter(writer, trisChunk->shortIndexArray, 3 * (size_t)trisChunk->triangleCount);
+    }
+    else {
+        write32BitArrayToWriter(writer, trisChunk->indexArray, 3 * (size_t)trisChunk->triangleCount);
+    }
+
+    endChunkInWriter(writer, chunkStart);
+}
+
+/* commentary: an index-only mesh is decoded for writing and evicted again afterwards, so saving a
+   large level never holds more than one of its undecoded meshes at a time */
+
+void writeMESHChunk(Blitz3DWriter* writer, Blitz3DMESHChunk* meshChunk, int passes) {
+    uint64_t chunkStart;
+    int wasPresent = meshDataPresentInMESHChunk(meshChunk);
+    unsigned int iter;
+
+    if (passes != 0) optimizeMESHChunk(meshChunk, passes);
+
+    chunkStart = beginChunkInWriter(writer, BLITZ3D_TAG_MESH_LITTLE_ENDIAN);
+    write32BitIntegerToWriter(writer, (uint32_t)meshChunk->brush_id);
+
+    if (getVRTSChunkFromMESHChunk(meshChunk) != NULL) writeVRTSChunk(writer, meshChunk->vrtsChunk);
+
+    for (iter = 0; iter < meshChunk->trisChunkCount; iter++) {
+        writeTRISChunk(writer, meshChunk->trisChunkArray[iter]);
+    }
+
+    endChunkInWriter(writer, chunkStart);
+
+    if (!wasPresent) evictMESHChunk(meshChunk);
+}
+
+void writeNODEChunk(Blitz3DWriter* writer, Blitz3DNODEChunk* nodeChunk, int passes) {
+    uint64_t chunkStart = beginChunkInWriter(writer, BLITZ3D_TAG_NODE_LITTLE_ENDIAN);
+    unsigned int iter;
+
+    writeStringToWriter(writer, nodeChunk->name);
+
+    for (iter = 0; iter < 3; iter++) writeFloatToWriter(writer, nodeChunk->position[iter]);
+    for (iter = 0; iter < 3; iter++) writeFloatToWriter(writer, nodeChunk->scale[iter]);
+    for (iter = 0; iter < 4; iter++) writeFloatToWriter(writer, nodeChunk->rotation[iter]);
+
+    if (nodeChunk->meshChunk != NULL) writeMESHChunk(writer, nodeChunk->meshChunk, passes);
+
+    for (iter = 0; iter < nodeChunk->nodeChunkCount; iter++) {
+        writeNODEChunk(writer, nodeChunk->nodeChunkArray[iter], passes);
+    }
+
+    endChunkInWriter(writer, chunkStart);
+}
+
+/* public functions */
+
+int saveB3DFile(B3DFile* blitz3dFile, const char* filePath, int passes) {
+    Blitz3DBB3DChunk* bb3dChunk = blitz3dFile->bb3dChunk;
+    Blitz3DWriter writer;
+    char* temporaryPath;
+    uint64_t chunkStart;
+    int result;
+
+    temporaryPath = (char*)malloc(strlen(filePath) + 5);
+    sprintf(temporaryPath, "%s.tmp", filePath);
+
+    memset(&writer, 0, sizeof(Blitz3DWriter));
+    writer.fp = fopen(temporaryPath, "wb");
+    writer.buffer = (unsigned char*)malloc(BLITZ3D_WRITE_BUFFER_SIZE);
+
+    if (writer.fp == NULL || writer.buffer == NULL) {
+        fprintf(stderr, "could not write %s\n", temporaryPath);
+
+        if (writer.fp != NULL) fclose(writer.fp);
+        free(writer.buffer);
+        free(temporaryPath);
+        return -1;
+    }
+
+    initializeBulkDecode();
+
+    chunkStart = beginChunkInWriter(&writer, BLITZ3D_TAG_BB3D_LITTLE_ENDIAN);
+    write32BitIntegerToWriter(&writer, (uint32_t)bb3dChunk->version);
+
+    if (bb3dChunk->texsChunk != NULL) writeTEXSChunk(&writer, bb3dChunk->texsChunk);
+    if (bb3dChunk->brusChunk != NULL) writeBRUSChunk(&writer, bb3dChunk->brusChunk);
+    if (bb3dChunk->nodeChunk != NULL) writeNODEChunk(&writer, bb3dChunk->nodeChunk, passes);
+
+    endChunkInWriter(&writer, chunkStart);
+    flushWriter(&writer);
+
+    if (fclose(writer.fp) != 0) writer.error = 1;
+    free(writer.buffer);
+
+    result = writer.error ? -1 : 0;
+
+    if (result == 0) {
+        remove(filePath);
+        if (rename(temporaryPath, filePath) != 0) result = -1;
+    }
+
+    if (result != 0) {
+        fprintf(stderr, "could not write %s\n", filePath);
+        remove(temporaryPath);
+    }
+
+    free(temporaryPath);
+
+    return result;
+}
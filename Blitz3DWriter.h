@@ -0,0 +1,17 @@
+#ifndef _BLITZ3DWRITER_H_
+#define _BLITZ3DWRITER_H_
+
+#include "Blitz3DFile.h"
+#include "Blitz3DOptimize.h"
+
+/* commentary: writes a loaded file back out as BB3D, after running the given BLITZ3D_PASS_* passes
+   over every mesh (0 for none). The passes change the loaded file as well. Only the chunks the loader
+   keeps are written, so a file saved without passes matches its source apart from any chunks the
+   loader skipped (animation, bones). The file is written under a temporary name and renamed into
+   place, so a failed save never leaves half a file behind.
+
+   returns 0, or -1 if the file could not be written */
+
+int saveB3DFile(B3DFile* blitz3dFile, const char* filePath, int passes);
+
+#endif
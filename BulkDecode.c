@@ -0,0 +1,340 @@
+#include "BulkDecode.h"
+
+#include <string.h>
+#include <stdint.h>
+
+/* the SIMD kernels are built with per-function target attributes, so the rest of the program
+   does not need -msse2 or -mavx2 and still runs on processors without them */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BULK_DECODE_X86
+#include <immintrin.h>
+#endif
+
+typedef void (*BulkDecodeFunction)(void* destination, const void* source, size_t count);
+typedef void (*BulkDecodeStridedFunction)(void* destination, const void* source, size_t count,
+    unsigned int components, size_t sourceStride);
+typedef int (*BulkNarrowFunction)(void* destination, const void* source, size_t count);
+
+int bulkDecodeKernel = BULK_DECODE_KERNEL_AUTO;
+BulkDecodeFunction bulkDecodeFunction = NULL;
+BulkDecodeStridedFunction bulkDecodeStridedFunction = NULL;
+BulkNarrowFunction bulkNarrowFunction = NULL;
+
+/* scalar kernels */
+
+uint32_t decodeLittleEndian32Value(const unsigned char* bytes) {
+    return (uint32_t)bytes[0]
+        | ((uint32_t)bytes[1] << 0x08)
+        | ((uint32_t)bytes[2] << 0x10)
+        | ((uint32_t)bytes[3] << 0x18);
+}
+
+void decodeLittleEndian32Scalar(void* destination, const void* source, size_t count) {
+    const unsigned char* input = (const unsigned char*)source;
+    uint32_t* output = (uint32_t*)destination;
+    size_t iter;
+
+    for (iter = 0; iter < count; iter++) {
+        output[iter] = decodeLittleEndian32Value(input + 4 * iter);
+    }
+}
+
+void decodeStridedLittleEndian32Scalar(void* destination, const void* source, size_t count,
+    unsigned int components, size_t sourceStride) {
+    const unsigned char* input = (const unsigned char*)source;
+    uint32_t* output = (uint32_t*)destination;
+    size_t iter;
+    unsigned int component;
+
+    for (iter = 0; iter < count; iter++) {
+        for (component = 0; component < components; component++) {
+            output[components * iter + component] = decodeLittleEndian32Value(input + sourceStride * iter + 4 * component);
+        }
+    }
+}
+
+int narrowLittleEndian32To16Scalar(void* destination, const void* source, size_t count) {
+    const unsigned char* input = (const unsigned char*)source;
+    uint16_t* output = (uint16_t*)destination;
+    uint32_t high = 0;
+    size_t iter;
+
+    for (iter = 0; iter < count; iter++) {
+        output[iter] = (uint16_t)(input[4 * iter] | (input[4 * iter + 1] << 8));
+        high |= input[4 * iter + 2] | input[4 * iter + 3];
+    }
+
+    return (high == 0) ? 0 : -1;
+}
+
+#ifdef BULK_DECODE_X86
+
+/* SSE2 kernels */
+
+/* commentary: x86 is little-endian, so decoding is a copy. The strided kernel moves a whole record
+   in one load and one store; a 3-component record is moved as 16 bytes, and the extra value it
+   writes is overwritten by the next record, which is why the last record is copied on its own */
+
+__attribute__((target("sse2")))
+void decodeLittleEndian32SSE2(void* destination, const void* source, size_t count) {
+    const unsigned char* input = (const unsigned char*)source;
+    unsigned char* output = (unsigned char*)destination;
+    size_t size = 4 * count, iter = 0;
+
+    for (; iter + 64 <= size; iter += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(input + iter));
+        __m128i b = _mm_loadu_si128((const __m128i*)(input + iter + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(input + iter + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(input + iter + 48));
+
+        _mm_storeu_si128((__m128i*)(output + iter), a);
+        _mm_storeu_si128((__m128i*)(output + iter + 16), b);
+        _mm_storeu_si128((__m128i*)(output + iter + 32), c);
+        _mm_storeu_si128((__m128i*)(output + iter + 48), d);
+    }
+
+    for (; iter + 16 <= size; iter += 16) {
+        _mm_storeu_si128((__m128i*)(output + iter), _mm_loadu_si128((const __m128i*)(input + iter)));
+    }
+
+    memcpy(output + iter, input + iter, size - iter);
+}
+
+__attribute__((target("sse2")))
+void decodeStridedLittleEndian32SSE2(void* destination, const void* source, size_t count,
+    unsigned int components, size_t sourceStride) {
+    const unsigned char* input = (const unsigned char*)source;
+    unsigned char* output = (unsigned char*)destination;
+    size_t iter = 0;
+
+    if (count == 0) return;
+
+    if (components == 2) {
+        for (; iter < count; iter++) {
+            _mm_storel_epi64((__m128i*)(output + 8 * iter), _mm_loadl_epi64((const __m128i*)(input + sourceStride * iter)));
+        }
+    }
+    else if (components == 3) {
+        for (; iter + 1 < count; iter++) {
+            _mm_storeu_si128((__m128i*)(output + 12 * iter), _mm_loadu_si128((const __m128i*)(input + sourceStride * iter)));
+        }
+
+        memcpy(output + 12 * iter, input + sourceStride * iter, 12);
+    }
+    else if (components == 4) {
+        for (; iter < count; iter++) {
+            _mm_storeu_si128((__m128i*)(output + 16 * iter), _mm_loadu_si128((const __m128i*)(input + sourceStride * iter)));
+        }
+    }
+    else {
+        for (; iter < count; iter++) {
+            memcpy(output + 4 * components * iter, input + sourceStride * iter, 4 * components);
+        }
+    }
+}
+
+/* commentary: SSE2 only has a signed 32 to 16-bit pack, so the values are biased down by 32768 to
+   fit it and biased back afterwards; the high halves are collected on the side to catch values the
+   pack would have saturated */
+
+__attribute__((target("sse2")))
+int narrowLittleEndian32To16SSE2(void* destination, const void* source, size_t count) {
+    const unsigned char* input = (const unsigned char*)source;
+    unsigned char* output = (unsigned char*)destination;
+    __m128i bias32 = _mm_set1_epi32(32768);
+    __m128i bias16 = _mm_set1_epi16((short)0x8000);
+    __m128i high = _mm_setzero_si128();
+    size_t iter = 0;
+
+    for (; iter + 8 <= count; iter += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(input + 4 * iter));
+        __m128i b = _mm_loadu_si128((const __m128i*)(input + 4 * iter + 16));
+
+        high = _mm_or_si128(high, _mm_or_si128(_mm_srli_epi32(a, 16), _mm_srli_epi32(b, 16)));
+
+        a = _mm_sub_epi32(a, bias32);
+        b = _mm_sub_epi32(b, bias32);
+
+        _mm_storeu_si128((__m128i*)(output + 2 * iter), _mm_add_epi16(_mm_packs_epi32(a, b), bias16));
+    }
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(high, _mm_setzero_si128())) != 0xFFFF) return -1;
+
+    return narrowLittleEndian32To16Scalar(output + 2 * iter, input + 4 * iter, count - iter);
+}
+
+/* AVX2 kernels */
+
+/* commentary: the strided kernel packs several records into each 256-bit store: four 2-component
+   records, two 4-component records, or two 3-component records squeezed together with a permute */
+
+__attribute__((target("avx2")))
+void decodeLittleEndian32AVX2(void* destination, const void* source, size_t count) {
+    const unsigned char* input = (const unsigned char*)source;
+    unsigned char* output = (unsigned char*)destination;
+    size_t size = 4 * count, iter = 0;
+
+    for (; iter + 128 <= size; iter += 128) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(input + iter));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(input + iter + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(input + iter + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(input + iter + 96));
+
+        _mm256_storeu_si256((__m256i*)(output + iter), a);
+        _mm256_storeu_si256((__m256i*)(output + iter + 32), b);
+        _mm256_storeu_si256((__m256i*)(output + iter + 64), c);
+        _mm256_storeu_si256((__m256i*)(output + iter + 96), d);
+    }
+
+    for (; iter + 32 <= size; iter += 32) {
+        _mm256_storeu_si256((__m256i*)(output + iter), _mm256_loadu_si256((const __m256i*)(input + iter)));
+    }
+
+    memcpy(output + iter, input + iter, size - iter);
+}
+
+__attribute__((target("avx2")))
+void decodeStridedLittleEndian32AVX2(void* destination, const void* source, size_t count,
+    unsigned int components, size_t sourceStride) {
+    const unsigned char* input = (const unsigned char*)source;
+    unsigned char* output = (unsigned char*)destination;
+    size_t iter = 0;
+
+    if (components == 2) {
+        for (; iter + 4 <= count; iter += 4) {
+            __m128i a = _mm_loadl_epi64((const __m128i*)(input + sourceStride * iter));
+            __m128i b = _mm_loadl_epi64((const __m128i*)(input + sourceStride * (iter + 1)));
+            __m128i c = _mm_loadl_epi64((const __m128i*)(input + sourceStride * (iter + 2)));
+            __m128i d = _mm_loadl_epi64((const __m128i*)(input + sourceStride * (iter + 3)));
+
+            __m256i packed = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi64(a, b)),
+                _mm_unpacklo_epi64(c, d), 1);
+
+            _mm256_storeu_si256((__m256i*)(output + 8 * iter), packed);
+        }
+    }
+    else if (components == 3) {
+        const __m256i squeeze = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+
+        /* the 32-byte store reaches two values into the third record, so a third record must follow */
+
+        for (; iter + 3 <= count; iter += 2) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(input + sourceStride * iter));
+            __m128i b = _mm_loadu_si128((const __m128i*)(input + sourceStride * (iter + 1)));
+
+            __m256i packed = _mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1);
+
+            _mm256_storeu_si256((__m256i*)(output + 12 * iter), _mm256_permutevar8x32_epi32(packed, squeeze));
+        }
+    }
+    else if (components == 4) {
+        for (; iter + 2 <= count; iter += 2) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(input + sourceStride * iter));
+            __m128i b = _mm_loadu_si128((const __m128i*)(input + sourceStride * (iter + 1)));
+
+            _mm256_storeu_si256((__m256i*)(output + 16 * iter),
+                _mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1));
+        }
+    }
+
+    decodeStridedLittleEndian32SSE2(output + 4 * components * iter, input + sourceStride * iter,
+        count - iter, components, sourceStride);
+}
+
+#endif
+
+/* kernel selection */
+
+int bulkDecodeKernelSupported(int kernel) {
+    if (kernel == BULK_DECODE_KERNEL_SCALAR) return 1;
+
+#ifdef BULK_DECODE_X86
+    __builtin_cpu_init();
+
+    if (kernel == BULK_DECODE_KERNEL_SSE2) return __builtin_cpu_supports("sse2") ? 1 : 0;
+    if (kernel == BULK_DECODE_KERNEL_AVX2) return __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif
+
+    return 0;
+}
+
+const char* getNameFromBulkDecodeKernel(int kernel) {
+    switch (kernel) {
+        case BULK_DECODE_KERNEL_SCALAR: return "scalar";
+        case BULK_DECODE_KERNEL_SSE2: return "SSE2";
+        case BULK_DECODE_KERNEL_AVX2: return "AVX2";
+    }
+
+    return "auto";
+}
+
+int setBulkDecodeKernel(int kernel) {
+    if (kernel == BULK_DECODE_KERNEL_AUTO) {
+        kernel = BULK_DECODE_KERNEL_SCALAR;
+
+        if (bulkDecodeKernelSupported(BULK_DECODE_KERNEL_SSE2)) kernel = BULK_DECODE_KERNEL_SSE2;
+        if (bulkDecodeKernelSupported(BULK_DECODE_KERNEL_AVX2)) kernel = BULK_DECODE_KERNEL_AVX2;
+    }
+
+    if (!bulkDecodeKernelSupported(kernel)) return -1;
+
+    bulkDecodeFunction = decodeLittleEndian32Scalar;
+    bulkDecodeStridedFunction = decodeStridedLittleEndian32Scalar;
+    bulkNarrowFunction = narrowLittleEndian32To16Scalar;
+
+    /* narrowing is bound by the loads, so the AVX2 kernel set shares the SSE2 one */
+
+#ifdef BULK_DECODE_X86
+    if (kernel == BULK_DECODE_KERNEL_SSE2) {
+        bulkDecodeFunction = decodeLittleEndian32SSE2;
+        bulkDecodeStridedFunction = decodeStridedLittleEndian32SSE2;
+        bulkNarrowFunction = narrowLittleEndian32To16SSE2;
+    }
+    else if (kernel == BULK_DECODE_KERNEL_AVX2) {
+        bulkDecodeFunction = decodeLittleEndian32AVX2;
+        bulkDecodeStridedFunction = decodeStridedLittleEndian32AVX2;
+        bulkNarrowFunction = narrowLittleEndian32To16SSE2;
+    }
+#endif
+
+    bulkDecodeKernel = kernel;
+
+    return 0;
+}
+
+int getBulkDecodeKernel() {
+    initializeBulkDecode();
+
+    return bulkDecodeKernel;
+}
+
+void initializeBulkDecode() {
+    if (bulkDecodeKernel == BULK_DECODE_KERNEL_AUTO) setBulkDecodeKernel(BULK_DECODE_KERNEL_AUTO);
+}
+
+/* decoding */
+
+void decodeLittleEndian32(void* destination, const void* source, size_t count) {
+    initializeBulkDecode();
+
+    bulkDecodeFunction(destination, source, count);
+}
+
+void decodeStridedLittleEndian32(void* destination, const void* source, size_t count,
+    unsigned int components, size_t sourceStride) {
+    initializeBulkDecode();
+
+    if (components == 0) return;
+
+    /* records packed back to back are one contiguous run */
+
+    if (sourceStride == 4 * (size_t)components) bulkDecodeFunction(destination, source, count * components);
+    else bulkDecodeStridedFunction(destination, source, count, components, sourceStride);
+}
+
+int narrowLittleEndian32To16(void* destination, const void* source, size_t count) {
+    initializeBulkDecode();
+
+    return bulkNarrowFunction(destination, source, count);
+}
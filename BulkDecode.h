@@ -0,0 +1,42 @@
+#ifndef _BULKDECODE_H_
+#define _BULKDECODE_H_
+
+#include <stddef.h>
+
+/* commentary: bulk decoding of little-endian 32-bit payloads (floats and indices) into native order.
+   The kernel is picked at runtime from what the processor supports; on x86 the data is already in
+   native order, so the SIMD kernels only have to move it, while the scalar kernel assembles each
+   value from its bytes and is correct on any host */
+
+#define BULK_DECODE_KERNEL_AUTO 0
+#define BULK_DECODE_KERNEL_SCALAR 1
+#define BULK_DECODE_KERNEL_SSE2 2
+#define BULK_DECODE_KERNEL_AVX2 3
+
+#define BULK_DECODE_KERNEL_COUNT 4
+
+/* picks the best kernel; called by the loaders before any threads start, and safe to call again */
+void initializeBulkDecode();
+
+/* returns 0, or -1 if the processor (or this build) cannot run the kernel */
+int setBulkDecodeKernel(int kernel);
+
+int getBulkDecodeKernel();
+
+int bulkDecodeKernelSupported(int kernel);
+
+const char* getNameFromBulkDecodeKernel(int kernel);
+
+/* count contiguous values */
+void decodeLittleEndian32(void* destination, const void* source, size_t count);
+
+/* components consecutive values out of each of count records, sourceStride bytes apart; the
+   destination is packed, components values per record */
+void decodeStridedLittleEndian32(void* destination, const void* source, size_t count,
+    unsigned int components, size_t sourceStride);
+
+/* count contiguous values, each stored as an unsigned 16-bit value; returns 0, or -1 if a value
+   does not fit in 16 bits, in which case the destination holds garbage */
+int narrowLittleEndian32To16(void* destination, const void* source, size_t count);
+
+#endif
@@ -0,0 +1,66 @@
+#include "DynamicArray.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DYNAMIC_ARRAY_INITIAL_CAPACITY 8
+
+void initializeDynamicArray(DynamicArray* array, size_t elementSize, Arena* arena) {
+    array->data = NULL;
+    array->count = 0;
+    array->capacity = 0;
+    array->elementSize = elementSize;
+
+    array->arena = arena;
+}
+
+void freeDynamicArray(DynamicArray* array) {
+    if (array->arena == NULL) free(array->data);
+
+    array->data = NULL;
+    array->count = 0;
+    array->capacity = 0;
+}
+
+int growDynamicArray(DynamicArray* array) {
+    size_t capacity = (array->capacity > 0) ? 2 * array->capacity : DYNAMIC_ARRAY_INITIAL_CAPACITY;
+    void* data;
+
+    if (array->arena != NULL) {
+        data = allocateFromArena(array->arena, capacity * array->elementSize);
+        if (data != NULL && array->count > 0) memcpy(data, array->data, array->count * array->elementSize);
+    }
+    else {
+        data = realloc(array->data, capacity * array->elementSize);
+    }
+
+    if (data == NULL) return -1;
+
+    array->data = data;
+    array->capacity = capacity;
+
+    return 0;
+}
+
+void* pushOntoDynamicArray(DynamicArray* array) {
+    if (array->count == array->capacity && growDynamicArray(array) != 0) return NULL;
+
+    return (unsigned char*)array->data + array->elementSize * array->count++;
+}
+
+int pushPointerOntoDynamicArray(DynamicArray* array, void* pointer) {
+    void** slot = (void**)pushOntoDynamicArray(array);
+    if (slot == NULL) return -1;
+
+    *slot = pointer;
+
+    return 0;
+}
+
+void* getDataFromDynamicArray(DynamicArray* array) {
+    return array->data;
+}
+
+size_t getDynamicArrayCount(DynamicArray* array) {
+    return array->count;
+}
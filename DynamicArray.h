@@ -0,0 +1,38 @@
+#ifndef _DYNAMICARRAY_H_
+#define _DYNAMICARRAY_H_
+
+#include <stddef.h>
+
+#include "Arena.h"
+
+/* commentary: a contiguous array that grows geometrically. When it is given an arena it grows inside
+   it, leaving the outgrown storage behind, so once filled its storage can be kept as the final array
+   with no copy; without an arena it grows with realloc and must be freed.
+
+   the structure is meant to live on the stack or inside another structure, so it is not opaque */
+
+typedef struct DynamicArray DynamicArray;
+struct DynamicArray {
+    void* data;
+    size_t count, capacity;
+    size_t elementSize;
+
+    Arena* arena;
+};
+
+void initializeDynamicArray(DynamicArray* array, size_t elementSize, Arena* arena);
+
+/* only needed without an arena */
+void freeDynamicArray(DynamicArray* array);
+
+/* returns the new (uninitialized) element, or NULL if out of memory */
+void* pushOntoDynamicArray(DynamicArray* array);
+
+/* for arrays of pointers; returns 0, or -1 if out of memory */
+int pushPointerOntoDynamicArray(DynamicArray* array, void* pointer);
+
+void* getDataFromDynamicArray(DynamicArray* array);
+
+size_t getDynamicArrayCount(DynamicArray* array);
+
+#endif
@@ -0,0 +1,127 @@
+#include "MappedFile.h"
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* commentary: pages are mapped copy-on-write, so callers may patch the bytes without touching the file */
+
+struct MappedFile {
+    unsigned char* data;
+    size_t size;
+
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+#endif
+};
+
+#ifdef _WIN32
+
+MappedFile* openMappedFile(const char* filePath) {
+    MappedFile* output;
+    LARGE_INTEGER fileSize;
+
+    output = (MappedFile*)calloc(1, sizeof(MappedFile));
+
+    output->fileHandle = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (output->fileHandle == INVALID_HANDLE_VALUE) {
+        free(output);
+        return NULL;
+    }
+
+    if (!GetFileSizeEx(output->fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(output->fileHandle);
+        free(output);
+        return NULL;
+    }
+
+    output->size = (size_t)fileSize.QuadPart;
+
+    output->mappingHandle = CreateFileMappingA(output->fileHandle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+
+    if (output->mappingHandle == NULL) {
+        CloseHandle(output->fileHandle);
+        free(output);
+        return NULL;
+    }
+
+    output->data = (unsigned char*)MapViewOfFile(output->mappingHandle, FILE_MAP_COPY, 0, 0, 0);
+
+    if (output->data == NULL) {
+        CloseHandle(output->mappingHandle);
+        CloseHandle(output->fileHandle);
+        free(output);
+        return NULL;
+    }
+
+    return output;
+}
+
+void closeMappedFile(MappedFile* mappedFile) {
+    UnmapViewOfFile(mappedFile->data);
+    CloseHandle(mappedFile->mappingHandle);
+    CloseHandle(mappedFile->fileHandle);
+
+    free(mappedFile);
+}
+
+#else
+
+MappedFile* openMappedFile(const char* filePath) {
+    MappedFile* output;
+    struct stat fileStatus;
+    void* data;
+    int fd;
+
+    fd = open(filePath, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    if (fstat(fd, &fileStatus) != 0 || fileStatus.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    data = mmap(NULL, (size_t)fileStatus.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+    /* commentary: the mapping keeps its own reference to the file */
+    close(fd);
+
+    if (data == MAP_FAILED) return NULL;
+
+#ifdef MADV_SEQUENTIAL
+    madvise(data, (size_t)fileStatus.st_size, MADV_SEQUENTIAL);
+#endif
+
+    output = (MappedFile*)malloc(sizeof(MappedFile));
+    output->data = (unsigned char*)data;
+    output->size = (size_t)fileStatus.st_size;
+
+    return output;
+}
+
+void closeMappedFile(MappedFile* mappedFile) {
+    munmap(mappedFile->data, mappedFile->size);
+
+    free(mappedFile);
+}
+
+#endif
+
+unsigned char* getDataFromMappedFile(MappedFile* mappedFile) {
+    return mappedFile->data;
+}
+
+size_t getSizeFromMappedFile(MappedFile* mappedFile) {
+    return mappedFile->size;
+}
@@ -0,0 +1,17 @@
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+#include <stddef.h>
+
+typedef struct MappedFile MappedFile;
+struct MappedFile;
+
+MappedFile* openMappedFile(const char* filePath);
+
+void closeMappedFile(MappedFile* mappedFile);
+
+unsigned char* getDataFromMappedFile(MappedFile* mappedFile);
+
+size_t getSizeFromMappedFile(MappedFile* mappedFile);
+
+#endif
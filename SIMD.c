@@ -0,0 +1,48 @@
+#include "SIMD.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#endif
+
+int simdLevel = SIMD_LEVEL_AUTO;
+
+int simdLevelSupported(int level) {
+    if (level == SIMD_LEVEL_SCALAR) return 1;
+
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+
+    if (level == SIMD_LEVEL_SSE2) return __builtin_cpu_supports("sse2") ? 1 : 0;
+#endif
+
+    return 0;
+}
+
+const char* getNameFromSIMDLevel(int level) {
+    switch (level) {
+        case SIMD_LEVEL_SCALAR: return "scalar";
+        case SIMD_LEVEL_SSE2: return "SSE2";
+    }
+
+    return "auto";
+}
+
+int setSIMDLevel(int level) {
+    if (level == SIMD_LEVEL_AUTO) {
+        level = SIMD_LEVEL_SCALAR;
+
+        if (simdLevelSupported(SIMD_LEVEL_SSE2)) level = SIMD_LEVEL_SSE2;
+    }
+
+    if (!simdLevelSupported(level)) return -1;
+
+    simdLevel = level;
+
+    return 0;
+}
+
+int getSIMDLevel() {
+    if (simdLevel == SIMD_LEVEL_AUTO) setSIMDLevel(SIMD_LEVEL_AUTO);
+
+    return simdLevel;
+}
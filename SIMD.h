@@ -0,0 +1,27 @@
+#ifndef _SIMD_H_
+#define _SIMD_H_
+
+/* commentary: the instruction set the geometry kernels run with (the scene's matrices, bounds,
+   quantization and the rasterizer), apart from BulkDecode's payload kernel. It is picked at runtime
+   from what the processor supports; the SIMD kernels are built with per-function target attributes and
+   give the same results as the scalar code, so lowering the level only changes the speed */
+
+#define SIMD_LEVEL_AUTO 0
+#define SIMD_LEVEL_SCALAR 1
+#define SIMD_LEVEL_SSE2 2
+
+#define SIMD_LEVEL_COUNT 3
+
+/* returns 0, or -1 if the processor (or this build) cannot run the level; set it before any threads
+   that use it start */
+int setSIMDLevel(int level);
+
+/* the level picked, never SIMD_LEVEL_AUTO; the first call picks it, and createThreadPool makes that
+   call so thread pool tasks only ever read the level */
+int getSIMDLevel();
+
+int simdLevelSupported(int level);
+
+const char* getNameFromSIMDLevel(int level);
+
+#endif
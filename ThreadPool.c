@@ -0,0 +1,281 @@
+#include "ThreadPool.h"
+#include "SIMD.h"
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+typedef struct ThreadPoolWorker ThreadPoolWorker;
+struct ThreadPoolWorker {
+    ThreadPool* threadPool;
+    unsigned int workerIndex;
+
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+};
+
+struct ThreadPool {
+    ThreadPoolWorker* workers;
+    unsigned int threadCount;
+
+    /* the loop currently being run */
+    ThreadPoolFunction function;
+    void* context;
+    unsigned int count;
+    unsigned int nextIndex;
+
+    unsigned int generation;
+    unsigned int activeWorkers;
+    int quit;
+
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+    HANDLE startSemaphore;
+    HANDLE doneEvent;
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t startCondition;
+    pthread_cond_t doneCondition;
+#endif
+};
+
+/* platform wrappers */
+
+#ifdef _WIN32
+
+void lockThreadPool(ThreadPool* threadPool) { EnterCriticalSection(&threadPool->lock); }
+
+void unlockThreadPool(ThreadPool* threadPool) { LeaveCriticalSection(&threadPool->lock); }
+
+#else
+
+void lockThreadPool(ThreadPool* threadPool) { pthread_mutex_lock(&threadPool->lock); }
+
+void unlockThreadPool(ThreadPool* threadPool) { pthread_mutex_unlock(&threadPool->lock); }
+
+#endif
+
+/* indices are handed out one at a time, so uneven work items balance themselves */
+
+void runThreadPoolLoop(ThreadPool* threadPool, unsigned int workerIndex) {
+    for (;;) {
+        unsigned int index;
+
+        lockThreadPool(threadPool);
+        index = threadPool->nextIndex;
+        if (index < threadPool->count) threadPool->nextIndex++;
+        unlockThreadPool(threadPool);
+
+        if (index >= threadPool->count) return;
+
+        threadPool->function(threadPool->context, index, workerIndex);
+    }
+}
+
+void finishThreadPoolLoop(ThreadPool* threadPool) {
+    lockThreadPool(threadPool);
+    threadPool->activeWorkers--;
+
+#ifdef _WIN32
+    if (threadPool->activeWorkers == 0) SetEvent(threadPool->doneEvent);
+    unlockThreadPool(threadPool);
+#else
+    if (threadPool->activeWorkers == 0) pthread_cond_signal(&threadPool->doneCondition);
+    unlockThreadPool(threadPool);
+#endif
+}
+
+#ifdef _WIN32
+
+DWORD WINAPI runThreadPoolWorker(LPVOID data) {
+    ThreadPoolWorker* worker = (ThreadPoolWorker*)data;
+    ThreadPool* threadPool = worker->threadPool;
+
+    for (;;) {
+        WaitForSingleObject(threadPool->startSemaphore, INFINITE);
+
+        if (threadPool->quit) return 0;
+
+        runThreadPoolLoop(threadPool, worker->workerIndex);
+        finishThreadPoolLoop(threadPool);
+    }
+}
+
+#else
+
+void* runThreadPoolWorker(void* data) {
+    ThreadPoolWorker* worker = (ThreadPoolWorker*)data;
+    ThreadPool* threadPool = worker->threadPool;
+    unsigned int generation = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&threadPool->lock);
+
+        while (threadPool->generation == generation && !threadPool->quit) {
+            pthread_cond_wait(&threadPool->startCondition, &threadPool->lock);
+        }
+
+        generation = threadPool->generation;
+
+        if (threadPool->quit) {
+            pthread_mutex_unlock(&threadPool->lock);
+            return NULL;
+        }
+
+        pthread_mutex_unlock(&threadPool->lock);
+
+        runThreadPoolLoop(threadPool, worker->workerIndex);
+        finishThreadPoolLoop(threadPool);
+    }
+}
+
+#endif
+
+unsigned int getProcessorCount() {
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+
+    GetSystemInfo(&systemInfo);
+
+    return (systemInfo.dwNumberOfProcessors > 0) ? (unsigned int)systemInfo.dwNumberOfProcessors : 1;
+#else
+    long output = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (output > 0) ? (unsigned int)output : 1;
+#endif
+}
+
+ThreadPool* createThreadPool(unsigned int threadCount) {
+    ThreadPool* output;
+    unsigned int iter;
+
+    if (threadCount == 0) threadCount = getProcessorCount();
+
+    /* getSIMDLevel picks the level the first time it is asked; asking here, before any worker starts,
+       keeps the tasks from racing to write it */
+    getSIMDLevel();
+
+    output = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    output->threadCount = threadCount;
+    output->workers = (ThreadPoolWorker*)calloc(threadCount, sizeof(ThreadPoolWorker));
+
+#ifdef _WIN32
+    InitializeCriticalSection(&output->lock);
+    output->startSemaphore = CreateSemaphore(NULL, 0, (LONG)threadCount, NULL);
+    output->doneEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+#else
+    pthread_mutex_init(&output->lock, NULL);
+    pthread_cond_init(&output->startCondition, NULL);
+    pthread_cond_init(&output->doneCondition, NULL);
+#endif
+
+    /* worker 0 is whichever thread calls runParallelForOnThreadPool */
+
+    for (iter = 1; iter < threadCount; iter++) {
+        ThreadPoolWorker* worker = &(output->workers[iter]);
+
+        worker->threadPool = output;
+        worker->workerIndex = iter;
+
+#ifdef _WIN32
+        worker->thread = CreateThread(NULL, 0, runThreadPoolWorker, worker, 0, NULL);
+#else
+        pthread_create(&worker->thread, NULL, runThreadPoolWorker, worker);
+#endif
+    }
+
+    return output;
+}
+
+void freeThreadPool(ThreadPool* threadPool) {
+    unsigned int iter;
+
+    lockThreadPool(threadPool);
+    threadPool->quit = 1;
+
+#ifdef _WIN32
+    unlockThreadPool(threadPool);
+    if (threadPool->threadCount > 1) ReleaseSemaphore(threadPool->startSemaphore, (LONG)(threadPool->threadCount - 1), NULL);
+#else
+    pthread_cond_broadcast(&threadPool->startCondition);
+    unlockThreadPool(threadPool);
+#endif
+
+    for (iter = 1; iter < threadPool->threadCount; iter++) {
+#ifdef _WIN32
+        WaitForSingleObject(threadPool->workers[iter].thread, INFINITE);
+        CloseHandle(threadPool->workers[iter].thread);
+#else
+        pthread_join(threadPool->workers[iter].thread, NULL);
+#endif
+    }
+
+#ifdef _WIN32
+    CloseHandle(threadPool->startSemaphore);
+    CloseHandle(threadPool->doneEvent);
+    DeleteCriticalSection(&threadPool->lock);
+#else
+    pthread_cond_destroy(&threadPool->startCondition);
+    pthread_cond_destroy(&threadPool->doneCondition);
+    pthread_mutex_destroy(&threadPool->lock);
+#endif
+
+    free(threadPool->workers);
+    free(threadPool);
+}
+
+unsigned int getThreadCountFromThreadPool(ThreadPool* threadPool) {
+    return threadPool->threadCount;
+}
+
+void runParallelForOnThreadPool(ThreadPool* threadPool, unsigned int count, ThreadPoolFunction function, void* context) {
+    if (count == 0) return;
+
+    /* commentary: not worth waking anyone for a single item */
+
+    if (threadPool->threadCount == 1 || count == 1) {
+        unsigned int iter;
+
+        for (iter = 0; iter < count; iter++) function(context, iter, 0);
+        return;
+    }
+
+    lockThreadPool(threadPool);
+
+    threadPool->function = function;
+    threadPool->context = context;
+    threadPool->count = count;
+    threadPool->nextIndex = 0;
+    threadPool->activeWorkers = threadPool->threadCount - 1;
+    threadPool->generation++;
+
+#ifdef _WIN32
+    unlockThreadPool(threadPool);
+    ReleaseSemaphore(threadPool->startSemaphore, (LONG)(threadPool->threadCount - 1), NULL);
+#else
+    pthread_cond_broadcast(&threadPool->startCondition);
+    unlockThreadPool(threadPool);
+#endif
+
+    runThreadPoolLoop(threadPool, 0);
+
+    /* wait for the other workers to finish their last item */
+
+#ifdef _WIN32
+    WaitForSingleObject(threadPool->doneEvent, INFINITE);
+#else
+    pthread_mutex_lock(&threadPool->lock);
+    while (threadPool->activeWorkers > 0) {
+        pthread_cond_wait(&threadPool->doneCondition, &threadPool->lock);
+    }
+    pthread_mutex_unlock(&threadPool->lock);
+#endif
+}
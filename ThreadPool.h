@@ -0,0 +1,21 @@
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+/* commentary: a fixed set of worker threads that run parallel-for loops; the calling thread takes part as worker 0 */
+
+typedef struct ThreadPool ThreadPool;
+struct ThreadPool;
+
+typedef void (*ThreadPoolFunction)(void* context, unsigned int index, unsigned int workerIndex);
+
+ThreadPool* createThreadPool(unsigned int threadCount);
+
+void freeThreadPool(ThreadPool* threadPool);
+
+unsigned int getThreadCountFromThreadPool(ThreadPool* threadPool);
+
+void runParallelForOnThreadPool(ThreadPool* threadPool, unsigned int count, ThreadPoolFunction function, void* context);
+
+unsigned int getProcessorCount();
+
+#endif
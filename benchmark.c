@@ -0,0 +1,2071 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+#include "Blitz3DFile.h"
+#include "Blitz3DStream.h"
+#include "Blitz3DGenerator.h"
+#include "Blitz3DWriter.h"
+#include "Blitz3DOptimize.h"
+#include "Blitz3DScene.h"
+#include "Blitz3DBatch.h"
+#include "Blitz3DBVH.h"
+#include "Blitz3DPVS.h"
+#include "Blitz3DInterleave.h"
+#include "Blitz3DRasterizer.h"
+#include "BulkDecode.h"
+#include "SIMD.h"
+#include "ThreadPool.h"
+#include "Stack.h"
+#include "DynamicArray.h"
+
+/* benchmark for the Blitz3D loader, run as: benchmark <file.b3d> [iterations]
+   or, for the bulk decode kernels on their own: benchmark --kernels [iterations]
+   or, for the child array containers on their own: benchmark --containers [iterations]
+   or, over a set of generated files: benchmark --suite [iterations]
+   and to write one generated file: benchmark --generate <file.b3d> [nodes depth vertices uvsets tris strings]
+   or, to time saving a level and check it loads back: benchmark --rewrite <in.b3d> <out.b3d> [passes]
+   or, for the vertex cache pass per mesh: benchmark --vertexcache <file.b3d> [cache size]
+   or, to time the mesh passes on one thread and on all of them: benchmark --optimize <file.b3d> [passes [epsilon]]
+   or, to time merging the level into one batch per brush: benchmark --batch <file.b3d> [iterations]
+   or, to time flattening the node tree and its world matrices: benchmark --scene <file.b3d> [iterations]
+   or, to time working out the bounds of every mesh and node: benchmark --bounds <file.b3d> [iterations]
+   or, to time frustum culling with the BVH against testing every range: benchmark --cull <file.b3d> [iterations]
+   or, to build, check and save the level's potentially visible sets: benchmark --pvs <file.b3d> [cells [samples rays]]
+   or, to pack each mesh's and batch's vertices into one array, as floats and compact:
+       benchmark --interleave <file.b3d> [iterations]
+   or, to draw the level in software along each axis, and optionally save the first view:
+       benchmark --raster <file.b3d> [iterations [image.ppm]] */
+
+#define DEFAULT_ITERATIONS 5
+
+/* the stream row feeds the file in pieces of this size, as a pipe would deliver it */
+#define STREAM_PIECE_SIZE (64 * 1024)
+
+/* the kernel benchmark decodes this many vertices, laid out like a lightmapped level: xyz plus two UV sets */
+#define KERNEL_VERTEX_COUNT (4 * 1024 * 1024)
+#define KERNEL_VERTEX_FLOATS 7
+
+/* the container benchmark fills this many arrays' worth of elements per round, at several array sizes */
+#define CONTAINER_ELEMENT_COUNT (1024 * 1024)
+
+/* the vertex cache report simulates a FIFO of this many entries unless told otherwise */
+#define DEFAULT_VERTEX_CACHE_SIZE 16
+
+/* the suite writes each of its configurations to this file in turn, and removes it when done */
+#define SUITE_FILE_PATH "benchmark_suite.b3d"
+
+typedef struct SuiteConfiguration SuiteConfiguration;
+struct SuiteConfiguration {
+    const char* label;
+
+    unsigned int nodeCount, treeDepth;
+    unsigned int vertexCount, texCoordSets, trisChunkCount;
+    int vertexFlags;
+    unsigned int stringLength;
+};
+
+/* commentary: each configuration moves one setting away from "base", so a change in one row points at
+   one part of the loader: node overhead, recursion, vertex decoding, TRIS chunk overhead, strings */
+
+SuiteConfiguration suiteConfigurations[] = {
+    { "base", 256, 4, 4096, 2, 2, 0, 16 },
+    { "nodes", 16384, 4, 64, 2, 1, 0, 16 },
+    { "deep", 1024, 512, 1024, 2, 2, 0, 16 },
+    { "vertices", 16, 2, 262144, 2, 2, 0, 16 },
+    { "uv0", 256, 4, 4096, 0, 2, 0, 16 },
+    { "uv4", 256, 4, 4096, 4, 2, 0, 16 },
+    { "normals", 256, 4, 4096, 2, 2, BLITZ3D_GENERATOR_NORMALS | BLITZ3D_GENERATOR_COLORS, 16 },
+    { "tris", 256, 4, 4096, 2, 64, 0, 16 },
+    { "strings", 16384, 4, 64, 2, 1, 0, 1024 }
+};
+
+#define SUITE_CONFIGURATION_COUNT (sizeof(suiteConfigurations) / sizeof(suiteConfigurations[0]))
+
+double getTimeInSeconds() {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)now.tv_sec + 1e-9 * (double)now.tv_nsec;
+#endif
+}
+
+double getFileMegabytes(const char* filePath) {
+    double output;
+    FILE* fp = fopen(filePath, "rb");
+    if (fp == NULL) return 0.0;
+
+    fseek(fp, 0, SEEK_END);
+    output = (double)ftell(fp) / (1024.0 * 1024.0);
+    fclose(fp);
+
+    return output;
+}
+
+/* commentary: peak RSS is per process, so it is reset before each measurement where the system allows
+   it (Linux); elsewhere a row shows the highest peak seen so far */
+
+void resetPeakMemory() {
+#ifdef __linux__
+    FILE* fp = fopen("/proc/self/clear_refs", "w");
+    if (fp == NULL) return;
+
+    fputs("5", fp);
+    fclose(fp);
+#endif
+}
+
+double getPeakMemoryMegabytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0.0;
+
+    return (double)counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    struct rusage usage;
+#ifdef __linux__
+    char line[128];
+    FILE* fp = fopen("/proc/self/status", "r");
+
+    /* VmHWM follows the reset above, while ru_maxrss does not */
+
+    if (fp != NULL) {
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            unsigned long kilobytes;
+
+            if (sscanf(line, "VmHWM: %lu kB", &kilobytes) == 1) {
+                fclose(fp);
+                return (double)kilobytes / 1024.0;
+            }
+        }
+
+        fclose(fp);
+    }
+#endif
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+
+#ifdef __APPLE__
+    return (double)usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    return (double)usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+/* commentary: the best of several runs is reported, which hides cold-cache effects after the first load */
+
+int timeLoader(const char* filePath, int flags, int iterations, double* best, double* mean, unsigned int* blockCount) {
+    double total = 0.0;
+    int iter;
+
+    *best = -1.0;
+
+    for (iter = 0; iter < iterations; iter++) {
+        double start, elapsed;
+        B3DFile* b3d;
+
+        start = getTimeInSeconds();
+        b3d = loadB3DFileWithFlags(filePath, flags);
+        elapsed = getTimeInSeconds() - start;
+
+        if (b3d == NULL) return -1;
+
+        total += elapsed;
+        if (*best < 0.0 || elapsed < *best) *best = elapsed;
+
+        *blockCount = getBlockCountFromFile(b3d);
+        freeB3DFile(b3d);
+    }
+
+    *mean = total / iterations;
+
+    return 0;
+}
+
+void benchmarkLoader(const char* label, const char* filePath, int flags, int iterations, double megabytes) {
+    double best, mean;
+    unsigned int blockCount;
+
+    if (timeLoader(filePath, flags, iterations, &best, &mean, &blockCount) != 0) {
+        fprintf(stderr, "%s: failed to load %s\n", label, filePath);
+        return;
+    }
+
+    printf("%-8s best %9.3f ms  mean %9.3f ms  %9.1f MB/s\n", label,
+        1000.0 * best, 1000.0 * mean, megabytes / best);
+}
+
+void countStreamTriangles(void* context, Blitz3DMESHChunk* meshChunk, Blitz3DTRISChunk* trisChunk) {
+    (void)meshChunk;
+
+    *((unsigned long*)context) += getTriangleCountFromTRISChunk(trisChunk);
+}
+
+void benchmarkStream(const char* filePath, int iterations, double megabytes) {
+    Blitz3DStreamCallbacks callbacks = { NULL };
+    unsigned char* piece;
+    double best = -1.0, total = 0.0;
+    size_t peakMemory = 0;
+    unsigned long triangleCount = 0;
+    int iter;
+
+    callbacks.triangleBatch = countStreamTriangles;
+    piece = (unsigned char*)malloc(STREAM_PIECE_SIZE);
+
+    for (iter = 0; iter < iterations; iter++) {
+        double start, elapsed;
+        Blitz3DStream* stream;
+        size_t count;
+        int result = 0;
+
+        FILE* fp = fopen(filePath, "rb");
+        if (fp == NULL) break;
+
+        triangleCount = 0;
+
+        start = getTimeInSeconds();
+        stream = createBlitz3DStream(&callbacks, &triangleCount);
+
+        while (result == 0 && (count = fread(piece, 1, STREAM_PIECE_SIZE, fp)) > 0) {
+            result = feedBlitz3DStream(stream, piece, count);
+        }
+
+        if (result == 0) result = finishBlitz3DStream(stream);
+        elapsed = getTimeInSeconds() - start;
+
+        peakMemory = getPeakMemoryFromBlitz3DStream(stream);
+        freeBlitz3DStream(stream);
+        fclose(fp);
+
+        if (result != 0) {
+            fprintf(stderr, "stream: failed to parse %s\n", filePath);
+            free(piece);
+            return;
+        }
+
+        total += elapsed;
+        if (best < 0.0 || elapsed < best) best = elapsed;
+    }
+
+    free(piece);
+
+    if (best < 0.0) return;
+
+    printf("%-8s best %9.3f ms  mean %9.3f ms  %9.1f MB/s  (%lu triangles, peak %.2f MB)\n", "stream",
+        1000.0 * best, 1000.0 * total / iterations, megabytes / best,
+        triangleCount, peakMemory / (1024.0 * 1024.0));
+}
+
+/* commentary: the first cached load writes the cache if it is missing or stale, so it is timed on its own */
+
+void printCacheWarmup(const char* filePath) {
+    double start, elapsed;
+    B3DFile* b3d;
+
+    start = getTimeInSeconds();
+    b3d = loadB3DFileWithFlags(filePath, BLITZ3D_LOAD_CACHED);
+    elapsed = getTimeInSeconds() - start;
+
+    if (b3d == NULL) return;
+
+    printf("%-8s %9.3f ms (%s)\n", "warmup", 1000.0 * elapsed,
+        fileLoadedFromCache(b3d) ? "cache was current" : "cache written");
+
+    freeB3DFile(b3d);
+}
+
+void printChunkMemory(const char* label, const char* filePath, int flags) {
+    const char* chunkNames[BLITZ3D_CHUNK_TYPE_COUNT] = { "BB3D", "TEXS", "BRUS", "NODE", "MESH", "VRTS", "TRIS" };
+    B3DFile* b3d;
+    int chunkType;
+
+    b3d = loadB3DFileWithFlags(filePath, flags);
+    if (b3d == NULL) return;
+
+    printf("memory by chunk type (%s):", label);
+    for (chunkType = 0; chunkType < BLITZ3D_CHUNK_TYPE_COUNT; chunkType++) {
+        printf(" %s %.2f MB", chunkNames[chunkType],
+            getBytesUsedByChunkTypeFromFile(b3d, chunkType) / (1024.0 * 1024.0));
+    }
+    printf(", reserved %.2f MB\n", getBytesReservedFromFile(b3d) / (1024.0 * 1024.0));
+
+    freeB3DFile(b3d);
+}
+
+/* commentary: rates are in decoded bytes per second, so the strided rows are comparable with the contiguous one */
+
+double timeDecodeKernel(int kernel, int layout, void* destination, const unsigned char* source, int iterations) {
+    double best = -1.0;
+    int iter;
+
+    setBulkDecodeKernel(kernel);
+
+    for (iter = 0; iter < iterations; iter++) {
+        double start = getTimeInSeconds(), elapsed;
+
+        if (layout == 0) {
+            decodeLittleEndian32(destination, source, KERNEL_VERTEX_COUNT * KERNEL_VERTEX_FLOATS);
+        }
+        else if (layout == 1) {
+            decodeStridedLittleEndian32(destination, source, KERNEL_VERTEX_COUNT, 3, KERNEL_VERTEX_FLOATS * sizeof(float));
+        }
+        else {
+            decodeStridedLittleEndian32(destination, source + 3 * sizeof(float), KERNEL_VERTEX_COUNT, 2,
+                KERNEL_VERTEX_FLOATS * sizeof(float));
+        }
+
+        elapsed = getTimeInSeconds() - start;
+        if (best < 0.0 || elapsed < best) best = elapsed;
+    }
+
+    return best;
+}
+
+void benchmarkDecodeKernels(int iterations) {
+    const char* layoutNames[3] = { "contiguous", "xyz of 7", "uv of 7" };
+    const size_t layoutBytes[3] = {
+        (size_t)KERNEL_VERTEX_COUNT * KERNEL_VERTEX_FLOATS * sizeof(float),
+        (size_t)KERNEL_VERTEX_COUNT * 3 * sizeof(float),
+        (size_t)KERNEL_VERTEX_COUNT * 2 * sizeof(float)
+    };
+    unsigned char* source;
+    void* destination;
+    size_t iter;
+    int kernel, layout;
+
+    source = (unsigned char*)malloc(layoutBytes[0]);
+    destination = malloc(layoutBytes[0]);
+
+    for (iter = 0; iter < layoutBytes[0]; iter++) source[iter] = (unsigned char)(iter * 31);
+
+    printf("bulk decode kernels, %d vertices of %d floats, %d iterations\n",
+        KERNEL_VERTEX_COUNT, KERNEL_VERTEX_FLOATS, iterations);
+
+    for (kernel = BULK_DECODE_KERNEL_SCALAR; kernel < BULK_DECODE_KERNEL_COUNT; kernel++) {
+        if (!bulkDecodeKernelSupported(kernel)) {
+            printf("%-8s not supported\n", getNameFromBulkDecodeKernel(kernel));
+            continue;
+        }
+
+        printf("%-8s", getNameFromBulkDecodeKernel(kernel));
+
+        for (layout = 0; layout < 3; layout++) {
+            double best = timeDecodeKernel(kernel, layout, destination, source, iterations);
+            printf("  %s %6.2f GB/s", layoutNames[layout], layoutBytes[layout] / best / 1e9);
+        }
+
+        printf("\n");
+    }
+
+    setBulkDecodeKernel(BULK_DECODE_KERNEL_AUTO);
+
+    free(source);
+    free(destination);
+}
+
+/* child array containers */
+
+/* commentary: both sides build what a chunk reader builds, an array of child pointers in file order
+   inside the file's arena; the Stack side pops its elements back out in reverse as the readers used to */
+
+double timeStackChildArrays(Arena* arena, unsigned int arraySize) {
+    double start = getTimeInSeconds();
+    unsigned int arrayIter, iter;
+
+    for (arrayIter = 0; arrayIter < CONTAINER_ELEMENT_COUNT / arraySize; arrayIter++) {
+        Stack* stack = createStack();
+        void** array;
+
+        for (iter = 0; iter < arraySize; iter++) pushOntoStack(stack, (void*)(size_t)iter);
+
+        array = (void**)allocateFromArena(arena, getStackCount(stack) * sizeof(void*));
+
+        for (iter = 0; iter < arraySize; iter++) array[arraySize - iter - 1] = popOffOfStack(stack);
+
+        freeStack(stack);
+    }
+
+    return getTimeInSeconds() - start;
+}
+
+double timeDynamicChildArrays(Arena* arena, unsigned int arraySize) {
+    double start = getTimeInSeconds();
+    unsigned int arrayIter, iter;
+
+    for (arrayIter = 0; arrayIter < CONTAINER_ELEMENT_COUNT / arraySize; arrayIter++) {
+        DynamicArray array;
+
+        initializeDynamicArray(&array, sizeof(void*), arena);
+
+        for (iter = 0; iter < arraySize; iter++) pushPointerOntoDynamicArray(&array, (void*)(size_t)iter);
+    }
+
+    return getTimeInSeconds() - start;
+}
+
+void benchmarkContainers(int iterations) {
+    const unsigned int arraySizes[4] = { 4, 64, 4096, CONTAINER_ELEMENT_COUNT };
+    unsigned int sizeIter;
+    int iter;
+
+    printf("child arrays, %d elements per round, %d iterations, ns per element\n", CONTAINER_ELEMENT_COUNT, iterations);
+
+    for (sizeIter = 0; sizeIter < 4; sizeIter++) {
+        double bestStack = -1.0, bestDynamic = -1.0;
+        size_t stackBytes = 0, dynamicBytes = 0;
+
+        for (iter = 0; iter < iterations; iter++) {
+            Arena* arena = createArena(256 * 1024);
+            double elapsed;
+
+            elapsed = timeStackChildArrays(arena, arraySizes[sizeIter]);
+            if (bestStack < 0.0 || elapsed < bestStack) bestStack = elapsed;
+            stackBytes = getBytesUsedFromArena(arena);
+
+            resetArena(arena);
+
+            elapsed = timeDynamicChildArrays(arena, arraySizes[sizeIter]);
+            if (bestDynamic < 0.0 || elapsed < bestDynamic) bestDynamic = elapsed;
+            dynamicBytes = getBytesUsedFromArena(arena);
+
+            freeArena(arena);
+        }
+
+        printf("%8u per array  Stack %7.2f  DynamicArray %7.2f  (arena %.2f MB vs %.2f MB)\n", arraySizes[sizeIter],
+            1e9 * bestStack / CONTAINER_ELEMENT_COUNT, 1e9 * bestDynamic / CONTAINER_ELEMENT_COUNT,
+            stackBytes / (1024.0 * 1024.0), dynamicBytes / (1024.0 * 1024.0));
+    }
+}
+
+/* saving */
+
+unsigned long countVerticesInNode(Blitz3DNODEChunk* nodeChunk) {
+    Blitz3DMESHChunk* meshChunk = getMESHChunkFromNODEChunk(nodeChunk);
+    unsigned long output = 0;
+    unsigned int iter;
+
+    if (meshChunk != NULL && getVRTSChunkFromMESHChunk(meshChunk) != NULL) {
+        output += getVertexCountFromVRTSChunk(getVRTSChunkFromMESHChunk(meshChunk));
+    }
+
+    for (iter = 0; iter < getNODEChunkArrayCountFromNodeChunk(nodeChunk); iter++) {
+        output += countVerticesInNode(getNODEChunkArrayEntryFromNODEChunk(nodeChunk, iter));
+    }
+
+    return output;
+}
+
+unsigned long countVerticesInFile(B3DFile* b3d) {
+    Blitz3DNODEChunk* nodeChunk = getNODEChunkFromBB3DChunk(getBB3DChunkFromFile(b3d));
+
+    return (nodeChunk != NULL) ? countVerticesInNode(nodeChunk) : 0;
+}
+
+int filesIdentical(const char* firstPath, const char* secondPath) {
+    FILE* first = fopen(firstPath, "rb");
+    FILE* second = fopen(secondPath, "rb");
+    int output = (first != NULL && second != NULL);
+    int a = 0, b = 0;
+
+    while (output && a != EOF) {
+        a = fgetc(first);
+        b = fgetc(second);
+
+        if (a != b) output = 0;
+    }
+
+    if (first != NULL) fclose(first);
+    if (second != NULL) fclose(second);
+
+    return output;
+}
+
+/* commentary: without passes a level this loader fully understands must come back byte for byte;
+   with passes the saved level is loaded again and its vertex count compared */
+
+int benchmarkRewrite(const char* inputPath, const char* outputPath, int passes) {
+    double start, elapsed;
+    unsigned long verticesBefore, verticesAfter;
+    B3DFile* b3d;
+
+    b3d = loadB3DFileWithFlags(inputPath, BLITZ3D_LOAD_MAPPED);
+    if (b3d == NULL) return 1;
+
+    verticesBefore = countVerticesInFile(b3d);
+
+    start = getTimeInSeconds();
+    if (saveB3DFile(b3d, outputPath, passes) != 0) {
+        freeB3DFile(b3d);
+        return 1;
+    }
+    elapsed = getTimeInSeconds() - start;
+
+    freeB3DFile(b3d);
+
+    printf("saved %s (passes %d) in %.3f ms, %.1f MB/s\n", outputPath, passes,
+        1000.0 * elapsed, getFileMegabytes(outputPath) / elapsed);
+
+    b3d = loadB3DFileWithFlags(outputPath, BLITZ3D_LOAD_MAPPED);
+    if (b3d == NULL) {
+        fprintf(stderr, "%s does not load back\n", outputPath);
+        return 1;
+    }
+
+    verticesAfter = countVerticesInFile(b3d);
+    freeB3DFile(b3d);
+
+    printf("%.2f MB -> %.2f MB, %lu -> %lu vertices\n", getFileMegabytes(inputPath), getFileMegabytes(outputPath),
+        verticesBefore, verticesAfter);
+
+    if (passes == 0) {
+        int identical = filesIdentical(inputPath, outputPath);
+
+        printf("round trip: %s\n", identical ? "identical" : "differs");
+        if (!identical) return 1;
+    }
+
+    return 0;
+}
+
+/* mesh passes */
+
+unsigned long countTrianglesInMESHChunk(Blitz3DMESHChunk* meshChunk);
+
+unsigned long countTrianglesInNode(Blitz3DNODEChunk* nodeChunk) {
+    Blitz3DMESHChunk* meshChunk = getMESHChunkFromNODEChunk(nodeChunk);
+    unsigned long output = 0;
+    unsigned int iter;
+
+    if (meshChunk != NULL && getVRTSChunkFromMESHChunk(meshChunk) != NULL) output += countTrianglesInMESHChunk(meshChunk);
+
+    for (iter = 0; iter < getNODEChunkArrayCountFromNodeChunk(nodeChunk); iter++) {
+        output += countTrianglesInNode(getNODEChunkArrayEntryFromNODEChunk(nodeChunk, iter));
+    }
+
+    return output;
+}
+
+unsigned long countTrianglesInFile(B3DFile* b3d) {
+    Blitz3DNODEChunk* nodeChunk = getNODEChunkFromBB3DChunk(getBB3DChunkFromFile(b3d));
+
+    return (nodeChunk != NULL) ? countTrianglesInNode(nodeChunk) : 0;
+}
+
+/* commentary: each run gets a fresh copy of the file, since the passes change it */
+
+int benchmarkOptimize(const char* filePath, int passes, float epsilon) {
+    const char* modeNames[2] = { "serial", "parallel" };
+    const unsigned int threadCounts[2] = { 1, 0 };
+    unsigned long verticesBefore, verticesAfter, trianglesBefore, trianglesAfter;
+    double start, elapsed;
+    size_t savedBytes;
+    int mode;
+
+    setWeldEpsilon(epsilon);
+    printf("passes %d, weld epsilon %g\n", passes, epsilon);
+
+    for (mode = 0; mode < 2; mode++) {
+        B3DFile* b3d = loadB3DFileWithFlags(filePath, BLITZ3D_LOAD_MAPPED);
+        if (b3d == NULL) return 1;
+
+        verticesBefore = countVerticesInFile(b3d);
+        trianglesBefore = countTrianglesInFile(b3d);
+
+        setThreadCountForOptimize(threadCounts[mode]);
+
+        start = getTimeInSeconds();
+        savedBytes = optimizeB3DFile(b3d, passes);
+        elapsed = getTimeInSeconds() - start;
+
+        verticesAfter = countVerticesInFile(b3d);
+        trianglesAfter = countTrianglesInFile(b3d);
+
+        printf("%-8s %9.3f ms  vertices %lu -> %lu, triangles %lu -> %lu, %.2f MB of vertex data saved\n",
+            modeNames[mode], 1000.0 * elapsed, verticesBefore, verticesAfter, trianglesBefore, trianglesAfter,
+            savedBytes / (1024.0 * 1024.0));
+
+        freeB3DFile(b3d);
+    }
+
+    setThreadCountForOptimize(0);
+    setWeldEpsilon(0.0f);
+
+    return 0;
+}
+
+/* static batches */
+
+unsigned long countTRISChunksInNode(Blitz3DNODEChunk* nodeChunk) {
+    Blitz3DMESHChunk* meshChunk = getMESHChunkFromNODEChunk(nodeChunk);
+    unsigned long output = 0;
+    unsigned int iter;
+
+    if (meshChunk != NULL) output += getTRISChunkArrayCountFromMESHChunk(meshChunk);
+
+    for (iter = 0; iter < getNODEChunkArrayCountFromNodeChunk(nodeChunk); iter++) {
+        output += countTRISChunksInNode(getNODEChunkArrayEntryFromNODEChunk(nodeChunk, iter));
+    }
+
+    return output;
+}
+
+double getBatchSetMegabytes(Blitz3DBatchSet* batchSet) {
+    double output = 0.0;
+    unsigned int iter;
+
+    for (iter = 0; iter < getBatchArrayCountFromBatchSet(batchSet); iter++) {
+        Blitz3DBatch* batch = getBatchArrayEntryFromBatchSet(batchSet, iter);
+        unsigned int floats = 3 + getTexCoordArrayCountFromBatch(batch) * getTexCoordArrayComponentCountFromBatch(batch);
+
+        if (getNormalArrayFromBatch(batch) != NULL) floats += 3;
+        if (getColorArrayFromBatch(batch) != NULL) floats += 4;
+
+        output += (double)getVertexCountFromBatch(batch) * floats * sizeof(float);
+        output += (double)getIndexCountFromBatch(batch) * getIndexSizeFromBatch(batch);
+    }
+
+    return output / (1024.0 * 1024.0);
+}
+
+/* commentary: the index-only row is what the viewer does; each mesh is decoded, copied and evicted */
+
+int benchmarkBatches(const char* filePath, int iterations) {
+    const char* modeNames[2] = { "mapped", "index" };
+    const int modeFlags[2] = { BLITZ3D_LOAD_MAPPED, BLITZ3D_LOAD_INDEX_ONLY };
+    int mode, iter;
+
+    for (mode = 0; mode < 2; mode++) {
+        double best = -1.0;
+
+        for (iter = 0; iter < iterations; iter++) {
+            B3DFile* b3d = loadB3DFileWithFlags(filePath, modeFlags[mode] | BLITZ3D_LOAD_SHORT_INDICES);
+            Blitz3DBatchSet* batchSet;
+            double start, elapsed;
+
+            if (b3d == NULL) return 1;
+
+            start = getTimeInSeconds();
+            batchSet = createBatchSetFromB3DFile(b3d);
+            elapsed = getTimeInSeconds() - start;
+
+            if (batchSet == NULL) {
+                freeB3DFile(b3d);
+                return 1;
+            }
+
+            if (best < 0.0 || elapsed < best) best = elapsed;
+
+            if (mode == 0 && iter == 0) {
+                Blitz3DNODEChunk* nodeChunk = getNODEChunkFromBB3DChunk(getBB3DChunkFromFile(b3d));
+                unsigned long batchVertices = 0;
+                unsigned int batchIter;
+
+                for (batchIter = 0; batchIter < getBatchArrayCountFromBatchSet(batchSet); batchIter++) {
+                    batchVertices += getVertexCountFromBatch(getBatchArrayEntryFromBatchSet(batchSet, batchIter));
+                }
+
+                printf("draws %lu -> %u, vertices %lu -> %lu, batches %.2f MB\n",
+                    (nodeChunk != NULL) ? countTRISChunksInNode(nodeChunk) : 0, getBatchArrayCountFromBatchSet(batchSet),
+                    countVerticesInFile(b3d), batchVertices, getBatchSetMegabytes(batchSet));
+            }
+
+            freeBatchSet(batchSet);
+            freeB3DFile(b3d);
+        }
+
+        printf("%-8s best %9.3f ms\n", modeNames[mode], 1000.0 * best);
+    }
+
+    return 0;
+}
+
+/* scene */
+
+/* world matrices are cheap next to everything else here, so each timing covers this many updates */
+#define SCENE_UPDATE_REPEATS 1000
+
+double timeWorldMatrices(Blitz3DScene* scene, int kernel, int iterations) {
+    double best = -1.0;
+    int iter, repeat;
+
+    if (setSIMDLevel(kernel) != 0) return -1.0;
+
+    for (iter = 0; iter < iterations; iter++) {
+        double start = getTimeInSeconds();
+        double elapsed;
+
+        for (repeat = 0; repeat < SCENE_UPDATE_REPEATS; repeat++) updateWorldMatricesInScene(scene);
+
+        elapsed = (getTimeInSeconds() - start) / SCENE_UPDATE_REPEATS;
+        if (best < 0.0 || elapsed < best) best = elapsed;
+    }
+
+    return best;
+}
+
+int benchmarkScene(const char* filePath, int iterations) {
+    const int kernels[2] = { SIMD_LEVEL_SCALAR, SIMD_LEVEL_SSE2 };
+    B3DFile* b3d = loadB3DFileWithFlags(filePath, BLITZ3D_LOAD_MAPPED);
+    Blitz3DScene* scene = NULL;
+    Blitz3DBatchSet* batchSet;
+    float* scalarMatrices = NULL;
+    double best = -1.0, start, elapsed, difference = 0.0;
+    unsigned int nodeCount, meshCount = 0, depth = 0, iter;
+    int kernel;
+
+    if (b3d == NULL) return 1;
+
+    for (iter = 0; iter < (unsigned int)iterations; iter++) {
+        if (scene != NULL) freeScene(scene);
+
+        start = getTimeInSeconds();
+        scene = createSceneFromB3DFile(b3d);
+        elapsed = getTimeInSeconds() - start;
+
+        if (scene == NULL) {
+            freeB3DFile(b3d);
+            return 1;
+        }
+
+        if (best < 0.0 || elapsed < best) best = elapsed;
+    }
+
+    nodeCount = getNodeCountFromScene(scene);
+
+    for (iter = 0; iter < nodeCount; iter++) {
+        unsigned int level = 0;
+        int parent;
+
+        if (getMESHChunkFromScene(scene, iter) != NULL) meshCount++;
+
+        for (parent = getParentIndexFromScene(scene, iter); parent >= 0; parent = getParentIndexFromScene(scene, parent)) level++;
+        if (level > depth) depth = level;
+    }
+
+    printf("nodes %u, meshes %u, depth %u\n", nodeCount, meshCount, depth);
+    printf("%-8s best %9.3f ms\n", "flatten", 1000.0 * best);
+
+    for (kernel = 0; kernel < 2; kernel++) {
+        best = timeWorldMatrices(scene, kernels[kernel], iterations);
+
+        if (best < 0.0) {
+            printf("%-8s unsupported\n", getNameFromSIMDLevel(kernels[kernel]));
+            continue;
+        }
+
+        printf("%-8s best %9.3f us per update\n", getNameFromSIMDLevel(kernels[kernel]), 1000000.0 * best);
+
+        if (kernel == 0) {
+            scalarMatrices = (float*)malloc(16 * (size_t)nodeCount * sizeof(float));
+            if (scalarMatrices != NULL) memcpy(scalarMatrices, getWorldMatrixFromScene(scene, 0), 16 * (size_t)nodeCount * sizeof(float));
+        }
+        else if (scalarMatrices != NULL) {
+            for (iter = 0; iter < 16 * nodeCount; iter++) {
+                double value = getWorldMatrixFromScene(scene, 0)[iter] - scalarMatrices[iter];
+
+                if (value < 0.0) value = -value;
+                if (value > difference) difference = value;
+            }
+
+            printf("largest difference from scalar %g\n", difference);
+        }
+    }
+
+    free(scalarMatrices);
+    setSIMDLevel(SIMD_LEVEL_AUTO);
+
+    start = getTimeInSeconds();
+    batchSet = createBatchSetFromScene(scene);
+    printf("%-8s %9.3f ms\n", "batches", 1000.0 * (getTimeInSeconds() - start));
+    if (batchSet != NULL) freeBatchSet(batchSet);
+
+    start = getTimeInSeconds();
+    bakeTransformsIntoScene(scene);
+    printf("%-8s %9.3f ms\n", "bake", 1000.0 * (getTimeInSeconds() - start));
+
+    freeScene(scene);
+    freeB3DFile(b3d);
+
+    return 0;
+}
+
+/* bounds */
+
+int benchmarkBounds(const char* filePath, int iterations) {
+    const int kernels[2] = { SIMD_LEVEL_SCALAR, SIMD_LEVEL_SSE2 };
+    B3DFile* b3d = loadB3DFileWithFlags(filePath, BLITZ3D_LOAD_MAPPED);
+    Blitz3DNODEChunk* nodeChunk;
+    Blitz3DBounds* bounds;
+    double best, start, elapsed;
+    int kernel, iter;
+
+    if (b3d == NULL) return 1;
+
+    nodeChunk = getNODEChunkFromBB3DChunk(getBB3DChunkFromFile(b3d));
+
+    printf("triangles %lu\n", countTrianglesInFile(b3d));
+
+    for (kernel = 0; kernel < 2; kernel++) {
+        if (setSIMDLevel(kernels[kernel]) != 0) {
+            printf("%-8s unsupported\n", getNameFromSIMDLevel(kernels[kernel]));
+            continue;
+        }
+
+        best = -1.0;
+
+        for (iter = 0; iter < iterations; iter++) {
+            start = getTimeInSeconds();
+            updateBoundsInB3DFile(b3d);
+            elapsed = getTimeInSeconds() - start;
+
+            if (best < 0.0 || elapsed < best) best = elapsed;
+        }
+
+        printf("%-8s best %9.3f ms", getNameFromSIMDLevel(kernels[kernel]), 1000.0 * best);
+
+        if (nodeChunk != NULL && !boundsEmpty(bounds = getBoundsFromNODEChunk(nodeChunk))) {
+            printf("  root (%g %g %g)-(%g %g %g) radius %g", getMinimumFromBounds(bounds)[0], getMinimumFromBounds(bounds)[1],
+                getMinimumFromBounds(bounds)[2], getMaximumFromBounds(bounds)[0], getMaximumFromBounds(bounds)[1],
+                getMaximumFromBounds(bounds)[2], getRadiusFromBounds(bounds));
+        }
+
+        printf("\n");
+    }
+
+    setSIMDLevel(SIMD_LEVEL_AUTO);
+    freeB3DFile(b3d);
+
+    return 0;
+}
+
+/* culling */
+
+/* each timing covers this many culls, and the views look from the middle of the level along each axis */
+#define CULL_REPEATS 100
+#define CULL_VIEW_COUNT 6
+
+/* the projection display.c sets up with gluPerspective(70.0, 1.333, 10, 10000) */
+
+void getViewerProjection(float* matrix) {
+    const float nearPlane = 10.0f, farPlane = 10000.0f;
+    float focal = (float)(1.0 / tan(0.5 * 70.0 * 3.14159265358979 / 180.0));
+
+    memset(matrix, 0, 16 * sizeof(float));
+
+    matrix[0] = focal / 1.333f;
+    matrix[5] = focal;
+    matrix[10] = (farPlane + nearPlane) / (nearPlane - farPlane);
+    matrix[11] = -1.0f;
+    matrix[14] = 2.0f * farPlane * nearPlane / (nearPlane - farPlane);
+}
+
+/* a view from eye along one of the six axis directions, as gluLookAt would build it */
+
+void getAxisView(const float* eye, unsigned int view, float* matrix) {
+    float forward[3] = { 0.0f, 0.0f, 0.0f }, up[3] = { 0.0f, 1.0f, 0.0f }, side[3];
+    unsigned int axis;
+
+    forward[view / 2] = (view % 2 == 0) ? 1.0f : -1.0f;
+    if (view / 2 == 1) { up[1] = 0.0f; up[2] = 1.0f; }
+
+    side[0] = forward[1] * up[2] - forward[2] * up[1];
+    side[1] = forward[2] * up[0] - forward[0] * up[2];
+    side[2] = forward[0] * up[1] - forward[1] * up[0];
+
+    up[0] = side[1] * forward[2] - side[2] * forward[1];
+    up[1] = side[2] * forward[0] - side[0] * forward[2];
+    up[2] = side[0] * forward[1] - side[1] * forward[0];
+
+    memset(matrix, 0, 16 * sizeof(float));
+
+    for (axis = 0; axis < 3; axis++) {
+        matrix[4 * axis] = side[axis];
+        matrix[4 * axis + 1] = up[axis];
+        matrix[4 * axis + 2] = -forward[axis];
+    }
+
+    matrix[12] = -(side[0] * eye[0] + side[1] * eye[1] + side[2] * eye[2]);
+    matrix[13] = -(up[0] * eye[0] + up[1] * eye[1] + up[2] * eye[2]);
+    matrix[14] = forward[0] * eye[0] + forward[1] * eye[1] + forward[2] * eye[2];
+    matrix[15] = 1.0f;
+}
+
+/* the plain way: every range's box against every plane */
+
+int boxOutsidePlanes(const float* planes, const float* minimum, const float* maximum) {
+    unsigned int iter, axis;
+
+    for (iter = 0; iter < 6; iter++) {
+        float farthest = planes[4 * iter + 3];
+
+        for (axis = 0; axis < 3; axis++) {
+            float weight = planes[4 * iter + axis];
+
+            farthest += weight * ((weight >= 0.0f) ? maximum[axis] : minimum[axis]);
+        }
+
+        if (farthest < 0.0f) return 1;
+    }
+
+    return 0;
+}
+
+unsigned int cullEveryRange(Blitz3DBatchSet* batchSet, const float* planes, unsigned char* visible) {
+    unsigned int batchIter, rangeIter, index = 0, output = 0;
+
+    for (batchIter = 0; batchIter < getBatchArrayCountFromBatchSet(batchSet); batchIter++) {
+        Blitz3DBatch* batch = getBatchArrayEntryFromBatchSet(batchSet, batchIter);
+
+        for (rangeIter = 0; rangeIter < getRangeArrayCountFromBatch(batch); rangeIter++, index++) {
+            Blitz3DBatchRange* range = getRangeArrayEntryFromBatch(batch, rangeIter);
+            Blitz3DBounds* bounds = getBoundsFromBatchRange(range);
+
+            visible[index] = getIndexCountFromBatchRange(range) > 0 && !boundsEmpty(bounds)
+                && !boxOutsidePlanes(planes, getMinimumFromBounds(bounds), getMaximumFromBounds(bounds));
+            output += visible[index];
+        }
+    }
+
+    return output;
+}
+
+int benchmarkCulling(const char* filePath, int iterations) {
+    B3DFile* b3d = loadB3DFileWithFlags(filePath, BLITZ3D_LOAD_MAPPED | BLITZ3D_LOAD_SHORT_INDICES);
+    Blitz3DNODEChunk* nodeChunk;
+    Blitz3DScene* scene;
+    Blitz3DBatchSet* batchSet;
+    Blitz3DBVH* bvh;
+    unsigned char* visible;
+    float projection[16], modelview[16], planes[24], eye[3] = { 0.0f, 0.0f, 0.0f };
+    double start, bvhBest, plainBest, elapsed;
+    unsigned int rangeCount = 0, batchIter, rangeIter, index, view, mismatches = 0, plainVisible = 0;
+    int iter, repeat;
+
+    if (b3d == NULL) return 1;
+
+    scene = createSceneFromB3DFile(b3d);
+    batchSet = (scene != NULL) ? createBatchSetFromScene(scene) : NULL;
+
+    if (batchSet == NULL) {
+        if (scene != NULL) freeScene(scene);
+        freeB3DFile(b3d);
+        return 1;
+    }
+
+    for (batchIter = 0; batchIter < getBatchArrayCountFromBatchSet(batchSet); batchIter++) {
+        rangeCount += getRangeArrayCountFromBatch(getBatchArrayEntryFromBatchSet(batchSet, batchIter));
+    }
+
+    /* the views look out from the middle of the root's box, which the scene's root matrix puts in place */
+
+    nodeChunk = getNODEChunkFromBB3DChunk(getBB3DChunkFromFile(b3d));
+
+    if (nodeChunk != NULL && !boundsEmpty(getBoundsFromNODEChunk(nodeChunk))) {
+        const float* center = getCenterFromBounds(getBoundsFromNODEChunk(nodeChunk));
+        const float* matrix = getWorldMatrixFromScene(scene, 0);
+
+        for (index = 0; index < 3; index++) {
+            eye[index] = matrix[12 + index] + matrix[index] * center[0] + matrix[4 + index] * center[1]
+                + matrix[8 + index] * center[2];
+        }
+    }
+
+    start = getTimeInSeconds();
+    bvh = createBVHFromBatchSet(batchSet);
+    elapsed = getTimeInSeconds() - start;
+
+    visible = (unsigned char*)malloc(rangeCount + 1);
+
+    if (bvh == NULL || visible == NULL) {
+        if (bvh != NULL) freeBVH(bvh);
+        free(visible);
+        freeBatchSet(batchSet);
+        freeScene(scene);
+        freeB3DFile(b3d);
+        return 1;
+    }
+
+    printf("ranges %u, items %u, nodes %u, build %.3f ms\n", rangeCount, getItemCountFromBVH(bvh), getNodeCountFromBVH(bvh),
+        1000.0 * elapsed);
+
+    getViewerProjection(projection);
+
+    for (view = 0; view < CULL_VIEW_COUNT; view++) {
+        getAxisView(eye, view, modelview);
+        getFrustumPlanesFromMatrices(projection, modelview, planes);
+
+        bvhBest = plainBest = -1.0;
+
+        for (iter = 0; iter < iterations; iter++) {
+            start = getTimeInSeconds();
+            for (repeat = 0; repeat < CULL_REPEATS; repeat++) cullBVH(bvh, planes);
+            elapsed = (getTimeInSeconds() - start) / CULL_REPEATS;
+            if (bvhBest < 0.0 || elapsed < bvhBest) bvhBest = elapsed;
+
+            start = getTimeInSeconds();
+            for (repeat = 0; repeat < CULL_REPEATS; repeat++) plainVisible = cullEveryRange(batchSet, planes, visible);
+            elapsed = (getTimeInSeconds() - start) / CULL_REPEATS;
+            if (plainBest < 0.0 || elapsed < plainBest) plainBest = elapsed;
+        }
+
+        /* both must find the same ranges visible */
+
+        for (batchIter = 0, index = 0; batchIter < getBatchArrayCountFromBatchSet(batchSet); batchIter++) {
+            Blitz3DBatch* batch = getBatchArrayEntryFromBatchSet(batchSet, batchIter);
+
+            for (rangeIter = 0; rangeIter < getRangeArrayCountFromBatch(batch); rangeIter++, index++) {
+                if (!rangeVisibleInBVH(bvh, batchIter, rangeIter) != !visible[index]) mismatches++;
+            }
+        }
+
+        if (plainVisible != getVisibleCountFromBVH(bvh)) mismatches++;
+
+        for (batchIter = 0, index = 0; batchIter < getBatchArrayCountFromBatchSet(batchSet); batchIter++) {
+            index += getDrawCountFromBVH(bvh, batchIter);
+        }
+
+        printf("view %u   visible %6u  culled %6u  total %6u  nodes tested %6u  draws %6u  bvh %9.3f us  every range %9.3f us\n",
+            view, getVisibleCountFromBVH(bvh), getCulledCountFromBVH(bvh), getItemCountFromBVH(bvh),
+            getNodesTestedCountFromBVH(bvh), index, 1000000.0 * bvhBest, 1000000.0 * plainBest);
+    }
+
+    printf("mismatches %u\n", mismatches);
+
+    free(visible);
+    freeBVH(bvh);
+    freeBatchSet(batchSet);
+    freeScene(scene);
+    freeB3DFile(b3d);
+
+    return mismatches != 0;
+}
+
+/* potentially visible sets */
+
+/* the check casts as many rays of its own as the build did, from anywhere in the grid, up to this many */
+#define PVS_CHECK_RAYS 200000
+
+int pvsSetsIdentical(Blitz3DPVS* first, Blitz3DPVS* second) {
+    unsigned int cellIndex, words = (getRangeCountFromPVS(first) + 63) / 64;
+
+    if (getCellCountFromPVS(first) != getCellCountFromPVS(second)) return 0;
+    if (getRangeCountFromPVS(first) != getRangeCountFromPVS(second)) return 0;
+
+    for (cellIndex = 0; cellIndex < getCellCountFromPVS(first); cellIndex++) {
+        if (memcmp(getVisibleRangesFromPVS(first, cellIndex), getVisibleRangesFromPVS(second, cellIndex),
+            words * sizeof(uint64_t)) != 0) return 0;
+    }
+
+    return 1;
+}
+
+/* commentary: builds the sets on one thread and on all of them, which must agree, saves them where the
+   viewer looks for them and loads them back. The culling rows look along each axis from the middle of
+   every cell, with the frustum alone and with the frustum and the cell's set */
+
+int benchmarkPVS(const char* filePath, unsigned int cells, unsigned int samples, unsigned int rays) {
+    const char* modeNames[2] = { "serial", "parallel" };
+    const unsigned int threadCounts[2] = { 1, 0 };
+    Blitz3DPVSSettings settings;
+    B3DFile* b3d = loadB3DFileWithFlags(filePath, BLITZ3D_LOAD_INDEX_ONLY | BLITZ3D_LOAD_SHORT_INDICES);
+    Blitz3DScene* scene;
+    Blitz3DBatchSet* batchSet;
+    Blitz3DBVH* bvh;
+    Blitz3DPVS* builds[2] = { NULL, NULL };
+    Blitz3DPVS* loaded = NULL;
+    char* pvsPath;
+    float projection[16], modelview[16], planes[24], eye[3];
+    double start, elapsed, frustumTotal = 0.0, pvsTotal = 0.0, cellTotal = 0.0;
+    unsigned int cellIndex, view, checkRays, misses, mismatches = 0;
+    double buildRays;
+    unsigned int* cellCounts;
+    int mode;
+
+    if (b3d == NULL) return 1;
+
+    scene = createSceneFromB3DFile(b3d);
+    batchSet = (scene != NULL) ? createBatchSetFromScene(scene) : NULL;
+    bvh = (batchSet != NULL) ? createBVHFromBatchSet(batchSet) : NULL;
+
+    if (bvh == NULL) {
+        if (batchSet != NULL) freeBatchSet(batchSet);
+        if (scene != NULL) freeScene(scene);
+        freeB3DFile(b3d);
+        return 1;
+    }
+
+    initializeBlitz3DPVSSettings(&settings);
+    if (cells > 0) settings.cellsOnLongestAxis = cells;
+    if (samples > 0) settings.samplesPerCell = samples;
+    if (rays > 0) settings.raysPerSample = rays;
+
+    printf("cells on longest axis %u, samples per cell %u, rays per sample %u\n", settings.cellsOnLongestAxis,
+        settings.samplesPerCell, settings.raysPerSample);
+
+    for (mode = 0; mode < 2; mode++) {
+        settings.threadCount = threadCounts[mode];
+
+        start = getTimeInSeconds();
+        builds[mode] = buildPVSFromBatchSet(batchSet, &settings);
+        elapsed = getTimeInSeconds() - start;
+
+        if (builds[mode] == NULL) {
+            fprintf(stderr, "could not build the sets\n");
+            if (builds[0] != NULL) freePVS(builds[0]);
+            freeBVH(bvh);
+            freeBatchSet(batchSet);
+            freeScene(scene);
+            freeB3DFile(b3d);
+            return 1;
+        }
+
+        printf("%-8s %9.3f ms\n", modeNames[mode], 1000.0 * elapsed);
+    }
+
+    if (!pvsSetsIdentical(builds[0], builds[1])) mismatches++;
+
+    cellCounts = getCellCountsFromPVS(builds[1]);
+    printf("cells %u x %u x %u, distinct sets %u, ranges %u\n", cellCounts[0], cellCounts[1], cellCounts[2],
+        getSetCountFromPVS(builds[1]), getRangeCountFromPVS(builds[1]));
+
+    pvsPath = getPVSPathFromLevelPath(filePath);
+
+    if (savePVS(builds[1], pvsPath) != 0) {
+        fprintf(stderr, "could not write %s\n", pvsPath);
+        mismatches++;
+    }
+    else {
+        start = getTimeInSeconds();
+        loaded = loadPVSForBatchSet(pvsPath, batchSet);
+        elapsed = getTimeInSeconds() - start;
+
+        if (loaded == NULL || !pvsSetsIdentical(builds[1], loaded)) mismatches++;
+
+        printf("saved %s, %.3f MB, loaded back in %.3f ms\n", pvsPath, getFileMegabytes(pvsPath), 1000.0 * elapsed);
+    }
+
+    buildRays = (double)getCellCountFromPVS(builds[1]) * settings.samplesPerCell * settings.raysPerSample;
+
+    start = getTimeInSeconds();
+    checkRays = checkPVSAgainstBatchSet(builds[1], batchSet,
+        (buildRays < PVS_CHECK_RAYS) ? (unsigned int)buildRays : PVS_CHECK_RAYS, &misses);
+    elapsed = getTimeInSeconds() - start;
+
+    printf("check    %u rays, %u hit a range missing from their cell's set (%.4f%%), %.3f ms\n", checkRays, misses,
+        (checkRays > 0) ? 100.0 * misses / checkRays : 0.0, 1000.0 * elapsed);
+
+    getViewerProjection(projection);
+
+    for (cellIndex = 0; cellIndex < getCellCountFromPVS(builds[1]); cellIndex++) {
+        getCellCenterFromPVS(builds[1], cellIndex, eye);
+        cellTotal += getVisibleCountFromPVS(builds[1], cellIndex);
+
+        for (view = 0; view < CULL_VIEW_COUNT; view++) {
+            getAxisView(eye, view, modelview);
+            getFrustumPlanesFromMatrices(projection, modelview, planes);
+
+            cullBVHWithinRanges(bvh, planes, getVisibleRangesFromPVS(builds[1], cellIndex));
+            frustumTotal += getFrustumVisibleCountFromBVH(bvh);
+            pvsTotal += getVisibleCountFromBVH(bvh);
+        }
+    }
+
+    printf("per cell: %.1f ranges in the set; per view: %.1f visible with the frustum, %.1f with the frustum and the set, of %u\n",
+        cellTotal / getCellCountFromPVS(builds[1]),
+        frustumTotal / ((double)getCellCountFromPVS(builds[1]) * CULL_VIEW_COUNT),
+        pvsTotal / ((double)getCellCountFromPVS(builds[1]) * CULL_VIEW_COUNT), getItemCountFromBVH(bvh));
+
+    printf("mismatches %u\n", mismatches);
+
+    free(pvsPath);
+    if (loaded != NULL) freePVS(loaded);
+    freePVS(builds[0]);
+    freePVS(builds[1]);
+    freeBVH(bvh);
+    freeBatchSet(batchSet);
+    freeScene(scene);
+    freeB3DFile(b3d);
+
+    return mismatches != 0;
+}
+
+/* interleaved vertices */
+
+typedef struct InterleaveTotals InterleaveTotals;
+struct InterleaveTotals {
+    unsigned int count;
+    double vertices;
+    double sourceBytes, packedBytes;
+    unsigned int states[BLITZ3D_ATTRIBUTE_COUNT][4];
+
+    /* float attributes that differ from their source, and for compact ones the worst error of each
+       kind: positions and tex coords as a fraction of their bound, colors as is, normals in degrees */
+    unsigned long mismatches;
+    double rangeError, colorError, normalDegrees;
+};
+
+void getSourceArraysFromVRTSChunk(Blitz3DVRTSChunk* vrtsChunk, const float** arrays) {
+    unsigned int set;
+
+    memset(arrays, 0, BLITZ3D_ATTRIBUTE_COUNT * sizeof(const float*));
+
+    arrays[BLITZ3D_ATTRIBUTE_POSITION] = getVertexArrayFromVRTSChunk(vrtsChunk);
+    if (normalArrayPresentInVRTSChunk(vrtsChunk)) {
+        arrays[BLITZ3D_ATTRIBUTE_NORMAL] = getNormalArrayFromVRTSChunk(vrtsChunk);
+    }
+    if (colorArrayPresentInVRTSChunk(vrtsChunk)) {
+        arrays[BLITZ3D_ATTRIBUTE_COLOR] = getColorArrayFromVRTSChunk(vrtsChunk);
+    }
+
+    for (set = 0; set < getTexCoordArrayCountFromVRTSChunk(vrtsChunk); set++) {
+        arrays[BLITZ3D_ATTRIBUTE_TEX_COORDS + set] = getTexCoordArrayEntryFromVRTSChunk(vrtsChunk, set);
+    }
+}
+
+void getSourceArraysFromBatch(Blitz3DBatch* batch, const float** arrays) {
+    unsigned int set;
+
+    memset(arrays, 0, BLITZ3D_ATTRIBUTE_COUNT * sizeof(const float*));
+
+    arrays[BLITZ3D_ATTRIBUTE_POSITION] = getVertexArrayFromBatch(batch);
+    arrays[BLITZ3D_ATTRIBUTE_NORMAL] = getNormalArrayFromBatch(batch);
+    arrays[BLITZ3D_ATTRIBUTE_COLOR] = getColorArrayFromBatch(batch);
+
+    for (set = 0; set < getTexCoordArrayCountFromBatch(batch); set++) {
+        arrays[BLITZ3D_ATTRIBUTE_TEX_COORDS + set] = getTexCoordArrayEntryFromBatch(batch, set);
+    }
+}
+
+/* decodes every packed and constant attribute and compares it with the array it came from */
+
+void measureInterleavedVertices(Blitz3DInterleavedVertices* vertices, const float** arrays, InterleaveTotals* totals) {
+    unsigned int attribute, iter, component;
+
+    totals->count++;
+    totals->vertices += getVertexCountFromInterleavedVertices(vertices);
+    totals->sourceBytes += (double)getVertexCountFromInterleavedVertices(vertices)
+        * getSourceStrideFromInterleavedVertices(vertices);
+    totals->packedBytes += (double)getVertexCountFromInterleavedVertices(vertices)
+        * getStrideFromInterleavedVertices(vertices);
+
+    for (attribute = 0; attribute < BLITZ3D_ATTRIBUTE_COUNT; attribute++) {
+        int state = getAttributeStateFromInterleavedVertices(vertices, attribute);
+        int type = getAttributeTypeFromInterleavedVertices(vertices, attribute);
+        unsigned int componentCount = getAttributeComponentCountFromInterleavedVertices(vertices, attribute);
+        float* step = getAttributeDecodeScaleFromInterleavedVertices(vertices, attribute);
+
+        totals->states[attribute][state]++;
+
+        if (state != BLITZ3D_ATTRIBUTE_PACKED && state != BLITZ3D_ATTRIBUTE_CONSTANT) continue;
+
+        for (iter = 0; iter < getVertexCountFromInterleavedVertices(vertices); iter++) {
+            const float* source = arrays[attribute] + (size_t)iter * componentCount;
+            float decoded[4];
+
+            decodeAttributeFromInterleavedVertices(vertices, attribute, iter, decoded);
+
+            if (state == BLITZ3D_ATTRIBUTE_CONSTANT || type == BLITZ3D_COMPONENTS_FLOAT) {
+                if (memcmp(decoded, source, componentCount * sizeof(float)) != 0) totals->mismatches++;
+            }
+            else if (type == BLITZ3D_COMPONENTS_SHORT_RANGE) {
+                /* the bound is half a step, plus the rounding of a float the size of the value */
+                for (component = 0; component < componentCount; component++) {
+                    double error = fabs((double)decoded[component] - source[component]);
+
+                    error /= 0.5 * step[component] + 2.0 * FLT_EPSILON * fabs(source[component]) + FLT_MIN;
+                    if (error > totals->rangeError) totals->rangeError = error;
+                }
+            }
+            else if (type == BLITZ3D_COMPONENTS_UNSIGNED_BYTE) {
+                for (component = 0; component < 4; component++) {
+                    double value = source[component], error;
+
+                    if (!(value >= 0.0)) value = 0.0;
+                    if (value > 1.0) value = 1.0;
+
+                    error = fabs(decoded[component] - value);
+                    if (error > totals->colorError) totals->colorError = error;
+                }
+            }
+            else {
+                /* the angle from the cross and dot products, since acos loses it near 1 */
+                double crossX = (double)decoded[1] * source[2] - (double)decoded[2] * source[1];
+                double crossY = (double)decoded[2] * source[0] - (double)decoded[0] * source[2];
+                double crossZ = (double)decoded[0] * source[1] - (double)decoded[1] * source[0];
+                double dot = (double)decoded[0] * source[0] + (double)decoded[1] * source[1]
+                    + (double)decoded[2] * source[2];
+                double degrees;
+
+                if (source[0] == 0.0f && source[1] == 0.0f && source[2] == 0.0f) continue;
+
+                degrees = atan2(sqrt(crossX * crossX + crossY * crossY + crossZ * crossZ), dot) * 180.0 / M_PI;
+
+                if (degrees > totals->normalDegrees) totals->normalDegrees = degrees;
+            }
+        }
+    }
+}
+
+/* with totals NULL this only packs, for timing */
+
+void interleaveMeshesInNode(Blitz3DNODEChunk* nodeChunk, Blitz3DBRUSChunk* brusChunk, int compact,
+    InterleaveTotals* totals) {
+    Blitz3DMESHChunk* meshChunk = getMESHChunkFromNODEChunk(nodeChunk);
+    unsigned int iter;
+
+    if (meshChunk != NULL) {
+        Blitz3DInterleavedVertices* vertices = compact ? createCompactVerticesFromMESHChunk(meshChunk, brusChunk)
+            : createInterleavedVerticesFromMESHChunk(meshChunk, brusChunk);
+
+        if (vertices != NULL) {
+            const float* arrays[BLITZ3D_ATTRIBUTE_COUNT];
+
+            if (totals != NULL) {
+                getSourceArraysFromVRTSChunk(getVRTSChunkFromMESHChunk(meshChunk), arrays);
+                measureInterleavedVertices(vertices, arrays, totals);
+            }
+
+            freeInterleavedVertices(vertices);
+        }
+    }
+
+    for (iter = 0; iter < getNODEChunkArrayCountFromNodeChunk(nodeChunk); iter++) {
+        interleaveMeshesInNode(getNODEChunkArrayEntryFromNODEChunk(nodeChunk, iter), brusChunk, compact, totals);
+    }
+}
+
+/* counts the meshes whose compact vertices differ between the scalar and the SSE2 kernels */
+
+unsigned int compareCompactKernelsInNode(Blitz3DNODEChunk* nodeChunk, Blitz3DBRUSChunk* brusChunk) {
+    Blitz3DMESHChunk* meshChunk = getMESHChunkFromNODEChunk(nodeChunk);
+    unsigned int iter, output = 0;
+
+    if (meshChunk != NULL && getVRTSChunkFromMESHChunk(meshChunk) != NULL) {
+        Blitz3DInterleavedVertices* vertices[2];
+
+        setSIMDLevel(SIMD_LEVEL_SCALAR);
+        vertices[0] = createCompactVerticesFromMESHChunk(meshChunk, brusChunk);
+        setSIMDLevel(SIMD_LEVEL_SSE2);
+        vertices[1] = createCompactVerticesFromMESHChunk(meshChunk, brusChunk);
+
+        if (vertices[0] == NULL || vertices[1] == NULL
+            || memcmp(getDataFromInterleavedVertices(vertices[0]), getDataFromInterleavedVertices(vertices[1]),
+                (size_t)getVertexCountFromInterleavedVertices(vertices[0])
+                * getStrideFromInterleavedVertices(vertices[0])) != 0) output++;
+
+        freeInterleavedVertices(vertices[0]);
+        freeInterleavedVertices(vertices[1]);
+    }
+
+    for (iter = 0; iter < getNODEChunkArrayCountFromNodeChunk(nodeChunk); iter++) {
+        output += compareCompactKernelsInNode(getNODEChunkArrayEntryFromNODEChunk(nodeChunk, iter), brusChunk);
+    }
+
+    return output;
+}
+
+void printInterleaveTotals(const char* label, InterleaveTotals* totals, int compact) {
+    const char* attributeNames[BLITZ3D_ATTRIBUTE_COUNT] = { "position", "normal", "color", "uv0", "uv1", "uv2",
+        "uv3", "uv4", "uv5", "uv6", "uv7" };
+    unsigned int attribute;
+
+    if (totals->vertices == 0.0) {
+        printf("%s: no vertices\n", label);
+        return;
+    }
+
+    printf("%s: %u, %.0f vertices, %.1f -> %.1f bytes per vertex, %.2f -> %.2f MB, mismatches %lu\n", label,
+        totals->count, totals->vertices, totals->sourceBytes / totals->vertices,
+        totals->packedBytes / totals->vertices, totals->sourceBytes / (1024.0 * 1024.0),
+        totals->packedBytes / (1024.0 * 1024.0), totals->mismatches);
+
+    if (compact) {
+        printf("  worst errors: positions and uvs %.3f of their bound, colors %.5f, normals %.5f degrees\n",
+            totals->rangeError, totals->colorError, totals->normalDegrees);
+    }
+    else {
+        printf("  %-9s %7s %9s %7s\n", "attribute", "packed", "constant", "unused");
+
+        for (attribute = 0; attribute < BLITZ3D_ATTRIBUTE_COUNT; attribute++) {
+            unsigned int* states = totals->states[attribute];
+
+            if (states[BLITZ3D_ATTRIBUTE_ABSENT] == totals->count) continue;
+
+            printf("  %-9s %7u %9u %7u\n", attributeNames[attribute], states[BLITZ3D_ATTRIBUTE_PACKED],
+                states[BLITZ3D_ATTRIBUTE_CONSTANT], states[BLITZ3D_ATTRIBUTE_UNUSED]);
+        }
+    }
+}
+
+double timeInterleave(Blitz3DNODEChunk* nodeChunk, Blitz3DBRUSChunk* brusChunk, int compact, int kernel,
+    int iterations) {
+    double best = -1.0;
+    int iter;
+
+    if (setSIMDLevel(kernel) != 0) return -1.0;
+
+    for (iter = 0; iter < iterations; iter++) {
+        double start = getTimeInSeconds(), elapsed;
+
+        interleaveMeshesInNode(nodeChunk, brusChunk, compact, NULL);
+
+        elapsed = getTimeInSeconds() - start;
+        if (best < 0.0 || elapsed < best) best = elapsed;
+    }
+
+    return best;
+}
+
+/* commentary: the compact rows are meant to stay within their documented bounds (see
+   Blitz3DInterleave.h): positions and uvs about 1 of their bound (rounding can take them a little
+   over), colors under 0.00196, normals under 0.004 degrees */
+
+int benchmarkInterleave(const char* filePath, int iterations) {
+    const int kernels[2] = { SIMD_LEVEL_SCALAR, SIMD_LEVEL_SSE2 };
+    const char* labels[2] = { "float", "compact" };
+    InterleaveTotals totals;
+    Blitz3DNODEChunk* nodeChunk;
+    Blitz3DBRUSChunk* brusChunk;
+    Blitz3DBatchSet* batchSet;
+    B3DFile* b3d;
+    unsigned long mismatches = 0;
+    unsigned int iter, kernelDifferences = 0;
+    int compact, kernel;
+
+    b3d = loadB3DFileWithFlags(filePath, BLITZ3D_LOAD_MAPPED | BLITZ3D_LOAD_SHORT_INDICES);
+    if (b3d == NULL) return 1;
+
+    nodeChunk = getNODEChunkFromBB3DChunk(getBB3DChunkFromFile(b3d));
+    brusChunk = getBRUSChunkFromBB3DChunk(getBB3DChunkFromFile(b3d));
+
+    batchSet = createBatchSetFromB3DFile(b3d);
+    if (batchSet == NULL) {
+        freeB3DFile(b3d);
+        return 1;
+    }
+
+    for (compact = 0; compact < 2; compact++) {
+        char label[32];
+
+        memset(&totals, 0, sizeof(totals));
+        if (nodeChunk != NULL) interleaveMeshesInNode(nodeChunk, brusChunk, compact, &totals);
+
+        sprintf(label, "meshes %s", labels[compact]);
+        printInterleaveTotals(label, &totals, compact);
+        mismatches += totals.mismatches;
+
+        memset(&totals, 0, sizeof(totals));
+
+        for (iter = 0; iter < getBatchArrayCountFromBatchSet(batchSet); iter++) {
+            Blitz3DBatch* batch = getBatchArrayEntryFromBatchSet(batchSet, iter);
+            Blitz3DInterleavedVertices* vertices = compact ? createCompactVerticesFromBatch(batch, brusChunk)
+                : createInterleavedVerticesFromBatch(batch, brusChunk);
+            const float* arrays[BLITZ3D_ATTRIBUTE_COUNT];
+
+            if (vertices == NULL) continue;
+
+            getSourceArraysFromBatch(batch, arrays);
+            measureInterleavedVertices(vertices, arrays, &totals);
+
+            freeInterleavedVertices(vertices);
+        }
+
+        sprintf(label, "batches %s", labels[compact]);
+        printInterleaveTotals(label, &totals, compact);
+        mismatches += totals.mismatches;
+    }
+
+    for (compact = 0; compact < 2 && nodeChunk != NULL; compact++) {
+        for (kernel = 0; kernel < 2; kernel++) {
+            double best = timeInterleave(nodeChunk, brusChunk, compact, kernels[kernel], iterations);
+
+            if (best < 0.0) {
+                printf("%-7s %-8s unsupported\n", labels[compact], getNameFromSIMDLevel(kernels[kernel]));
+                continue;
+            }
+
+            printf("%-7s %-8s meshes packed in %9.3f ms\n", labels[compact],
+                getNameFromSIMDLevel(kernels[kernel]), 1000.0 * best);
+        }
+    }
+
+    if (nodeChunk != NULL && simdLevelSupported(SIMD_LEVEL_SSE2)) {
+        kernelDifferences = compareCompactKernelsInNode(nodeChunk, brusChunk);
+        printf("meshes whose compact vertices differ between kernels: %u\n", kernelDifferences);
+    }
+
+    setSIMDLevel(SIMD_LEVEL_AUTO);
+
+    freeBatchSet(batchSet);
+    freeB3DFile(b3d);
+
+    return (mismatches != 0 || kernelDifferences != 0);
+}
+
+/* software rasterizer */
+
+/* the viewer's window */
+#define RASTER_WIDTH 800
+#define RASTER_HEIGHT 600
+
+#define RASTER_TEXTURE_SIZE 64
+
+/* stands in for the images the TEXS chunk names, which the benchmark does not load: even textures are
+   a checkerboard with a color of their own, odd ones a smooth gray ramp like a lightmap's */
+
+void fillRasterTestTexture(unsigned char* pixels, unsigned int textureIndex) {
+    unsigned int x, y;
+
+    for (y = 0; y < RASTER_TEXTURE_SIZE; y++) {
+        for (x = 0; x < RASTER_TEXTURE_SIZE; x++) {
+            unsigned char* texel = pixels + 4 * (y * RASTER_TEXTURE_SIZE + x);
+
+            if (textureIndex % 2 == 0) {
+                int light = ((x / 8 + y / 8) % 2 == 0);
+
+                texel[0] = (unsigned char)(light ? 255 : 40 + 50 * (textureIndex / 2 % 4));
+                texel[1] = (unsigned char)(light ? 255 : 40 + 70 * (textureIndex / 2 % 3));
+                texel[2] = (unsigned char)(light ? 255 : 40 + 90 * (textureIndex / 2 % 2));
+            }
+            else {
+                texel[0] = texel[1] = texel[2] = (unsigned char)(96 + (x + y) * 159 / (2 * RASTER_TEXTURE_SIZE - 2));
+            }
+
+            texel[3] = 255;
+        }
+    }
+}
+
+/* returns 0, or -1 if the file could not be written */
+
+int writePPMImage(const char* filePath, const unsigned char* pixels, unsigned int width, unsigned int height,
+    unsigned int pitch) {
+    FILE* file = fopen(filePath, "wb");
+    unsigned int x, y;
+
+    if (file == NULL) return -1;
+
+    fprintf(file, "P6\n%u %u\n255\n", width, height);
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) fwrite(pixels + (size_t)y * pitch + 4 * x, 1, 3, file);
+    }
+
+    return (fclose(file) == 0) ? 0 : -1;
+}
+
+unsigned int countDifferentPixels(const unsigned char* first, const unsigned char* second, unsigned int width,
+    unsigned int height, unsigned int pitch) {
+    unsigned int x, y, output = 0;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            if (memcmp(first + (size_t)y * pitch + 4 * x, second + (size_t)y * pitch + 4 * x, 4) != 0) output++;
+        }
+    }
+
+    return output;
+}
+
+/* commentary: draws the six axis views from the middle of the level with each kernel, on one thread
+   and on all of them. Every row is checked against the first one's images: the thread count must not
+   change a pixel, and on x86-64 neither does the kernel (a 32-bit build's scalar code may round on
+   the x87 and differ in a few pixels). Throughput counts every triangle in the batches, in millions per
+   second; the rasterizer has no culling of its own beyond the clipping. The triangles set up and binned
+   are per view, averaged over the six */
+
+int benchmarkRaster(const char* filePath, int iterations, const char* imagePath) {
+    const int kernels[2] = { SIMD_LEVEL_SCALAR, SIMD_LEVEL_SSE2 };
+    const unsigned int threadCounts[2] = { 1, 0 };
+    B3DFile* b3d = loadB3DFileWithFlags(filePath, BLITZ3D_LOAD_INDEX_ONLY | BLITZ3D_LOAD_SHORT_INDICES);
+    Blitz3DNODEChunk* nodeChunk;
+    Blitz3DBRUSChunk* brusChunk;
+    Blitz3DTEXSChunk* texsChunk;
+    Blitz3DScene* scene;
+    Blitz3DBatchSet* batchSet;
+    Blitz3DRasterizer* rasterizer;
+    unsigned char texture[4 * RASTER_TEXTURE_SIZE * RASTER_TEXTURE_SIZE];
+    unsigned char* referenceImages = NULL;
+    float projection[16], modelviews[CULL_VIEW_COUNT][16], eye[3] = { 0.0f, 0.0f, 0.0f };
+    size_t imageSize = 0;
+    unsigned int pitch = 0, triangleCount = 0, textureCount, index, view, configuration, threadDifferences = 0;
+    int iter, failed = 0;
+
+    if (b3d == NULL) return 1;
+
+    scene = createSceneFromB3DFile(b3d);
+    batchSet = (scene != NULL) ? createBatchSetFromScene(scene) : NULL;
+
+    if (batchSet == NULL) {
+        if (scene != NULL) freeScene(scene);
+        freeB3DFile(b3d);
+        return 1;
+    }
+
+    brusChunk = getBRUSChunkFromBB3DChunk(getBB3DChunkFromFile(b3d));
+    texsChunk = getTEXSChunkFromBB3DChunk(getBB3DChunkFromFile(b3d));
+    textureCount = (texsChunk != NULL) ? getTextureArrayCountFromTEXSChunk(texsChunk) : 0;
+
+    for (index = 0; index < getBatchArrayCountFromBatchSet(batchSet); index++) {
+        triangleCount += getIndexCountFromBatch(getBatchArrayEntryFromBatchSet(batchSet, index)) / 3;
+    }
+
+    /* the views look out from the middle of the root's box, as the culling benchmark's do */
+
+    nodeChunk = getNODEChunkFromBB3DChunk(getBB3DChunkFromFile(b3d));
+
+    if (nodeChunk != NULL && !boundsEmpty(getBoundsFromNODEChunk(nodeChunk))) {
+        const float* center = getCenterFromBounds(getBoundsFromNODEChunk(nodeChunk));
+        const float* matrix = getWorldMatrixFromScene(scene, 0);
+
+        for (index = 0; index < 3; index++) {
+            eye[index] = matrix[12 + index] + matrix[index] * center[0] + matrix[4 + index] * center[1]
+                + matrix[8 + index] * center[2];
+        }
+    }
+
+    getViewerProjection(projection);
+    for (view = 0; view < CULL_VIEW_COUNT; view++) getAxisView(eye, view, modelviews[view]);
+
+    for (configuration = 0; configuration < 4 && !failed; configuration++) {
+        int kernel = kernels[configuration / 2];
+        unsigned int threadCount = threadCounts[configuration % 2];
+        unsigned int differences = 0, setupTotal = 0, binnedTotal = 0;
+        double best = -1.0;
+
+        if (setSIMDLevel(kernel) != 0) {
+            printf("%-8s unsupported\n", getNameFromSIMDLevel(kernel));
+            continue;
+        }
+
+        rasterizer = createRasterizer(RASTER_WIDTH, RASTER_HEIGHT, threadCount);
+        if (rasterizer == NULL) {
+            failed = 1;
+            break;
+        }
+
+        for (index = 0; index < textureCount && !failed; index++) {
+            fillRasterTestTexture(texture, index);
+            failed = (setTextureInRasterizer(rasterizer, index, RASTER_TEXTURE_SIZE, RASTER_TEXTURE_SIZE,
+                texture) != 0);
+        }
+
+        if (referenceImages == NULL && !failed) {
+            pitch = getPitchFromRasterizer(rasterizer);
+            imageSize = (size_t)pitch * RASTER_HEIGHT;
+            referenceImages = (unsigned char*)malloc(CULL_VIEW_COUNT * imageSize);
+            failed = (referenceImages == NULL);
+        }
+
+        for (iter = 0; iter < iterations && !failed; iter++) {
+            double start = getTimeInSeconds(), elapsed;
+
+            for (view = 0; view < CULL_VIEW_COUNT && !failed; view++) {
+                clearRasterizer(rasterizer, 0.0f, 0.0f, 0.5f, 1.0f);
+                failed = (drawBatchSetWithRasterizer(rasterizer, batchSet, brusChunk, projection,
+                    modelviews[view]) != 0);
+            }
+
+            elapsed = (getTimeInSeconds() - start) / CULL_VIEW_COUNT;
+            if (best < 0.0 || elapsed < best) best = elapsed;
+        }
+
+        /* each view once more, to compare */
+
+        for (view = 0; view < CULL_VIEW_COUNT && !failed; view++) {
+            unsigned char* reference = referenceImages + view * imageSize;
+
+            clearRasterizer(rasterizer, 0.0f, 0.0f, 0.5f, 1.0f);
+            failed = (drawBatchSetWithRasterizer(rasterizer, batchSet, brusChunk, projection, modelviews[view]) != 0);
+
+            setupTotal += getSetupCountFromRasterizer(rasterizer);
+            binnedTotal += getBinnedCountFromRasterizer(rasterizer);
+
+            if (configuration == 0) memcpy(reference, getColorBufferFromRasterizer(rasterizer), imageSize);
+            else {
+                differences += countDifferentPixels(reference, getColorBufferFromRasterizer(rasterizer), RASTER_WIDTH,
+                    RASTER_HEIGHT, pitch);
+            }
+        }
+
+        if (!failed) {
+            printf("%-8s %2u threads  %9.3f ms per view  %8.2f Mtris/s  set up %8u  binned %8u  pixels differing %u\n",
+                getNameFromSIMDLevel(kernel), (threadCount > 0) ? threadCount : getProcessorCount(),
+                1000.0 * best, getSubmittedCountFromRasterizer(rasterizer) / best / 1000000.0,
+                setupTotal / CULL_VIEW_COUNT, binnedTotal / CULL_VIEW_COUNT, differences);
+
+            /* one thread and all of them run the same kernel back to back */
+            if (configuration % 2 == 1) threadDifferences += differences;
+        }
+
+        freeRasterizer(rasterizer);
+    }
+
+    if (!failed) {
+        printf("triangles per view %u, %u x %u pixels, %u textures\n", triangleCount, RASTER_WIDTH, RASTER_HEIGHT,
+            textureCount);
+    }
+
+    if (!failed && imagePath != NULL && referenceImages != NULL) {
+        if (writePPMImage(imagePath, referenceImages, RASTER_WIDTH, RASTER_HEIGHT, pitch) != 0) {
+            fprintf(stderr, "could not write %s\n", imagePath);
+        }
+    }
+
+    setSIMDLevel(SIMD_LEVEL_AUTO);
+
+    free(referenceImages);
+    freeBatchSet(batchSet);
+    freeScene(scene);
+    freeB3DFile(b3d);
+
+    return failed || threadDifferences != 0;
+}
+
+/* vertex cache */
+
+typedef struct VertexCacheTotals VertexCacheTotals;
+struct VertexCacheTotals {
+    unsigned int meshCount;
+    double triangles;
+    double missesBefore, missesAfter;
+    double seconds;
+};
+
+unsigned long countTrianglesInMESHChunk(Blitz3DMESHChunk* meshChunk) {
+    unsigned long output = 0;
+    unsigned int iter;
+
+    for (iter = 0; iter < getTRISChunkArrayCountFromMESHChunk(meshChunk); iter++) {
+        output += getTriangleCountFromTRISChunk(getTRISChunkArrayEntryFromMESHChunk(meshChunk, iter));
+    }
+
+    return output;
+}
+
+void reportVertexCacheInNode(Blitz3DNODEChunk* nodeChunk, unsigned int cacheSize, VertexCacheTotals* totals) {
+    Blitz3DMESHChunk* meshChunk = getMESHChunkFromNODEChunk(nodeChunk);
+    unsigned int iter;
+
+    if (meshChunk != NULL && getVRTSChunkFromMESHChunk(meshChunk) != NULL) {
+        double acmrBefore, atvrBefore, acmrAfter, atvrAfter, start;
+        unsigned long triangles = countTrianglesInMESHChunk(meshChunk);
+
+        getVertexCacheStatisticsFromMESHChunk(meshChunk, cacheSize, &acmrBefore, &atvrBefore);
+
+        start = getTimeInSeconds();
+        optimizeMESHChunk(meshChunk, BLITZ3D_PASS_VERTEX_CACHE | BLITZ3D_PASS_REORDER);
+        totals->seconds += getTimeInSeconds() - start;
+
+        getVertexCacheStatisticsFromMESHChunk(meshChunk, cacheSize, &acmrAfter, &atvrAfter);
+
+        printf("%-24.24s %9lu %7.3f %7.3f %7.3f %7.3f\n", getNameFromNODEChunk(nodeChunk), triangles,
+            acmrBefore, acmrAfter, atvrBefore, atvrAfter);
+
+        totals->meshCount++;
+        totals->triangles += triangles;
+        totals->missesBefore += acmrBefore * triangles;
+        totals->missesAfter += acmrAfter * triangles;
+    }
+
+    for (iter = 0; iter < getNODEChunkArrayCountFromNodeChunk(nodeChunk); iter++) {
+        reportVertexCacheInNode(getNODEChunkArrayEntryFromNODEChunk(nodeChunk, iter), cacheSize, totals);
+    }
+}
+
+int benchmarkVertexCache(const char* filePath, unsigned int cacheSize) {
+    VertexCacheTotals totals;
+    Blitz3DNODEChunk* nodeChunk;
+    B3DFile* b3d;
+
+    b3d = loadB3DFileWithFlags(filePath, BLITZ3D_LOAD_MAPPED);
+    if (b3d == NULL) return 1;
+
+    memset(&totals, 0, sizeof(totals));
+
+    printf("%u entry FIFO\n", cacheSize);
+    printf("%-24s %9s %7s %7s %7s %7s\n", "mesh", "triangles", "ACMR", "after", "ATVR", "after");
+
+    nodeChunk = getNODEChunkFromBB3DChunk(getBB3DChunkFromFile(b3d));
+    if (nodeChunk != NULL) reportVertexCacheInNode(nodeChunk, cacheSize, &totals);
+
+    if (totals.triangles > 0.0) {
+        printf("%u meshes, %.0f triangles: ACMR %.3f -> %.3f, optimized in %.3f ms\n", totals.meshCount,
+            totals.triangles, totals.missesBefore / totals.triangles, totals.missesAfter / totals.triangles,
+            1000.0 * totals.seconds);
+    }
+
+    freeB3DFile(b3d);
+
+    return 0;
+}
+
+/* generated files */
+
+void benchmarkSuite(int iterations) {
+    const char* modeNames[2] = { "FILE*", "mapped" };
+    const int modeFlags[2] = { 0, BLITZ3D_LOAD_MAPPED };
+    unsigned int iter;
+    int mode;
+
+    printf("%-9s %-7s %9s %9s %10s %8s %9s\n", "config", "mode", "MB", "best ms", "MB/s", "blocks", "peak MB");
+
+    for (iter = 0; iter < SUITE_CONFIGURATION_COUNT; iter++) {
+        SuiteConfiguration* configuration = &(suiteConfigurations[iter]);
+        Blitz3DGeneratorSettings settings;
+        double megabytes;
+
+        initializeBlitz3DGeneratorSettings(&settings);
+        settings.nodeCount = configuration->nodeCount;
+        settings.treeDepth = configuration->treeDepth;
+        settings.vertexCount = configuration->vertexCount;
+        settings.texCoordSets = configuration->texCoordSets;
+        settings.trisChunkCount = configuration->trisChunkCount;
+        settings.vertexFlags = configuration->vertexFlags;
+        settings.stringLength = configuration->stringLength;
+
+        megabytes = generateB3DFile(SUITE_FILE_PATH, &settings) / (1024.0 * 1024.0);
+
+        if (megabytes == 0.0) {
+            fprintf(stderr, "%s: failed to write %s\n", configuration->label, SUITE_FILE_PATH);
+            break;
+        }
+
+        for (mode = 0; mode < 2; mode++) {
+            double best, mean;
+            unsigned int blockCount;
+
+            resetPeakMemory();
+
+            if (timeLoader(SUITE_FILE_PATH, modeFlags[mode], iterations, &best, &mean, &blockCount) != 0) {
+                fprintf(stderr, "%s: failed to load %s\n", configuration->label, SUITE_FILE_PATH);
+                continue;
+            }
+
+            printf("%-9s %-7s %9.2f %9.3f %10.1f %8u %9.1f\n", configuration->label, modeNames[mode],
+                megabytes, 1000.0 * best, megabytes / best, blockCount, getPeakMemoryMegabytes());
+        }
+    }
+
+    remove(SUITE_FILE_PATH);
+}
+
+int generateFromArguments(int argc, char* argv[]) {
+    Blitz3DGeneratorSettings settings;
+    size_t size;
+
+    initializeBlitz3DGeneratorSettings(&settings);
+
+    if (argc > 3) settings.nodeCount = (unsigned int)atoi(argv[3]);
+    if (argc > 4) settings.treeDepth = (unsigned int)atoi(argv[4]);
+    if (argc > 5) settings.vertexCount = (unsigned int)atoi(argv[5]);
+    if (argc > 6) settings.texCoordSets = (unsigned int)atoi(argv[6]);
+    if (argc > 7) settings.trisChunkCount = (unsigned int)atoi(argv[7]);
+    if (argc > 8) settings.stringLength = (unsigned int)atoi(argv[8]);
+
+    size = generateB3DFile(argv[2], &settings);
+
+    if (size == 0) {
+        fprintf(stderr, "failed to write %s\n", argv[2]);
+        return 1;
+    }
+
+    printf("%s: %.2f MB\n", argv[2], size / (1024.0 * 1024.0));
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* filePath;
+    int iterations = DEFAULT_ITERATIONS;
+    double megabytes;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file.b3d> [iterations]\n       %s --kernels [iterations]\n"
+            "       %s --containers [iterations]\n"
+            "       %s --suite [iterations]\n"
+            "       %s --generate <file.b3d> [nodes depth vertices uvsets tris strings]\n"
+            "       %s --rewrite <in.b3d> <out.b3d> [passes]\n"
+            "       %s --vertexcache <file.b3d> [cache size]\n"
+            "       %s --optimize <file.b3d> [passes [epsilon]]\n"
+            "       %s --batch <file.b3d> [iterations]\n"
+            "       %s --scene <file.b3d> [iterations]\n"
+            "       %s --bounds <file.b3d> [iterations]\n"
+            "       %s --cull <file.b3d> [iterations]\n"
+            "       %s --pvs <file.b3d> [cells [samples rays]]\n"
+            "       %s --interleave <file.b3d> [iterations]\n"
+            "       %s --raster <file.b3d> [iterations [image.ppm]]\n",
+            argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0],
+            argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    if (strcmp(argv[1], "--generate") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "usage: %s --generate <file.b3d> [nodes depth vertices uvsets tris strings]\n", argv[0]);
+            return 1;
+        }
+
+        return generateFromArguments(argc, argv);
+    }
+
+    if (strcmp(argv[1], "--rewrite") == 0) {
+        if (argc < 4) {
+            fprintf(stderr, "usage: %s --rewrite <in.b3d> <out.b3d> [passes]\n", argv[0]);
+            return 1;
+        }
+
+        return benchmarkRewrite(argv[2], argv[3], (argc > 4) ? atoi(argv[4]) : 0);
+    }
+
+    if (strcmp(argv[1], "--vertexcache") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "usage: %s --vertexcache <file.b3d> [cache size]\n", argv[0]);
+            return 1;
+        }
+
+        return benchmarkVertexCache(argv[2], (argc > 3) ? (unsigned int)atoi(argv[3]) : DEFAULT_VERTEX_CACHE_SIZE);
+    }
+
+    if (strcmp(argv[1], "--optimize") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "usage: %s --optimize <file.b3d> [passes [epsilon]]\n", argv[0]);
+            return 1;
+        }
+
+        return benchmarkOptimize(argv[2], (argc > 3) ? atoi(argv[3]) : BLITZ3D_PASS_WELD | BLITZ3D_PASS_CLEAN_TRIANGLES,
+            (argc > 4) ? (float)atof(argv[4]) : 0.0f);
+    }
+
+    if (strcmp(argv[1], "--batch") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "usage: %s --batch <file.b3d> [iterations]\n", argv[0]);
+            return 1;
+        }
+
+        return benchmarkBatches(argv[2], (argc > 3 && atoi(argv[3]) > 0) ? atoi(argv[3]) : DEFAULT_ITERATIONS);
+    }
+
+    if (strcmp(argv[1], "--scene") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "usage: %s --scene <file.b3d> [iterations]\n", argv[0]);
+            return 1;
+        }
+
+        return benchmarkScene(argv[2], (argc > 3 && atoi(argv[3]) > 0) ? atoi(argv[3]) : DEFAULT_ITERATIONS);
+    }
+
+    if (strcmp(argv[1], "--bounds") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "usage: %s --bounds <file.b3d> [iterations]\n", argv[0]);
+            return 1;
+        }
+
+        return benchmarkBounds(argv[2], (argc > 3 && atoi(argv[3]) > 0) ? atoi(argv[3]) : DEFAULT_ITERATIONS);
+    }
+
+    if (strcmp(argv[1], "--cull") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "usage: %s --cull <file.b3d> [iterations]\n", argv[0]);
+            return 1;
+        }
+
+        return benchmarkCulling(argv[2], (argc > 3 && atoi(argv[3]) > 0) ? atoi(argv[3]) : DEFAULT_ITERATIONS);
+    }
+
+    if (strcmp(argv[1], "--pvs") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "usage: %s --pvs <file.b3d> [cells [samples rays]]\n", argv[0]);
+            return 1;
+        }
+
+        return benchmarkPVS(argv[2], (argc > 3) ? (unsigned int)atoi(argv[3]) : 0,
+            (argc > 4) ? (unsigned int)atoi(argv[4]) : 0, (argc > 5) ? (unsigned int)atoi(argv[5]) : 0);
+    }
+
+    if (strcmp(argv[1], "--interleave") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "usage: %s --interleave <file.b3d> [iterations]\n", argv[0]);
+            return 1;
+        }
+
+        return benchmarkInterleave(argv[2], (argc > 3 && atoi(argv[3]) > 0) ? atoi(argv[3]) : DEFAULT_ITERATIONS);
+    }
+
+    if (strcmp(argv[1], "--raster") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "usage: %s --raster <file.b3d> [iterations [image.ppm]]\n", argv[0]);
+            return 1;
+        }
+
+        return benchmarkRaster(argv[2], (argc > 3 && atoi(argv[3]) > 0) ? atoi(argv[3]) : DEFAULT_ITERATIONS,
+            (argc > 4) ? argv[4] : NULL);
+    }
+
+    filePath = argv[1];
+    if (argc > 2) iterations = atoi(argv[2]);
+    if (iterations < 1) iterations = 1;
+
+    if (strcmp(filePath, "--kernels") == 0) {
+        benchmarkDecodeKernels(iterations);
+        return 0;
+    }
+
+    if (strcmp(filePath, "--containers") == 0) {
+        benchmarkContainers(iterations);
+        return 0;
+    }
+
+    if (strcmp(filePath, "--suite") == 0) {
+        benchmarkSuite(iterations);
+        return 0;
+    }
+
+    megabytes = getFileMegabytes(filePath);
+
+    printf("%s: %.2f MB, %d iterations, %s decode\n", filePath, megabytes, iterations,
+        getNameFromBulkDecodeKernel(getBulkDecodeKernel()));
+
+    benchmarkLoader("FILE*", filePath, 0, iterations, megabytes);
+    benchmarkLoader("mapped", filePath, BLITZ3D_LOAD_MAPPED, iterations, megabytes);
+
+    /* the same mapped load with every VRTS chunk forced through the generic decoder */
+    setSpecializedVertexDecodersEnabled(0);
+    benchmarkLoader("generic", filePath, BLITZ3D_LOAD_MAPPED, iterations, megabytes);
+    setSpecializedVertexDecodersEnabled(1);
+
+    benchmarkLoader("parallel", filePath, BLITZ3D_LOAD_PARALLEL, iterations, megabytes);
+    benchmarkLoader("index", filePath, BLITZ3D_LOAD_INDEX_ONLY, iterations, megabytes);
+    benchmarkLoader("short", filePath, BLITZ3D_LOAD_MAPPED | BLITZ3D_LOAD_SHORT_INDICES, iterations, megabytes);
+
+    benchmarkStream(filePath, iterations, megabytes);
+
+    printCacheWarmup(filePath);
+    benchmarkLoader("cached", filePath, BLITZ3D_LOAD_CACHED, iterations, megabytes);
+
+    printChunkMemory("mapped", filePath, BLITZ3D_LOAD_MAPPED);
+    printChunkMemory("short", filePath, BLITZ3D_LOAD_MAPPED | BLITZ3D_LOAD_SHORT_INDICES);
+
+    return 0;
+}
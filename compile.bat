@@ -2,11 +2,53 @@ set PATH=%PATH%;C:\MinGW\bin
 
 gcc -c Stack.c 2>compile.log
 
+gcc -c MappedFile.c 2>>compile.log
+
+gcc -c Arena.c 2>>compile.log
+
+gcc -c DynamicArray.c 2>>compile.log
+
+gcc -c ThreadPool.c 2>>compile.log
+
 gcc -c Blitz3DFile.c 2>>compile.log
 
+gcc -c Blitz3DVertexDecoders.c 2>>compile.log
+
+gcc -c Blitz3DBounds.c 2>>compile.log
+
+gcc -c Blitz3DCache.c 2>>compile.log
+
+gcc -c Blitz3DStream.c 2>>compile.log
+
+gcc -c Blitz3DOptimize.c 2>>compile.log
+
+gcc -c Blitz3DWriter.c 2>>compile.log
+
+gcc -c Blitz3DScene.c 2>>compile.log
+
+gcc -c Blitz3DBatch.c 2>>compile.log
+
+gcc -c Blitz3DBVH.c 2>>compile.log
+
+gcc -c Blitz3DPVS.c 2>>compile.log
+
+gcc -c Blitz3DInterleave.c 2>>compile.log
+
+gcc -c Blitz3DRasterizer.c 2>>compile.log
+
+gcc -c BulkDecode.c 2>>compile.log
+
+gcc -c SIMD.c 2>>compile.log
+
 gcc -IC:/resources/SDL2-2.0.3/i686-w64-mingw32/include/SDL2 -IC:/resources/lpng1522 -c -ansi display.c 2>>compile.log
 
-gcc -LC:/resources/SDL2-2.0.3/i686-w64-mingw32/lib -LC:/resources/lpng1522 -LC:/resources/zlib-1.2.8 -o LightmapViewer.exe display.o Stack.o Blitz3DFile.o -lmingw32 -lSDL2main -lSDL2 -lopengl32 -lglu32 -lpng -lz 2>>compile.log
+gcc -LC:/resources/SDL2-2.0.3/i686-w64-mingw32/lib -LC:/resources/lpng1522 -LC:/resources/zlib-1.2.8 -o LightmapViewer.exe display.o MappedFile.o Arena.o DynamicArray.o ThreadPool.o Blitz3DFile.o Blitz3DVertexDecoders.o Blitz3DBounds.o Blitz3DCache.o Blitz3DStream.o Blitz3DOptimize.o Blitz3DWriter.o Blitz3DScene.o Blitz3DBatch.o Blitz3DBVH.o Blitz3DPVS.o Blitz3DInterleave.o Blitz3DRasterizer.o BulkDecode.o SIMD.o -lmingw32 -lSDL2main -lSDL2 -lopengl32 -lglu32 -lpng -lz 2>>compile.log
+
+gcc -c Blitz3DGenerator.c 2>>compile.log
+
+gcc -c benchmark.c 2>>compile.log
+
+gcc -o Benchmark.exe benchmark.o Blitz3DGenerator.o Stack.o MappedFile.o Arena.o DynamicArray.o ThreadPool.o Blitz3DFile.o Blitz3DVertexDecoders.o Blitz3DBounds.o Blitz3DCache.o Blitz3DStream.o Blitz3DOptimize.o Blitz3DWriter.o Blitz3DScene.o Blitz3DBatch.o Blitz3DBVH.o Blitz3DPVS.o Blitz3DInterleave.o Blitz3DRasterizer.o BulkDecode.o SIMD.o -lpsapi 2>>compile.log
 
 type compile.log
 
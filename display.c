@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 
 #include <SDL.h>
 #include <SDL_opengl.h>
@@ -11,6 +13,11 @@
 #include <png.h>
 
 #include "Blitz3DFile.h"
+#include "Blitz3DScene.h"
+#include "Blitz3DBatch.h"
+#include "Blitz3DBVH.h"
+#include "Blitz3DPVS.h"
+#include "Blitz3DInterleave.h"
 
 /* program global variables */
 
@@ -28,10 +35,96 @@ const Uint8* keyPress;
 int quit = 0;
 
 B3DFile* b3dTest;
+Blitz3DScene* b3dScene;
+Blitz3DBatchSet* b3dBatches;
+Blitz3DBVH* b3dBVH;
+Blitz3DPVS* b3dPVS;
 int* textures;
 
 void (APIENTRY * glActiveTextureARB)(unsigned int) = NULL;
 void (APIENTRY * glClientActiveTextureARB)(unsigned int) = NULL;
+void (APIENTRY * glMultiTexCoord4fvARB)(unsigned int, const float*) = NULL;
+
+/* OpenGL 1.4; NULL where the driver lacks it, and the draws go one by one */
+void (APIENTRY * glMultiDrawElements)(GLenum, const GLsizei*, GLenum, const void* const*, GLsizei) = NULL;
+
+/* OpenGL 1.5 buffer objects; NULL where the driver lacks them, and the batches are drawn from client memory */
+void (APIENTRY * glGenBuffers)(GLsizei, GLuint*) = NULL;
+void (APIENTRY * glDeleteBuffers)(GLsizei, const GLuint*) = NULL;
+void (APIENTRY * glBindBuffer)(GLenum, GLuint) = NULL;
+void (APIENTRY * glBufferData)(GLenum, ptrdiff_t, const void*, GLenum) = NULL;
+
+/* OpenGL 3.0 vertex array objects; NULL where the driver lacks them, and the arrays are set up per draw */
+void (APIENTRY * glGenVertexArrays)(GLsizei, GLuint*) = NULL;
+void (APIENTRY * glDeleteVertexArrays)(GLsizei, const GLuint*) = NULL;
+void (APIENTRY * glBindVertexArray)(GLuint) = NULL;
+
+/* OpenGL 3.0 framebuffer objects (or the EXT extension), for --headless */
+void (APIENTRY * glGenFramebuffers)(GLsizei, GLuint*) = NULL;
+void (APIENTRY * glDeleteFramebuffers)(GLsizei, const GLuint*) = NULL;
+void (APIENTRY * glBindFramebuffer)(GLenum, GLuint) = NULL;
+GLenum (APIENTRY * glCheckFramebufferStatus)(GLenum) = NULL;
+void (APIENTRY * glGenRenderbuffers)(GLsizei, GLuint*) = NULL;
+void (APIENTRY * glDeleteRenderbuffers)(GLsizei, const GLuint*) = NULL;
+void (APIENTRY * glBindRenderbuffer)(GLenum, GLuint) = NULL;
+void (APIENTRY * glRenderbufferStorage)(GLenum, GLenum, GLsizei, GLsizei) = NULL;
+void (APIENTRY * glFramebufferRenderbuffer)(GLenum, GLenum, GLenum, GLuint) = NULL;
+
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#define GL_STATIC_DRAW 0x88E4
+#endif
+
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER 0x8D40
+#define GL_RENDERBUFFER 0x8D41
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#define GL_DEPTH_ATTACHMENT 0x8D00
+#endif
+
+#ifndef GL_DEPTH_COMPONENT24
+#define GL_DEPTH_COMPONENT24 0x81A6
+#endif
+
+/* retained buffers */
+
+/* commentary: each batch is uploaded once at load, its vertices interleaved in a vertex buffer (see
+   Blitz3DInterleave.h) and its indices in an index buffer, so a frame no longer hands the driver the
+   whole level to copy. Attributes the interleaving left out as constant are set once per draw.
+   Compact vertices are decoded by the pipeline: positions and tex coords are shorts put back in
+   place by the modelview and texture matrices, and colors are normalized bytes. The fixed-function
+   pipeline cannot unfold octahedral normals, and nothing here is lit, so those are left off.
+   With vertex array objects the array setup is recorded once per batch as well; without them the
+   pointers are still set per draw, but as offsets into the buffers. Without buffer objects, or when
+   started with --client-arrays, the batches are drawn from client memory as before */
+
+typedef struct BatchBuffers BatchBuffers;
+struct BatchBuffers {
+    GLuint vertexArray;
+    GLuint vertexBuffer, indexBuffer;
+
+    /* the layout of the vertex buffer and the constant attributes; the packed data itself is released */
+    Blitz3DInterleavedVertices* vertices;
+};
+
+BatchBuffers* b3dBatchBuffers = NULL;
+
+/* headless rendering */
+
+/* commentary: with --headless the viewer draws a fixed number of frames as fast as it can and prints
+   how long they took, for measuring the draw paths on machines with no display. SDL's offscreen video
+   driver (SDL 2.0.10 on, over EGL) is tried first, unless SDL_VIDEODRIVER names another; failing that
+   the usual driver opens a hidden window. Either way the frames go to a framebuffer object of the
+   window's size where the driver has them, since a hidden window's own pixels need not be drawn at all.
+   There is no input and no delay between frames: the camera stays at the start and turns once around
+   over the run, and each frame is timed from clearing to glFinish */
+
+#define HEADLESS_FRAME_COUNT 300
+
+GLuint offscreenFramebuffer = 0;
+GLuint offscreenRenderbuffers[2] = { 0, 0 };
 
 /* image structure */
 
@@ -160,6 +253,327 @@ Image* loadPNGImage(const char* filePath) {
 
 /* OpenGL draw code for Blitz3D level */
 
+void bindBrush(Blitz3DBRUSChunk* brusChunk, int brushId) {
+    Blitz3DBrush* brush;
+
+    if (brushId < 0) return;
+
+    brush = getBrushArrayEntryFromBRUSChunk(brusChunk, brushId);
+
+    /* texture unit n draws with tex coord set n */
+
+    glActiveTextureARB(GL_TEXTURE0_ARB);
+    glBindTexture(GL_TEXTURE_2D, textures[getTextureIdArrayEntryFromBrush(brush, getTextureLayerFromTexCoordSet(0))]);
+
+    glActiveTextureARB(GL_TEXTURE1_ARB);
+    glBindTexture(GL_TEXTURE_2D, textures[getTextureIdArrayEntryFromBrush(brush, getTextureLayerFromTexCoordSet(1))]);
+}
+
+/* points the fixed-function arrays at the batch's buffers, one stride apart, for the attributes packed there */
+
+GLenum getInterleavedComponentType(Blitz3DInterleavedVertices* vertices, unsigned int attribute) {
+    switch (getAttributeTypeFromInterleavedVertices(vertices, attribute)) {
+        case BLITZ3D_COMPONENTS_SHORT_RANGE: return GL_SHORT;
+        case BLITZ3D_COMPONENTS_UNSIGNED_BYTE: return GL_UNSIGNED_BYTE;
+    }
+
+    return GL_FLOAT;
+}
+
+void enableInterleavedArrays(BatchBuffers* buffers) {
+    Blitz3DInterleavedVertices* vertices = buffers->vertices;
+    GLsizei stride = (GLsizei)getStrideFromInterleavedVertices(vertices);
+    unsigned int set;
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffers->vertexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers->indexBuffer);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, getInterleavedComponentType(vertices, BLITZ3D_ATTRIBUTE_POSITION), stride,
+        (const void*)(size_t)getAttributeOffsetFromInterleavedVertices(vertices, BLITZ3D_ATTRIBUTE_POSITION));
+
+    if (getAttributeStateFromInterleavedVertices(vertices, BLITZ3D_ATTRIBUTE_NORMAL) == BLITZ3D_ATTRIBUTE_PACKED
+        && getAttributeTypeFromInterleavedVertices(vertices, BLITZ3D_ATTRIBUTE_NORMAL) == BLITZ3D_COMPONENTS_FLOAT) {
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, stride,
+            (const void*)(size_t)getAttributeOffsetFromInterleavedVertices(vertices, BLITZ3D_ATTRIBUTE_NORMAL));
+    }
+
+    if (getAttributeStateFromInterleavedVertices(vertices, BLITZ3D_ATTRIBUTE_COLOR) == BLITZ3D_ATTRIBUTE_PACKED) {
+        glEnableClientState(GL_COLOR_ARRAY);
+        glColorPointer(4, getInterleavedComponentType(vertices, BLITZ3D_ATTRIBUTE_COLOR), stride,
+            (const void*)(size_t)getAttributeOffsetFromInterleavedVertices(vertices, BLITZ3D_ATTRIBUTE_COLOR));
+    }
+
+    for (set = 0; set < 2; set++) {
+        unsigned int attribute = BLITZ3D_ATTRIBUTE_TEX_COORDS + set;
+
+        if (getAttributeStateFromInterleavedVertices(vertices, attribute) != BLITZ3D_ATTRIBUTE_PACKED) continue;
+
+        glClientActiveTextureARB(GL_TEXTURE0_ARB + set);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(getAttributeComponentCountFromInterleavedVertices(vertices, attribute),
+            getInterleavedComponentType(vertices, attribute), stride,
+            (const void*)(size_t)getAttributeOffsetFromInterleavedVertices(vertices, attribute));
+    }
+}
+
+/* multiplies the current matrix by the decode transform of a compact attribute: offset + scale * stored */
+
+void multiplyDecodeMatrix(Blitz3DInterleavedVertices* vertices, unsigned int attribute) {
+    unsigned int componentCount = getAttributeComponentCountFromInterleavedVertices(vertices, attribute);
+    float* offset = getAttributeDecodeOffsetFromInterleavedVertices(vertices, attribute);
+    float* scale = getAttributeDecodeScaleFromInterleavedVertices(vertices, attribute);
+
+    glTranslatef(offset[0], (componentCount > 1) ? offset[1] : 0.f, (componentCount > 2) ? offset[2] : 0.f);
+    glScalef(scale[0], (componentCount > 1) ? scale[1] : 1.f, (componentCount > 2) ? scale[2] : 1.f);
+}
+
+/* commentary: current values and matrices are not vertex array state, so they are set on every draw;
+   a color the brush does not read is white, as when no color array is given */
+
+void beginInterleavedDraw(BatchBuffers* buffers) {
+    Blitz3DInterleavedVertices* vertices = buffers->vertices;
+    unsigned int set, component;
+
+    if (getAttributeStateFromInterleavedVertices(vertices, BLITZ3D_ATTRIBUTE_COLOR) == BLITZ3D_ATTRIBUTE_CONSTANT) {
+        glColor4fv(getAttributeConstantFromInterleavedVertices(vertices, BLITZ3D_ATTRIBUTE_COLOR));
+    }
+    else glColor4f(1.f, 1.f, 1.f, 1.f);
+
+    if (getAttributeStateFromInterleavedVertices(vertices, BLITZ3D_ATTRIBUTE_NORMAL) == BLITZ3D_ATTRIBUTE_CONSTANT) {
+        glNormal3fv(getAttributeConstantFromInterleavedVertices(vertices, BLITZ3D_ATTRIBUTE_NORMAL));
+    }
+
+    for (set = 0; set < 2 && glMultiTexCoord4fvARB != NULL; set++) {
+        unsigned int attribute = BLITZ3D_ATTRIBUTE_TEX_COORDS + set;
+        float texCoord[4] = { 0.f, 0.f, 0.f, 1.f };
+
+        if (getAttributeStateFromInterleavedVertices(vertices, attribute) != BLITZ3D_ATTRIBUTE_CONSTANT) continue;
+
+        for (component = 0; component < getAttributeComponentCountFromInterleavedVertices(vertices, attribute);
+            component++) {
+            texCoord[component] = getAttributeConstantFromInterleavedVertices(vertices, attribute)[component];
+        }
+
+        glMultiTexCoord4fvARB(GL_TEXTURE0_ARB + set, texCoord);
+    }
+
+    for (set = 0; set < 2; set++) {
+        unsigned int attribute = BLITZ3D_ATTRIBUTE_TEX_COORDS + set;
+
+        if (getAttributeStateFromInterleavedVertices(vertices, attribute) != BLITZ3D_ATTRIBUTE_PACKED
+            || getAttributeTypeFromInterleavedVertices(vertices, attribute) != BLITZ3D_COMPONENTS_SHORT_RANGE) continue;
+
+        glActiveTextureARB(GL_TEXTURE0_ARB + set);
+        glMatrixMode(GL_TEXTURE);
+        glPushMatrix();
+        multiplyDecodeMatrix(vertices, attribute);
+    }
+
+    glMatrixMode(GL_MODELVIEW);
+
+    if (getAttributeTypeFromInterleavedVertices(vertices, BLITZ3D_ATTRIBUTE_POSITION)
+        == BLITZ3D_COMPONENTS_SHORT_RANGE) {
+        glPushMatrix();
+        multiplyDecodeMatrix(vertices, BLITZ3D_ATTRIBUTE_POSITION);
+    }
+}
+
+void endInterleavedDraw(BatchBuffers* buffers) {
+    Blitz3DInterleavedVertices* vertices = buffers->vertices;
+    unsigned int set;
+
+    if (getAttributeTypeFromInterleavedVertices(vertices, BLITZ3D_ATTRIBUTE_POSITION)
+        == BLITZ3D_COMPONENTS_SHORT_RANGE) {
+        glPopMatrix();
+    }
+
+    for (set = 0; set < 2; set++) {
+        unsigned int attribute = BLITZ3D_ATTRIBUTE_TEX_COORDS + set;
+
+        if (getAttributeStateFromInterleavedVertices(vertices, attribute) != BLITZ3D_ATTRIBUTE_PACKED
+            || getAttributeTypeFromInterleavedVertices(vertices, attribute) != BLITZ3D_COMPONENTS_SHORT_RANGE) continue;
+
+        glActiveTextureARB(GL_TEXTURE0_ARB + set);
+        glMatrixMode(GL_TEXTURE);
+        glPopMatrix();
+    }
+
+    glMatrixMode(GL_MODELVIEW);
+}
+
+/* points the fixed-function arrays at the batch's streams: into its buffers if it has them, else at client memory */
+
+void enableBatchArrays(Blitz3DBatch* batch, BatchBuffers* buffers) {
+    unsigned int texCoordComponentCount = getTexCoordArrayComponentCountFromBatch(batch);
+
+    if (buffers != NULL) {
+        enableInterleavedArrays(buffers);
+        return;
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, getVertexArrayFromBatch(batch));
+
+    if (getNormalArrayFromBatch(batch) != NULL) {
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, 0, getNormalArrayFromBatch(batch));
+    }
+
+    if (getColorArrayFromBatch(batch) != NULL) {
+        glEnableClientState(GL_COLOR_ARRAY);
+        glColorPointer(4, GL_FLOAT, 0, getColorArrayFromBatch(batch));
+    }
+
+    if (getTexCoordArrayCountFromBatch(batch) > 0) {
+        glClientActiveTextureARB(GL_TEXTURE0_ARB);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(texCoordComponentCount, GL_FLOAT, 0, getTexCoordArrayEntryFromBatch(batch, 0));
+    }
+
+    if (getTexCoordArrayCountFromBatch(batch) > 1) {
+        glClientActiveTextureARB(GL_TEXTURE1_ARB);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(texCoordComponentCount, GL_FLOAT, 0, getTexCoordArrayEntryFromBatch(batch, 1));
+    }
+}
+
+void disableBatchArrays() {
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+
+    glClientActiveTextureARB(GL_TEXTURE0_ARB);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    glClientActiveTextureARB(GL_TEXTURE1_ARB);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    if (glBindBuffer != NULL) {
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+}
+
+void freeBatchBuffers(BatchBuffers* buffers, unsigned int batchCount) {
+    unsigned int iter;
+
+    for (iter = 0; iter < batchCount; iter++) {
+        if (buffers[iter].vertexArray != 0) glDeleteVertexArrays(1, &(buffers[iter].vertexArray));
+        if (buffers[iter].vertexBuffer != 0) glDeleteBuffers(1, &(buffers[iter].vertexBuffer));
+        if (buffers[iter].indexBuffer != 0) glDeleteBuffers(1, &(buffers[iter].indexBuffer));
+        freeInterleavedVertices(buffers[iter].vertices);
+    }
+
+    free(buffers);
+}
+
+/* returns NULL without buffer objects, or if the driver (or the interleaving) ran out of memory */
+
+BatchBuffers* uploadBatches(Blitz3DBatchSet* batches, Blitz3DBRUSChunk* brusChunk, int compact) {
+    BatchBuffers* output;
+    unsigned int iter, batchCount = getBatchArrayCountFromBatchSet(batches);
+
+    if (glGenBuffers == NULL || glDeleteBuffers == NULL || glBindBuffer == NULL || glBufferData == NULL) return NULL;
+
+    output = (BatchBuffers*)calloc(batchCount + 1, sizeof(BatchBuffers));
+    if (output == NULL) return NULL;
+
+    while (glGetError() != GL_NO_ERROR);
+
+    for (iter = 0; iter < batchCount; iter++) {
+        Blitz3DBatch* batch = getBatchArrayEntryFromBatchSet(batches, iter);
+        BatchBuffers* buffers = &(output[iter]);
+        Blitz3DInterleavedVertices* vertices;
+
+        vertices = compact ? createCompactVerticesFromBatch(batch, brusChunk)
+            : createInterleavedVerticesFromBatch(batch, brusChunk);
+        if (vertices == NULL) {
+            freeBatchBuffers(output, batchCount);
+            return NULL;
+        }
+
+        buffers->vertices = vertices;
+
+        glGenBuffers(1, &(buffers->vertexBuffer));
+        glBindBuffer(GL_ARRAY_BUFFER, buffers->vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, (ptrdiff_t)((size_t)getVertexCountFromInterleavedVertices(vertices)
+            * getStrideFromInterleavedVertices(vertices)), getDataFromInterleavedVertices(vertices), GL_STATIC_DRAW);
+
+        releaseDataFromInterleavedVertices(vertices);
+
+        glGenBuffers(1, &(buffers->indexBuffer));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers->indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+            (ptrdiff_t)((size_t)getIndexCountFromBatch(batch) * getIndexSizeFromBatch(batch)),
+            (getIndexSizeFromBatch(batch) == 2) ? (const void*)getShortIndexArrayFromBatch(batch)
+            : (const void*)getIndexArrayFromBatch(batch), GL_STATIC_DRAW);
+
+        /* the vertex array object records the buffers, the pointers and the enabled arrays */
+        if (glGenVertexArrays != NULL && glDeleteVertexArrays != NULL && glBindVertexArray != NULL) {
+            glGenVertexArrays(1, &(buffers->vertexArray));
+            glBindVertexArray(buffers->vertexArray);
+            enableBatchArrays(batch, buffers);
+            glBindVertexArray(0);
+        }
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    if (glGetError() != GL_NO_ERROR) {
+        freeBatchBuffers(output, batchCount);
+        return NULL;
+    }
+
+    return output;
+}
+
+/* commentary: one draw per brush for the whole level, see Blitz3DBatch.h; with a BVH, only the runs
+   of the batch that survived culling are drawn, see Blitz3DBVH.h. With buffers the BVH hands out
+   offsets into the index buffer rather than pointers */
+
+void drawBatch(Blitz3DBatch* batch, unsigned int batchIndex, Blitz3DBVH* bvh, BatchBuffers* buffers,
+    Blitz3DBRUSChunk* brusChunk) {
+    GLenum indexType = (getIndexSizeFromBatch(batch) == 2) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    const void* indices = NULL;
+    unsigned int iter;
+
+    if (bvh != NULL && getDrawCountFromBVH(bvh, batchIndex) == 0) return;
+
+    if (buffers != NULL && buffers->vertexArray != 0) glBindVertexArray(buffers->vertexArray);
+    else enableBatchArrays(batch, buffers);
+
+    if (buffers == NULL) {
+        indices = (indexType == GL_UNSIGNED_SHORT) ? (const void*)getShortIndexArrayFromBatch(batch)
+            : (const void*)getIndexArrayFromBatch(batch);
+    }
+
+    if (buffers != NULL) beginInterleavedDraw(buffers);
+
+    bindBrush(brusChunk, getBrushIdFromBatch(batch));
+
+    if (bvh == NULL) {
+        glDrawElements(GL_TRIANGLES, getIndexCountFromBatch(batch), indexType, indices);
+    }
+    else if (glMultiDrawElements != NULL) {
+        glMultiDrawElements(GL_TRIANGLES, getDrawIndexCountArrayFromBVH(bvh, batchIndex), indexType,
+            getDrawIndexPointerArrayFromBVH(bvh, batchIndex), getDrawCountFromBVH(bvh, batchIndex));
+    }
+    else {
+        for (iter = 0; iter < getDrawCountFromBVH(bvh, batchIndex); iter++) {
+            glDrawElements(GL_TRIANGLES, getDrawIndexCountArrayFromBVH(bvh, batchIndex)[iter], indexType,
+                getDrawIndexPointerArrayFromBVH(bvh, batchIndex)[iter]);
+        }
+    }
+
+    if (buffers != NULL) endInterleavedDraw(buffers);
+
+    if (buffers != NULL && buffers->vertexArray != 0) glBindVertexArray(0);
+    else disableBatchArrays();
+}
+
 void drawMesh(Blitz3DMESHChunk* mesh) {
     unsigned int iter;
     unsigned int texCoordCount;
@@ -199,7 +613,6 @@ void drawMesh(Blitz3DMESHChunk* mesh) {
 
     for (iter = 0; iter < getTRISChunkArrayCountFromMESHChunk(mesh); iter++) {
         Blitz3DTRISChunk* trisChunk;
-        Blitz3DBrush* brush;
         int trisBrushId;
 
         trisChunk = getTRISChunkArrayEntryFromMESHChunk(mesh, iter);
@@ -207,18 +620,16 @@ void drawMesh(Blitz3DMESHChunk* mesh) {
         trisBrushId = getBrushIdFromTRISChunk(trisChunk);
         if (trisBrushId == -1) trisBrushId = meshBrushId;
 
-        brush = getBrushArrayEntryFromBRUSChunk(brusChunk, trisBrushId);
-
-        /* commentary: not sure why the brush textures seem reversed here! */
-
-        glActiveTextureARB(GL_TEXTURE0_ARB);
-        glBindTexture(GL_TEXTURE_2D, textures[getTextureIdArrayEntryFromBrush(brush, 1)]);
+        bindBrush(brusChunk, trisBrushId);
 
-        glActiveTextureARB(GL_TEXTURE1_ARB);
-        glBindTexture(GL_TEXTURE_2D, textures[getTextureIdArrayEntryFromBrush(brush, 0)]);
-
-        glDrawElements(GL_TRIANGLES, 3 * getTriangleCountFromTRISChunk(trisChunk),
-            GL_UNSIGNED_INT, getTriangleIndexArrayFromTRISChunk(trisChunk));
+        if (getIndexSizeFromTRISChunk(trisChunk) == 2) {
+            glDrawElements(GL_TRIANGLES, 3 * getTriangleCountFromTRISChunk(trisChunk),
+                GL_UNSIGNED_SHORT, getShortTriangleIndexArrayFromTRISChunk(trisChunk));
+        }
+        else {
+            glDrawElements(GL_TRIANGLES, 3 * getTriangleCountFromTRISChunk(trisChunk),
+                GL_UNSIGNED_INT, getTriangleIndexArrayFromTRISChunk(trisChunk));
+        }
     }
 
     glDisableClientState(GL_VERTEX_ARRAY);
@@ -232,26 +643,107 @@ void drawMesh(Blitz3DMESHChunk* mesh) {
     glDisableClientState(GL_TEXTURE_COORD_ARRAY);
 }
 
-void drawNode(Blitz3DNODEChunk* node) {
+/* the scene's nodes come parent first, so each is drawn with its world matrix straight on top of the view */
+
+void drawScene(Blitz3DScene* scene) {
     unsigned int iter;
 
-    /* commentary: still need to apply matrix transforms per node */
+    for (iter = 0; iter < getNodeCountFromScene(scene); iter++) {
+        if (getMESHChunkFromScene(scene, iter) == NULL) continue;
 
-    if (getMESHChunkFromNODEChunk(node) != NULL) {
-        drawMesh( getMESHChunkFromNODEChunk(node) );
-    }
+        glPushMatrix();
+        glMultMatrixf(getWorldMatrixFromScene(scene, iter));
 
-    for (iter = 0; iter < getNODEChunkArrayCountFromNodeChunk(node); iter++) {
-        drawNode( getNODEChunkArrayEntryFromNODEChunk(node, iter) );
+        drawMesh( getMESHChunkFromScene(scene, iter) );
+
+        glPopMatrix();
     }
 }
 
-void drawB3D(B3DFile* b3d) {
-    drawNode( getNODEChunkFromBB3DChunk( getBB3DChunkFromFile(b3d) ) );
+void drawB3D(B3DFile* b3d, Blitz3DScene* scene, Blitz3DBatchSet* batches, BatchBuffers* buffers, Blitz3DBVH* bvh) {
+    unsigned int iter;
+
+    /* the per-mesh path is kept for when batching runs out of memory; the batches are in world space */
+
+    if (batches != NULL) {
+        for (iter = 0; iter < getBatchArrayCountFromBatchSet(batches); iter++) {
+            drawBatch(getBatchArrayEntryFromBatchSet(batches, iter), iter, bvh,
+                (buffers != NULL) ? &(buffers[iter]) : NULL, getBRUSChunkFromBB3DChunk(getBB3DChunkFromFile(b3d)));
+        }
+    }
+    else if (scene != NULL) {
+        drawScene(scene);
+    }
 
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 }
 
+/* binds a framebuffer of the screen's size in place of the window's; returns 0 (drawing to the window)
+   if the driver has no framebuffer objects or the framebuffer is incomplete */
+
+GLuint createOffscreenFramebuffer() {
+    GLuint framebuffer;
+
+    if (glGenFramebuffers == NULL || glGenRenderbuffers == NULL) return 0;
+
+    glGenRenderbuffers(2, offscreenRenderbuffers);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreenRenderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SCREEN_WIDTH, SCREEN_HEIGHT);
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreenRenderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, SCREEN_WIDTH, SCREEN_HEIGHT);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenRenderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, offscreenRenderbuffers[1]);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(2, offscreenRenderbuffers);
+        return 0;
+    }
+
+    glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+    return framebuffer;
+}
+
+void freeOffscreenFramebuffer(GLuint framebuffer) {
+    if (framebuffer == 0) return;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(2, offscreenRenderbuffers);
+}
+
+int compareFrameTimes(const void* a, const void* b) {
+    double first = *(const double*)a, second = *(const double*)b;
+
+    return (first > second) - (first < second);
+}
+
+/* the first frame (uploads, first use of each texture) is shown apart from the rest; sorts the times */
+
+void printFrameTimes(double* frameTimes, unsigned int frameCount) {
+    double total = 0.0;
+    unsigned int iter, count = frameCount - 1;
+    double* times = frameTimes + 1;
+
+    printf("first frame %9.3f ms\n", frameTimes[0]);
+    if (count == 0) return;
+
+    for (iter = 0; iter < count; iter++) total += times[iter];
+
+    qsort(times, count, sizeof(double), compareFrameTimes);
+
+    printf("%u frames: mean %.3f ms (%.1f per second), min %.3f, median %.3f, 95th percentile %.3f, max %.3f ms\n",
+        count, total / count, 1000.0 * count / total, times[0], times[count / 2],
+        times[(count * 95) / 100], times[count - 1]);
+}
+
 int loadPNGTexture(char* filePath) {
     int texture;
     Image* pngImage = loadPNGImage(filePath);
@@ -349,24 +841,143 @@ int main(int argc, char* argv[]) {
     /* memory to store only the rotation transform of the view matrix */
     float viewRotation[16];
 
-    if (argc < 2) b3dFilePath = "test1/test1.b3d";
-    else b3dFilePath = argv[1];
+    /* the whole view, for culling */
+    float modelview[16], projection[16], frustumPlanes[24];
+    char windowTitle[160];
+
+    /* the camera in the level's space, and the cell of the potentially visible sets it is in */
+    float cameraPosition[3];
+    int cameraCell;
+    char* pvsPath;
+
+    /* the last frame's time from clearing to swapping, for comparing the draw paths */
+    Uint64 frameStart;
+    double frameMilliseconds = 0.0;
+
+    int clientArrays = 0, compactVertices = 0, usePVS = 0, argIter;
+
+    /* every frame's time when headless, and what they saw */
+    int headless = 0, offscreenDriver = 0;
+    unsigned int frameCount = HEADLESS_FRAME_COUNT, frameIndex = 0;
+    double* frameTimes = NULL;
+    double visibleTotal = 0.0;
+
+    /* a level path and, to draw from client memory instead of buffers, --client-arrays; --compact
+       uploads quantized vertices instead of floats, --pvs culls with the level's potentially visible sets
+       as well as the frustum, and --headless [frame count] draws without a window */
+    b3dFilePath = "test1/test1.b3d";
+
+    for (argIter = 1; argIter < argc; argIter++) {
+        if (strcmp(argv[argIter], "--client-arrays") == 0) clientArrays = 1;
+        else if (strcmp(argv[argIter], "--compact") == 0) compactVertices = 1;
+        else if (strcmp(argv[argIter], "--pvs") == 0) usePVS = 1;
+        else if (strcmp(argv[argIter], "--headless") == 0) {
+            headless = 1;
+            if (argIter + 1 < argc && atoi(argv[argIter + 1]) > 0) frameCount = (unsigned int)atoi(argv[++argIter]);
+        }
+        else b3dFilePath = argv[argIter];
+    }
+
+    if (headless) {
+        frameTimes = malloc(frameCount * sizeof(double));
+        if (frameTimes == NULL) error("out of memory for frame times");
+    }
+
+    /* the batches copy the meshes, so the meshes are only decoded long enough to be copied */
+    b3dTest = loadB3DFileWithFlags(b3dFilePath, BLITZ3D_LOAD_INDEX_ONLY | BLITZ3D_LOAD_SHORT_INDICES);
+    if (b3dTest == NULL) error("could not load the B3D file");
+    b3dScene = createSceneFromB3DFile(b3dTest);
+    b3dBatches = (b3dScene != NULL) ? createBatchSetFromScene(b3dScene) : NULL;
+
+    /* without a BVH (out of memory) every batch is drawn whole */
+    b3dBVH = (b3dBatches != NULL) ? createBVHFromBatchSet(b3dBatches) : NULL;
+
+    /* the sets are built offline (benchmark --pvs). They are sampled, so they can leave out a range seen
+       through a small gap, and they are only used when asked for; without them, or out of date, the
+       frustum culls alone */
+    b3dPVS = NULL;
 
-    b3dTest = loadB3DFile(b3dFilePath);
+    if (usePVS && b3dBVH != NULL) {
+        pvsPath = getPVSPathFromLevelPath(b3dFilePath);
+        b3dPVS = (pvsPath != NULL) ? loadPVSForBatchSet(pvsPath, b3dBatches) : NULL;
+        free(pvsPath);
+    }
 /*
     printf("textures:\n");
     printf("directory: %s\n", getDirectoryFromFile(b3dTest));
     printf("texture count: %d\n", getNumberOfTexturesFromBRUSChunk(getBRUSChunkFromBB3DChunk(getBB3DChunkFromFile(b3dTest))));
 */
-    SDL_Init(SDL_INIT_VIDEO);
+    if (headless && getenv("SDL_VIDEODRIVER") == NULL) offscreenDriver = (SDL_VideoInit("offscreen") == 0);
+    if (!offscreenDriver && SDL_Init(SDL_INIT_VIDEO) != 0) error(SDL_GetError());
 
     glWindow = SDL_CreateWindow("B3D Lightmap Viewer", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-        SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_OPENGL);
+        SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_OPENGL | (headless ? SDL_WINDOW_HIDDEN : 0));
+    if (glWindow == NULL) error(SDL_GetError());
 
     glContext = SDL_GL_CreateContext(glWindow);
+    if (glContext == NULL) error(SDL_GetError());
 
     glActiveTextureARB = SDL_GL_GetProcAddress("glActiveTextureARB");
     glClientActiveTextureARB = SDL_GL_GetProcAddress("glClientActiveTextureARB");
+    glMultiTexCoord4fvARB = SDL_GL_GetProcAddress("glMultiTexCoord4fvARB");
+
+    glMultiDrawElements = SDL_GL_GetProcAddress("glMultiDrawElements");
+    if (glMultiDrawElements == NULL) glMultiDrawElements = SDL_GL_GetProcAddress("glMultiDrawElementsEXT");
+
+    glGenBuffers = SDL_GL_GetProcAddress("glGenBuffers");
+    if (glGenBuffers == NULL) glGenBuffers = SDL_GL_GetProcAddress("glGenBuffersARB");
+    glDeleteBuffers = SDL_GL_GetProcAddress("glDeleteBuffers");
+    if (glDeleteBuffers == NULL) glDeleteBuffers = SDL_GL_GetProcAddress("glDeleteBuffersARB");
+    glBindBuffer = SDL_GL_GetProcAddress("glBindBuffer");
+    if (glBindBuffer == NULL) glBindBuffer = SDL_GL_GetProcAddress("glBindBufferARB");
+    glBufferData = SDL_GL_GetProcAddress("glBufferData");
+    if (glBufferData == NULL) glBufferData = SDL_GL_GetProcAddress("glBufferDataARB");
+
+    glGenVertexArrays = SDL_GL_GetProcAddress("glGenVertexArrays");
+    glDeleteVertexArrays = SDL_GL_GetProcAddress("glDeleteVertexArrays");
+    glBindVertexArray = SDL_GL_GetProcAddress("glBindVertexArray");
+
+    if (headless) {
+        glGenFramebuffers = SDL_GL_GetProcAddress("glGenFramebuffers");
+        if (glGenFramebuffers == NULL) glGenFramebuffers = SDL_GL_GetProcAddress("glGenFramebuffersEXT");
+        glDeleteFramebuffers = SDL_GL_GetProcAddress("glDeleteFramebuffers");
+        if (glDeleteFramebuffers == NULL) glDeleteFramebuffers = SDL_GL_GetProcAddress("glDeleteFramebuffersEXT");
+        glBindFramebuffer = SDL_GL_GetProcAddress("glBindFramebuffer");
+        if (glBindFramebuffer == NULL) glBindFramebuffer = SDL_GL_GetProcAddress("glBindFramebufferEXT");
+        glCheckFramebufferStatus = SDL_GL_GetProcAddress("glCheckFramebufferStatus");
+        if (glCheckFramebufferStatus == NULL) {
+            glCheckFramebufferStatus = SDL_GL_GetProcAddress("glCheckFramebufferStatusEXT");
+        }
+        glGenRenderbuffers = SDL_GL_GetProcAddress("glGenRenderbuffers");
+        if (glGenRenderbuffers == NULL) glGenRenderbuffers = SDL_GL_GetProcAddress("glGenRenderbuffersEXT");
+        glDeleteRenderbuffers = SDL_GL_GetProcAddress("glDeleteRenderbuffers");
+        if (glDeleteRenderbuffers == NULL) glDeleteRenderbuffers = SDL_GL_GetProcAddress("glDeleteRenderbuffersEXT");
+        glBindRenderbuffer = SDL_GL_GetProcAddress("glBindRenderbuffer");
+        if (glBindRenderbuffer == NULL) glBindRenderbuffer = SDL_GL_GetProcAddress("glBindRenderbufferEXT");
+        glRenderbufferStorage = SDL_GL_GetProcAddress("glRenderbufferStorage");
+        if (glRenderbufferStorage == NULL) glRenderbufferStorage = SDL_GL_GetProcAddress("glRenderbufferStorageEXT");
+        glFramebufferRenderbuffer = SDL_GL_GetProcAddress("glFramebufferRenderbuffer");
+        if (glFramebufferRenderbuffer == NULL) {
+            glFramebufferRenderbuffer = SDL_GL_GetProcAddress("glFramebufferRenderbufferEXT");
+        }
+
+        offscreenFramebuffer = createOffscreenFramebuffer();
+
+        /* a hidden window's swaps are never made, but nothing should wait on a vertical blank either */
+        SDL_GL_SetSwapInterval(0);
+
+        printf("headless, %s, drawing to %s, %s, %s vertices\n",
+            offscreenDriver ? "offscreen video driver" : "hidden window",
+            (offscreenFramebuffer != 0) ? "a framebuffer object" : "the window",
+            clientArrays ? "client arrays" : "buffers", compactVertices ? "compact" : "float");
+    }
+
+    /* the batches go to the driver once, and the BVH's draws become offsets into their index buffers */
+    if (b3dBatches != NULL && !clientArrays) {
+        b3dBatchBuffers = uploadBatches(b3dBatches, getBRUSChunkFromBB3DChunk(getBB3DChunkFromFile(b3dTest)),
+            compactVertices);
+    }
+    if (b3dBatchBuffers != NULL && b3dBVH != NULL) useIndexOffsetsInBVH(b3dBVH, 1);
 
     keyPress = SDL_GetKeyboardState(NULL);
 
@@ -407,7 +1018,13 @@ int main(int argc, char* argv[]) {
 
         if (keyPress[SDL_SCANCODE_ESCAPE]) quit = 1;
 
-        mouseStates = SDL_GetRelativeMouseState(&differentialX, &differentialY);
+        /* headless, the camera only turns, a frame's worth of a full turn at a time */
+        if (headless) {
+            if (frameIndex == frameCount) break;
+            angleY = 360.f * frameIndex / frameCount;
+        }
+
+        mouseStates = headless ? 0 : SDL_GetRelativeMouseState(&differentialX, &differentialY);
 
         /* change camera orientation when mouse dragged */
         if (mouseStates & SDL_BUTTON(SDL_BUTTON_LEFT)) {
@@ -461,6 +1078,8 @@ int main(int argc, char* argv[]) {
             angleY = 0.f;
         }
 
+        frameStart = SDL_GetPerformanceCounter();
+
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         /* construct the view matrix */
@@ -471,15 +1090,69 @@ int main(int argc, char* argv[]) {
         glTranslatef(-positionX, -positionY, -positionZ);
         glScalef(1.f, 1.f, -1.f);
 
-        drawB3D(b3dTest);
+        /* cull the level against the view just built, and show what it saved */
+        if (b3dBVH != NULL) {
+            glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+            glGetFloatv(GL_PROJECTION_MATRIX, projection);
+
+            getFrustumPlanesFromMatrices(projection, modelview, frustumPlanes);
+
+            /* the scale above flips z, so the level sees the camera at -positionZ */
+            cameraPosition[0] = positionX;
+            cameraPosition[1] = positionY;
+            cameraPosition[2] = -positionZ;
+            cameraCell = (b3dPVS != NULL) ? getCellIndexFromPVS(b3dPVS, cameraPosition) : -1;
 
-        SDL_GL_SwapWindow(glWindow);
-        SDL_Delay(16);
+            /* outside the grid nothing can be ruled out */
+            cullBVHWithinRanges(b3dBVH, frustumPlanes,
+                (cameraCell >= 0) ? getVisibleRangesFromPVS(b3dPVS, (unsigned int)cameraCell) : NULL);
+
+            sprintf(windowTitle, "B3D Lightmap Viewer - %u visible, %u culled (%u by the PVS), %u total, %.2f ms %s",
+                getVisibleCountFromBVH(b3dBVH), getCulledCountFromBVH(b3dBVH),
+                getFrustumVisibleCountFromBVH(b3dBVH) - getVisibleCountFromBVH(b3dBVH), getItemCountFromBVH(b3dBVH),
+                frameMilliseconds, (b3dBatchBuffers != NULL) ? "buffers" : "client arrays");
+            if (!headless) SDL_SetWindowTitle(glWindow, windowTitle);
+        }
+
+        drawB3D(b3dTest, b3dScene, b3dBatches, b3dBatchBuffers, b3dBVH);
+
+        if (headless) glFinish();
+        else SDL_GL_SwapWindow(glWindow);
+
+        frameMilliseconds = 1000.0 * (SDL_GetPerformanceCounter() - frameStart) / SDL_GetPerformanceFrequency();
+
+        if (headless) {
+            frameTimes[frameIndex++] = frameMilliseconds;
+            if (b3dBVH != NULL) visibleTotal += getVisibleCountFromBVH(b3dBVH);
+        }
+        else {
+            SDL_Delay(16);
+        }
+    }
+
+    if (headless) {
+        if (frameIndex == frameCount) {
+            printFrameTimes(frameTimes, frameCount);
+            if (b3dBVH != NULL) printf("visible ranges per frame %.1f\n", visibleTotal / frameCount);
+        }
+        free(frameTimes);
+        freeOffscreenFramebuffer(offscreenFramebuffer);
     }
 
-    /* commentary: still need to clear the loaded data from memory */
+    glDeleteTextures(getTextureArrayCountFromTEXSChunk(getTEXSChunkFromBB3DChunk(getBB3DChunkFromFile(b3dTest))), textures);
+    free(textures);
+
+    if (b3dBatchBuffers != NULL) freeBatchBuffers(b3dBatchBuffers, getBatchArrayCountFromBatchSet(b3dBatches));
+    if (b3dPVS != NULL) freePVS(b3dPVS);
+    if (b3dBVH != NULL) freeBVH(b3dBVH);
+    if (b3dBatches != NULL) freeBatchSet(b3dBatches);
+    if (b3dScene != NULL) freeScene(b3dScene);
+    freeB3DFile(b3dTest);
 
     SDL_DestroyWindow(glWindow);
+
+    /* the offscreen driver was started on its own, so SDL_Quit would leave it running */
+    if (offscreenDriver) SDL_VideoQuit();
     SDL_Quit();
 
     return 0;